@@ -0,0 +1,191 @@
+#include "physics_batch.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include "LinearMath/btThreads.h"
+#include "Bullet3Common/b3ParallelFor.h"
+#include "Bullet3Collision/NarrowPhaseCollision/b3Config.h"
+#include "Bullet3Collision/NarrowPhaseCollision/b3CpuNarrowPhase.h"
+#include "Bullet3Collision/BroadPhaseCollision/b3DynamicBvhBroadphase.h"
+#include "Bullet3Collision/NarrowPhaseCollision/shared/b3RigidBodyData.h"
+#include "Bullet3Dynamics/b3CpuRigidBodyPipeline.h"
+
+namespace GR
+{
+	namespace
+	{
+		constexpr double FixedStep = 1.0 / 60.0;
+		constexpr int SolverIterations = 20;  // Jacobi batches converge slower than sequential impulses
+
+		struct ParallelForAdapter : public btIParallelForBody
+		{
+			const b3IParallelForBody* body;
+
+			void forLoop(int iBegin, int iEnd) const override
+			{
+				body->forLoop(iBegin, iEnd);
+			}
+		};
+
+		void BulletParallelFor(int iBegin, int iEnd, int grainSize, const b3IParallelForBody& body)
+		{
+			ParallelForAdapter adapter;
+			adapter.body = &body;
+			btParallelFor(iBegin, iEnd, grainSize, adapter);
+		}
+	};
+
+	BatchPhysics::BatchPhysics()
+		: m_NarrowPhase(nullptr), m_Broadphase(nullptr), m_Pipeline(nullptr), m_Origin(0.0), m_Accumulator(0.0)
+	{
+		b3SetCustomParallelForFunc(BulletParallelFor);
+	}
+
+	BatchPhysics::~BatchPhysics()
+	{
+		Destroy();
+	}
+
+	void BatchPhysics::Destroy()
+	{
+		delete m_Pipeline;
+		delete m_Broadphase;
+		delete m_NarrowPhase;
+
+		m_Pipeline = nullptr;
+		m_Broadphase = nullptr;
+		m_NarrowPhase = nullptr;
+
+		m_Ids.clear();
+		m_BoxShapes.clear();
+		m_SphereShapes.clear();
+	}
+
+	void BatchPhysics::Reset(const glm::dvec3& Origin, double SurfaceRadius, float Gravity)
+	{
+		Destroy();
+
+		const glm::dvec3 up = glm::normalize(Origin);
+		m_Origin = up * SurfaceRadius;
+		m_Accumulator = 0.0;
+
+		b3Config config;
+		m_NarrowPhase = new b3CpuNarrowPhase(config);
+		m_Broadphase = new b3DynamicBvhBroadphase(config.m_maxConvexBodies);
+		m_Pipeline = new b3CpuRigidBodyPipeline(m_NarrowPhase, m_Broadphase, config);
+		m_Pipeline->setNumSolverIterations(SolverIterations);
+
+		// the origin is on the surface, so the tangent plane passes through the local origin
+		const b3Vector3 normal = b3MakeVector3(float(up.x), float(up.y), float(up.z));
+		int ground = m_NarrowPhase->registerPlaneShape(normal, 0.f);
+
+		const float position[3] = {0.f, 0.f, 0.f};
+		const float orientation[4] = {0.f, 0.f, 0.f, 1.f};
+		m_Pipeline->registerPhysicsInstance(0.f, position, orientation, ground, -1);
+
+		const float gravity[3] = {float(-up.x * Gravity), float(-up.y * Gravity), float(-up.z * Gravity)};
+		m_Pipeline->setGravity(gravity);
+	}
+
+	int BatchPhysics::AddBody(int Collidable, float Mass, const glm::dmat4& Transform, uint32_t Id)
+	{
+		if (Collidable < 0)
+		{
+			return -1;
+		}
+
+		const glm::dvec3 offset = glm::dvec3(Transform[3]) - m_Origin;
+		const glm::quat rotation = glm::quat_cast(glm::mat3(Transform));
+		const float position[3] = {float(offset.x), float(offset.y), float(offset.z)};
+		const float orientation[4] = {rotation.x, rotation.y, rotation.z, rotation.w};
+
+		// body 0 is the ground
+		if (m_Pipeline->registerPhysicsInstance(Mass, position, orientation, Collidable, int(m_Ids.size())) < 0)
+		{
+			return -1;
+		}
+		m_Ids.push_back(Id);
+
+		return int(m_Ids.size()) - 1;
+	}
+
+	int BatchPhysics::AddBox(const glm::vec3& HalfExtents, float Mass, const glm::dmat4& Transform, uint32_t Id)
+	{
+		const std::array<float, 3> key = {HalfExtents.x, HalfExtents.y, HalfExtents.z};
+		auto shape = m_BoxShapes.find(key);
+		if (shape == m_BoxShapes.end())
+		{
+			float vertices[8 * 4];
+			for (int i = 0; i < 8; i++)
+			{
+				vertices[i * 4 + 0] = (i & 1) ? HalfExtents.x : -HalfExtents.x;
+				vertices[i * 4 + 1] = (i & 2) ? HalfExtents.y : -HalfExtents.y;
+				vertices[i * 4 + 2] = (i & 4) ? HalfExtents.z : -HalfExtents.z;
+				vertices[i * 4 + 3] = 0.f;
+			}
+			const float scaling[3] = {1.f, 1.f, 1.f};
+			shape = m_BoxShapes.emplace(key, m_NarrowPhase->registerConvexHullShape(vertices, sizeof(float) * 4, 8, scaling)).first;
+		}
+
+		return AddBody(shape->second, Mass, Transform, Id);
+	}
+
+	int BatchPhysics::AddSphere(float Radius, float Mass, const glm::dmat4& Transform, uint32_t Id)
+	{
+		auto shape = m_SphereShapes.find(Radius);
+		if (shape == m_SphereShapes.end())
+		{
+			shape = m_SphereShapes.emplace(Radius, m_NarrowPhase->registerSphereShape(Radius)).first;
+		}
+
+		return AddBody(shape->second, Mass, Transform, Id);
+	}
+
+	void BatchPhysics::SetMaterial(int Index, float Friction, float Restitution)
+	{
+		m_Pipeline->setBodyMaterial(Index + 1, Friction, Restitution);
+	}
+
+	void BatchPhysics::SetVelocity(int Index, const glm::vec3& Linear, const glm::vec3& Angular)
+	{
+		m_Pipeline->setBodyVelocity(Index + 1, &Linear.x, &Angular.x);
+	}
+
+	void BatchPhysics::Step(double Delta, int MaxSubSteps)
+	{
+		if (!m_Pipeline)
+		{
+			return;
+		}
+
+		m_Accumulator += Delta;
+		int steps = 0;
+		while (m_Accumulator >= FixedStep && steps < MaxSubSteps)
+		{
+			m_Pipeline->stepSimulation(float(FixedStep));
+			m_Accumulator -= FixedStep;
+			steps++;
+		}
+
+		// don't build up a backlog on slow frames
+		if (steps == MaxSubSteps)
+		{
+			m_Accumulator = 0.0;
+		}
+	}
+
+	int BatchPhysics::GetNumBodies() const
+	{
+		return int(m_Ids.size());
+	}
+
+	glm::dmat4 BatchPhysics::GetTransform(int Index) const
+	{
+		const b3RigidBodyData& body = m_Pipeline->getBodyBuffer()[Index + 1];
+		const glm::dquat rotation = glm::dquat(body.m_quat.w, body.m_quat.x, body.m_quat.y, body.m_quat.z);
+
+		glm::dmat4 T = glm::dmat4(glm::mat3_cast(rotation));
+		T[3] = glm::dvec4(m_Origin + glm::dvec3(body.m_pos.x, body.m_pos.y, body.m_pos.z), 1.0);
+
+		return T;
+	}
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <array>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+class b3CpuNarrowPhase;
+class b3CpuRigidBodyPipeline;
+struct b3DynamicBvhBroadphase;
+
+namespace GR
+{
+	// Bullet3 CPU rigid body pipeline as a second backend for scenes with many simple dynamic bodies.
+	//
+	// The pipeline works in single precision, so it simulates a local region: positions are offsets from an
+	// origin on the planet surface, the ground is the tangent plane at that origin and gravity points down
+	// along its normal. Only boxes and spheres are supported, no constraints, no sleeping. The stages run
+	// through btParallelFor on the task scheduler that PhysicsWorld installs.
+	class BatchPhysics
+	{
+	public:
+		BatchPhysics();
+
+		~BatchPhysics();
+
+		// Drop all bodies and start a new region. Origin is projected onto the surface of radius SurfaceRadius.
+		void Reset(const glm::dvec3& Origin, double SurfaceRadius, float Gravity);
+
+		bool IsEnabled() const { return m_Pipeline != nullptr; }
+
+		// Transform is in world space, returns the body index or -1
+		int AddBox(const glm::vec3& HalfExtents, float Mass, const glm::dmat4& Transform, uint32_t Id);
+
+		int AddSphere(float Radius, float Mass, const glm::dmat4& Transform, uint32_t Id);
+
+		void SetMaterial(int Index, float Friction, float Restitution);
+
+		void SetVelocity(int Index, const glm::vec3& Linear, const glm::vec3& Angular);
+
+		// fixed steps of 1/60 s, at most MaxSubSteps per call, the remainder is carried to the next call
+		void Step(double Delta, int MaxSubSteps = 10);
+
+		int GetNumBodies() const;
+
+		// the ground plane is not counted, indices start at 0
+		glm::dmat4 GetTransform(int Index) const;
+
+		uint32_t GetId(int Index) const { return m_Ids[Index]; }
+
+		const glm::dvec3& GetOrigin() const { return m_Origin; }
+
+	private:
+		BatchPhysics(const BatchPhysics&) = delete;
+		BatchPhysics& operator=(const BatchPhysics&) = delete;
+
+		void Destroy();
+
+		int AddBody(int Collidable, float Mass, const glm::dmat4& Transform, uint32_t Id);
+
+		b3CpuNarrowPhase* m_NarrowPhase;
+		b3DynamicBvhBroadphase* m_Broadphase;
+		b3CpuRigidBodyPipeline* m_Pipeline;
+
+		glm::dvec3 m_Origin;
+		double m_Accumulator;
+		std::vector<uint32_t> m_Ids;
+		std::map<std::array<float, 3>, int> m_BoxShapes;  // collidable by half extents
+		std::map<float, int> m_SphereShapes;  // collidable by radius
+	};
+};
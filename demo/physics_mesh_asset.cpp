@@ -0,0 +1,377 @@
+#include "physics_mesh_asset.hpp"
+#include "BulletCollision/CollisionDispatch/btInternalEdgeUtility.h"
+#include "LinearMath/btThreads.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GR
+{
+	namespace
+	{
+		const char CollisionMeshMagic[8] = {'G', 'R', 'P', 'H', 'Y', 'S', 'C', 'M'};
+
+		uint64_t AlignOffset(uint64_t Offset)
+		{
+			return (Offset + CollisionMesh::Alignment - 1) & ~uint64_t(CollisionMesh::Alignment - 1);
+		}
+
+		// all parts of Mesh with its scaling applied, the indices of later parts are offset by the vertices before
+		bool FlattenMesh(const btStridingMeshInterface& Mesh, btAlignedObjectArray<btScalar>& Vertices, btAlignedObjectArray<int32_t>& Indices)
+		{
+			const btVector3 scaling = Mesh.getScaling();
+			for (int part = 0; part < Mesh.getNumSubParts(); ++part)
+			{
+				const unsigned char* vertexBase;
+				const unsigned char* indexBase;
+				int numVertices, vertexStride, indexStride, numTriangles;
+				PHY_ScalarType vertexType, indexType;
+				Mesh.getLockedReadOnlyVertexIndexBase(&vertexBase, numVertices, vertexType, vertexStride, &indexBase, indexStride, numTriangles, indexType, part);
+
+				const int firstVertex = Vertices.size() / 3;
+				bool supported = (vertexType == PHY_FLOAT || vertexType == PHY_DOUBLE) &&
+								 (indexType == PHY_INTEGER || indexType == PHY_SHORT || indexType == PHY_UCHAR);
+				if (supported)
+				{
+					for (int i = 0; i < numVertices; ++i)
+					{
+						const unsigned char* vertex = vertexBase + size_t(i) * vertexStride;
+						for (int k = 0; k < 3; ++k)
+						{
+							const btScalar value = vertexType == PHY_FLOAT ? btScalar(reinterpret_cast<const float*>(vertex)[k])
+																		   : btScalar(reinterpret_cast<const double*>(vertex)[k]);
+							Vertices.push_back(value * scaling[k]);
+						}
+					}
+
+					for (int i = 0; i < numTriangles && supported; ++i)
+					{
+						const unsigned char* triangle = indexBase + size_t(i) * indexStride;
+						for (int k = 0; k < 3; ++k)
+						{
+							int index;
+							switch (indexType)
+							{
+								case PHY_INTEGER:
+									index = reinterpret_cast<const int*>(triangle)[k];
+									break;
+								case PHY_SHORT:
+									index = reinterpret_cast<const unsigned short*>(triangle)[k];
+									break;
+								default:
+									index = triangle[k];
+									break;
+							}
+							supported = supported && index >= 0 && index < numVertices;
+							Indices.push_back(int32_t(firstVertex + index));
+						}
+					}
+				}
+				Mesh.unLockReadOnlyVertexBase(part);
+
+				if (!supported)
+				{
+					return false;
+				}
+			}
+
+			return Indices.size() > 0;
+		}
+	};
+
+	bool CookCollisionMesh(const char* Path, const btStridingMeshInterface& Mesh, const CollisionMesh::CookOptions& Options)
+	{
+		btAlignedObjectArray<btScalar> vertices;
+		btAlignedObjectArray<int32_t> indices;
+		if (!FlattenMesh(Mesh, vertices, indices))
+		{
+			return false;
+		}
+		const int numVertices = vertices.size() / 3;
+		const int numTriangles = indices.size() / 3;
+
+		btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+		for (int i = 0; i < numVertices; ++i)
+		{
+			const btVector3 vertex(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+			aabbMin.setMin(vertex);
+			aabbMax.setMax(vertex);
+		}
+
+		// the loader builds the shape over the same flat mesh with the same premade aabb, so the bvh quantization matches
+		btTriangleIndexVertexArray flat(numTriangles, &indices[0], 3 * sizeof(int32_t), numVertices, &vertices[0], 3 * sizeof(btScalar));
+		flat.setPremadeAabb(aabbMin, aabbMax);
+		// the bvh build and btGenerateInternalEdgeInfoMt run through btParallelFor, the result doesn't depend on the scheduler
+		const bool installScheduler = btGetTaskScheduler() == nullptr;
+		if (installScheduler)
+		{
+			btSetTaskScheduler(btGetSequentialTaskScheduler());
+		}
+
+		btBvhTriangleMeshShape shape(&flat, true, true, Options.buildMode);
+
+		btTriangleInfoMap triangleInfoMap;
+		if (Options.internalEdgeInfo)
+		{
+			if (Options.triangleInfoMap)
+			{
+				triangleInfoMap.m_convexEpsilon = Options.triangleInfoMap->m_convexEpsilon;
+				triangleInfoMap.m_planarEpsilon = Options.triangleInfoMap->m_planarEpsilon;
+				triangleInfoMap.m_equalVertexThreshold = Options.triangleInfoMap->m_equalVertexThreshold;
+				triangleInfoMap.m_edgeDistanceThreshold = Options.triangleInfoMap->m_edgeDistanceThreshold;
+				triangleInfoMap.m_maxEdgeAngleThreshold = Options.triangleInfoMap->m_maxEdgeAngleThreshold;
+				triangleInfoMap.m_zeroAreaThreshold = Options.triangleInfoMap->m_zeroAreaThreshold;
+			}
+			btGenerateInternalEdgeInfoMt(&shape, &triangleInfoMap);
+		}
+		if (installScheduler)
+		{
+			btSetTaskScheduler(nullptr);
+		}
+
+		CollisionMesh::Header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, CollisionMeshMagic, sizeof(CollisionMeshMagic));
+		header.version = CollisionMesh::Version;
+		header.scalarSize = sizeof(btScalar);
+		header.endianTag = CollisionMesh::EndianTag;
+		header.numVertices = uint32_t(numVertices);
+		header.numTriangles = uint32_t(numTriangles);
+		for (int i = 0; i < 3; ++i)
+		{
+			header.aabbMin[i] = aabbMin[i];
+			header.aabbMax[i] = aabbMax[i];
+		}
+
+		const btOptimizedBvh* bvh = shape.getOptimizedBvh();
+		header.sectionSizes[CollisionMesh::Vertices] = uint64_t(numVertices) * 3 * sizeof(btScalar);
+		header.sectionSizes[CollisionMesh::Indices] = uint64_t(numTriangles) * 3 * sizeof(int32_t);
+		header.sectionSizes[CollisionMesh::Bvh] = bvh->calculateSerializeBufferSize();
+		header.sectionSizes[CollisionMesh::TriangleInfoMap] = Options.internalEdgeInfo ? triangleInfoMap.calculateSerializeInPlaceBufferSize() : 0;
+
+		uint64_t offset = AlignOffset(sizeof(CollisionMesh::Header));
+		for (int i = 0; i < CollisionMesh::SectionCount; ++i)
+		{
+			header.sections[i] = offset;
+			offset = AlignOffset(offset + header.sectionSizes[i]);
+		}
+		header.fileSize = offset;
+
+		btAlignedObjectArray<char> data;
+		data.resize(int(header.fileSize), 0);
+		memcpy(&data[0], &header, sizeof(header));
+		memcpy(&data[0] + header.sections[CollisionMesh::Vertices], &vertices[0], size_t(header.sectionSizes[CollisionMesh::Vertices]));
+		memcpy(&data[0] + header.sections[CollisionMesh::Indices], &indices[0], size_t(header.sectionSizes[CollisionMesh::Indices]));
+		bvh->serializeInPlace(&data[0] + header.sections[CollisionMesh::Bvh], unsigned(header.sectionSizes[CollisionMesh::Bvh]), false);
+		if (Options.internalEdgeInfo)
+		{
+			triangleInfoMap.serializeInPlace(&data[0] + header.sections[CollisionMesh::TriangleInfoMap]);
+		}
+
+		FILE* file = fopen(Path, "wb");
+		if (!file)
+		{
+			return false;
+		}
+		const bool written = fwrite(&data[0], 1, size_t(header.fileSize), file) == size_t(header.fileSize);
+
+		return fclose(file) == 0 && written;
+	}
+
+	CollisionMeshAsset::CollisionMeshAsset()
+		: m_Data(nullptr), m_Size(0), m_Mesh(nullptr), m_Bvh(nullptr), m_TriangleInfoMap(nullptr), m_Shape(nullptr)
+	{
+	}
+
+	CollisionMeshAsset::~CollisionMeshAsset()
+	{
+		Close();
+	}
+
+	bool CollisionMeshAsset::Open(const char* Path)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		{
+			mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		}
+		CloseHandle(file);
+		if (!mapping)
+		{
+			return false;
+		}
+
+		// the view keeps the mapping object alive
+		void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!data)
+		{
+			return false;
+		}
+		m_Size = size_t(size.QuadPart);
+#else
+		int file = open(Path, O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat info;
+		void* data = MAP_FAILED;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+		{
+			data = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		}
+		close(file);
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+		m_Size = size_t(info.st_size);
+#endif
+		m_Data = static_cast<char*>(data);
+
+		if (!Validate() || !CreateShape())
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void CollisionMeshAsset::Close()
+	{
+		delete m_Shape;
+		delete m_TriangleInfoMap;
+		// constructed in place, its arrays don't own their memory
+		if (m_Bvh)
+		{
+			m_Bvh->~btOptimizedBvh();
+		}
+		delete m_Mesh;
+
+		if (m_Data)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(m_Data);
+#else
+			munmap(m_Data, m_Size);
+#endif
+		}
+		m_Shape = nullptr;
+		m_TriangleInfoMap = nullptr;
+		m_Bvh = nullptr;
+		m_Mesh = nullptr;
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	bool CollisionMeshAsset::Validate() const
+	{
+		if (!m_Data || m_Size < sizeof(CollisionMesh::Header))
+		{
+			return false;
+		}
+
+		const CollisionMesh::Header& header = GetHeader();
+		if (memcmp(header.magic, CollisionMeshMagic, sizeof(CollisionMeshMagic)) != 0 || header.version != CollisionMesh::Version ||
+			header.scalarSize != sizeof(btScalar) || header.endianTag != CollisionMesh::EndianTag || header.fileSize != m_Size ||
+			header.numTriangles == 0)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < CollisionMesh::SectionCount; ++i)
+		{
+			const uint64_t offset = header.sections[i];
+			if ((offset & (CollisionMesh::Alignment - 1)) != 0 || offset < sizeof(CollisionMesh::Header) || offset > m_Size ||
+				header.sectionSizes[i] > m_Size - offset)
+			{
+				return false;
+			}
+		}
+
+		if (header.sectionSizes[CollisionMesh::Vertices] != uint64_t(header.numVertices) * 3 * sizeof(btScalar) ||
+			header.sectionSizes[CollisionMesh::Indices] != uint64_t(header.numTriangles) * 3 * sizeof(int32_t) ||
+			header.sectionSizes[CollisionMesh::Bvh] < sizeof(btQuantizedBvh))
+		{
+			return false;
+		}
+
+		// btTriangleIndexVertexArray reads the vertices of the indices without bounds checks
+		const int32_t* indices = reinterpret_cast<const int32_t*>(GetSection(CollisionMesh::Indices));
+		const uint64_t numIndices = uint64_t(header.numTriangles) * 3;
+		for (uint64_t i = 0; i < numIndices; ++i)
+		{
+			if (uint32_t(indices[i]) >= header.numVertices)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool CollisionMeshAsset::CreateShape()
+	{
+		const CollisionMesh::Header& header = GetHeader();
+
+		btIndexedMesh part;
+		part.m_numTriangles = int(header.numTriangles);
+		part.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(GetSection(CollisionMesh::Indices));
+		part.m_triangleIndexStride = 3 * sizeof(int32_t);
+		part.m_numVertices = int(header.numVertices);
+		part.m_vertexBase = reinterpret_cast<const unsigned char*>(GetSection(CollisionMesh::Vertices));
+		part.m_vertexStride = 3 * sizeof(btScalar);
+		part.m_indexType = PHY_INTEGER;
+
+		m_Mesh = new btTriangleIndexVertexArray;
+		m_Mesh->addIndexedMesh(part, PHY_INTEGER);
+		m_Mesh->setPremadeAabb(btVector3(header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]),
+							   btVector3(header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]));
+
+		m_Bvh = btOptimizedBvh::deSerializeInPlace(GetSection(CollisionMesh::Bvh), unsigned(header.sectionSizes[CollisionMesh::Bvh]), false);
+		if (!m_Bvh || !m_Bvh->isQuantized())
+		{
+			return false;
+		}
+
+		if (header.sectionSizes[CollisionMesh::TriangleInfoMap] > 0)
+		{
+			m_TriangleInfoMap = new btTriangleInfoMap;
+			if (!m_TriangleInfoMap->deSerializeInPlace(GetSection(CollisionMesh::TriangleInfoMap), unsigned(header.sectionSizes[CollisionMesh::TriangleInfoMap])))
+			{
+				return false;
+			}
+		}
+
+		// the local aabb comes from the premade aabb and the bvh is set afterwards, nothing walks the triangles
+		m_Shape = new btBvhTriangleMeshShape(m_Mesh, true, false);
+		m_Shape->setOptimizedBvh(m_Bvh);
+		m_Shape->setTriangleInfoMap(m_TriangleInfoMap);
+
+		return true;
+	}
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include <btBulletDynamicsCommon.h>
+#include "BulletCollision/CollisionShapes/btTriangleInfoMap.h"
+
+namespace GR
+{
+	// Precooked static triangle mesh for btBvhTriangleMeshShape.
+	//
+	// The file is a header followed by 16 byte aligned sections: the vertices, the indices, the quantized bvh
+	// written with btOptimizedBvh::serializeInPlace and the internal edge info written with btTriangleInfoMap::serializeInPlace.
+	// Everything is stored in the native btScalar/endian layout of the cooker, so the loader maps the file and builds
+	// the shape over the mapped sections without copying or rebuilding anything. A file written with a different
+	// btScalar size or byte order is rejected by CollisionMeshAsset::Open, cook it again for that build.
+	namespace CollisionMesh
+	{
+		constexpr uint32_t Version = 1;
+		constexpr uint32_t EndianTag = 0x01020304;
+		constexpr uint32_t Alignment = 16;
+
+		enum Section
+		{
+			Vertices,         // btScalar[NumVertices * 3]
+			Indices,          // int32_t[NumTriangles * 3]
+			Bvh,              // btQuantizedBvh in place
+			TriangleInfoMap,  // btTriangleInfoMap in place, empty without internal edge info
+			SectionCount
+		};
+
+		struct Header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t scalarSize;
+			uint32_t endianTag;
+			uint32_t numVertices;
+			uint32_t numTriangles;
+			uint32_t padding;
+			uint64_t fileSize;
+			uint64_t sections[SectionCount];  // byte offset of each section from the start of the file
+			uint64_t sectionSizes[SectionCount];
+			btScalar aabbMin[4];  // of the vertices, the premade aabb of the mesh interface
+			btScalar aabbMax[4];
+		};
+
+		struct CookOptions
+		{
+			btQuantizedBvh::btBuildMode buildMode = btQuantizedBvh::BUILD_BINNED_SAH;
+
+			// run btGenerateInternalEdgeInfoMt, a map with different thresholds can be passed in
+			bool internalEdgeInfo = true;
+			const btTriangleInfoMap* triangleInfoMap = nullptr;
+		};
+	};
+
+	// Flatten all parts of Mesh into one, build its quantized bvh and internal edge info and write them to Path.
+	// This is the offline step, it takes as long as creating a btBvhTriangleMeshShape from the raw mesh.
+	// The bvh and the edge info are built on the task scheduler that PhysicsWorld installs, the cooker runs them on the
+	// sequential scheduler when none is installed.
+	bool CookCollisionMesh(const char* Path, const btStridingMeshInterface& Mesh, const CollisionMesh::CookOptions& Options = CollisionMesh::CookOptions());
+
+	// A cooked mesh mapped into memory with mmap/MapViewOfFile and the btBvhTriangleMeshShape over it.
+	//
+	// The mapping is private and writable: the bvh and the info map are constructed in place in their first bytes,
+	// those pages are copied on write, the rest of the file is only read. The shape is static and unscaled, use
+	// btScaledBvhTriangleMeshShape for scaled instances, setLocalScaling would build a new bvh.
+	class CollisionMeshAsset
+	{
+	public:
+		CollisionMeshAsset();
+
+		~CollisionMeshAsset();
+
+		// map and validate the file and create the shape, it is valid until Close
+		bool Open(const char* Path);
+
+		// the shape has to be removed from the world before
+		void Close();
+
+		bool IsOpen() const { return m_Shape != nullptr; }
+
+		btBvhTriangleMeshShape* GetShape() const { return m_Shape; }
+
+		const CollisionMesh::Header& GetHeader() const { return *reinterpret_cast<const CollisionMesh::Header*>(m_Data); }
+
+		int GetNumTriangles() const { return int(GetHeader().numTriangles); }
+
+	private:
+		CollisionMeshAsset(const CollisionMeshAsset&) = delete;
+		CollisionMeshAsset& operator=(const CollisionMeshAsset&) = delete;
+
+		bool Validate() const;
+
+		bool CreateShape();
+
+		char* GetSection(CollisionMesh::Section Section) const { return m_Data + GetHeader().sections[Section]; }
+
+		char* m_Data;
+		size_t m_Size;
+		btTriangleIndexVertexArray* m_Mesh;
+		btOptimizedBvh* m_Bvh;
+		btTriangleInfoMap* m_TriangleInfoMap;
+		btBvhTriangleMeshShape* m_Shape;
+	};
+};
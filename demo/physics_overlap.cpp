@@ -0,0 +1,341 @@
+#include "physics_overlap.hpp"
+#include <algorithm>
+#include <mutex>
+
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/CollisionShapes/btSphereShape.h"
+#include "BulletCollision/CollisionShapes/btCompoundShape.h"
+#include "BulletCollision/CollisionShapes/btConcaveShape.h"
+#include "BulletCollision/CollisionShapes/btTriangleShape.h"
+#include "BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+
+namespace GR
+{
+	namespace
+	{
+		constexpr int MaxGjkIterations = 64;
+		constexpr int BatchGrainSize = 16;
+
+		// same convergence threshold as btGjkPairDetector
+#ifdef BT_USE_DOUBLE_PRECISION
+		constexpr btScalar GjkRelativeError2 = btScalar(1.0e-12);
+#else
+		constexpr btScalar GjkRelativeError2 = btScalar(1.0e-6);
+#endif
+
+		bool SphereSphereOverlap(const btSphereShape* A, const btTransform& TransformA, const btSphereShape* B, const btTransform& TransformB)
+		{
+			const btScalar radius = A->getRadius() + B->getRadius();
+			return TransformA.getOrigin().distance2(TransformB.getOrigin()) <= radius * radius;
+		}
+
+		bool SphereBoxOverlap(const btSphereShape* A, const btTransform& TransformA, const btBoxShape* B, const btTransform& TransformB)
+		{
+			const btVector3 center = TransformB.invXform(TransformA.getOrigin());
+			const btVector3& halfExtents = B->getHalfExtentsWithMargin();
+
+			btVector3 closest = center;
+			closest.setMax(-halfExtents);
+			closest.setMin(halfExtents);
+
+			const btScalar radius = A->getRadius();
+			return closest.distance2(center) <= radius * radius;
+		}
+
+		// separating axis test of two oriented boxes, the 3 + 3 face normals and the 9 edge cross products
+		bool BoxBoxOverlap(const btBoxShape* A, const btTransform& TransformA, const btBoxShape* B, const btTransform& TransformB)
+		{
+			const btVector3& a = A->getHalfExtentsWithMargin();
+			const btVector3& b = B->getHalfExtentsWithMargin();
+
+			// rotation and position of B in the space of A
+			const btMatrix3x3 r = TransformA.getBasis().transposeTimes(TransformB.getBasis());
+			const btVector3 t = (TransformB.getOrigin() - TransformA.getOrigin()) * TransformA.getBasis();
+
+			// the epsilon keeps the cross products of parallel edges from reporting a separation
+			btMatrix3x3 absR;
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					absR[i][j] = btFabs(r[i][j]) + SIMD_EPSILON;
+				}
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				if (btFabs(t[i]) > a[i] + b.dot(absR[i]))
+					return false;
+			}
+
+			for (int j = 0; j < 3; ++j)
+			{
+				const btScalar ra = a[0] * absR[0][j] + a[1] * absR[1][j] + a[2] * absR[2][j];
+				const btScalar dist = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+				if (btFabs(dist) > ra + b[j])
+					return false;
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				const int i1 = (i + 1) % 3;
+				const int i2 = (i + 2) % 3;
+				for (int j = 0; j < 3; ++j)
+				{
+					const int j1 = (j + 1) % 3;
+					const int j2 = (j + 2) % 3;
+					const btScalar ra = a[i1] * absR[i2][j] + a[i2] * absR[i1][j];
+					const btScalar rb = b[j1] * absR[i][j2] + b[j2] * absR[i][j1];
+					const btScalar dist = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+					if (btFabs(dist) > ra + rb)
+						return false;
+				}
+			}
+			return true;
+		}
+
+		// GJK on the Minkowski difference of the cores without margins. The shapes overlap if a point of it is within
+		// the sum of the margins from the origin, and are separated if a support plane is further away than that.
+		bool GjkOverlap(const btConvexShape* A, const btTransform& TransformA, const btConvexShape* B, const btTransform& TransformB)
+		{
+			const btScalar margin = A->getMarginNonVirtual() + B->getMarginNonVirtual();
+			const btScalar margin2 = margin * margin;
+
+			btVoronoiSimplexSolver simplex;
+			simplex.reset();
+
+			btVector3 v = TransformA.getOrigin() - TransformB.getOrigin();
+			if (v.length2() < SIMD_EPSILON)
+			{
+				v.setValue(1.0, 0.0, 0.0);
+			}
+
+			for (int i = 0; i < MaxGjkIterations; ++i)
+			{
+				const btVector3 pA = TransformA(A->localGetSupportVertexWithoutMarginNonVirtual((-v) * TransformA.getBasis()));
+				const btVector3 pB = TransformB(B->localGetSupportVertexWithoutMarginNonVirtual(v * TransformB.getBasis()));
+				const btVector3 w = pA - pB;
+
+				const btScalar vw = v.dot(w);
+				const btScalar v2 = v.length2();
+				if (vw > 0.0 && vw * vw > margin2 * v2)
+					return false;
+
+				// after the first iteration v is the closest point of the simplex, without progress it is the closest of the cores
+				if (i > 0 && (simplex.inSimplex(w) || v2 - vw <= GjkRelativeError2 * v2))
+					return v2 <= margin2;
+
+				simplex.addVertex(w, pA, pB);
+				if (!simplex.closest(v))
+					return true;  // degenerate simplex through the origin
+
+				// a full simplex contains the origin and v is zero
+				if (v.length2() <= margin2)
+					return true;
+			}
+			return v.length2() <= margin2;
+		}
+
+		bool ConvexOverlap(const btConvexShape* A, const btTransform& TransformA, const btConvexShape* B, const btTransform& TransformB)
+		{
+			const int typeA = A->getShapeType();
+			const int typeB = B->getShapeType();
+
+			if (typeA == SPHERE_SHAPE_PROXYTYPE && typeB == SPHERE_SHAPE_PROXYTYPE)
+				return SphereSphereOverlap(static_cast<const btSphereShape*>(A), TransformA, static_cast<const btSphereShape*>(B), TransformB);
+			if (typeA == SPHERE_SHAPE_PROXYTYPE && typeB == BOX_SHAPE_PROXYTYPE)
+				return SphereBoxOverlap(static_cast<const btSphereShape*>(A), TransformA, static_cast<const btBoxShape*>(B), TransformB);
+			if (typeA == BOX_SHAPE_PROXYTYPE && typeB == SPHERE_SHAPE_PROXYTYPE)
+				return SphereBoxOverlap(static_cast<const btSphereShape*>(B), TransformB, static_cast<const btBoxShape*>(A), TransformA);
+			if (typeA == BOX_SHAPE_PROXYTYPE && typeB == BOX_SHAPE_PROXYTYPE)
+				return BoxBoxOverlap(static_cast<const btBoxShape*>(A), TransformA, static_cast<const btBoxShape*>(B), TransformB);
+
+			return GjkOverlap(A, TransformA, B, TransformB);
+		}
+
+		// triangles of a concave shape in its local space until the first one overlapping the query
+		struct TriangleOverlap : public btTriangleCallback
+		{
+			const btConvexShape* shape;
+			btTransform transform;  // of the query in the space of the concave shape
+			btScalar margin;
+			bool overlap = false;
+
+			void processTriangle(btVector3* triangle, int partId, int triangleIndex) override
+			{
+				if (overlap)
+				{
+					return;
+				}
+
+				btTriangleShape triangleShape(triangle[0], triangle[1], triangle[2]);
+				triangleShape.setMargin(margin);
+				overlap = ConvexOverlap(shape, transform, &triangleShape, btTransform::getIdentity());
+			}
+		};
+
+		bool ShapeOverlap(const OverlapQuery& Query, const btVector3& AabbMin, const btVector3& AabbMax, const btCollisionShape* Shape, const btTransform& Transform)
+		{
+			if (Shape->isConvex())
+			{
+				return ConvexOverlap(Query.shape, Query.transform, static_cast<const btConvexShape*>(Shape), Transform);
+			}
+
+			if (Shape->isCompound())
+			{
+				const btCompoundShape* compound = static_cast<const btCompoundShape*>(Shape);
+				for (int i = 0; i < compound->getNumChildShapes(); ++i)
+				{
+					const btCollisionShape* child = compound->getChildShape(i);
+					const btTransform childTransform = Transform * compound->getChildTransform(i);
+
+					btVector3 childMin, childMax;
+					child->getAabb(childTransform, childMin, childMax);
+					if (TestAabbAgainstAabb2(AabbMin, AabbMax, childMin, childMax) && ShapeOverlap(Query, AabbMin, AabbMax, child, childTransform))
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			if (Shape->isConcave())
+			{
+				const btConcaveShape* concave = static_cast<const btConcaveShape*>(Shape);
+
+				TriangleOverlap callback;
+				callback.shape = Query.shape;
+				callback.transform = Transform.inverseTimes(Query.transform);
+				callback.margin = concave->getMargin();
+
+				btVector3 localMin, localMax;
+				Query.shape->getAabb(callback.transform, localMin, localMax);
+				concave->processAllTriangles(&callback, localMin, localMax);
+				return callback.overlap;
+			}
+
+			return false;
+		}
+
+		// narrowphase directly in the broadphase traversal, the candidates are not collected
+		struct OverlapBroadphaseCallback : public btBroadphaseAabbCallback
+		{
+			const OverlapQuery& query;
+			const btVector3& aabbMin;
+			const btVector3& aabbMax;
+			std::vector<uint32_t>& ids;
+
+			OverlapBroadphaseCallback(const OverlapQuery& Query, const btVector3& AabbMin, const btVector3& AabbMax, std::vector<uint32_t>& Ids)
+				: query(Query), aabbMin(AabbMin), aabbMax(AabbMax), ids(Ids)
+			{
+			}
+
+			bool process(const btBroadphaseProxy* proxy) override
+			{
+				const btCollisionObject* object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+				if (object == query.ignore || object->getUserIndex() < 0)
+				{
+					return true;
+				}
+
+				// same filter as btCollisionWorld::ContactResultCallback::needsCollision
+				if (!(proxy->m_collisionFilterGroup & query.collisionFilterMask) || !(query.collisionFilterGroup & proxy->m_collisionFilterMask))
+				{
+					return true;
+				}
+
+				if (ShapeOverlap(query, aabbMin, aabbMax, object->getCollisionShape(), object->getWorldTransform()))
+				{
+					ids.push_back(uint32_t(object->getUserIndex()));
+				}
+				return true;
+			}
+		};
+
+		struct OverlapBatchChunk
+		{
+			int begin;
+			std::vector<uint32_t> counts;
+			std::vector<uint32_t> ids;
+		};
+
+		struct OverlapBatchLoop : public btIParallelForBody
+		{
+			btCollisionWorld* world;
+			const OverlapQuery* queries;
+			std::vector<OverlapBatchChunk>* chunks;
+			std::mutex* mutex;
+
+			void forLoop(int iBegin, int iEnd) const override
+			{
+				OverlapBatchChunk chunk;
+				chunk.begin = iBegin;
+				chunk.counts.resize(iEnd - iBegin);
+
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					const size_t first = chunk.ids.size();
+					QueryOverlaps(*world, queries[i], chunk.ids);
+					chunk.counts[i - iBegin] = uint32_t(chunk.ids.size() - first);
+				}
+
+				std::lock_guard<std::mutex> lock(*mutex);
+				chunks->push_back(std::move(chunk));
+			}
+		};
+	};
+
+	void QueryOverlaps(btCollisionWorld& World, const OverlapQuery& Query, std::vector<uint32_t>& Ids)
+	{
+		btAssert(Query.shape && Query.shape->isConvex());
+
+		btVector3 aabbMin, aabbMax;
+		Query.shape->getAabb(Query.transform, aabbMin, aabbMax);
+
+		OverlapBroadphaseCallback callback(Query, aabbMin, aabbMax, Ids);
+		World.getBroadphase()->aabbTest(aabbMin, aabbMax, callback);
+	}
+
+	void QueryOverlapsBatch(btCollisionWorld& World, const OverlapQuery* Queries, int NumQueries, std::vector<uint32_t>& Ids, std::vector<uint32_t>& Offsets)
+	{
+		std::vector<OverlapBatchChunk> chunks;
+		std::mutex mutex;
+
+		OverlapBatchLoop loop;
+		loop.world = &World;
+		loop.queries = Queries;
+		loop.chunks = &chunks;
+		loop.mutex = &mutex;
+		if (btGetTaskScheduler())
+		{
+			btParallelFor(0, NumQueries, BatchGrainSize, loop);
+		}
+		else
+		{
+			loop.forLoop(0, NumQueries);
+		}
+
+		// the chunks finish in any order, place them by their first query
+		Offsets.assign(NumQueries + 1, 0);
+		for (const OverlapBatchChunk& chunk : chunks)
+		{
+			for (size_t i = 0; i < chunk.counts.size(); ++i)
+			{
+				Offsets[chunk.begin + i + 1] = chunk.counts[i];
+			}
+		}
+		for (int i = 0; i < NumQueries; ++i)
+		{
+			Offsets[i + 1] += Offsets[i];
+		}
+
+		Ids.resize(Offsets[NumQueries]);
+		for (const OverlapBatchChunk& chunk : chunks)
+		{
+			std::copy(chunk.ids.begin(), chunk.ids.end(), Ids.begin() + Offsets[chunk.begin]);
+		}
+	}
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "LinearMath/btTransform.h"
+#include "BulletCollision/BroadphaseCollision/btBroadphaseProxy.h"
+
+class btCollisionObject;
+class btCollisionWorld;
+class btConvexShape;
+
+namespace GR
+{
+	// Boolean overlap query of a convex shape against the objects of a collision world.
+	//
+	// Unlike btCollisionWorld::contactTest no collision algorithms are created and no manifolds are written: the
+	// candidates of the broadphase aabb test are checked with closed form tests for spheres and boxes, a separating
+	// axis test for box pairs and otherwise a GJK that stops as soon as it finds a separating plane or a point of the
+	// Minkowski difference within the margins. Compounds are tested child by child, concave shapes triangle by
+	// triangle until the first overlap. Shapes include their margins, like in the contact generation.
+	struct OverlapQuery
+	{
+		const btConvexShape* shape = nullptr;
+		btTransform transform = btTransform::getIdentity();
+		int collisionFilterGroup = btBroadphaseProxy::DefaultFilter;
+		int collisionFilterMask = btBroadphaseProxy::AllFilter;
+		const btCollisionObject* ignore = nullptr;  // usually the body of the querying entity
+	};
+
+	// Append the user indices of the overlapping objects to Ids, each object once. Objects with a negative user index
+	// are skipped. The world is only read, queries can run concurrently but not during a simulation step.
+	void QueryOverlaps(btCollisionWorld& World, const OverlapQuery& Query, std::vector<uint32_t>& Ids);
+
+	// Run the queries in parallel through btParallelFor on the task scheduler that PhysicsWorld installs, or serially
+	// when no scheduler is installed. The ids of query i are Ids[Offsets[i]] up to Ids[Offsets[i + 1]],
+	// Offsets has NumQueries + 1 entries. Both vectors are overwritten.
+	void QueryOverlapsBatch(btCollisionWorld& World, const OverlapQuery* Queries, int NumQueries, std::vector<uint32_t>& Ids, std::vector<uint32_t>& Offsets);
+};
@@ -0,0 +1,636 @@
+#include "physics_replay.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace GR
+{
+	namespace
+	{
+		constexpr char Magic[8] = { 'G', 'R', 'R', 'E', 'P', 'L', 'A', 'Y' };
+		constexpr double DirectionScale = 32767.0;
+		constexpr double RotationScale = 16383.0 * 1.4142135623730951;  // smallest three components are within +-1/sqrt(2)
+
+		void PutVarint(std::vector<uint8_t>& Out, uint64_t Value)
+		{
+			while (Value >= 0x80)
+			{
+				Out.push_back(uint8_t(Value) | 0x80);
+				Value >>= 7;
+			}
+			Out.push_back(uint8_t(Value));
+		}
+
+		void PutSigned(std::vector<uint8_t>& Out, int64_t Value)
+		{
+			PutVarint(Out, (uint64_t(Value) << 1) ^ uint64_t(Value >> 63));
+		}
+
+		bool GetVarint(const uint8_t*& It, const uint8_t* End, uint64_t& Value)
+		{
+			Value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (It == End)
+				{
+					return false;
+				}
+				const uint8_t byte = *It++;
+				Value |= uint64_t(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool GetSigned(const uint8_t*& It, const uint8_t* End, int64_t& Value)
+		{
+			uint64_t v;
+			if (!GetVarint(It, End, v))
+			{
+				return false;
+			}
+			Value = int64_t(v >> 1) ^ -int64_t(v & 1);
+			return true;
+		}
+
+		double SignNotZero(double v)
+		{
+			return v >= 0.0 ? 1.0 : -1.0;
+		}
+
+		// octahedral encoding of the direction from the planet center
+		void EncodeDirection(const btVector3& Position, int16_t Out[2])
+		{
+			const double x = Position.x(), y = Position.y(), z = Position.z();
+			const double l1 = std::abs(x) + std::abs(y) + std::abs(z);
+			double u = l1 > 0.0 ? x / l1 : 0.0;
+			double v = l1 > 0.0 ? y / l1 : 0.0;
+			if (z < 0.0)
+			{
+				const double fu = (1.0 - std::abs(v)) * SignNotZero(u);
+				const double fv = (1.0 - std::abs(u)) * SignNotZero(v);
+				u = fu;
+				v = fv;
+			}
+			Out[0] = int16_t(std::lround(u * DirectionScale));
+			Out[1] = int16_t(std::lround(v * DirectionScale));
+		}
+
+		btVector3 DecodeAnchor(const int16_t In[2], double SurfaceRadius)
+		{
+			double u = In[0] / DirectionScale;
+			double v = In[1] / DirectionScale;
+			const double z = 1.0 - std::abs(u) - std::abs(v);
+			if (z < 0.0)
+			{
+				const double fu = (1.0 - std::abs(v)) * SignNotZero(u);
+				const double fv = (1.0 - std::abs(u)) * SignNotZero(v);
+				u = fu;
+				v = fv;
+			}
+			const double scale = SurfaceRadius / std::sqrt(u * u + v * v + z * z);
+			return btVector3(btScalar(u * scale), btScalar(v * scale), btScalar(z * scale));
+		}
+
+		void EncodeRotation(const btQuaternion& Rotation, uint8_t& Index, int32_t Out[3])
+		{
+			const double q[4] = { Rotation.x(), Rotation.y(), Rotation.z(), Rotation.w() };
+			int largest = 0;
+			for (int i = 1; i < 4; ++i)
+			{
+				if (std::abs(q[i]) > std::abs(q[largest]))
+				{
+					largest = i;
+				}
+			}
+			// q and -q are the same rotation, the dropped component is restored as positive
+			const double sign = q[largest] < 0.0 ? -1.0 : 1.0;
+			for (int i = 0, k = 0; i < 4; ++i)
+			{
+				if (i != largest)
+				{
+					Out[k++] = int32_t(std::lround(q[i] * sign * RotationScale));
+				}
+			}
+			Index = uint8_t(largest);
+		}
+
+		btQuaternion DecodeRotation(uint8_t Index, const int32_t In[3])
+		{
+			double q[4];
+			double sum = 0.0;
+			for (int i = 0, k = 0; i < 4; ++i)
+			{
+				if (i != Index)
+				{
+					q[i] = In[k++] / RotationScale;
+					sum += q[i] * q[i];
+				}
+			}
+			q[Index] = std::sqrt(std::max(0.0, 1.0 - sum));
+			const btQuaternion rotation = btQuaternion(btScalar(q[0]), btScalar(q[1]), btScalar(q[2]), btScalar(q[3]));
+			return rotation.normalized();
+		}
+
+		btTransform DecodePose(const Replay::QuantizedPose& Pose, const Replay::Header& Header)
+		{
+			const btVector3 anchor = DecodeAnchor(Pose.anchor, Header.surfaceRadius);
+			const double inv = 1.0 / Header.positionScale;
+			const btVector3 offset(btScalar(Pose.position[0] * inv), btScalar(Pose.position[1] * inv), btScalar(Pose.position[2] * inv));
+			return btTransform(DecodeRotation(Pose.rotationIndex, Pose.rotation), anchor + offset);
+		}
+	};
+
+	ReplayRecorder::ReplayRecorder()
+		: m_File(nullptr),
+		  m_Header(),
+		  m_Delta(0.f),
+		  m_Time(0.0),
+		  m_BlockTime(0.0),
+		  m_FrameIndex(0),
+		  m_BlockFrames(0),
+		  m_Stop(false)
+	{
+	}
+
+	ReplayRecorder::~ReplayRecorder()
+	{
+		Close();
+	}
+
+	bool ReplayRecorder::Open(const char* Path, double SurfaceRadius, uint32_t FramesPerBlock, double PositionScale)
+	{
+		Close();
+
+		m_File = fopen(Path, "wb");
+		if (!m_File)
+		{
+			return false;
+		}
+
+		memcpy(m_Header.magic, Magic, sizeof(Magic));
+		m_Header.version = Replay::Version;
+		m_Header.framesPerBlock = std::max(FramesPerBlock, 1u);
+		m_Header.surfaceRadius = SurfaceRadius;
+		m_Header.positionScale = PositionScale;
+		if (fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1)
+		{
+			fclose(m_File);
+			m_File = nullptr;
+			return false;
+		}
+
+		m_Records.clear();
+		m_Previous.clear();
+		m_Block.clear();
+		m_Time = 0.0;
+		m_FrameIndex = 0;
+		m_BlockFrames = 0;
+		m_Stop = false;
+		m_Writer = std::thread(&ReplayRecorder::WriterLoop, this);
+
+		return true;
+	}
+
+	void ReplayRecorder::Close()
+	{
+		if (!m_File)
+		{
+			return;
+		}
+
+		FlushBlock();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+		m_Condition.notify_one();
+		m_Writer.join();
+
+		fclose(m_File);
+		m_File = nullptr;
+		m_FreeBlocks.clear();
+	}
+
+	void ReplayRecorder::BeginFrame(double Delta)
+	{
+		if (m_BlockFrames == 0)
+		{
+			m_Block.resize(sizeof(Replay::BlockHeader));
+			m_BlockTime = m_Time;
+		}
+		m_Delta = float(Delta);
+		m_Records.clear();
+	}
+
+	void ReplayRecorder::AddBody(uint32_t Id, const btTransform& Transform, bool Active)
+	{
+		if (!Active && m_BlockFrames != 0)
+		{
+			return;
+		}
+		m_Records.push_back({ Id, Transform });
+	}
+
+	void ReplayRecorder::EndFrame()
+	{
+		std::sort(m_Records.begin(), m_Records.end(), [](const ReplayPose& a, const ReplayPose& b) { return a.id < b.id; });
+		m_Records.erase(std::unique(m_Records.begin(), m_Records.end(), [](const ReplayPose& a, const ReplayPose& b) { return a.id == b.id; }), m_Records.end());
+
+		const size_t deltaOffset = m_Block.size();
+		m_Block.resize(deltaOffset + sizeof(float));
+		memcpy(&m_Block[deltaOffset], &m_Delta, sizeof(float));
+		PutVarint(m_Block, m_Records.size());
+
+		// both lists are sorted by id, walk them together
+		const size_t numPrevious = m_Previous.size();
+		size_t previous = 0;
+		for (size_t i = 0; i < m_Records.size(); ++i)
+		{
+			const ReplayPose& record = m_Records[i];
+			PutVarint(m_Block, i == 0 ? record.id : record.id - m_Records[i - 1].id - 1);
+
+			while (previous < numPrevious && m_Previous[previous].id < record.id)
+			{
+				++previous;
+			}
+			const bool known = previous < numPrevious && m_Previous[previous].id == record.id;
+
+			Replay::QuantizedPose pose;
+			pose.id = record.id;
+			if (known)
+			{
+				pose.anchor[0] = m_Previous[previous].anchor[0];
+				pose.anchor[1] = m_Previous[previous].anchor[1];
+			}
+			else
+			{
+				EncodeDirection(record.transform.getOrigin(), pose.anchor);
+			}
+			const btVector3 offset = record.transform.getOrigin() - DecodeAnchor(pose.anchor, m_Header.surfaceRadius);
+			for (int k = 0; k < 3; ++k)
+			{
+				pose.position[k] = std::llround(double(offset[k]) * m_Header.positionScale);
+			}
+			EncodeRotation(record.transform.getRotation(), pose.rotationIndex, pose.rotation);
+
+			if (!known)
+			{
+				m_Block.push_back(uint8_t(Replay::FullRecord));
+				PutSigned(m_Block, pose.anchor[0]);
+				PutSigned(m_Block, pose.anchor[1]);
+				for (int k = 0; k < 3; ++k)
+				{
+					PutSigned(m_Block, pose.position[k]);
+				}
+				m_Block.push_back(pose.rotationIndex);
+				for (int k = 0; k < 3; ++k)
+				{
+					PutSigned(m_Block, pose.rotation[k]);
+				}
+				m_Previous.push_back(pose);
+				continue;
+			}
+
+			Replay::QuantizedPose& last = m_Previous[previous];
+			const bool indexChanged = last.rotationIndex != pose.rotationIndex;
+			m_Block.push_back(uint8_t(indexChanged ? Replay::QuaternionIndexChanged : 0));
+			for (int k = 0; k < 3; ++k)
+			{
+				PutSigned(m_Block, pose.position[k] - last.position[k]);
+			}
+			if (indexChanged)
+			{
+				m_Block.push_back(pose.rotationIndex);
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				PutSigned(m_Block, indexChanged ? pose.rotation[k] : pose.rotation[k] - last.rotation[k]);
+			}
+			last = pose;
+		}
+		if (m_Previous.size() != numPrevious)
+		{
+			std::inplace_merge(m_Previous.begin(), m_Previous.begin() + numPrevious, m_Previous.end(),
+							   [](const Replay::QuantizedPose& a, const Replay::QuantizedPose& b) { return a.id < b.id; });
+		}
+
+		m_Time += m_Delta;
+		++m_FrameIndex;
+		if (++m_BlockFrames == m_Header.framesPerBlock)
+		{
+			FlushBlock();
+		}
+	}
+
+	void ReplayRecorder::FlushBlock()
+	{
+		if (m_BlockFrames == 0)
+		{
+			return;
+		}
+
+		Replay::BlockHeader header;
+		header.magic = Replay::BlockMagic;
+		header.firstFrame = m_FrameIndex - m_BlockFrames;
+		header.numFrames = m_BlockFrames;
+		header.size = uint32_t(m_Block.size() - sizeof(header));
+		header.startTime = m_BlockTime;
+		memcpy(m_Block.data(), &header, sizeof(header));
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Pending.push_back(std::move(m_Block));
+			if (!m_FreeBlocks.empty())
+			{
+				m_Block = std::move(m_FreeBlocks.back());
+				m_FreeBlocks.pop_back();
+			}
+			else
+			{
+				m_Block = std::vector<uint8_t>();
+			}
+		}
+		m_Condition.notify_one();
+
+		m_Previous.clear();
+		m_BlockFrames = 0;
+	}
+
+	void ReplayRecorder::WriterLoop()
+	{
+		std::vector<std::vector<uint8_t>> blocks;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this] { return m_Stop || !m_Pending.empty(); });
+				if (m_Pending.empty())
+				{
+					return;
+				}
+				blocks.swap(m_Pending);
+			}
+
+			for (const std::vector<uint8_t>& block : blocks)
+			{
+				fwrite(block.data(), 1, block.size(), m_File);
+			}
+			fflush(m_File);
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (std::vector<uint8_t>& block : blocks)
+			{
+				block.clear();
+				m_FreeBlocks.push_back(std::move(block));
+			}
+			blocks.clear();
+		}
+	}
+
+	ReplayPlayer::ReplayPlayer()
+		: m_File(nullptr),
+		  m_Header(),
+		  m_NumFrames(0),
+		  m_Block(0),
+		  m_Cursor(0),
+		  m_Decoded(0),
+		  m_Frame(0),
+		  m_Time(0.0)
+	{
+	}
+
+	ReplayPlayer::~ReplayPlayer()
+	{
+		Close();
+	}
+
+	bool ReplayPlayer::Open(const char* Path)
+	{
+		Close();
+
+		m_File = fopen(Path, "rb");
+		if (!m_File)
+		{
+			return false;
+		}
+
+		if (fread(&m_Header, sizeof(m_Header), 1, m_File) != 1 || memcmp(m_Header.magic, Magic, sizeof(Magic)) != 0 ||
+			m_Header.version != Replay::Version || !(m_Header.positionScale > 0.0))
+		{
+			Close();
+			return false;
+		}
+
+		fseek(m_File, 0, SEEK_END);
+		const long fileSize = ftell(m_File);
+		long offset = long(sizeof(m_Header));
+
+		// a recording that was cut off ends at the last complete block
+		Replay::BlockHeader header;
+		while (fseek(m_File, offset, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, m_File) == 1)
+		{
+			const long data = offset + long(sizeof(header));
+			if (header.magic != Replay::BlockMagic || header.firstFrame != m_NumFrames || header.numFrames == 0 || data + long(header.size) > fileSize)
+			{
+				break;
+			}
+			m_Blocks.push_back({ header.firstFrame, header.numFrames, data, header.size, header.startTime });
+			m_NumFrames += header.numFrames;
+			offset = data + long(header.size);
+		}
+
+		m_Block = m_Blocks.size();
+		m_Frame = m_NumFrames;
+		return true;
+	}
+
+	void ReplayPlayer::Close()
+	{
+		if (m_File)
+		{
+			fclose(m_File);
+			m_File = nullptr;
+		}
+		m_Blocks.clear();
+		m_NumFrames = 0;
+		m_Block = 0;
+		m_Data.clear();
+		m_Decoded = 0;
+		m_Frame = 0;
+		m_State.clear();
+		m_Poses.clear();
+	}
+
+	bool ReplayPlayer::Seek(uint32_t Frame)
+	{
+		if (Frame >= m_NumFrames)
+		{
+			return false;
+		}
+
+		const size_t index = size_t(std::upper_bound(m_Blocks.begin(), m_Blocks.end(), Frame, [](uint32_t f, const Block& b) { return f < b.firstFrame; }) - m_Blocks.begin()) - 1;
+
+		// keep decoding forward inside the current block, otherwise start again at the keyframe
+		if (index != m_Block || m_Decoded == 0 || m_Frame > Frame)
+		{
+			if (!LoadBlock(index))
+			{
+				return false;
+			}
+		}
+		while (m_Decoded == 0 || m_Frame < Frame)
+		{
+			if (!DecodeFrame())
+			{
+				m_Decoded = 0;
+				m_Frame = m_NumFrames;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ReplayPlayer::Step()
+	{
+		return Seek(m_Frame < m_NumFrames ? m_Frame + 1 : 0);
+	}
+
+	bool ReplayPlayer::LoadBlock(size_t Index)
+	{
+		const Block& block = m_Blocks[Index];
+		m_Data.resize(block.size);
+		if (fseek(m_File, block.offset, SEEK_SET) != 0 || (block.size && fread(m_Data.data(), block.size, 1, m_File) != 1))
+		{
+			m_Block = m_Blocks.size();
+			return false;
+		}
+		m_Block = Index;
+		m_Cursor = 0;
+		m_Decoded = 0;
+		m_Time = block.startTime;
+		m_State.clear();
+		m_Poses.clear();
+		return true;
+	}
+
+	bool ReplayPlayer::DecodeFrame()
+	{
+		const Block& block = m_Blocks[m_Block];
+		if (m_Decoded == block.numFrames)
+		{
+			return false;
+		}
+
+		const uint8_t* it = m_Data.data() + m_Cursor;
+		const uint8_t* end = m_Data.data() + m_Data.size();
+		if (end - it < ptrdiff_t(sizeof(float)))
+		{
+			return false;
+		}
+		float delta;
+		memcpy(&delta, it, sizeof(float));
+		it += sizeof(float);
+
+		uint64_t count;
+		if (!GetVarint(it, end, count))
+		{
+			return false;
+		}
+
+		size_t state = 0;
+		uint64_t id = 0;
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			uint64_t idDelta;
+			if (!GetVarint(it, end, idDelta) || it == end)
+			{
+				return false;
+			}
+			id = i == 0 ? idDelta : id + idDelta + 1;
+			const uint8_t flags = *it++;
+
+			while (state < m_State.size() && m_State[state].id < id)
+			{
+				++state;
+			}
+			const bool known = state < m_State.size() && m_State[state].id == id;
+			if (bool(flags & Replay::FullRecord) == known)
+			{
+				return false;
+			}
+
+			Replay::QuantizedPose pose;
+			int64_t values[5];
+			if (flags & Replay::FullRecord)
+			{
+				for (int k = 0; k < 5; ++k)
+				{
+					if (!GetSigned(it, end, values[k]))
+					{
+						return false;
+					}
+				}
+				pose.id = uint32_t(id);
+				pose.anchor[0] = int16_t(values[0]);
+				pose.anchor[1] = int16_t(values[1]);
+				for (int k = 0; k < 3; ++k)
+				{
+					pose.position[k] = values[2 + k];
+				}
+			}
+			else
+			{
+				pose = m_State[state];
+				for (int k = 0; k < 3; ++k)
+				{
+					if (!GetSigned(it, end, values[k]))
+					{
+						return false;
+					}
+					pose.position[k] += values[k];
+				}
+			}
+
+			const bool absoluteRotation = (flags & (Replay::FullRecord | Replay::QuaternionIndexChanged)) != 0;
+			if (absoluteRotation)
+			{
+				if (it == end || *it > 3)
+				{
+					return false;
+				}
+				pose.rotationIndex = *it++;
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				if (!GetSigned(it, end, values[k]))
+				{
+					return false;
+				}
+				pose.rotation[k] = int32_t(absoluteRotation ? values[k] : pose.rotation[k] + values[k]);
+			}
+
+			const ReplayPose decoded = { pose.id, DecodePose(pose, m_Header) };
+			if (known)
+			{
+				m_State[state] = pose;
+				m_Poses[state] = decoded;
+			}
+			else
+			{
+				m_State.insert(m_State.begin() + state, pose);
+				m_Poses.insert(m_Poses.begin() + state, decoded);
+			}
+		}
+
+		m_Cursor = size_t(it - m_Data.data());
+		m_Time += delta;
+		m_Frame = block.firstFrame + m_Decoded;
+		++m_Decoded;
+		return true;
+	}
+};
@@ -0,0 +1,185 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <btBulletDynamicsCommon.h>
+
+namespace GR
+{
+	// Delta compressed stream of body transforms for replays.
+	//
+	// The file is a header followed by blocks of frames. The first frame of every block is a keyframe that holds
+	// all bodies, the following frames only the bodies that were active, delta encoded against their previous
+	// record in the same block. Blocks don't depend on each other, so a player seeks by decoding a single block.
+	//
+	// Positions are fixed point offsets from an anchor on the planet surface below the body, the anchor is stored
+	// as an octahedral encoded direction when a body first appears in a block. Rotations are smallest three
+	// quaternions with 15 bits per component. All integers are zigzag varints.
+	namespace Replay
+	{
+		constexpr uint32_t Version = 1;
+		constexpr uint32_t BlockMagic = 0x4b4c4252;  // "RBLK"
+		constexpr double DefaultPositionScale = 1024.0;  // fixed point steps per unit
+		constexpr uint32_t DefaultFramesPerBlock = 60;
+
+		struct Header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t framesPerBlock;
+			double surfaceRadius;
+			double positionScale;
+		};
+
+		struct BlockHeader
+		{
+			uint32_t magic;
+			uint32_t firstFrame;
+			uint32_t numFrames;
+			uint32_t size;  // bytes of frame data after the header
+			double startTime;
+		};
+
+		enum RecordFlags
+		{
+			FullRecord = 1,  // new anchor and absolute values, no previous record of the body in the block
+			QuaternionIndexChanged = 2  // the largest quaternion component changed, the three components are absolute
+		};
+
+		// quantized transform, also the delta state of encoder and decoder
+		struct QuantizedPose
+		{
+			uint32_t id;
+			int16_t anchor[2];
+			int64_t position[3];
+			int32_t rotation[3];
+			uint8_t rotationIndex;
+		};
+	};
+
+	struct ReplayPose
+	{
+		uint32_t id;  // entity
+		btTransform transform;
+	};
+
+	// Encodes frames on the calling thread and writes finished blocks on a background thread.
+	class ReplayRecorder
+	{
+	public:
+		ReplayRecorder();
+
+		~ReplayRecorder();
+
+		// SurfaceRadius is the planet radius the positions are relative to
+		bool Open(const char* Path, double SurfaceRadius, uint32_t FramesPerBlock = Replay::DefaultFramesPerBlock, double PositionScale = Replay::DefaultPositionScale);
+
+		// flush the pending frames and join the writer thread
+		void Close();
+
+		bool IsOpen() const { return m_File != nullptr; }
+
+		// the next frame is the first of a block, all bodies are recorded
+		bool IsKeyframe() const { return m_BlockFrames == 0; }
+
+		void BeginFrame(double Delta);
+
+		// inactive bodies are only recorded in keyframes, the player keeps their last pose
+		void AddBody(uint32_t Id, const btTransform& Transform, bool Active);
+
+		void EndFrame();
+
+		uint32_t GetNumFrames() const { return m_FrameIndex; }
+
+	private:
+		ReplayRecorder(const ReplayRecorder&) = delete;
+		ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+		void FlushBlock();
+
+		void WriterLoop();
+
+		FILE* m_File;
+		Replay::Header m_Header;
+
+		std::vector<ReplayPose> m_Records;  // bodies of the current frame, sorted and quantized in EndFrame
+		std::vector<Replay::QuantizedPose> m_Previous;  // last record of every body in the block, sorted by id
+		std::vector<uint8_t> m_Block;
+		float m_Delta;
+		double m_Time;
+		double m_BlockTime;
+		uint32_t m_FrameIndex;
+		uint32_t m_BlockFrames;
+
+		std::thread m_Writer;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		std::vector<std::vector<uint8_t>> m_Pending;
+		std::vector<std::vector<uint8_t>> m_FreeBlocks;
+		bool m_Stop;
+	};
+
+	// Reads a replay, seeks to any frame by decoding from the keyframe of its block.
+	class ReplayPlayer
+	{
+	public:
+		ReplayPlayer();
+
+		~ReplayPlayer();
+
+		// reads the header and the block headers, the frame data is read per block on demand
+		bool Open(const char* Path);
+
+		void Close();
+
+		uint32_t GetNumFrames() const { return m_NumFrames; }
+
+		// index of the decoded frame, GetNumFrames() before the first Seek
+		uint32_t GetFrame() const { return m_Frame; }
+
+		double GetTime() const { return m_Time; }
+
+		bool Seek(uint32_t Frame);
+
+		// decode the frame after the current one
+		bool Step();
+
+		// pose of every body seen since the keyframe, sorted by id
+		const std::vector<ReplayPose>& GetPoses() const { return m_Poses; }
+
+	private:
+		ReplayPlayer(const ReplayPlayer&) = delete;
+		ReplayPlayer& operator=(const ReplayPlayer&) = delete;
+
+		struct Block
+		{
+			uint32_t firstFrame;
+			uint32_t numFrames;
+			long offset;  // of the frame data
+			uint32_t size;
+			double startTime;
+		};
+
+		bool LoadBlock(size_t Index);
+
+		bool DecodeFrame();
+
+		FILE* m_File;
+		Replay::Header m_Header;
+		std::vector<Block> m_Blocks;
+		uint32_t m_NumFrames;
+
+		size_t m_Block;
+		std::vector<uint8_t> m_Data;
+		size_t m_Cursor;
+		uint32_t m_Decoded;  // frames of the block decoded so far
+		uint32_t m_Frame;
+		double m_Time;
+		std::vector<Replay::QuantizedPose> m_State;  // sorted by id, parallel to m_Poses
+		std::vector<ReplayPose> m_Poses;
+	};
+};
@@ -0,0 +1,748 @@
+#include "physics_snapshot.hpp"
+#include "LinearMath/btHashMap.h"
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GR
+{
+	namespace
+	{
+		const char SnapshotMagic[8] = {'G', 'R', 'P', 'H', 'Y', 'S', 'S', 'N'};
+
+		void GetSectionLayout(const Snapshot::Header& Header, int Section, uint64_t& Count, uint64_t& ElementSize)
+		{
+			switch (Section)
+			{
+				case Snapshot::Shapes:
+					Count = Header.numShapes;
+					ElementSize = sizeof(Snapshot::Shape);
+					break;
+				case Snapshot::Transforms:
+					Count = Header.numBodies;
+					ElementSize = sizeof(btTransform);
+					break;
+				case Snapshot::LinearVelocities:
+				case Snapshot::AngularVelocities:
+				case Snapshot::Gravities:
+				case Snapshot::LocalInertias:
+				case Snapshot::LinearFactors:
+				case Snapshot::AngularFactors:
+					Count = Header.numBodies;
+					ElementSize = sizeof(btVector3);
+					break;
+				case Snapshot::Masses:
+					Count = Header.numBodies;
+					ElementSize = sizeof(btScalar);
+					break;
+				case Snapshot::Materials:
+					Count = Header.numBodies;
+					ElementSize = sizeof(Snapshot::Material);
+					break;
+				case Snapshot::Dampings:
+					Count = Header.numBodies;
+					ElementSize = sizeof(Snapshot::Damping);
+					break;
+				case Snapshot::States:
+					Count = Header.numBodies;
+					ElementSize = sizeof(Snapshot::BodyState);
+					break;
+				case Snapshot::Entities:
+					Count = Header.numBodies;
+					ElementSize = sizeof(int32_t);
+					break;
+				default:
+					Count = Header.numConstraints;
+					ElementSize = sizeof(Snapshot::Constraint);
+					break;
+			}
+		}
+
+		uint64_t AlignOffset(uint64_t Offset)
+		{
+			return (Offset + Snapshot::Alignment - 1) & ~uint64_t(Snapshot::Alignment - 1);
+		}
+
+		template <typename T>
+		T* GetSection(btAlignedObjectArray<char>& Data, const Snapshot::Header& Header, Snapshot::Section Section)
+		{
+			return reinterpret_cast<T*>(&Data[0] + Header.sections[Section]);
+		}
+
+		bool IsSupportedShape(int Type)
+		{
+			return Type == BOX_SHAPE_PROXYTYPE || Type == SPHERE_SHAPE_PROXYTYPE || Type == CAPSULE_SHAPE_PROXYTYPE ||
+				   Type == CYLINDER_SHAPE_PROXYTYPE || Type == STATIC_PLANE_PROXYTYPE;
+		}
+
+		bool WriteShape(const btCollisionShape* Shape, Snapshot::Shape& Out)
+		{
+			memset(&Out, 0, sizeof(Out));
+			Out.type = Shape->getShapeType();
+			if (!IsSupportedShape(Out.type))
+			{
+				return false;
+			}
+
+			const btVector3& scaling = Shape->getLocalScaling();
+			Out.scaling[0] = scaling.x();
+			Out.scaling[1] = scaling.y();
+			Out.scaling[2] = scaling.z();
+			Out.margin = Shape->getMargin();
+
+			btVector3 params(0.0, 0.0, 0.0);
+			btScalar param3 = 0.0;
+			switch (Out.type)
+			{
+				case BOX_SHAPE_PROXYTYPE:
+					// unscaled extents including the margin, what the constructor takes
+					params = static_cast<const btBoxShape*>(Shape)->getHalfExtentsWithMargin() / scaling;
+					break;
+				case SPHERE_SHAPE_PROXYTYPE:
+					params.setX(static_cast<const btSphereShape*>(Shape)->getImplicitShapeDimensions().x());
+					break;
+				case CAPSULE_SHAPE_PROXYTYPE:
+				{
+					const btCapsuleShape* capsule = static_cast<const btCapsuleShape*>(Shape);
+					const int upAxis = capsule->getUpAxis();
+					params.setX(capsule->getImplicitShapeDimensions()[(upAxis + 2) % 3] / scaling[(upAxis + 2) % 3]);
+					params.setY(capsule->getImplicitShapeDimensions()[upAxis] / scaling[upAxis]);
+					Out.upAxis = upAxis;
+					break;
+				}
+				case CYLINDER_SHAPE_PROXYTYPE:
+				{
+					const btCylinderShape* cylinder = static_cast<const btCylinderShape*>(Shape);
+					params = cylinder->getHalfExtentsWithMargin() / scaling;
+					Out.upAxis = cylinder->getUpAxis();
+					break;
+				}
+				case STATIC_PLANE_PROXYTYPE:
+				{
+					const btStaticPlaneShape* plane = static_cast<const btStaticPlaneShape*>(Shape);
+					params = plane->getPlaneNormal();
+					param3 = plane->getPlaneConstant();
+					break;
+				}
+			}
+			Out.params[0] = params.x();
+			Out.params[1] = params.y();
+			Out.params[2] = params.z();
+			Out.params[3] = param3;
+
+			return true;
+		}
+
+		btCollisionShape* CreateShape(const Snapshot::Shape& In)
+		{
+			btCollisionShape* shape = nullptr;
+			const btVector3 params(In.params[0], In.params[1], In.params[2]);
+			switch (In.type)
+			{
+				case BOX_SHAPE_PROXYTYPE:
+					shape = new btBoxShape(params);
+					break;
+				case SPHERE_SHAPE_PROXYTYPE:
+					shape = new btSphereShape(params.x());
+					break;
+				case CAPSULE_SHAPE_PROXYTYPE:
+					if (In.upAxis == 0)
+						shape = new btCapsuleShapeX(params.x(), 2.0 * params.y());
+					else if (In.upAxis == 2)
+						shape = new btCapsuleShapeZ(params.x(), 2.0 * params.y());
+					else
+						shape = new btCapsuleShape(params.x(), 2.0 * params.y());
+					break;
+				case CYLINDER_SHAPE_PROXYTYPE:
+					if (In.upAxis == 0)
+						shape = new btCylinderShapeX(params);
+					else if (In.upAxis == 2)
+						shape = new btCylinderShapeZ(params);
+					else
+						shape = new btCylinderShape(params);
+					break;
+				case STATIC_PLANE_PROXYTYPE:
+					shape = new btStaticPlaneShape(params, In.params[3]);
+					break;
+				default:
+					return nullptr;
+			}
+			shape->setLocalScaling(btVector3(In.scaling[0], In.scaling[1], In.scaling[2]));
+			// spheres and capsules derive the margin from the radius
+			if (In.type == BOX_SHAPE_PROXYTYPE || In.type == CYLINDER_SHAPE_PROXYTYPE)
+			{
+				shape->setMargin(In.margin);
+			}
+
+			return shape;
+		}
+
+		bool DisablesCollisions(btTypedConstraint* Constraint)
+		{
+			btRigidBody& body = Constraint->getRigidBodyA();
+			for (int i = 0; i < body.getNumConstraintRefs(); ++i)
+			{
+				if (body.getConstraintRef(i) == Constraint)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		bool WriteConstraint(btTypedConstraint* Constraint, const btHashMap<btHashPtr, int>& BodyIndex, Snapshot::Constraint& Out)
+		{
+			memset(static_cast<void*>(&Out), 0, sizeof(Out));
+			Out.type = Constraint->getConstraintType();
+
+			const int* bodyA = BodyIndex.find(&Constraint->getRigidBodyA());
+			const int* bodyB = BodyIndex.find(&Constraint->getRigidBodyB());
+			if ((!bodyA && &Constraint->getRigidBodyA() != &btTypedConstraint::getFixedBody()) ||
+				(!bodyB && &Constraint->getRigidBodyB() != &btTypedConstraint::getFixedBody()))
+			{
+				return false;
+			}
+			Out.bodyA = bodyA ? *bodyA : -1;
+			Out.bodyB = bodyB ? *bodyB : -1;
+			Out.flags = (Constraint->isEnabled() ? Snapshot::Enabled : 0) |
+						(DisablesCollisions(Constraint) ? Snapshot::DisableCollisionsBetweenLinkedBodies : 0);
+			Out.overrideNumSolverIterations = Constraint->getOverrideNumSolverIterations();
+			Out.breakingImpulseThreshold = Constraint->getBreakingImpulseThreshold();
+
+			switch (Out.type)
+			{
+				case POINT2POINT_CONSTRAINT_TYPE:
+				{
+					btPoint2PointConstraint* p2p = static_cast<btPoint2PointConstraint*>(Constraint);
+					Out.frameA.setIdentity();
+					Out.frameA.setOrigin(p2p->getPivotInA());
+					Out.frameB.setIdentity();
+					Out.frameB.setOrigin(p2p->getPivotInB());
+					Out.params[0] = p2p->m_setting.m_tau;
+					Out.params[1] = p2p->m_setting.m_damping;
+					Out.params[2] = p2p->m_setting.m_impulseClamp;
+					break;
+				}
+				case HINGE_CONSTRAINT_TYPE:
+				{
+					btHingeConstraint* hinge = static_cast<btHingeConstraint*>(Constraint);
+					Out.frameA = hinge->getAFrame();
+					Out.frameB = hinge->getBFrame();
+					Out.lowerLimit[1].setValue(hinge->getLowerLimit(), 0.0, 0.0);
+					Out.upperLimit[1].setValue(hinge->getUpperLimit(), 0.0, 0.0);
+					Out.params[0] = hinge->getLimitSoftness();
+					Out.params[1] = hinge->getLimitBiasFactor();
+					Out.params[2] = hinge->getLimitRelaxationFactor();
+					Out.params[3] = hinge->getMotorTargetVelocity();
+					Out.params[4] = hinge->getMaxMotorImpulse();
+					Out.flags |= (hinge->getUseReferenceFrameA() ? Snapshot::UseReferenceFrameA : 0) |
+								 (hinge->getAngularOnly() ? Snapshot::AngularOnly : 0) |
+								 (hinge->getEnableAngularMotor() ? Snapshot::EnableAngularMotor : 0);
+					break;
+				}
+				case D6_SPRING_2_CONSTRAINT_TYPE:
+				{
+					// also covers btFixedConstraint
+					btGeneric6DofSpring2Constraint* dof = static_cast<btGeneric6DofSpring2Constraint*>(Constraint);
+					Out.frameA = dof->getFrameOffsetA();
+					Out.frameB = dof->getFrameOffsetB();
+					dof->getLinearLowerLimit(Out.lowerLimit[0]);
+					dof->getLinearUpperLimit(Out.upperLimit[0]);
+					dof->getAngularLowerLimit(Out.lowerLimit[1]);
+					dof->getAngularUpperLimit(Out.upperLimit[1]);
+					Out.rotateOrder = dof->getRotationOrder();
+					break;
+				}
+				default:
+					return false;
+			}
+
+			return true;
+		}
+
+		btTypedConstraint* CreateConstraint(const Snapshot::Constraint& In, btRigidBody& BodyA, btRigidBody& BodyB)
+		{
+			btTypedConstraint* constraint = nullptr;
+			switch (In.type)
+			{
+				case POINT2POINT_CONSTRAINT_TYPE:
+				{
+					btPoint2PointConstraint* p2p = new btPoint2PointConstraint(BodyA, BodyB, In.frameA.getOrigin(), In.frameB.getOrigin());
+					p2p->m_setting.m_tau = In.params[0];
+					p2p->m_setting.m_damping = In.params[1];
+					p2p->m_setting.m_impulseClamp = In.params[2];
+					constraint = p2p;
+					break;
+				}
+				case HINGE_CONSTRAINT_TYPE:
+				{
+					btHingeConstraint* hinge = new btHingeConstraint(BodyA, BodyB, In.frameA, In.frameB, (In.flags & Snapshot::UseReferenceFrameA) != 0);
+					hinge->setLimit(In.lowerLimit[1].x(), In.upperLimit[1].x(), In.params[0], In.params[1], In.params[2]);
+					hinge->setAngularOnly((In.flags & Snapshot::AngularOnly) != 0);
+					hinge->enableAngularMotor((In.flags & Snapshot::EnableAngularMotor) != 0, In.params[3], In.params[4]);
+					constraint = hinge;
+					break;
+				}
+				case D6_SPRING_2_CONSTRAINT_TYPE:
+				{
+					btGeneric6DofSpring2Constraint* dof = new btGeneric6DofSpring2Constraint(BodyA, BodyB, In.frameA, In.frameB, RotateOrder(In.rotateOrder));
+					dof->setLinearLowerLimit(In.lowerLimit[0]);
+					dof->setLinearUpperLimit(In.upperLimit[0]);
+					dof->setAngularLowerLimit(In.lowerLimit[1]);
+					dof->setAngularUpperLimit(In.upperLimit[1]);
+					constraint = dof;
+					break;
+				}
+				default:
+					return nullptr;
+			}
+			constraint->setEnabled((In.flags & Snapshot::Enabled) != 0);
+			constraint->setOverrideNumSolverIterations(In.overrideNumSolverIterations);
+			constraint->setBreakingImpulseThreshold(In.breakingImpulseThreshold);
+
+			return constraint;
+		}
+	};
+
+	PhysicsSnapshot::PhysicsSnapshot()
+		: m_Data(nullptr), m_Size(0), m_Mapping(nullptr)
+	{
+	}
+
+	PhysicsSnapshot::~PhysicsSnapshot()
+	{
+		Close();
+	}
+
+	bool PhysicsSnapshot::Open(const char* Path)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		{
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		}
+		CloseHandle(file);
+		if (!mapping)
+		{
+			return false;
+		}
+
+		// the view keeps the mapping object alive
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (!data)
+		{
+			return false;
+		}
+		m_Size = size_t(size.QuadPart);
+#else
+		int file = open(Path, O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat info;
+		void* data = MAP_FAILED;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+		{
+			data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		}
+		close(file);
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+		m_Size = size_t(info.st_size);
+#endif
+		m_Mapping = data;
+		m_Data = data;
+
+		if (!Validate())
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	bool PhysicsSnapshot::Open(const void* Data, size_t Size)
+	{
+		Close();
+
+		if ((reinterpret_cast<uintptr_t>(Data) & (Snapshot::Alignment - 1)) != 0)
+		{
+			return false;
+		}
+		m_Data = Data;
+		m_Size = Size;
+
+		if (!Validate())
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void PhysicsSnapshot::Close()
+	{
+		if (m_Mapping)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(m_Mapping);
+#else
+			munmap(m_Mapping, m_Size);
+#endif
+		}
+		m_Mapping = nullptr;
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+	bool PhysicsSnapshot::Validate() const
+	{
+		if (!m_Data || m_Size < sizeof(Snapshot::Header))
+		{
+			return false;
+		}
+
+		const Snapshot::Header& header = GetHeader();
+		if (memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 || header.version != Snapshot::Version ||
+			header.scalarSize != sizeof(btScalar) || header.endianTag != Snapshot::EndianTag || header.fileSize != m_Size)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < Snapshot::SectionCount; ++i)
+		{
+			uint64_t count, elementSize;
+			GetSectionLayout(header, i, count, elementSize);
+			const uint64_t offset = header.sections[i];
+			if ((offset & (Snapshot::Alignment - 1)) != 0 || offset < sizeof(Snapshot::Header) || offset > m_Size ||
+				count > (m_Size - offset) / elementSize)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void PhysicsSnapshotBodies::Destroy()
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			bodies[i].~btRigidBody();
+			motionStates[i].~btDefaultMotionState();
+		}
+		btAlignedFree(bodies);
+		btAlignedFree(motionStates);
+
+		bodies = nullptr;
+		motionStates = nullptr;
+		count = 0;
+	}
+
+	bool SavePhysicsSnapshot(const char* Path, btDiscreteDynamicsWorld& World)
+	{
+		const btCollisionObjectArray& objects = World.getCollisionObjectArray();
+		const int numBodies = objects.size();
+
+		btHashMap<btHashPtr, int> shapeIndex;
+		btHashMap<btHashPtr, int> bodyIndex;
+		btAlignedObjectArray<Snapshot::Shape> shapes;
+		btAlignedObjectArray<int> bodyShapes;
+		bodyShapes.resize(numBodies);
+		for (int i = 0; i < numBodies; ++i)
+		{
+			const btRigidBody* body = btRigidBody::upcast(objects[i]);
+			if (!body)
+			{
+				return false;
+			}
+			bodyIndex.insert(body, i);
+
+			const btCollisionShape* shape = body->getCollisionShape();
+			const int* index = shapeIndex.find(shape);
+			if (!index)
+			{
+				Snapshot::Shape record;
+				if (!WriteShape(shape, record))
+				{
+					return false;
+				}
+				shapeIndex.insert(shape, shapes.size());
+				bodyShapes[i] = shapes.size();
+				shapes.push_back(record);
+			}
+			else
+			{
+				bodyShapes[i] = *index;
+			}
+		}
+
+		btAlignedObjectArray<Snapshot::Constraint> constraints;
+		constraints.reserve(World.getNumConstraints());
+		for (int i = 0; i < World.getNumConstraints(); ++i)
+		{
+			Snapshot::Constraint record;
+			if (!WriteConstraint(World.getConstraint(i), bodyIndex, record))
+			{
+				return false;
+			}
+			constraints.push_back(record);
+		}
+
+		Snapshot::Header header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+		header.version = Snapshot::Version;
+		header.scalarSize = sizeof(btScalar);
+		header.endianTag = Snapshot::EndianTag;
+		header.numShapes = uint32_t(shapes.size());
+		header.numBodies = uint32_t(numBodies);
+		header.numConstraints = uint32_t(constraints.size());
+		const btVector3 gravity = World.getGravity();
+		for (int i = 0; i < 3; ++i)
+		{
+			header.gravity[i] = gravity[i];
+		}
+
+		uint64_t offset = AlignOffset(sizeof(Snapshot::Header));
+		for (int i = 0; i < Snapshot::SectionCount; ++i)
+		{
+			uint64_t count, elementSize;
+			GetSectionLayout(header, i, count, elementSize);
+			header.sections[i] = offset;
+			offset = AlignOffset(offset + count * elementSize);
+		}
+		header.fileSize = offset;
+
+		btAlignedObjectArray<char> data;
+		data.resize(int(header.fileSize), 0);
+		memcpy(&data[0], &header, sizeof(header));
+
+		Snapshot::Shape* outShapes = GetSection<Snapshot::Shape>(data, header, Snapshot::Shapes);
+		for (int i = 0; i < shapes.size(); ++i)
+		{
+			outShapes[i] = shapes[i];
+		}
+
+		btTransform* transforms = GetSection<btTransform>(data, header, Snapshot::Transforms);
+		btVector3* linearVelocities = GetSection<btVector3>(data, header, Snapshot::LinearVelocities);
+		btVector3* angularVelocities = GetSection<btVector3>(data, header, Snapshot::AngularVelocities);
+		btVector3* gravities = GetSection<btVector3>(data, header, Snapshot::Gravities);
+		btVector3* localInertias = GetSection<btVector3>(data, header, Snapshot::LocalInertias);
+		btVector3* linearFactors = GetSection<btVector3>(data, header, Snapshot::LinearFactors);
+		btVector3* angularFactors = GetSection<btVector3>(data, header, Snapshot::AngularFactors);
+		btScalar* masses = GetSection<btScalar>(data, header, Snapshot::Masses);
+		Snapshot::Material* materials = GetSection<Snapshot::Material>(data, header, Snapshot::Materials);
+		Snapshot::Damping* dampings = GetSection<Snapshot::Damping>(data, header, Snapshot::Dampings);
+		Snapshot::BodyState* states = GetSection<Snapshot::BodyState>(data, header, Snapshot::States);
+		int32_t* entities = GetSection<int32_t>(data, header, Snapshot::Entities);
+		for (int i = 0; i < numBodies; ++i)
+		{
+			const btRigidBody* body = btRigidBody::upcast(objects[i]);
+			const btBroadphaseProxy* proxy = body->getBroadphaseHandle();
+
+			transforms[i] = body->getWorldTransform();
+			linearVelocities[i] = body->getLinearVelocity();
+			angularVelocities[i] = body->getAngularVelocity();
+			gravities[i] = body->getGravity();
+			localInertias[i] = body->getLocalInertia();
+			linearFactors[i] = body->getLinearFactor();
+			angularFactors[i] = body->getAngularFactor();
+			masses[i] = body->getMass();
+
+			materials[i].friction = body->getFriction();
+			materials[i].rollingFriction = body->getRollingFriction();
+			materials[i].spinningFriction = body->getSpinningFriction();
+			materials[i].restitution = body->getRestitution();
+
+			dampings[i].linear = body->getLinearDamping();
+			dampings[i].angular = body->getAngularDamping();
+			dampings[i].linearSleepingThreshold = body->getLinearSleepingThreshold();
+			dampings[i].angularSleepingThreshold = body->getAngularSleepingThreshold();
+			dampings[i].deactivationTime = body->getDeactivationTime();
+			dampings[i].ccdMotionThreshold = body->getCcdMotionThreshold();
+			dampings[i].ccdSweptSphereRadius = body->getCcdSweptSphereRadius();
+
+			states[i].shape = bodyShapes[i];
+			states[i].collisionFlags = body->getCollisionFlags();
+			states[i].activationState = body->getActivationState();
+			states[i].rigidBodyFlags = body->getFlags();
+			states[i].filterGroup = proxy ? proxy->m_collisionFilterGroup : int(btBroadphaseProxy::DefaultFilter);
+			states[i].filterMask = proxy ? proxy->m_collisionFilterMask : int(btBroadphaseProxy::AllFilter);
+
+			entities[i] = body->getUserIndex();
+		}
+
+		Snapshot::Constraint* outConstraints = GetSection<Snapshot::Constraint>(data, header, Snapshot::Constraints);
+		for (int i = 0; i < constraints.size(); ++i)
+		{
+			outConstraints[i] = constraints[i];
+		}
+
+		FILE* file = fopen(Path, "wb");
+		if (!file)
+		{
+			return false;
+		}
+		const bool written = fwrite(&data[0], 1, size_t(header.fileSize), file) == size_t(header.fileSize);
+
+		return fclose(file) == 0 && written;
+	}
+
+	bool LoadPhysicsSnapshot(const PhysicsSnapshot& Snapshot, btDiscreteDynamicsWorld& World, btDbvtBroadphase* Broadphase,
+							 PhysicsSnapshotBodies& Bodies, btAlignedObjectArray<btCollisionShape*>& Shapes)
+	{
+		const int numShapes = Snapshot.GetNumShapes();
+		const int numBodies = Snapshot.GetNumBodies();
+		const int numConstraints = Snapshot.GetNumConstraints();
+
+		const Snapshot::Shape* shapes = Snapshot.GetSection<Snapshot::Shape>(Snapshot::Shapes);
+		const btTransform* transforms = Snapshot.GetSection<btTransform>(Snapshot::Transforms);
+		const btVector3* linearVelocities = Snapshot.GetSection<btVector3>(Snapshot::LinearVelocities);
+		const btVector3* angularVelocities = Snapshot.GetSection<btVector3>(Snapshot::AngularVelocities);
+		const btVector3* gravities = Snapshot.GetSection<btVector3>(Snapshot::Gravities);
+		const btVector3* localInertias = Snapshot.GetSection<btVector3>(Snapshot::LocalInertias);
+		const btVector3* linearFactors = Snapshot.GetSection<btVector3>(Snapshot::LinearFactors);
+		const btVector3* angularFactors = Snapshot.GetSection<btVector3>(Snapshot::AngularFactors);
+		const btScalar* masses = Snapshot.GetSection<btScalar>(Snapshot::Masses);
+		const Snapshot::Material* materials = Snapshot.GetSection<Snapshot::Material>(Snapshot::Materials);
+		const Snapshot::Damping* dampings = Snapshot.GetSection<Snapshot::Damping>(Snapshot::Dampings);
+		const Snapshot::BodyState* states = Snapshot.GetSection<Snapshot::BodyState>(Snapshot::States);
+		const int32_t* entities = Snapshot.GetSection<int32_t>(Snapshot::Entities);
+		const Snapshot::Constraint* constraints = Snapshot.GetSection<Snapshot::Constraint>(Snapshot::Constraints);
+
+		// check the references up front so a bad file leaves the world untouched
+		if (Bodies.count)
+		{
+			return false;
+		}
+		for (int i = 0; i < numShapes; ++i)
+		{
+			if (!IsSupportedShape(shapes[i].type))
+			{
+				return false;
+			}
+		}
+		for (int i = 0; i < numBodies; ++i)
+		{
+			if (states[i].shape < 0 || states[i].shape >= numShapes)
+			{
+				return false;
+			}
+		}
+		for (int i = 0; i < numConstraints; ++i)
+		{
+			const Snapshot::Constraint& c = constraints[i];
+			if (c.bodyA < -1 || c.bodyA >= numBodies || c.bodyB < -1 || c.bodyB >= numBodies ||
+				(c.type != POINT2POINT_CONSTRAINT_TYPE && c.type != HINGE_CONSTRAINT_TYPE && c.type != D6_SPRING_2_CONSTRAINT_TYPE))
+			{
+				return false;
+			}
+		}
+
+		const int firstShape = Shapes.size();
+		Shapes.reserve(firstShape + numShapes);
+		for (int i = 0; i < numShapes; ++i)
+		{
+			Shapes.push_back(CreateShape(shapes[i]));
+		}
+
+		// world gravity first, setGravity overwrites the gravity of the bodies in the world
+		const Snapshot::Header& header = Snapshot.GetHeader();
+		World.setGravity(btVector3(header.gravity[0], header.gravity[1], header.gravity[2]));
+
+		Bodies.bodies = static_cast<btRigidBody*>(btAlignedAlloc(sizeof(btRigidBody) * numBodies, 16));
+		Bodies.motionStates = static_cast<btDefaultMotionState*>(btAlignedAlloc(sizeof(btDefaultMotionState) * numBodies, 16));
+		for (int i = 0; i < numBodies; ++i)
+		{
+			btDefaultMotionState* motionState = new (&Bodies.motionStates[i]) btDefaultMotionState(transforms[i]);
+
+			btRigidBody::btRigidBodyConstructionInfo info(masses[i], motionState, Shapes[firstShape + states[i].shape], localInertias[i]);
+			info.m_linearDamping = dampings[i].linear;
+			info.m_angularDamping = dampings[i].angular;
+			info.m_linearSleepingThreshold = dampings[i].linearSleepingThreshold;
+			info.m_angularSleepingThreshold = dampings[i].angularSleepingThreshold;
+			info.m_friction = materials[i].friction;
+			info.m_rollingFriction = materials[i].rollingFriction;
+			info.m_spinningFriction = materials[i].spinningFriction;
+			info.m_restitution = materials[i].restitution;
+
+			btRigidBody* body = new (&Bodies.bodies[i]) btRigidBody(info);
+			body->setCollisionFlags(states[i].collisionFlags);
+			body->setFlags(states[i].rigidBodyFlags);
+			body->setLinearVelocity(linearVelocities[i]);
+			body->setAngularVelocity(angularVelocities[i]);
+			body->setLinearFactor(linearFactors[i]);
+			body->setAngularFactor(angularFactors[i]);
+			body->setCcdMotionThreshold(dampings[i].ccdMotionThreshold);
+			body->setCcdSweptSphereRadius(dampings[i].ccdSweptSphereRadius);
+			body->setUserIndex(entities[i]);
+		}
+		Bodies.count = numBodies;
+
+		// defer the pair search while the proxies are inserted, then build the tree and the pairs in bulk
+		const bool bulkBroadphase = Broadphase && Broadphase == World.getBroadphase();
+		const bool deferedCollide = bulkBroadphase && Broadphase->m_deferedcollide;
+		if (bulkBroadphase)
+		{
+			Broadphase->m_deferedcollide = true;
+		}
+
+		World.getCollisionObjectArray().reserve(World.getNumCollisionObjects() + numBodies);
+		for (int i = 0; i < numBodies; ++i)
+		{
+			btRigidBody* body = &Bodies.bodies[i];
+			World.addRigidBody(body, states[i].filterGroup, states[i].filterMask);
+			body->setGravity(gravities[i]);
+			body->forceActivationState(states[i].activationState);
+			body->setDeactivationTime(dampings[i].deactivationTime);
+		}
+
+		if (bulkBroadphase)
+		{
+			Broadphase->m_sets[0].optimizeTopDown();
+			Broadphase->calculateOverlappingPairs(World.getDispatcher());
+			Broadphase->m_deferedcollide = deferedCollide;
+		}
+
+		for (int i = 0; i < numConstraints; ++i)
+		{
+			const Snapshot::Constraint& c = constraints[i];
+			btRigidBody& bodyA = c.bodyA < 0 ? btTypedConstraint::getFixedBody() : Bodies.bodies[c.bodyA];
+			btRigidBody& bodyB = c.bodyB < 0 ? btTypedConstraint::getFixedBody() : Bodies.bodies[c.bodyB];
+			World.addConstraint(CreateConstraint(c, bodyA, bodyB), (c.flags & Snapshot::DisableCollisionsBetweenLinkedBodies) != 0);
+		}
+
+		return true;
+	}
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include <btBulletDynamicsCommon.h>
+
+namespace GR
+{
+	// Fixed layout binary snapshot of a dynamics world.
+	//
+	// The file is a header followed by 16 byte aligned sections. Bodies are stored as structure of arrays,
+	// one section per field, in the native btScalar/endian layout of the writer, so a mapped file is used
+	// in place: the sections are read through typed pointers, nothing is parsed or converted per field.
+	// A file written with a different btScalar size or byte order is rejected by PhysicsSnapshot::Open.
+	namespace Snapshot
+	{
+		constexpr uint32_t Version = 1;
+		constexpr uint32_t EndianTag = 0x01020304;
+		constexpr uint32_t Alignment = 16;
+
+		enum Section
+		{
+			Shapes,            // Shape[NumShapes]
+			Transforms,        // btTransform[NumBodies]
+			LinearVelocities,  // btVector3[NumBodies]
+			AngularVelocities, // btVector3[NumBodies]
+			Gravities,         // btVector3[NumBodies], per body gravity acceleration
+			LocalInertias,     // btVector3[NumBodies]
+			LinearFactors,     // btVector3[NumBodies]
+			AngularFactors,    // btVector3[NumBodies]
+			Masses,            // btScalar[NumBodies]
+			Materials,         // Material[NumBodies]
+			Dampings,          // Damping[NumBodies]
+			States,            // BodyState[NumBodies]
+			Entities,          // int32_t[NumBodies], btCollisionObject::getUserIndex, -1 for bodies without entity
+			Constraints,       // Constraint[NumConstraints]
+			SectionCount
+		};
+
+		struct Header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t scalarSize;
+			uint32_t endianTag;
+			uint32_t numShapes;
+			uint32_t numBodies;
+			uint32_t numConstraints;
+			uint64_t fileSize;
+			uint64_t sections[SectionCount];  // byte offset of each section from the start of the file
+			btScalar gravity[4];
+		};
+
+		struct Shape
+		{
+			int32_t type;  // BroadphaseNativeTypes
+			int32_t upAxis;
+			btScalar params[4];  // box/cylinder: half extents without margin, sphere: radius, capsule: radius, half height, plane: normal, constant
+			btScalar scaling[3];
+			btScalar margin;
+		};
+
+		struct Material
+		{
+			btScalar friction;
+			btScalar rollingFriction;
+			btScalar spinningFriction;
+			btScalar restitution;
+		};
+
+		struct Damping
+		{
+			btScalar linear;
+			btScalar angular;
+			btScalar linearSleepingThreshold;
+			btScalar angularSleepingThreshold;
+			btScalar deactivationTime;
+			btScalar ccdMotionThreshold;
+			btScalar ccdSweptSphereRadius;
+			btScalar padding;
+		};
+
+		struct BodyState
+		{
+			int32_t shape;
+			int32_t collisionFlags;
+			int32_t activationState;
+			int32_t rigidBodyFlags;
+			int32_t filterGroup;
+			int32_t filterMask;
+			int32_t padding[2];
+		};
+
+		struct Constraint
+		{
+			int32_t type;  // btTypedConstraintType
+			int32_t bodyA;  // -1 for btTypedConstraint::getFixedBody
+			int32_t bodyB;
+			int32_t flags;
+			int32_t overrideNumSolverIterations;
+			int32_t rotateOrder;
+			int32_t padding[2];
+			btTransform frameA;
+			btTransform frameB;
+			btVector3 lowerLimit[2];  // linear, angular
+			btVector3 upperLimit[2];
+			btScalar params[6];  // hinge: softness, bias, relaxation, motor target velocity, max motor impulse; point2point: tau, damping, impulse clamp
+			btScalar breakingImpulseThreshold;
+			btScalar padding2;
+		};
+
+		enum ConstraintFlags
+		{
+			Enabled = 1,
+			DisableCollisionsBetweenLinkedBodies = 2,
+			UseReferenceFrameA = 4,
+			AngularOnly = 8,
+			EnableAngularMotor = 16
+		};
+	};
+
+	// Read only view of a snapshot file, mapped into memory with mmap/MapViewOfFile.
+	class PhysicsSnapshot
+	{
+	public:
+		PhysicsSnapshot();
+
+		~PhysicsSnapshot();
+
+		// map and validate the file, the sections are accessible until Close
+		bool Open(const char* Path);
+
+		// validate a snapshot that is already in memory, the data has to be 16 byte aligned and outlive the view
+		bool Open(const void* Data, size_t Size);
+
+		void Close();
+
+		const Snapshot::Header& GetHeader() const { return *reinterpret_cast<const Snapshot::Header*>(m_Data); }
+
+		int GetNumShapes() const { return int(GetHeader().numShapes); }
+
+		int GetNumBodies() const { return int(GetHeader().numBodies); }
+
+		int GetNumConstraints() const { return int(GetHeader().numConstraints); }
+
+		template <typename T>
+		const T* GetSection(Snapshot::Section Section) const
+		{
+			return reinterpret_cast<const T*>(static_cast<const char*>(m_Data) + GetHeader().sections[Section]);
+		}
+
+	private:
+		PhysicsSnapshot(const PhysicsSnapshot&) = delete;
+		PhysicsSnapshot& operator=(const PhysicsSnapshot&) = delete;
+
+		bool Validate() const;
+
+		const void* m_Data;
+		size_t m_Size;
+		void* m_Mapping;
+	};
+
+	// Rigid bodies and motion states of a loaded snapshot, constructed in place in one block each.
+	struct PhysicsSnapshotBodies
+	{
+		btRigidBody* bodies = nullptr;
+		btDefaultMotionState* motionStates = nullptr;
+		int count = 0;
+
+		bool Owns(const btCollisionObject* Object) const
+		{
+			return count && Object >= bodies && Object < bodies + count;
+		}
+
+		// the bodies have to be removed from the world before
+		void Destroy();
+	};
+
+	// Write all rigid bodies, their shapes and the constraints between them. Fails if the world contains
+	// other collision objects, shapes or constraints than the snapshot supports.
+	bool SavePhysicsSnapshot(const char* Path, btDiscreteDynamicsWorld& World);
+
+	// Create the shapes, bodies and constraints of a snapshot in World. New shapes are appended to Shapes,
+	// the constraints are allocated with new. If Broadphase is the broadphase of World, the proxies are
+	// added without per proxy pair queries, the tree is rebuilt top down and the pairs are found in one pass.
+	bool LoadPhysicsSnapshot(const PhysicsSnapshot& Snapshot, btDiscreteDynamicsWorld& World, btDbvtBroadphase* Broadphase,
+							 PhysicsSnapshotBodies& Bodies, btAlignedObjectArray<btCollisionShape*>& Shapes);
+};
@@ -1,16 +1,45 @@
 #include "physics_world.hpp"
 #include "Vulkan/renderer.hpp"
+#include "BulletCollision/CollisionDispatch/btInternalEdgeUtility.h"
 
 namespace GR
 {
+	namespace
+	{
+		// contacts of bodies with CF_CUSTOM_MATERIAL_CALLBACK, the cooked meshes
+		bool AdjustInternalEdgeContacts(btManifoldPoint& cp, const btCollisionObjectWrapper* colObj0Wrap, int partId0, int index0,
+										const btCollisionObjectWrapper* colObj1Wrap, int partId1, int index1)
+		{
+			if (colObj1Wrap->getCollisionShape()->getShapeType() == TRIANGLE_SHAPE_PROXYTYPE)
+			{
+				btAdjustInternalEdgeContacts(cp, colObj1Wrap, colObj0Wrap, partId1, index1);
+			}
+			else
+			{
+				btAdjustInternalEdgeContacts(cp, colObj0Wrap, colObj1Wrap, partId0, index0);
+			}
+			return true;
+		}
+	};
+
 	PhysicsWorld::PhysicsWorld(const Renderer& Context)
-		: World(Context)
+		: World(Context), m_TaskScheduler(nullptr)
 	{
+		// the batch backend and the other parallel paths run through btParallelFor, which needs a task scheduler
+		if (!btGetTaskScheduler())
+		{
+			m_TaskScheduler = btCreateDefaultTaskScheduler();
+			btSetTaskScheduler(m_TaskScheduler ? m_TaskScheduler : btGetSequentialTaskScheduler());
+		}
+
 		m_Broadphase = new btDbvtBroadphase;
 		m_Solver = new btSequentialImpulseConstraintSolver;
 		m_CollisionConfiguration = new btDefaultCollisionConfiguration;
 		m_Dispatcher = new btCollisionDispatcher(m_CollisionConfiguration);
 		m_DynamicsWorld = new btDiscreteDynamicsWorld(m_Dispatcher, m_Broadphase, m_Solver, m_CollisionConfiguration);
+
+		// slow frames run collision detection once and substep only the solver
+		m_DynamicsWorld->setSoftStepping(true);
 	}
 
 	PhysicsWorld::~PhysicsWorld()
@@ -23,6 +52,12 @@ namespace GR
 		delete m_CollisionConfiguration;
 		delete m_Broadphase;
 		delete m_Solver;
+
+		if (m_TaskScheduler)
+		{
+			btSetTaskScheduler(btGetSequentialTaskScheduler());
+			delete m_TaskScheduler;
+		}
 	}
 
 	Entity PhysicsWorld::AddShape(const Shapes::GeoClipmap& Descriptor)
@@ -150,6 +185,73 @@ namespace GR
 		return ctDeep.d;
 	}
 
+	void PhysicsWorld::OverlapSphere(const glm::dvec3& Center, double Radius, std::vector<Entity>& out) const
+	{
+		btSphereShape shape(Radius);
+
+		OverlapQuery query;
+		query.shape = &shape;
+		query.transform.setOrigin(btVector3(Center.x, Center.y, Center.z));
+
+		Overlap(query, out);
+	}
+
+	void PhysicsWorld::OverlapBox(const glm::dvec3& Center, const glm::dvec3& HalfExtents, const glm::dquat& Rotation, std::vector<Entity>& out) const
+	{
+		btBoxShape shape(btVector3(HalfExtents.x, HalfExtents.y, HalfExtents.z));
+
+		OverlapQuery query;
+		query.shape = &shape;
+		query.transform.setOrigin(btVector3(Center.x, Center.y, Center.z));
+		query.transform.setRotation(btQuaternion(Rotation.x, Rotation.y, Rotation.z, Rotation.w));
+
+		Overlap(query, out);
+	}
+
+	void PhysicsWorld::OverlapCapsule(const glm::dvec3& A, const glm::dvec3& B, double Radius, std::vector<Entity>& out) const
+	{
+		const btVector3 a = btVector3(A.x, A.y, A.z);
+		const btVector3 b = btVector3(B.x, B.y, B.z);
+		const btVector3 axis = b - a;
+		const btScalar height = axis.length();
+
+		// btCapsuleShape is along its local y axis
+		btCapsuleShape shape(Radius, height);
+
+		OverlapQuery query;
+		query.shape = &shape;
+		query.transform.setOrigin((a + b) * 0.5);
+		if (height > SIMD_EPSILON)
+		{
+			query.transform.setRotation(shortestArcQuat(btVector3(0.0, 1.0, 0.0), axis / height));
+		}
+
+		Overlap(query, out);
+	}
+
+	void PhysicsWorld::Overlap(const OverlapQuery& Query, std::vector<Entity>& out) const
+	{
+		std::vector<uint32_t> ids;
+		QueryOverlaps(*m_DynamicsWorld, Query, ids);
+
+		for (uint32_t id : ids)
+		{
+			out.push_back(Entity(id));
+		}
+	}
+
+	void PhysicsWorld::OverlapBatch(const std::vector<OverlapQuery>& Queries, std::vector<Entity>& out, std::vector<uint32_t>& offsets) const
+	{
+		std::vector<uint32_t> ids;
+		QueryOverlapsBatch(*m_DynamicsWorld, Queries.data(), int(Queries.size()), ids, offsets);
+
+		out.resize(ids.size());
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			out[i] = Entity(ids[i]);
+		}
+	}
+
 	void PhysicsWorld::ResetObject(Entity object)
 	{
 		Components::WorldMatrix& transform = GetComponent<Components::WorldMatrix>(object);
@@ -189,6 +291,185 @@ namespace GR
 		body->forceActivationState(0);
 	}
 
+	Entity PhysicsWorld::AddCollisionMesh(const char* Path, const glm::dvec3& Position)
+	{
+		CollisionMeshAsset* asset = new CollisionMeshAsset;
+		if (!asset->Open(Path))
+		{
+			delete asset;
+			return Entity(-1);
+		}
+		m_MeshAssets.push_back(asset);
+
+		if (!gContactAddedCallback)
+		{
+			gContactAddedCallback = AdjustInternalEdgeContacts;
+		}
+
+		Entity ent = Registry.create();
+
+		btTransform startTransform;
+		startTransform.setIdentity();
+		startTransform.setOrigin(btVector3(Position.x, Position.y, Position.z));
+
+		btDefaultMotionState* myMotionState = new btDefaultMotionState(startTransform);
+		btRigidBody::btRigidBodyConstructionInfo rbInfo(0.0, myMotionState, asset->GetShape(), btVector3(0.0, 0.0, 0.0));
+		btRigidBody* body = new btRigidBody(rbInfo);
+
+		if (asset->GetShape()->getTriangleInfoMap())
+		{
+			body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+		}
+		body->setUserIndex(int(ent));
+
+		Registry.emplace<Components::Body>(ent, body);
+		Registry.emplace<Components::Mass>(ent, btScalar(0.0));
+		m_DynamicsWorld->addRigidBody(body);
+
+		return ent;
+	}
+
+	bool PhysicsWorld::SaveSnapshot(const char* Path) const
+	{
+		return SavePhysicsSnapshot(Path, *m_DynamicsWorld);
+	}
+
+	bool PhysicsWorld::LoadSnapshot(const char* Path)
+	{
+		if (m_DynamicsWorld->getNumCollisionObjects() > 0)
+		{
+			return false;
+		}
+
+		PhysicsSnapshot snapshot;
+		if (!snapshot.Open(Path) || !LoadPhysicsSnapshot(snapshot, *m_DynamicsWorld, m_Broadphase, m_SnapshotBodies, m_CollisionShapes))
+		{
+			return false;
+		}
+
+		for (int i = 0; i < m_SnapshotBodies.count; ++i)
+		{
+			btRigidBody* body = &m_SnapshotBodies.bodies[i];
+			if (body->getUserIndex() < 0)
+			{
+				continue;
+			}
+
+			Entity ent = Entity(body->getUserIndex());
+			if (!Registry.valid(ent))
+			{
+				ent = Registry.create(ent);
+			}
+			Registry.emplace_or_replace<Components::Body>(ent, body);
+			Registry.emplace_or_replace<Components::Mass>(ent, body->getMass());
+		}
+
+		return true;
+	}
+
+	bool PhysicsWorld::SaveCheckpoint(btDynamicsWorldCheckpoint& Checkpoint) const
+	{
+		return Checkpoint.save(m_DynamicsWorld, m_Dispatcher, m_Broadphase);
+	}
+
+	bool PhysicsWorld::RestoreCheckpoint(const btDynamicsWorldCheckpoint& Checkpoint)
+	{
+		if (!Checkpoint.restore(m_DynamicsWorld, m_Dispatcher, m_Broadphase))
+		{
+			return false;
+		}
+
+		// update every entity, DrawScene skips sleeping bodies and the restore can move those too
+		auto view = Registry.view<Components::Body, Components::WorldMatrix>();
+		for (const auto& [ent, body, transform] : view.each())
+		{
+			glm::dmat4 T;
+			body.body->getWorldTransform().getOpenGLMatrix(glm::value_ptr(T));
+			transform.SetFromMatrix(T);
+		}
+
+		return true;
+	}
+
+	void PhysicsWorld::EnableBatchPhysics(const glm::dvec3& Origin)
+	{
+		for (const auto& [ent, body] : Registry.view<Components::BatchBody>().each())
+		{
+			Registry.destroy(ent);
+		}
+
+		m_Batch.Reset(Origin, Renderer::Rg, -gravity);
+	}
+
+	Entity PhysicsWorld::AddBatchShape(const Shapes::Cube& Descriptor, const glm::dvec3& Position)
+	{
+		if (!m_Batch.IsEnabled())
+		{
+			return AddShape(Descriptor);
+		}
+
+		Entity ent = World::AddShape(Descriptor);
+		Components::WorldMatrix& transform = GetComponent<Components::WorldMatrix>(ent);
+		transform.SetOffset(Position);
+
+		glm::vec3 extents = Descriptor.GetDimensions();
+		float mass = extents.x * extents.y;
+		int index = m_Batch.AddBox(extents, mass, transform.GetMatrix(), uint32_t(ent));
+		m_Batch.SetMaterial(index, 0.5f, 0.f);
+
+		Registry.emplace<Components::BatchBody>(ent, index);
+		Registry.emplace<Components::Mass>(ent, mass);
+
+		return ent;
+	}
+
+	Entity PhysicsWorld::AddBatchShape(const Shapes::Sphere& Descriptor, const glm::dvec3& Position)
+	{
+		if (!m_Batch.IsEnabled())
+		{
+			return AddShape(Descriptor);
+		}
+
+		Entity ent = World::AddShape(Descriptor);
+		Components::WorldMatrix& transform = GetComponent<Components::WorldMatrix>(ent);
+		transform.SetOffset(Position);
+
+		glm::vec3 extents = Descriptor.GetDimensions();
+		float mass = extents.x * extents.y * 0.5f;
+		int index = m_Batch.AddSphere(extents.x, mass, transform.GetMatrix(), uint32_t(ent));
+		m_Batch.SetMaterial(index, 0.5f, 0.f);
+
+		Registry.emplace<Components::BatchBody>(ent, index);
+		Registry.emplace<Components::Mass>(ent, mass);
+
+		return ent;
+	}
+
+	bool PhysicsWorld::StartRecording(const char* Path)
+	{
+		return m_Recorder.Open(Path, Renderer::Rg);
+	}
+
+	void PhysicsWorld::StopRecording()
+	{
+		m_Recorder.Close();
+	}
+
+	void PhysicsWorld::ApplyReplayFrame(const ReplayPlayer& Player)
+	{
+		for (const ReplayPose& pose : Player.GetPoses())
+		{
+			const Entity ent = Entity(pose.id);
+			Components::WorldMatrix* transform = Registry.valid(ent) ? Registry.try_get<Components::WorldMatrix>(ent) : nullptr;
+			if (transform)
+			{
+				glm::dmat4 T;
+				pose.transform.getOpenGLMatrix(glm::value_ptr(T));
+				transform->SetFromMatrix(T);
+			}
+		}
+	}
+
 	void PhysicsWorld::DrawScene(double Delta)
 	{
 		constexpr double fixedStep = 1.0 / 60.0;
@@ -211,23 +492,65 @@ namespace GR
 		}
 		m_DynamicsWorld->stepSimulation(Delta, 10, fixedStep);
 
+		if (m_Batch.IsEnabled())
+		{
+			m_Batch.Step(Delta);
+
+			for (const auto& [ent, body, transform] : Registry.view<Components::BatchBody, Components::WorldMatrix>().each())
+			{
+				transform.SetFromMatrix(m_Batch.GetTransform(body.index));
+			}
+		}
+
+		if (m_Recorder.IsOpen())
+		{
+			m_Recorder.BeginFrame(Delta);
+			for (const auto& [ent, body] : Registry.view<Components::Body>().each())
+			{
+				m_Recorder.AddBody(uint32_t(ent), body.body->getWorldTransform(), body.body->getActivationState() == ACTIVE_TAG);
+			}
+			for (const auto& [ent, body] : Registry.view<Components::BatchBody>().each())
+			{
+				btTransform T;
+				glm::dmat4 M = m_Batch.GetTransform(body.index);
+				T.setFromOpenGLMatrix(glm::value_ptr(M));
+				m_Recorder.AddBody(uint32_t(ent), T, true);
+			}
+			m_Recorder.EndFrame();
+		}
+
 		World::DrawScene(Delta);
 	}
 
 	void PhysicsWorld::Clear()
 	{
-		for (int i = 0; i < m_DynamicsWorld->getNumCollisionObjects(); ++i)
+		for (int i = m_DynamicsWorld->getNumConstraints() - 1; i >= 0; --i)
+		{
+			btTypedConstraint* constraint = m_DynamicsWorld->getConstraint(i);
+			m_DynamicsWorld->removeConstraint(constraint);
+			delete constraint;
+		}
+
+		// removal swaps the last object into the freed slot, walk backwards
+		for (int i = m_DynamicsWorld->getNumCollisionObjects() - 1; i >= 0; --i)
 		{
 			btCollisionObject* obj = m_DynamicsWorld->getCollisionObjectArray()[i];
+			m_DynamicsWorld->removeCollisionObject(obj);
+
+			// bodies of a loaded snapshot are destroyed with their block below
+			if (m_SnapshotBodies.Owns(obj))
+			{
+				continue;
+			}
+
 			btRigidBody* body = btRigidBody::upcast(obj);
 			if (body && body->getMotionState())
 			{
 				delete body->getMotionState();
 			}
-
-			m_DynamicsWorld->removeCollisionObject(obj);
 			delete obj;
 		}
+		m_SnapshotBodies.Destroy();
 
 		for (int i = 0; i < m_CollisionShapes.size(); ++i)
 		{
@@ -235,6 +558,19 @@ namespace GR
 		}
 		m_CollisionShapes.resize(0);
 
+		// the shapes of the cooked meshes belong to their assets
+		for (int i = 0; i < m_MeshAssets.size(); ++i)
+		{
+			delete m_MeshAssets[i];
+		}
+		m_MeshAssets.resize(0);
+
+		// keep the region, drop the bodies
+		if (m_Batch.IsEnabled())
+		{
+			m_Batch.Reset(m_Batch.GetOrigin(), Renderer::Rg, -gravity);
+		}
+
 		World::Clear();
 	}
 };
\ No newline at end of file
@@ -1,13 +1,21 @@
 #pragma once
 #include "Engine/world.hpp"
 #include "glm/gtc/type_ptr.hpp"
+#include "glm/gtc/quaternion.hpp"
 
 #include <btBulletDynamicsCommon.h>
+#include "LinearMath/btThreads.h"
 #include "BulletCollision/CollisionDispatch/btCollisionWorld.h"
 #include "BulletDynamics/Character/btKinematicCharacterController.h"
 #include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
 #include "BulletCollision/CollisionDispatch/btGhostObject.h"
 #include "BulletCollision/CollisionShapes/btShapeHull.h"
+#include "BulletDynamics/Dynamics/btDynamicsWorldCheckpoint.h"
+#include "physics_snapshot.hpp"
+#include "physics_replay.hpp"
+#include "physics_batch.hpp"
+#include "physics_mesh_asset.hpp"
+#include "physics_overlap.hpp"
 
 namespace GR
 {
@@ -22,6 +30,12 @@ namespace GR
 		{
 			btScalar mass = 0.f;
 		};
+
+		// body of the batch backend, see PhysicsWorld::EnableBatchPhysics
+		struct BatchBody
+		{
+			int index;
+		};
 	};
 
 	struct RayCastResult
@@ -102,12 +116,68 @@ namespace GR
 
 		double DeepestContactPoint(Entity object, RayCastResult& out);
 
+		// Entities whose bodies overlap the shape, appended to out without contact points (see physics_overlap.hpp).
+		// Bodies of the batch backend are not part of the world.
+		void OverlapSphere(const glm::dvec3& Center, double Radius, std::vector<Entity>& out) const;
+
+		void OverlapBox(const glm::dvec3& Center, const glm::dvec3& HalfExtents, const glm::dquat& Rotation, std::vector<Entity>& out) const;
+
+		// capsule around the segment from A to B
+		void OverlapCapsule(const glm::dvec3& A, const glm::dvec3& B, double Radius, std::vector<Entity>& out) const;
+
+		void Overlap(const OverlapQuery& Query, std::vector<Entity>& out) const;
+
+		// Answer many queries in parallel through btParallelFor, the entities of query i are out[offsets[i]] up to out[offsets[i + 1]].
+		void OverlapBatch(const std::vector<OverlapQuery>& Queries, std::vector<Entity>& out, std::vector<uint32_t>& offsets) const;
+
 		void ResetObject(Entity object);
 
 		void ResetPosition(Entity object);
 
 		void FreezeObject(Entity object);
 
+		// Map a mesh cooked with CookCollisionMesh and add it as a static body at Position, the file stays mapped until Clear.
+		// Contacts with the mesh are corrected with its internal edge info, so bodies slide over the edges between triangles.
+		Entity AddCollisionMesh(const char* Path, const glm::dvec3& Position);
+
+		// Write the bodies, shapes, constraints and entity ids to a fixed layout snapshot file (see physics_snapshot.hpp).
+		bool SaveSnapshot(const char* Path) const;
+
+		// Map a snapshot file and create its bodies in bulk, the world has to be empty. Entities of the stored ids
+		// that don't exist are created, the bodies are attached as Components::Body. Contact manifolds are not part
+		// of the snapshot, the first step after loading starts without warm starting.
+		bool LoadSnapshot(const char* Path);
+
+		// Save the simulation state in memory for a later rollback. Fails for shapes or objects the checkpoint doesn't
+		// support, see btDynamicsWorldCheckpoint. Bodies and constraints must not be added or removed until the restore.
+		bool SaveCheckpoint(btDynamicsWorldCheckpoint& Checkpoint) const;
+
+		// Roll the world back to a checkpoint of this world and move the entities along. Stepping afterwards with the
+		// same deltas reproduces the steps after the save exactly.
+		bool RestoreCheckpoint(const btDynamicsWorldCheckpoint& Checkpoint);
+
+		// Simulate the shapes added with AddBatchShape in a Bullet3 CPU pipeline around Origin (see physics_batch.hpp).
+		// Batch bodies collide with each other and the ground plane below Origin, not with the bodies of AddShape.
+		// Calling it again drops the batch bodies and starts a new region.
+		void EnableBatchPhysics(const glm::dvec3& Origin);
+
+		bool IsBatchPhysicsEnabled() const { return m_Batch.IsEnabled(); }
+
+		Entity AddBatchShape(const Shapes::Cube& Descriptor, const glm::dvec3& Position);
+
+		Entity AddBatchShape(const Shapes::Sphere& Descriptor, const glm::dvec3& Position);
+
+		// Record the transforms of all bodies with an entity after every step of DrawScene (see physics_replay.hpp).
+		// Blocks are written on a background thread, StopRecording flushes the last one.
+		bool StartRecording(const char* Path);
+
+		void StopRecording();
+
+		bool IsRecording() const { return m_Recorder.IsOpen(); }
+
+		// Move the entities to the poses of the current frame of a replay, entities that don't exist are skipped.
+		void ApplyReplayFrame(const ReplayPlayer& Player);
+
 		void DrawScene(double Delta) override;
 
 		void Clear() override;
@@ -119,5 +189,10 @@ namespace GR
 		btDiscreteDynamicsWorld* m_DynamicsWorld;
 		btCollisionDispatcher* m_Dispatcher;
 		btDbvtBroadphase* m_Broadphase;
+		btITaskScheduler* m_TaskScheduler;  // created by this world, null if a scheduler was already installed
+		PhysicsSnapshotBodies m_SnapshotBodies;
+		btAlignedObjectArray<CollisionMeshAsset*> m_MeshAssets;
+		ReplayRecorder m_Recorder;
+		BatchPhysics m_Batch;
 	};
 };
\ No newline at end of file
@@ -4,6 +4,12 @@
 
 #include "Bullet3Collision/NarrowPhaseCollision/shared/b3ConvexPolyhedronData.h"
 #include "Bullet3Collision/NarrowPhaseCollision/shared/b3ContactConvexConvexSAT.h"
+#include "Bullet3Collision/NarrowPhaseCollision/shared/b3ReduceContacts.h"
+#include "Bullet3Common/b3ParallelFor.h"
+
+//pairs are processed in fixed size chunks, each chunk writes its own contact array. The chunks are concatenated in order,
+//so the contacts don't depend on the number of threads
+#define B3_NARROWPHASE_PAIRS_PER_CHUNK 64
 
 struct b3CpuNarrowPhaseInternalData
 {
@@ -17,9 +23,15 @@ struct b3CpuNarrowPhaseInternalData
 	b3AlignedObjectArray<b3Vector3> m_convexVertices;
 	b3AlignedObjectArray<int> m_convexIndices;
 	b3AlignedObjectArray<b3GpuFace> m_convexFaces;
+	b3AlignedObjectArray<b3GpuFace> m_planeFaces;
 
 	b3AlignedObjectArray<b3Contact4Data> m_contacts;
 
+	//per chunk of pairs
+	b3AlignedObjectArray<b3AlignedObjectArray<b3Contact4Data> > m_chunkContacts;
+	b3AlignedObjectArray<b3AlignedObjectArray<b3Vector3> > m_chunkScratch;
+	b3AlignedObjectArray<int> m_chunkOffsets;
+
 	int m_numAcceleratedShapes;
 };
 
@@ -50,94 +62,445 @@ b3CpuNarrowPhase::~b3CpuNarrowPhase()
 	delete m_data;
 }
 
-void b3CpuNarrowPhase::computeContacts(b3AlignedObjectArray<b3Int4>& pairs, b3AlignedObjectArray<b3Aabb>& aabbsWorldSpace, b3AlignedObjectArray<b3RigidBodyData>& bodies)
+static b3Contact4Data& b3AddContact(b3AlignedObjectArray<b3Contact4Data>& contactsOut, int& nContacts, int bodyIndexA, int bodyIndexB, const b3RigidBodyData* bodies)
 {
-	int nPairs = pairs.size();
-	int numContacts = 0;
-	int maxContactCapacity = m_data->m_config.m_maxContactCapacity;
-	m_data->m_contacts.resize(maxContactCapacity);
+	b3Contact4Data& contact = contactsOut.expand();
+	nContacts++;
+	contact.m_batchIdx = 0;
+	contact.m_bodyAPtrAndSignBit = (bodies[bodyIndexA].m_invMass == 0) ? -bodyIndexA : bodyIndexA;
+	contact.m_bodyBPtrAndSignBit = (bodies[bodyIndexB].m_invMass == 0) ? -bodyIndexB : bodyIndexB;
+	contact.m_childIndexA = -1;
+	contact.m_childIndexB = -1;
+	return contact;
+}
 
-	for (int i = 0; i < nPairs; i++)
-	{
-		int bodyIndexA = pairs[i].x;
-		int bodyIndexB = pairs[i].y;
-		int collidableIndexA = bodies[bodyIndexA].m_collidableIdx;
-		int collidableIndexB = bodies[bodyIndexB].m_collidableIdx;
+static b3Transform b3GetBodyTransform(const b3RigidBodyData& body)
+{
+	b3Transform tr;
+	tr.setOrigin(body.m_pos);
+	tr.setRotation(body.m_quat);
+	return tr;
+}
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_SPHERE &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_CONVEX_HULL)
-		{
-			//			computeContactSphereConvex(i,bodyIndexA,bodyIndexB,collidableIndexA,collidableIndexB,&bodies[0],
-			//				&m_data->m_collidablesCPU[0],&hostConvexData[0],&hostVertices[0],&hostIndices[0],&hostFaces[0],&hostContacts[0],nContacts,maxContactCapacity);
-		}
+//world space plane of a SHAPE_PLANE body, n.x = planeConstant on the plane
+static void b3GetWorldPlane(const b3RigidBodyData& body, const b3GpuFace& face, b3Vector3& normalOut, b3Scalar& constantOut)
+{
+	b3Vector3 localNormal = b3MakeVector3(face.m_plane.x, face.m_plane.y, face.m_plane.z);
+	b3Transform tr = b3GetBodyTransform(body);
+	normalOut = tr.getBasis() * localNormal;
+	constantOut = normalOut.dot(tr(localNormal * -face.m_plane.w));
+}
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_CONVEX_HULL &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_SPHERE)
-		{
-			//			computeContactSphereConvex(i,bodyIndexB,bodyIndexA,collidableIndexB,collidableIndexA,&bodies[0],
-			//				&m_data->m_collidablesCPU[0],&hostConvexData[0],&hostVertices[0],&hostIndices[0],&hostFaces[0],&hostContacts[0],nContacts,maxContactCapacity);
-			//printf("convex-sphere\n");
-		}
+static int b3ContactSphereSphereCpu(int bodyIndexA, int bodyIndexB, const b3Collidable& colA, const b3Collidable& colB, const b3RigidBodyData* bodies,
+									b3AlignedObjectArray<b3Contact4Data>& contactsOut, int& nContacts, b3Scalar threshold)
+{
+	b3Vector3 posA = bodies[bodyIndexA].m_pos;
+	b3Vector3 posB = bodies[bodyIndexB].m_pos;
+	b3Vector3 diff = posA - posB;
+	b3Scalar len = diff.length();
+	b3Scalar dist = len - colA.m_radius - colB.m_radius;
+	if (dist >= threshold)
+		return -1;
+
+	b3Vector3 normalOnB = len > B3_EPSILON ? diff / len : b3MakeVector3(0, 1, 0);
+	int contactIndex = nContacts;
+	b3Contact4Data& contact = b3AddContact(contactsOut, nContacts, bodyIndexA, bodyIndexB, bodies);
+	contact.m_worldPosB[0] = posB + normalOnB * colB.m_radius;
+	contact.m_worldPosB[0].w = dist;
+	contact.m_worldNormalOnB = normalOnB;
+	b3Contact4Data_setNumPoints(&contact, 1);
+	return contactIndex;
+}
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_CONVEX_HULL &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_PLANE)
-		{
-			//			computeContactPlaneConvex(i,bodyIndexB,bodyIndexA,collidableIndexB,collidableIndexA,&bodies[0],
-			//			&m_data->m_collidablesCPU[0],&hostConvexData[0],&hostVertices[0],&hostIndices[0],&hostFaces[0],&hostContacts[0],nContacts,maxContactCapacity);
-			//			printf("convex-plane\n");
-		}
+static int b3ContactSpherePlaneCpu(int sphereBodyIndex, int planeBodyIndex, const b3Collidable& sphere, const b3GpuFace& plane, const b3RigidBodyData* bodies,
+								   b3AlignedObjectArray<b3Contact4Data>& contactsOut, int& nContacts, b3Scalar threshold)
+{
+	b3Vector3 planeNormal;
+	b3Scalar planeConstant;
+	b3GetWorldPlane(bodies[planeBodyIndex], plane, planeNormal, planeConstant);
+
+	b3Vector3 center = bodies[sphereBodyIndex].m_pos;
+	b3Scalar centerDist = planeNormal.dot(center) - planeConstant;
+	b3Scalar dist = centerDist - sphere.m_radius;
+	if (dist >= threshold)
+		return -1;
+
+	int contactIndex = nContacts;
+	b3Contact4Data& contact = b3AddContact(contactsOut, nContacts, sphereBodyIndex, planeBodyIndex, bodies);
+	contact.m_worldPosB[0] = center - planeNormal * centerDist;
+	contact.m_worldPosB[0].w = dist;
+	contact.m_worldNormalOnB = planeNormal;
+	b3Contact4Data_setNumPoints(&contact, 1);
+	return contactIndex;
+}
+
+static int b3ContactConvexPlaneCpu(int convexBodyIndex, int planeBodyIndex, const b3ConvexPolyhedronData& hull, const b3Vector3* vertices, const b3GpuFace& plane,
+								   const b3RigidBodyData* bodies, b3AlignedObjectArray<b3Vector3>& scratch,
+								   b3AlignedObjectArray<b3Contact4Data>& contactsOut, int& nContacts, b3Scalar threshold)
+{
+	b3Vector3 planeNormal;
+	b3Scalar planeConstant;
+	b3GetWorldPlane(bodies[planeBodyIndex], plane, planeNormal, planeConstant);
+
+	b3Transform tr = b3GetBodyTransform(bodies[convexBodyIndex]);
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_PLANE &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_CONVEX_HULL)
+	//points on the plane, w is the distance of the vertex
+	scratch.resize(0);
+	for (int i = 0; i < hull.m_numVertices; i++)
+	{
+		b3Vector3 vertex = tr(vertices[hull.m_vertexOffset + i]);
+		b3Scalar dist = planeNormal.dot(vertex) - planeConstant;
+		if (dist < threshold)
 		{
-			//			computeContactPlaneConvex(i,bodyIndexA,bodyIndexB,collidableIndexA,collidableIndexB,&bodies[0],
-			//			&m_data->m_collidablesCPU[0],&hostConvexData[0],&hostVertices[0],&hostIndices[0],&hostFaces[0],&hostContacts[0],nContacts,maxContactCapacity);
-			//			printf("plane-convex\n");
+			b3Vector3& point = scratch.expandNonInitializing();
+			point = vertex - planeNormal * dist;
+			point.w = dist;
 		}
+	}
+	if (scratch.size() == 0)
+		return -1;
+
+	b3Int4 contactIdx;
+	contactIdx.x = 0;
+	contactIdx.y = 1;
+	contactIdx.z = 2;
+	contactIdx.w = 3;
+	int numPoints = b3ReduceContacts(&scratch[0], scratch.size(), planeNormal, &contactIdx);
+
+	int contactIndex = nContacts;
+	b3Contact4Data& contact = b3AddContact(contactsOut, nContacts, convexBodyIndex, planeBodyIndex, bodies);
+	for (int p = 0; p < numPoints; p++)
+	{
+		contact.m_worldPosB[p] = scratch[contactIdx.s[p]];
+	}
+	contact.m_worldNormalOnB = planeNormal;
+	b3Contact4Data_setNumPoints(&contact, numPoints);
+	return contactIndex;
+}
+
+static b3Vector3 b3ClosestPointOnSegment(const b3Vector3& point, const b3Vector3& a, const b3Vector3& b)
+{
+	b3Vector3 ab = b - a;
+	b3Scalar lenSqr = ab.length2();
+	b3Scalar t = lenSqr > B3_EPSILON ? (point - a).dot(ab) / lenSqr : b3Scalar(0);
+	t = b3Max(b3Scalar(0), b3Min(b3Scalar(1), t));
+	return a + ab * t;
+}
+
+static int b3ContactSphereConvexCpu(int sphereBodyIndex, int convexBodyIndex, const b3Collidable& sphere, const b3ConvexPolyhedronData& hull,
+									const b3Vector3* vertices, const int* indices, const b3GpuFace* faces, const b3RigidBodyData* bodies,
+									b3AlignedObjectArray<b3Contact4Data>& contactsOut, int& nContacts, b3Scalar threshold)
+{
+	b3Transform tr = b3GetBodyTransform(bodies[convexBodyIndex]);
+	b3Vector3 center = tr.invXform(bodies[sphereBodyIndex].m_pos);
+	b3Scalar radius = sphere.m_radius;
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_COMPOUND_OF_CONVEX_HULLS &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_COMPOUND_OF_CONVEX_HULLS)
+	int deepestFace = -1;
+	b3Scalar maxFaceDist = -B3_LARGE_FLOAT;
+	for (int f = 0; f < hull.m_numFaces; f++)
+	{
+		const b3GpuFace& face = faces[hull.m_faceOffset + f];
+		b3Scalar dist = b3MakeVector3(face.m_plane.x, face.m_plane.y, face.m_plane.z).dot(center) + face.m_plane.w;
+		if (dist > maxFaceDist)
 		{
-			//			computeContactCompoundCompound(i,bodyIndexB,bodyIndexA,collidableIndexB,collidableIndexA,&bodies[0],
-			//			&m_data->m_collidablesCPU[0],&hostConvexData[0],&cpuChildShapes[0], hostAabbsWorldSpace,hostAabbsLocalSpace,hostVertices,hostUniqueEdges,hostIndices,hostFaces,&hostContacts[0],
-			//			nContacts,maxContactCapacity,treeNodesCPU,subTreesCPU,bvhInfoCPU);
-			//			printf("convex-plane\n");
+			maxFaceDist = dist;
+			deepestFace = f;
 		}
-
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_COMPOUND_OF_CONVEX_HULLS &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_PLANE)
+	}
+	//separated by a face plane
+	if (deepestFace < 0 || maxFaceDist - radius >= threshold)
+		return -1;
+
+	b3Vector3 closest;
+	b3Vector3 localNormal;
+	b3Scalar dist;
+	if (maxFaceDist <= 0)
+	{
+		//center inside the hull, push out along the closest face
+		const b3GpuFace& face = faces[hull.m_faceOffset + deepestFace];
+		localNormal = b3MakeVector3(face.m_plane.x, face.m_plane.y, face.m_plane.z);
+		closest = center - localNormal * maxFaceDist;
+		dist = maxFaceDist - radius;
+	}
+	else
+	{
+		//the closest point of the hull is on one of the faces the center is in front of
+		b3Scalar minDistSqr = B3_LARGE_FLOAT;
+		for (int f = 0; f < hull.m_numFaces; f++)
 		{
-			//			computeContactPlaneCompound(i,bodyIndexB,bodyIndexA,collidableIndexB,collidableIndexA,&bodies[0],
-			//			&m_data->m_collidablesCPU[0],&hostConvexData[0],&cpuChildShapes[0], &hostVertices[0],&hostIndices[0],&hostFaces[0],&hostContacts[0],nContacts,maxContactCapacity);
-			//			printf("convex-plane\n");
+			const b3GpuFace& face = faces[hull.m_faceOffset + f];
+			b3Vector3 faceNormal = b3MakeVector3(face.m_plane.x, face.m_plane.y, face.m_plane.z);
+			b3Scalar faceDist = faceNormal.dot(center) + face.m_plane.w;
+			if (faceDist <= 0)
+				continue;
+
+			b3Vector3 projected = center - faceNormal * faceDist;
+			b3Vector3 faceClosest = projected;
+			bool inside = true;
+			int sign = 0;
+			for (int e = 0; e < face.m_numIndices && inside; e++)
+			{
+				const b3Vector3& a = vertices[hull.m_vertexOffset + indices[face.m_indexOffset + e]];
+				const b3Vector3& b = vertices[hull.m_vertexOffset + indices[face.m_indexOffset + (e + 1) % face.m_numIndices]];
+				b3Scalar side = faceNormal.dot((b - a).cross(projected - a));
+				int edgeSign = side > 0 ? 1 : (side < 0 ? -1 : 0);
+				if (edgeSign && sign && edgeSign != sign)
+					inside = false;
+				if (edgeSign)
+					sign = edgeSign;
+			}
+			if (!inside)
+			{
+				b3Scalar minEdgeDistSqr = B3_LARGE_FLOAT;
+				for (int e = 0; e < face.m_numIndices; e++)
+				{
+					const b3Vector3& a = vertices[hull.m_vertexOffset + indices[face.m_indexOffset + e]];
+					const b3Vector3& b = vertices[hull.m_vertexOffset + indices[face.m_indexOffset + (e + 1) % face.m_numIndices]];
+					b3Vector3 edgeClosest = b3ClosestPointOnSegment(center, a, b);
+					b3Scalar edgeDistSqr = (center - edgeClosest).length2();
+					if (edgeDistSqr < minEdgeDistSqr)
+					{
+						minEdgeDistSqr = edgeDistSqr;
+						faceClosest = edgeClosest;
+					}
+				}
+			}
+			b3Scalar distSqr = (center - faceClosest).length2();
+			if (distSqr < minDistSqr)
+			{
+				minDistSqr = distSqr;
+				closest = faceClosest;
+			}
 		}
+		b3Scalar len = b3Sqrt(minDistSqr);
+		dist = len - radius;
+		if (dist >= threshold)
+			return -1;
+		localNormal = len > B3_EPSILON ? (center - closest) / len : b3MakeVector3(0, 1, 0);
+	}
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_PLANE &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_COMPOUND_OF_CONVEX_HULLS)
+	int contactIndex = nContacts;
+	b3Contact4Data& contact = b3AddContact(contactsOut, nContacts, sphereBodyIndex, convexBodyIndex, bodies);
+	contact.m_worldPosB[0] = tr(closest);
+	contact.m_worldPosB[0].w = dist;
+	contact.m_worldNormalOnB = tr.getBasis() * localNormal;
+	b3Contact4Data_setNumPoints(&contact, 1);
+	return contactIndex;
+}
+
+struct b3ComputeContactsLoop : public b3IParallelForBody
+{
+	b3CpuNarrowPhaseInternalData* m_data;
+	b3Int4* m_pairs;
+	int m_numPairs;
+	const b3RigidBodyData* m_bodies;
+	const b3AlignedObjectArray<b3RigidBodyData>* m_bodyArray;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const b3Scalar threshold = B3_CPU_NARROWPHASE_CONTACT_THRESHOLD;
+		const b3Collidable* collidables = &m_data->m_collidablesCPU[0];
+
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
 		{
-			//			computeContactPlaneCompound(i,bodyIndexA,bodyIndexB,collidableIndexA,collidableIndexB,&bodies[0],
-			//			&m_data->m_collidablesCPU[0],&hostConvexData[0],&cpuChildShapes[0],&hostVertices[0],&hostIndices[0],&hostFaces[0],&hostContacts[0],nContacts,maxContactCapacity);
-			//			printf("plane-convex\n");
+			int pairBegin = chunk * B3_NARROWPHASE_PAIRS_PER_CHUNK;
+			int pairEnd = b3Min(pairBegin + B3_NARROWPHASE_PAIRS_PER_CHUNK, m_numPairs);
+
+			b3AlignedObjectArray<b3Contact4Data>& contacts = m_data->m_chunkContacts[chunk];
+			b3AlignedObjectArray<b3Vector3>& scratch = m_data->m_chunkScratch[chunk];
+			contacts.resize(0);
+			contacts.reserve(pairEnd - pairBegin);
+			int numContacts = 0;
+
+			for (int i = pairBegin; i < pairEnd; i++)
+			{
+				int bodyIndexA = m_pairs[i].x;
+				int bodyIndexB = m_pairs[i].y;
+				int collidableIndexA = m_bodies[bodyIndexA].m_collidableIdx;
+				int collidableIndexB = m_bodies[bodyIndexB].m_collidableIdx;
+				const b3Collidable& colA = collidables[collidableIndexA];
+				const b3Collidable& colB = collidables[collidableIndexB];
+				int contactIndex = -1;
+
+				if (colA.m_shapeType == SHAPE_SPHERE && colB.m_shapeType == SHAPE_SPHERE)
+				{
+					contactIndex = b3ContactSphereSphereCpu(bodyIndexA, bodyIndexB, colA, colB, m_bodies, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_SPHERE && colB.m_shapeType == SHAPE_PLANE)
+				{
+					contactIndex = b3ContactSpherePlaneCpu(bodyIndexA, bodyIndexB, colA, m_data->m_planeFaces[colB.m_shapeIndex], m_bodies, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_PLANE && colB.m_shapeType == SHAPE_SPHERE)
+				{
+					contactIndex = b3ContactSpherePlaneCpu(bodyIndexB, bodyIndexA, colB, m_data->m_planeFaces[colA.m_shapeIndex], m_bodies, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_CONVEX_HULL && colB.m_shapeType == SHAPE_PLANE)
+				{
+					contactIndex = b3ContactConvexPlaneCpu(bodyIndexA, bodyIndexB, m_data->m_convexPolyhedra[colA.m_shapeIndex], &m_data->m_convexVertices[0],
+														   m_data->m_planeFaces[colB.m_shapeIndex], m_bodies, scratch, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_PLANE && colB.m_shapeType == SHAPE_CONVEX_HULL)
+				{
+					contactIndex = b3ContactConvexPlaneCpu(bodyIndexB, bodyIndexA, m_data->m_convexPolyhedra[colB.m_shapeIndex], &m_data->m_convexVertices[0],
+														   m_data->m_planeFaces[colA.m_shapeIndex], m_bodies, scratch, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_SPHERE && colB.m_shapeType == SHAPE_CONVEX_HULL)
+				{
+					contactIndex = b3ContactSphereConvexCpu(bodyIndexA, bodyIndexB, colA, m_data->m_convexPolyhedra[colB.m_shapeIndex], &m_data->m_convexVertices[0],
+															&m_data->m_convexIndices[0], &m_data->m_convexFaces[0], m_bodies, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_CONVEX_HULL && colB.m_shapeType == SHAPE_SPHERE)
+				{
+					contactIndex = b3ContactSphereConvexCpu(bodyIndexB, bodyIndexA, colB, m_data->m_convexPolyhedra[colA.m_shapeIndex], &m_data->m_convexVertices[0],
+															&m_data->m_convexIndices[0], &m_data->m_convexFaces[0], m_bodies, contacts, numContacts, threshold);
+				}
+				else if (colA.m_shapeType == SHAPE_CONVEX_HULL && colB.m_shapeType == SHAPE_CONVEX_HULL)
+				{
+					contactIndex = b3ContactConvexConvexSAT(i, bodyIndexA, bodyIndexB, collidableIndexA, collidableIndexB, *m_bodyArray,
+															m_data->m_collidablesCPU, m_data->m_convexPolyhedra, m_data->m_convexVertices, m_data->m_uniqueEdges, m_data->m_convexIndices, m_data->m_convexFaces,
+															contacts, numContacts, pairEnd - pairBegin);
+				}
+				//compounds and concave meshes are not supported by the CPU narrowphase yet
+
+				m_pairs[i].z = contactIndex;
+			}
 		}
+	}
+};
+
+struct b3GatherContactsLoop : public b3IParallelForBody
+{
+	b3CpuNarrowPhaseInternalData* m_data;
+	b3Int4* m_pairs;
+	int m_numPairs;
+	const b3RigidBodyData* m_bodies;
 
-		if (m_data->m_collidablesCPU[collidableIndexA].m_shapeType == SHAPE_CONVEX_HULL &&
-			m_data->m_collidablesCPU[collidableIndexB].m_shapeType == SHAPE_CONVEX_HULL)
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
 		{
-			//printf("pairs[i].z=%d\n",pairs[i].z);
-			//int contactIndex = computeContactConvexConvex2(i,bodyIndexA,bodyIndexB,collidableIndexA,collidableIndexB,bodies,
-			//		m_data->m_collidablesCPU,hostConvexData,hostVertices,hostUniqueEdges,hostIndices,hostFaces,hostContacts,nContacts,maxContactCapacity,oldHostContacts);
-			int contactIndex = b3ContactConvexConvexSAT(i, bodyIndexA, bodyIndexB, collidableIndexA, collidableIndexB, bodies,
-														m_data->m_collidablesCPU, m_data->m_convexPolyhedra, m_data->m_convexVertices, m_data->m_uniqueEdges, m_data->m_convexIndices, m_data->m_convexFaces, m_data->m_contacts, numContacts, maxContactCapacity);
+			const b3AlignedObjectArray<b3Contact4Data>& contacts = m_data->m_chunkContacts[chunk];
+			int offset = m_data->m_chunkOffsets[chunk];
+			for (int c = 0; c < contacts.size(); c++)
+			{
+				b3Contact4Data& contact = m_data->m_contacts[offset + c];
+				contact = contacts[c];
+
+				const b3RigidBodyData& bodyA = m_bodies[abs(contact.m_bodyAPtrAndSignBit)];
+				const b3RigidBodyData& bodyB = m_bodies[abs(contact.m_bodyBPtrAndSignBit)];
+				float friction = b3Min(1.f, b3Sqrt(bodyA.m_frictionCoeff * bodyB.m_frictionCoeff));
+				float restitution = b3Min(1.f, b3Sqrt(bodyA.m_restituitionCoeff * bodyB.m_restituitionCoeff));
+				contact.m_frictionCoeffCmp = (unsigned short)(friction * 0xffff);
+				contact.m_restituitionCoeffCmp = (unsigned short)(restitution * 0xffff);
+			}
 
-			if (contactIndex >= 0)
+			int pairBegin = chunk * B3_NARROWPHASE_PAIRS_PER_CHUNK;
+			int pairEnd = b3Min(pairBegin + B3_NARROWPHASE_PAIRS_PER_CHUNK, m_numPairs);
+			for (int i = pairBegin; i < pairEnd; i++)
 			{
-				pairs[i].z = contactIndex;
+				if (m_pairs[i].z >= 0)
+					m_pairs[i].z += offset;
 			}
-			//			printf("plane-convex\n");
 		}
 	}
+};
+
+void b3CpuNarrowPhase::computeContacts(b3AlignedObjectArray<b3Int4>& pairs, b3AlignedObjectArray<b3Aabb>& aabbsWorldSpace, b3AlignedObjectArray<b3RigidBodyData>& bodies)
+{
+	B3_PROFILE("computeContacts");
+	int nPairs = pairs.size();
+	int numChunks = (nPairs + B3_NARROWPHASE_PAIRS_PER_CHUNK - 1) / B3_NARROWPHASE_PAIRS_PER_CHUNK;
+	if (m_data->m_chunkContacts.size() < numChunks)
+	{
+		m_data->m_chunkContacts.resize(numChunks);
+		m_data->m_chunkScratch.resize(numChunks);
+	}
+	m_data->m_chunkOffsets.resize(numChunks);
+
+	if (nPairs)
+	{
+		b3ComputeContactsLoop computeLoop;
+		computeLoop.m_data = m_data;
+		computeLoop.m_pairs = &pairs[0];
+		computeLoop.m_numPairs = nPairs;
+		computeLoop.m_bodies = &bodies[0];
+		computeLoop.m_bodyArray = &bodies;
+		b3ParallelFor(0, numChunks, 1, computeLoop);
+	}
+
+	int numContacts = 0;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		m_data->m_chunkOffsets[chunk] = numContacts;
+		numContacts += m_data->m_chunkContacts[chunk].size();
+	}
 
+	int maxContactCapacity = m_data->m_config.m_maxContactCapacity;
+	if (numContacts > maxContactCapacity)
+	{
+		b3Error("Error: exceeding contact capacity (%d/%d)\n", numContacts, maxContactCapacity);
+	}
 	m_data->m_contacts.resize(numContacts);
+
+	if (nPairs)
+	{
+		b3GatherContactsLoop gatherLoop;
+		gatherLoop.m_data = m_data;
+		gatherLoop.m_pairs = &pairs[0];
+		gatherLoop.m_numPairs = nPairs;
+		gatherLoop.m_bodies = &bodies[0];
+		b3ParallelFor(0, numChunks, 1, gatherLoop);
+	}
+}
+
+int b3CpuNarrowPhase::registerSphereShape(float radius)
+{
+	int collidableIndex = allocateCollidable();
+	if (collidableIndex < 0)
+		return collidableIndex;
+
+	b3Collidable& col = m_data->m_collidablesCPU[collidableIndex];
+	col.m_shapeType = SHAPE_SPHERE;
+	col.m_shapeIndex = 0;
+	col.m_radius = radius;
+
+	b3Aabb& aabb = m_data->m_localShapeAABBCPU[collidableIndex];
+	aabb.m_minVec = b3MakeVector3(-radius, -radius, -radius);
+	aabb.m_minIndices[3] = 0;
+	aabb.m_maxVec = b3MakeVector3(radius, radius, radius);
+	aabb.m_signedMaxIndices[3] = 0;
+
+	return collidableIndex;
+}
+
+int b3CpuNarrowPhase::registerFace(const b3Vector3& faceNormal, float faceConstant)
+{
+	int faceOffset = m_data->m_planeFaces.size();
+	b3GpuFace& face = m_data->m_planeFaces.expand();
+	face.m_plane = b3MakeVector3(faceNormal.x, faceNormal.y, faceNormal.z, faceConstant);
+	face.m_indexOffset = 0;
+	face.m_numIndices = 0;
+	return faceOffset;
+}
+
+int b3CpuNarrowPhase::registerPlaneShape(const b3Vector3& planeNormal, float planeConstant)
+{
+	int collidableIndex = allocateCollidable();
+	if (collidableIndex < 0)
+		return collidableIndex;
+
+	b3Collidable& col = m_data->m_collidablesCPU[collidableIndex];
+	col.m_shapeType = SHAPE_PLANE;
+	col.m_shapeIndex = registerFace(planeNormal, planeConstant);
+	col.m_radius = planeConstant;
+
+	b3Aabb& aabb = m_data->m_localShapeAABBCPU[collidableIndex];
+	aabb.m_minVec = b3MakeVector3(-1e30f, -1e30f, -1e30f);
+	aabb.m_minIndices[3] = 0;
+	aabb.m_maxVec = b3MakeVector3(1e30f, 1e30f, 1e30f);
+	aabb.m_signedMaxIndices[3] = 0;
+
+	return collidableIndex;
 }
 
 int b3CpuNarrowPhase::registerConvexHullShape(b3ConvexUtility* utilPtr)
@@ -162,7 +525,7 @@ int b3CpuNarrowPhase::registerConvexHullShape(b3ConvexUtility* utilPtr)
 
 	if (col.m_shapeIndex >= 0)
 	{
-		b3Aabb aabb;
+		b3Aabb& aabb = m_data->m_localShapeAABBCPU[collidableIndex];
 
 		b3Vector3 myAabbMin = b3MakeVector3(1e30f, 1e30f, 1e30f);
 		b3Vector3 myAabbMax = b3MakeVector3(-1e30f, -1e30f, -1e30f);
@@ -181,8 +544,6 @@ int b3CpuNarrowPhase::registerConvexHullShape(b3ConvexUtility* utilPtr)
 		aabb.m_max[1] = myAabbMax[1];
 		aabb.m_max[2] = myAabbMax[2];
 		aabb.m_signedMaxIndices[3] = 0;
-
-		m_data->m_localShapeAABBCPU.push_back(aabb);
 	}
 
 	return collidableIndex;
@@ -194,6 +555,9 @@ int b3CpuNarrowPhase::allocateCollidable()
 	if (curSize < m_data->m_config.m_maxConvexShapes)
 	{
 		m_data->m_collidablesCPU.expand();
+		b3Aabb& aabb = m_data->m_localShapeAABBCPU.expand();
+		aabb.m_minVec.setZero();
+		aabb.m_maxVec.setZero();
 		return curSize;
 	}
 	else
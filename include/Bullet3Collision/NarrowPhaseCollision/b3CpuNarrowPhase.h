@@ -9,6 +9,11 @@
 #include "Bullet3Collision/NarrowPhaseCollision/shared/b3RigidBodyData.h"
 #include "Bullet3Collision/NarrowPhaseCollision/shared/b3Contact4Data.h"
 
+///contact points are generated up to this distance, world space aabbs should be enlarged by half of it
+#define B3_CPU_NARROWPHASE_CONTACT_THRESHOLD 0.02f
+
+///b3CpuNarrowPhase computes the contacts of sphere, plane and convex hull pairs.
+///The pairs are split in fixed size chunks that are processed with b3ParallelFor, the resulting contacts are in pair order.
 class b3CpuNarrowPhase
 {
 protected:
@@ -50,6 +55,8 @@ public:
 	void setObjectVelocityCpu(float* linVel, float* angVel, int bodyIndex);
 
 	//virtual void computeContacts(cl_mem broadphasePairs, int numBroadphasePairs, cl_mem aabbsWorldSpace, int numObjects);
+	///pairs[i].z is set to the index of the contact of the pair, or -1. The friction and restitution of a contact are the
+	///geometric mean of the coefficients of the bodies.
 	virtual void computeContacts(b3AlignedObjectArray<b3Int4>& pairs, b3AlignedObjectArray<b3Aabb>& aabbsWorldSpace, b3AlignedObjectArray<b3RigidBodyData>& bodies);
 
 	const struct b3RigidBodyData* getBodiesCpu() const;
@@ -0,0 +1,39 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_PARALLEL_FOR_H
+#define B3_PARALLEL_FOR_H
+
+///b3IParallelForBody - subclass this to express work that can be done in parallel.
+///Iterations may run out of order and on any thread, so they must not depend on each other.
+class b3IParallelForBody
+{
+public:
+	virtual ~b3IParallelForBody() {}
+	virtual void forLoop(int iBegin, int iEnd) const = 0;
+};
+
+typedef void(b3ParallelForFunc)(int iBegin, int iEnd, int grainSize, const b3IParallelForBody& body);
+
+///Bullet3 has no task scheduler of its own, the developer can route b3ParallelFor to one (for example btParallelFor).
+///Without a custom function, or with a null one, the loop runs on the calling thread.
+void b3SetCustomParallelForFunc(b3ParallelForFunc* parallelForFunc);
+
+b3ParallelForFunc* b3GetCustomParallelForFunc();
+
+///call this to dispatch work like a for-loop, grainSize is the minimum number of iterations per task
+void b3ParallelFor(int iBegin, int iEnd, int grainSize, const b3IParallelForBody& body);
+
+#endif  //B3_PARALLEL_FOR_H
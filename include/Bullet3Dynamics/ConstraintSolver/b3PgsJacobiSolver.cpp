@@ -29,6 +29,7 @@ subject to the following restrictions:
 //#include "b3SolverBody.h"
 //#include "b3SolverConstraint.h"
 #include "Bullet3Common/b3AlignedObjectArray.h"
+#include "Bullet3Common/b3ParallelFor.h"
 #include <string.h>  //for memset
 //#include "../../dynamics/basic_demo/Stubs/AdlContact4.h"
 #include "Bullet3Collision/NarrowPhaseCollision/b3Contact4.h"
@@ -621,7 +622,7 @@ int b3PgsJacobiSolver::getOrInitSolverBody(int bodyIndex, b3RigidBodyData* bodie
 
 	b3RigidBodyData& body = bodies[bodyIndex];
 	int curIndex = -1;
-	if (m_usePgs || body.m_invMass == 0.f)
+	if (m_usePgs)
 	{
 		if (m_bodyCount[bodyIndex] < 0)
 		{
@@ -638,8 +639,12 @@ int b3PgsJacobiSolver::getOrInitSolverBody(int bodyIndex, b3RigidBodyData* bodie
 	}
 	else
 	{
-		b3Assert(m_bodyCount[bodyIndex] > 0);
-		m_bodyCountCheck[bodyIndex]++;
+		//Jacobi: every manifold has its own copy of the body, so manifolds can be solved in parallel
+		if (body.m_invMass != 0.f)
+		{
+			b3Assert(m_bodyCount[bodyIndex] > 0);
+			m_bodyCountCheck[bodyIndex]++;
+		}
 		curIndex = m_tmpSolverBodyPool.size();
 		b3SolverBody& solverBody = m_tmpSolverBodyPool.expand();
 		initSolverBody(bodyIndex, &solverBody, &body);
@@ -883,7 +888,8 @@ void b3PgsJacobiSolver::convertContact(b3RigidBodyData* bodies, b3InertiaData* i
 			solverConstraint.m_solverBodyIdA = solverBodyIdA;
 			solverConstraint.m_solverBodyIdB = solverBodyIdB;
 
-			solverConstraint.m_originalContactPoint = &cp;
+			//cp is a temporary, there is no persistent contact point to write the impulse back to
+			solverConstraint.m_originalContactPoint = 0;
 
 			setupContactConstraint(bodies, inertias, solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal, vel, rel_vel, relaxation, rel_pos1, rel_pos2);
 
@@ -1237,11 +1243,21 @@ b3Scalar b3PgsJacobiSolver::solveGroupCacheFriendlySetup(b3RigidBodyData* bodies
 		{
 			int i;
 
+			m_jacobiBatches.resizeNoInitialize(numManifolds + 1);
 			for (i = 0; i < numManifolds; i++)
 			{
+				b3JacobiBatch& batch = m_jacobiBatches[i];
+				batch.m_contactBegin = m_tmpSolverContactConstraintPool.size();
+				batch.m_frictionBegin = m_tmpSolverContactFrictionConstraintPool.size();
+				batch.m_rollingFrictionBegin = m_tmpSolverContactRollingFrictionConstraintPool.size();
+
 				b3Contact4& manifold = manifoldPtr[i];
 				convertContact(bodies, inertias, &manifold, infoGlobal);
 			}
+			b3JacobiBatch& end = m_jacobiBatches[numManifolds];
+			end.m_contactBegin = m_tmpSolverContactConstraintPool.size();
+			end.m_frictionBegin = m_tmpSolverContactFrictionConstraintPool.size();
+			end.m_rollingFrictionBegin = m_tmpSolverContactRollingFrictionConstraintPool.size();
 		}
 	}
 
@@ -1525,10 +1541,212 @@ void b3PgsJacobiSolver::solveGroupCacheFriendlySplitImpulseIterations(b3TypedCon
 	}
 }
 
+struct b3JacobiBatchLoop : public b3IParallelForBody
+{
+	b3PgsJacobiSolver* m_solver;
+	int m_pass;
+	const b3ContactSolverInfo* m_infoGlobal;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			m_solver->solveJacobiBatch(i, m_pass, *m_infoGlobal);
+		}
+	}
+};
+
+struct b3JacobiAverageLoop : public b3IParallelForBody
+{
+	b3PgsJacobiSolver* m_solver;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		m_solver->averageVelocities(iBegin, iEnd);
+	}
+};
+
+void b3PgsJacobiSolver::solveJacobiBatch(int batch, int pass, const b3ContactSolverInfo& infoGlobal)
+{
+	const b3JacobiBatch& rows = m_jacobiBatches[batch];
+	const b3JacobiBatch& nextRows = m_jacobiBatches[batch + 1];
+	bool useSimd = (infoGlobal.m_solverMode & B3_SOLVER_SIMD) != 0;
+
+	switch (pass)
+	{
+		case B3_JACOBI_CONTACT:
+		{
+			for (int j = rows.m_contactBegin; j < nextRows.m_contactBegin; j++)
+			{
+				const b3SolverConstraint& solveManifold = m_tmpSolverContactConstraintPool[j];
+				if (useSimd)
+					resolveSingleConstraintRowLowerLimitSIMD(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+				else
+					resolveSingleConstraintRowLowerLimit(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+			}
+			break;
+		}
+		case B3_JACOBI_FRICTION:
+		{
+			for (int j = rows.m_frictionBegin; j < nextRows.m_frictionBegin; j++)
+			{
+				b3SolverConstraint& solveManifold = m_tmpSolverContactFrictionConstraintPool[j];
+				b3Scalar totalImpulse = m_tmpSolverContactConstraintPool[solveManifold.m_frictionIndex].m_appliedImpulse;
+
+				if (totalImpulse > b3Scalar(0))
+				{
+					solveManifold.m_lowerLimit = -(solveManifold.m_friction * totalImpulse);
+					solveManifold.m_upperLimit = solveManifold.m_friction * totalImpulse;
+
+					if (useSimd)
+						resolveSingleConstraintRowGenericSIMD(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+					else
+						resolveSingleConstraintRowGeneric(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+				}
+			}
+
+			for (int j = rows.m_rollingFrictionBegin; j < nextRows.m_rollingFrictionBegin; j++)
+			{
+				b3SolverConstraint& rollingFrictionConstraint = m_tmpSolverContactRollingFrictionConstraintPool[j];
+				b3Scalar totalImpulse = m_tmpSolverContactConstraintPool[rollingFrictionConstraint.m_frictionIndex].m_appliedImpulse;
+				if (totalImpulse > b3Scalar(0))
+				{
+					b3Scalar rollingFrictionMagnitude = rollingFrictionConstraint.m_friction * totalImpulse;
+					if (rollingFrictionMagnitude > rollingFrictionConstraint.m_friction)
+						rollingFrictionMagnitude = rollingFrictionConstraint.m_friction;
+
+					rollingFrictionConstraint.m_lowerLimit = -rollingFrictionMagnitude;
+					rollingFrictionConstraint.m_upperLimit = rollingFrictionMagnitude;
+
+					if (useSimd)
+						resolveSingleConstraintRowGenericSIMD(m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdA], m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdB], rollingFrictionConstraint);
+					else
+						resolveSingleConstraintRowGeneric(m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdA], m_tmpSolverBodyPool[rollingFrictionConstraint.m_solverBodyIdB], rollingFrictionConstraint);
+				}
+			}
+			break;
+		}
+		case B3_JACOBI_INTERLEAVED:
+		{
+			int numFrictionDirections = (infoGlobal.m_solverMode & B3_SOLVER_USE_2_FRICTION_DIRECTIONS) ? 2 : 1;
+			for (int j = rows.m_contactBegin; j < nextRows.m_contactBegin; j++)
+			{
+				const b3SolverConstraint& solveManifold = m_tmpSolverContactConstraintPool[j];
+				resolveSingleConstraintRowLowerLimitSIMD(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+				b3Scalar totalImpulse = solveManifold.m_appliedImpulse;
+				if (totalImpulse > b3Scalar(0))
+				{
+					for (int d = 0; d < numFrictionDirections; d++)
+					{
+						b3SolverConstraint& frictionConstraint = m_tmpSolverContactFrictionConstraintPool[solveManifold.m_frictionIndex + d];
+						frictionConstraint.m_lowerLimit = -(frictionConstraint.m_friction * totalImpulse);
+						frictionConstraint.m_upperLimit = frictionConstraint.m_friction * totalImpulse;
+
+						resolveSingleConstraintRowGenericSIMD(m_tmpSolverBodyPool[frictionConstraint.m_solverBodyIdA], m_tmpSolverBodyPool[frictionConstraint.m_solverBodyIdB], frictionConstraint);
+					}
+				}
+			}
+			break;
+		}
+		case B3_JACOBI_SPLIT_IMPULSE:
+		{
+			for (int j = rows.m_contactBegin; j < nextRows.m_contactBegin; j++)
+			{
+				const b3SolverConstraint& solveManifold = m_tmpSolverContactConstraintPool[j];
+				if (useSimd)
+					resolveSplitPenetrationSIMD(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+				else
+					resolveSplitPenetrationImpulseCacheFriendly(m_tmpSolverBodyPool[solveManifold.m_solverBodyIdA], m_tmpSolverBodyPool[solveManifold.m_solverBodyIdB], solveManifold);
+			}
+			break;
+		}
+		default:
+			b3Assert(0);
+	}
+}
+
+void b3PgsJacobiSolver::solveJacobiPass(int pass, const b3ContactSolverInfo& infoGlobal)
+{
+	b3JacobiBatchLoop loop;
+	loop.m_solver = this;
+	loop.m_pass = pass;
+	loop.m_infoGlobal = &infoGlobal;
+	b3ParallelFor(0, m_jacobiBatches.size() - 1, 64, loop);
+}
+
+///same passes as solveSingleIteration and solveGroupCacheFriendlySplitImpulseIterations in Jacobi mode, without joints
+void b3PgsJacobiSolver::solveJacobiBatchIterations(const b3ContactSolverInfo& infoGlobal)
+{
+	buildJacobiBodyLists();
+
+	if (infoGlobal.m_splitImpulse)
+	{
+		for (int iteration = 0; iteration < infoGlobal.m_numIterations; iteration++)
+		{
+			solveJacobiPass(B3_JACOBI_SPLIT_IMPULSE, infoGlobal);
+		}
+	}
+
+	for (int iteration = 0; iteration < infoGlobal.m_numIterations; iteration++)
+	{
+		if ((infoGlobal.m_solverMode & B3_SOLVER_SIMD) && (infoGlobal.m_solverMode & B3_SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS))
+		{
+			solveJacobiPass(B3_JACOBI_INTERLEAVED, infoGlobal);
+		}
+		else
+		{
+			solveJacobiPass(B3_JACOBI_CONTACT, infoGlobal);
+			if (infoGlobal.m_solverMode & B3_SOLVER_SIMD)
+				averageVelocities();
+			solveJacobiPass(B3_JACOBI_FRICTION, infoGlobal);
+		}
+		averageVelocities();
+	}
+}
+
+void b3PgsJacobiSolver::buildJacobiBodyLists()
+{
+	int numBodies = m_bodyCount.size();
+	m_jacobiBodyOffsets.resize(0);
+	m_jacobiBodyOffsets.resize(numBodies + 1, 0);
+
+	for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
+	{
+		if (!m_tmpSolverBodyPool[i].m_invMass.isZero())
+			m_jacobiBodyOffsets[m_tmpSolverBodyPool[i].m_originalBodyIndex + 1]++;
+	}
+	for (int i = 0; i < numBodies; i++)
+	{
+		m_jacobiBodyOffsets[i + 1] += m_jacobiBodyOffsets[i];
+	}
+
+	m_jacobiBodies.resizeNoInitialize(m_jacobiBodyOffsets[numBodies]);
+	for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
+	{
+		if (!m_tmpSolverBodyPool[i].m_invMass.isZero())
+		{
+			int orgBodyIndex = m_tmpSolverBodyPool[i].m_originalBodyIndex;
+			//the offsets are moved to the end of each range while filling, and moved back below
+			m_jacobiBodies[m_jacobiBodyOffsets[orgBodyIndex]++] = i;
+		}
+	}
+	for (int i = numBodies; i > 0; i--)
+	{
+		m_jacobiBodyOffsets[i] = m_jacobiBodyOffsets[i - 1];
+	}
+	m_jacobiBodyOffsets[0] = 0;
+}
+
 b3Scalar b3PgsJacobiSolver::solveGroupCacheFriendlyIterations(b3TypedConstraint** constraints, int numConstraints, const b3ContactSolverInfo& infoGlobal)
 {
 	B3_PROFILE("solveGroupCacheFriendlyIterations");
 
+	if (!m_usePgs && m_tmpSolverNonContactConstraintPool.size() == 0)
+	{
+		solveJacobiBatchIterations(infoGlobal);
+		return 0.f;
+	}
+
 	{
 		///this is a special step to resolve penetrations (just for contacts)
 		solveGroupCacheFriendlySplitImpulseIterations(constraints, numConstraints, infoGlobal);
@@ -1560,6 +1778,14 @@ void b3PgsJacobiSolver::averageVelocities()
 	m_deltaAngularVelocities.resize(0);
 	m_deltaAngularVelocities.resize(numBodies, b3MakeVector3(0, 0, 0));
 
+	if (m_jacobiBodyOffsets.size() == numBodies + 1 && m_jacobiBodies.size() == m_jacobiBodyOffsets[numBodies])
+	{
+		b3JacobiAverageLoop loop;
+		loop.m_solver = this;
+		b3ParallelFor(0, numBodies, 256, loop);
+		return;
+	}
+
 	for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
 	{
 		if (!m_tmpSolverBodyPool[i].m_invMass.isZero())
@@ -1586,6 +1812,39 @@ void b3PgsJacobiSolver::averageVelocities()
 	}
 }
 
+///average the copies of the original bodies in [bodyBegin, bodyEnd), summed in solver body order like the serial version
+void b3PgsJacobiSolver::averageVelocities(int bodyBegin, int bodyEnd)
+{
+	for (int orgBodyIndex = bodyBegin; orgBodyIndex < bodyEnd; orgBodyIndex++)
+	{
+		int begin = m_jacobiBodyOffsets[orgBodyIndex];
+		int end = m_jacobiBodyOffsets[orgBodyIndex + 1];
+		if (begin == end)
+			continue;
+
+		b3Assert(m_bodyCount[orgBodyIndex] == m_bodyCountCheck[orgBodyIndex]);
+
+		b3Vector3 deltaLinearVelocity = b3MakeVector3(0, 0, 0);
+		b3Vector3 deltaAngularVelocity = b3MakeVector3(0, 0, 0);
+		for (int j = begin; j < end; j++)
+		{
+			const b3SolverBody& solverBody = m_tmpSolverBodyPool[m_jacobiBodies[j]];
+			deltaLinearVelocity += solverBody.getDeltaLinearVelocity();
+			deltaAngularVelocity += solverBody.getDeltaAngularVelocity();
+		}
+		m_deltaLinearVelocities[orgBodyIndex] = deltaLinearVelocity;
+		m_deltaAngularVelocities[orgBodyIndex] = deltaAngularVelocity;
+
+		b3Scalar factor = 1.f / b3Scalar(m_bodyCount[orgBodyIndex]);
+		for (int j = begin; j < end; j++)
+		{
+			b3SolverBody& solverBody = m_tmpSolverBodyPool[m_jacobiBodies[j]];
+			solverBody.m_deltaLinearVelocity = deltaLinearVelocity * factor;
+			solverBody.m_deltaAngularVelocity = deltaAngularVelocity * factor;
+		}
+	}
+}
+
 b3Scalar b3PgsJacobiSolver::solveGroupCacheFriendlyFinish(b3RigidBodyData* bodies, b3InertiaData* inertias, int numBodies, const b3ContactSolverInfo& infoGlobal)
 {
 	B3_PROFILE("solveGroupCacheFriendlyFinish");
@@ -1598,7 +1857,8 @@ b3Scalar b3PgsJacobiSolver::solveGroupCacheFriendlyFinish(b3RigidBodyData* bodie
 		{
 			const b3SolverConstraint& solveManifold = m_tmpSolverContactConstraintPool[j];
 			b3ContactPoint* pt = (b3ContactPoint*)solveManifold.m_originalContactPoint;
-			b3Assert(pt);
+			if (!pt)
+				continue;
 			pt->m_appliedImpulse = solveManifold.m_appliedImpulse;
 			//	float f = m_tmpSolverContactFrictionConstraintPool[solveManifold.m_frictionIndex].m_appliedImpulse;
 			//	printf("pt->m_appliedImpulseLateral1 = %f\n", f);
@@ -1687,6 +1947,8 @@ b3Scalar b3PgsJacobiSolver::solveGroupCacheFriendlyFinish(b3RigidBodyData* bodie
 	m_tmpSolverContactRollingFrictionConstraintPool.resizeNoInitialize(0);
 
 	m_tmpSolverBodyPool.resizeNoInitialize(0);
+	m_jacobiBodyOffsets.resize(0);
+	m_jacobiBodies.resize(0);
 	return 0.f;
 }
 
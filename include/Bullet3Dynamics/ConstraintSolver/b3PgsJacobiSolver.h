@@ -14,8 +14,15 @@ class b3Dispatcher;
 struct b3RigidBodyData;
 struct b3InertiaData;
 
+///b3PgsJacobiSolver solves contacts and joints with projected Gauss-Seidel (usePgs) or with Jacobi iterations.
+///In Jacobi mode every manifold gets its own copy of the dynamic bodies it touches and the copies are averaged after each
+///pass, so the manifolds are independent batches. Without joints (which Jacobi mode doesn't support) the batches and the
+///averaging run with b3ParallelFor; the result is the same as solving the batches one after the other in manifold order.
 class b3PgsJacobiSolver
 {
+	friend struct b3JacobiBatchLoop;
+	friend struct b3JacobiAverageLoop;
+
 protected:
 	b3AlignedObjectArray<b3SolverBody> m_tmpSolverBodyPool;
 	b3ConstraintArray m_tmpSolverContactConstraintPool;
@@ -34,8 +41,34 @@ protected:
 	b3AlignedObjectArray<b3Vector3> m_deltaLinearVelocities;
 	b3AlignedObjectArray<b3Vector3> m_deltaAngularVelocities;
 
+	///rows of one manifold in the contact, friction and rolling friction pools, up to the rows of the next one
+	struct b3JacobiBatch
+	{
+		int m_contactBegin;
+		int m_frictionBegin;
+		int m_rollingFrictionBegin;
+	};
+	b3AlignedObjectArray<b3JacobiBatch> m_jacobiBatches;  //one per manifold, plus the end of the last one
+
+	//dynamic solver bodies of each original body, in solver body order
+	b3AlignedObjectArray<int> m_jacobiBodyOffsets;
+	b3AlignedObjectArray<int> m_jacobiBodies;
+
+	enum b3JacobiPass
+	{
+		B3_JACOBI_CONTACT,
+		B3_JACOBI_FRICTION,
+		B3_JACOBI_INTERLEAVED,
+		B3_JACOBI_SPLIT_IMPULSE
+	};
+
 	bool m_usePgs;
 	void averageVelocities();
+	void averageVelocities(int bodyBegin, int bodyEnd);
+	void buildJacobiBodyLists();
+	void solveJacobiBatch(int batch, int pass, const b3ContactSolverInfo& infoGlobal);
+	void solveJacobiPass(int pass, const b3ContactSolverInfo& infoGlobal);
+	void solveJacobiBatchIterations(const b3ContactSolverInfo& infoGlobal);
 
 	int m_maxOverrideNumSolverIterations;
 
@@ -5,21 +5,33 @@
 #include "Bullet3Collision/BroadPhaseCollision/b3DynamicBvhBroadphase.h"
 #include "Bullet3Collision/NarrowPhaseCollision/b3Config.h"
 #include "Bullet3Collision/NarrowPhaseCollision/b3CpuNarrowPhase.h"
+#include "Bullet3Collision/NarrowPhaseCollision/b3Contact4.h"
 #include "Bullet3Collision/BroadPhaseCollision/shared/b3Aabb.h"
 #include "Bullet3Collision/NarrowPhaseCollision/shared/b3Collidable.h"
 #include "Bullet3Common/b3Vector3.h"
-#include "Bullet3Dynamics/shared/b3ContactConstraint4.h"
-#include "Bullet3Dynamics/shared/b3Inertia.h"
+#include "Bullet3Common/b3ParallelFor.h"
+#include "Bullet3Dynamics/ConstraintSolver/b3PgsJacobiSolver.h"
+#include "Bullet3Dynamics/ConstraintSolver/b3ContactSolverInfo.h"
+
+//bodies per task of the pair search, the pairs of a chunk are stored together and concatenated in body order
+#define B3_PIPELINE_BODIES_PER_CHUNK 128
 
 struct b3CpuRigidBodyPipelineInternalData
 {
 	b3AlignedObjectArray<b3RigidBodyData> m_rigidBodies;
-	b3AlignedObjectArray<b3Inertia> m_inertias;
+	b3AlignedObjectArray<b3InertiaData> m_inertias;
 	b3AlignedObjectArray<b3Aabb> m_aabbWorldSpace;
 
+	b3AlignedObjectArray<b3Int4> m_overlappingPairs;
+	b3AlignedObjectArray<b3AlignedObjectArray<b3Int4> > m_chunkPairs;
+
 	b3DynamicBvhBroadphase* m_bp;
 	b3CpuNarrowPhase* m_np;
 	b3Config m_config;
+
+	b3PgsJacobiSolver* m_solver;
+	b3ContactSolverInfo m_solverInfo;
+	b3Vector3 m_gravity;
 };
 
 b3CpuRigidBodyPipeline::b3CpuRigidBodyPipeline(class b3CpuNarrowPhase* narrowphase, struct b3DynamicBvhBroadphase* broadphaseDbvt, const b3Config& config)
@@ -28,52 +40,182 @@ b3CpuRigidBodyPipeline::b3CpuRigidBodyPipeline(class b3CpuNarrowPhase* narrowpha
 	m_data->m_np = narrowphase;
 	m_data->m_bp = broadphaseDbvt;
 	m_data->m_config = config;
+
+	//the pairs are found by computeOverlappingPairs, the broadphase only maintains the trees
+	m_data->m_bp->m_deferedcollide = true;
+
+	m_data->m_solver = new b3PgsJacobiSolver(false);
+	m_data->m_solverInfo.m_splitImpulse = false;
+	m_data->m_solverInfo.m_solverMode |= B3_SOLVER_USE_2_FRICTION_DIRECTIONS;
+	m_data->m_gravity = b3MakeVector3(0, -9, 0);
 }
 
 b3CpuRigidBodyPipeline::~b3CpuRigidBodyPipeline()
 {
+	delete m_data->m_solver;
 	delete m_data;
 }
 
-void b3CpuRigidBodyPipeline::updateAabbWorldSpace()
+struct b3UpdateAabbsLoop : public b3IParallelForBody
 {
-	for (int i = 0; i < this->getNumBodies(); i++)
+	b3CpuRigidBodyPipelineInternalData* m_data;
+
+	void forLoop(int iBegin, int iEnd) const
 	{
-		b3RigidBodyData* body = &m_data->m_rigidBodies[i];
-		b3Float4 position = body->m_pos;
-		b3Quat orientation = body->m_quat;
+		const float margin = 0.5f * B3_CPU_NARROWPHASE_CONTACT_THRESHOLD;
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			const b3RigidBodyData& body = m_data->m_rigidBodies[i];
+			const b3Aabb& localAabb = m_data->m_np->getLocalSpaceAabb(body.m_collidableIdx);
+			b3Aabb& worldAabb = m_data->m_aabbWorldSpace[i];
+			b3TransformAabb2(localAabb.m_minVec, localAabb.m_maxVec, margin, body.m_pos, body.m_quat, &worldAabb.m_minVec, &worldAabb.m_maxVec);
+		}
+	}
+};
 
-		int collidableIndex = body->m_collidableIdx;
-		b3Collidable& collidable = m_data->m_np->getCollidableCpu(collidableIndex);
-		int shapeIndex = collidable.m_shapeIndex;
+void b3CpuRigidBodyPipeline::updateAabbWorldSpace()
+{
+	B3_PROFILE("updateAabbWorldSpace");
+	b3UpdateAabbsLoop loop;
+	loop.m_data = m_data;
+	b3ParallelFor(0, getNumBodies(), 256, loop);
 
-		if (shapeIndex >= 0)
+	//the trees of the broadphase are not thread safe, static bodies never move
+	for (int i = 0; i < getNumBodies(); i++)
+	{
+		if (m_data->m_rigidBodies[i].m_invMass != 0.f)
 		{
-			b3Aabb localAabb = m_data->m_np->getLocalSpaceAabb(shapeIndex);
 			b3Aabb& worldAabb = m_data->m_aabbWorldSpace[i];
-			float margin = 0.f;
-			b3TransformAabb2(localAabb.m_minVec, localAabb.m_maxVec, margin, position, orientation, &worldAabb.m_minVec, &worldAabb.m_maxVec);
 			m_data->m_bp->setAabb(i, worldAabb.m_minVec, worldAabb.m_maxVec, 0);
 		}
 	}
 }
 
+struct b3FindPairsCollider : public b3DynamicBvh::ICollide
+{
+	const b3CpuRigidBodyPipelineInternalData* m_data;
+	int m_bodyIndex;
+	b3AlignedObjectArray<int>* m_others;
+
+	void Process(const b3DbvtNode* leaf)
+	{
+		int otherIndex = ((b3BroadphaseProxy*)leaf->data)->getUid();
+		if (otherIndex == m_bodyIndex)
+			return;
+		//a pair of two dynamic bodies is reported by the lower index, static bodies don't search
+		if (otherIndex < m_bodyIndex && m_data->m_rigidBodies[otherIndex].m_invMass != 0.f)
+			return;
+
+		const b3Aabb& aabbA = m_data->m_aabbWorldSpace[m_bodyIndex];
+		const b3Aabb& aabbB = m_data->m_aabbWorldSpace[otherIndex];
+		if (b3TestAabbAgainstAabb(aabbA.m_minVec, aabbA.m_maxVec, aabbB.m_minVec, aabbB.m_maxVec))
+			m_others->push_back(otherIndex);
+	}
+};
+
+struct b3FindPairsLoop : public b3IParallelForBody
+{
+	b3CpuRigidBodyPipelineInternalData* m_data;
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		const b3DynamicBvh* sets = m_data->m_bp->m_sets;
+		b3AlignedObjectArray<int> others;
+
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			b3AlignedObjectArray<b3Int4>& pairs = m_data->m_chunkPairs[chunk];
+			pairs.resize(0);
+
+			int bodyBegin = chunk * B3_PIPELINE_BODIES_PER_CHUNK;
+			int bodyEnd = b3Min(bodyBegin + B3_PIPELINE_BODIES_PER_CHUNK, m_data->m_rigidBodies.size());
+			for (int i = bodyBegin; i < bodyEnd; i++)
+			{
+				if (m_data->m_rigidBodies[i].m_invMass == 0.f)
+					continue;
+
+				others.resize(0);
+				b3FindPairsCollider collider;
+				collider.m_data = m_data;
+				collider.m_bodyIndex = i;
+				collider.m_others = &others;
+
+				const b3Aabb& aabb = m_data->m_aabbWorldSpace[i];
+				B3_ATTRIBUTE_ALIGNED16(b3DbvtVolume)
+				volume = b3DbvtVolume::FromMM(aabb.m_minVec, aabb.m_maxVec);
+				sets[0].collideTV(sets[0].m_root, volume, collider);
+				sets[1].collideTV(sets[1].m_root, volume, collider);
+
+				//the tree layout depends on the update history, sort to get the same pairs for the same bodies
+				others.quickSort(b3IntLess());
+				for (int j = 0; j < others.size(); j++)
+				{
+					b3Int4& pair = pairs.expandNonInitializing();
+					pair.x = b3Min(i, others[j]);
+					pair.y = b3Max(i, others[j]);
+					pair.z = -1;
+					pair.w = 0;
+				}
+			}
+		}
+	}
+
+	struct b3IntLess
+	{
+		bool operator()(int a, int b) const
+		{
+			return a < b;
+		}
+	};
+};
+
 void b3CpuRigidBodyPipeline::computeOverlappingPairs()
 {
-	int numPairs = m_data->m_bp->getOverlappingPairCache()->getNumOverlappingPairs();
-	m_data->m_bp->calculateOverlappingPairs();
-	numPairs = m_data->m_bp->getOverlappingPairCache()->getNumOverlappingPairs();
-	printf("numPairs=%d\n", numPairs);
+	B3_PROFILE("computeOverlappingPairs");
+	b3DynamicBvhBroadphase* bp = m_data->m_bp;
+	bp->m_sets[0].optimizeIncremental(1 + (bp->m_sets[0].m_leaves * bp->m_dupdates) / 100);
+
+	int numChunks = (getNumBodies() + B3_PIPELINE_BODIES_PER_CHUNK - 1) / B3_PIPELINE_BODIES_PER_CHUNK;
+	if (m_data->m_chunkPairs.size() < numChunks)
+		m_data->m_chunkPairs.resize(numChunks);
+
+	b3FindPairsLoop loop;
+	loop.m_data = m_data;
+	b3ParallelFor(0, numChunks, 1, loop);
+
+	int numPairs = 0;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		numPairs += m_data->m_chunkPairs[chunk].size();
+	}
+	if (numPairs > m_data->m_config.m_maxBroadphasePairs)
+	{
+		b3Error("Error: exceeding broadphase pair capacity (%d/%d)\n", numPairs, m_data->m_config.m_maxBroadphasePairs);
+	}
+
+	m_data->m_overlappingPairs.resizeNoInitialize(numPairs);
+	int offset = 0;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		const b3AlignedObjectArray<b3Int4>& pairs = m_data->m_chunkPairs[chunk];
+		for (int i = 0; i < pairs.size(); i++)
+		{
+			m_data->m_overlappingPairs[offset++] = pairs[i];
+		}
+	}
 }
 
 void b3CpuRigidBodyPipeline::computeContactPoints()
 {
-	b3AlignedObjectArray<b3Int4>& pairs = m_data->m_bp->getOverlappingPairCache()->getOverlappingPairArray();
-
-	m_data->m_np->computeContacts(pairs, m_data->m_aabbWorldSpace, m_data->m_rigidBodies);
+	B3_PROFILE("computeContactPoints");
+	m_data->m_np->computeContacts(m_data->m_overlappingPairs, m_data->m_aabbWorldSpace, m_data->m_rigidBodies);
 }
+
 void b3CpuRigidBodyPipeline::stepSimulation(float deltaTime)
 {
+	B3_PROFILE("stepSimulation");
+	m_data->m_solverInfo.m_timeStep = deltaTime;
+
 	//update world space aabb's
 	updateAabbWorldSpace();
 
@@ -83,315 +225,115 @@ void b3CpuRigidBodyPipeline::stepSimulation(float deltaTime)
 	//compute contacts
 	computeContactPoints();
 
+	//gravity is applied before the solver, so resting contacts cancel it in the same step
+	applyGravity(deltaTime);
+
 	//solve contacts
+	solveContactConstraints();
 
 	//update transforms
 	integrate(deltaTime);
 }
 
-static inline float b3CalcRelVel(const b3Vector3& l0, const b3Vector3& l1, const b3Vector3& a0, const b3Vector3& a1,
-								 const b3Vector3& linVel0, const b3Vector3& angVel0, const b3Vector3& linVel1, const b3Vector3& angVel1)
+struct b3ApplyGravityLoop : public b3IParallelForBody
 {
-	return b3Dot(l0, linVel0) + b3Dot(a0, angVel0) + b3Dot(l1, linVel1) + b3Dot(a1, angVel1);
-}
+	b3RigidBodyData* m_bodies;
+	b3Vector3 m_deltaVelocity;
 
-static inline void b3SetLinearAndAngular(const b3Vector3& n, const b3Vector3& r0, const b3Vector3& r1,
-										 b3Vector3& linear, b3Vector3& angular0, b3Vector3& angular1)
-{
-	linear = -n;
-	angular0 = -b3Cross(r0, n);
-	angular1 = b3Cross(r1, n);
-}
-
-static inline void b3SolveContact(b3ContactConstraint4& cs,
-								  const b3Vector3& posA, b3Vector3& linVelA, b3Vector3& angVelA, float invMassA, const b3Matrix3x3& invInertiaA,
-								  const b3Vector3& posB, b3Vector3& linVelB, b3Vector3& angVelB, float invMassB, const b3Matrix3x3& invInertiaB,
-								  float maxRambdaDt[4], float minRambdaDt[4])
-{
-	b3Vector3 dLinVelA;
-	dLinVelA.setZero();
-	b3Vector3 dAngVelA;
-	dAngVelA.setZero();
-	b3Vector3 dLinVelB;
-	dLinVelB.setZero();
-	b3Vector3 dAngVelB;
-	dAngVelB.setZero();
-
-	for (int ic = 0; ic < 4; ic++)
+	void forLoop(int iBegin, int iEnd) const
 	{
-		//	dont necessary because this makes change to 0
-		if (cs.m_jacCoeffInv[ic] == 0.f) continue;
-
+		for (int i = iBegin; i < iEnd; i++)
 		{
-			b3Vector3 angular0, angular1, linear;
-			b3Vector3 r0 = cs.m_worldPos[ic] - (b3Vector3&)posA;
-			b3Vector3 r1 = cs.m_worldPos[ic] - (b3Vector3&)posB;
-			b3SetLinearAndAngular((const b3Vector3&)-cs.m_linear, (const b3Vector3&)r0, (const b3Vector3&)r1, linear, angular0, angular1);
-
-			float rambdaDt = b3CalcRelVel((const b3Vector3&)cs.m_linear, (const b3Vector3&)-cs.m_linear, angular0, angular1,
-										  linVelA, angVelA, linVelB, angVelB) +
-							 cs.m_b[ic];
-			rambdaDt *= cs.m_jacCoeffInv[ic];
-
-			{
-				float prevSum = cs.m_appliedRambdaDt[ic];
-				float updated = prevSum;
-				updated += rambdaDt;
-				updated = b3Max(updated, minRambdaDt[ic]);
-				updated = b3Min(updated, maxRambdaDt[ic]);
-				rambdaDt = updated - prevSum;
-				cs.m_appliedRambdaDt[ic] = updated;
-			}
-
-			b3Vector3 linImp0 = invMassA * linear * rambdaDt;
-			b3Vector3 linImp1 = invMassB * (-linear) * rambdaDt;
-			b3Vector3 angImp0 = (invInertiaA * angular0) * rambdaDt;
-			b3Vector3 angImp1 = (invInertiaB * angular1) * rambdaDt;
-#ifdef _WIN32
-			b3Assert(_finite(linImp0.getX()));
-			b3Assert(_finite(linImp1.getX()));
-#endif
-			{
-				linVelA += linImp0;
-				angVelA += angImp0;
-				linVelB += linImp1;
-				angVelB += angImp1;
-			}
+			if (m_bodies[i].m_invMass != 0.f)
+				m_bodies[i].m_linVel += m_deltaVelocity;
 		}
 	}
-}
+};
 
-static inline void b3SolveFriction(b3ContactConstraint4& cs,
-								   const b3Vector3& posA, b3Vector3& linVelA, b3Vector3& angVelA, float invMassA, const b3Matrix3x3& invInertiaA,
-								   const b3Vector3& posB, b3Vector3& linVelB, b3Vector3& angVelB, float invMassB, const b3Matrix3x3& invInertiaB,
-								   float maxRambdaDt[4], float minRambdaDt[4])
+void b3CpuRigidBodyPipeline::applyGravity(float timeStep)
 {
-	if (cs.m_fJacCoeffInv[0] == 0 && cs.m_fJacCoeffInv[0] == 0) return;
-	const b3Vector3& center = (const b3Vector3&)cs.m_center;
-
-	b3Vector3 n = -(const b3Vector3&)cs.m_linear;
-
-	b3Vector3 tangent[2];
-
-	b3PlaneSpace1(n, tangent[0], tangent[1]);
-
-	b3Vector3 angular0, angular1, linear;
-	b3Vector3 r0 = center - posA;
-	b3Vector3 r1 = center - posB;
-	for (int i = 0; i < 2; i++)
-	{
-		b3SetLinearAndAngular(tangent[i], r0, r1, linear, angular0, angular1);
-		float rambdaDt = b3CalcRelVel(linear, -linear, angular0, angular1,
-									  linVelA, angVelA, linVelB, angVelB);
-		rambdaDt *= cs.m_fJacCoeffInv[i];
-
-		{
-			float prevSum = cs.m_fAppliedRambdaDt[i];
-			float updated = prevSum;
-			updated += rambdaDt;
-			updated = b3Max(updated, minRambdaDt[i]);
-			updated = b3Min(updated, maxRambdaDt[i]);
-			rambdaDt = updated - prevSum;
-			cs.m_fAppliedRambdaDt[i] = updated;
-		}
-
-		b3Vector3 linImp0 = invMassA * linear * rambdaDt;
-		b3Vector3 linImp1 = invMassB * (-linear) * rambdaDt;
-		b3Vector3 angImp0 = (invInertiaA * angular0) * rambdaDt;
-		b3Vector3 angImp1 = (invInertiaB * angular1) * rambdaDt;
-#ifdef _WIN32
-		b3Assert(_finite(linImp0.getX()));
-		b3Assert(_finite(linImp1.getX()));
-#endif
-		linVelA += linImp0;
-		angVelA += angImp0;
-		linVelB += linImp1;
-		angVelB += angImp1;
-	}
-
-	{  //	angular damping for point constraint
-		b3Vector3 ab = (posB - posA).normalized();
-		b3Vector3 ac = (center - posA).normalized();
-		if (b3Dot(ab, ac) > 0.95f || (invMassA == 0.f || invMassB == 0.f))
-		{
-			float angNA = b3Dot(n, angVelA);
-			float angNB = b3Dot(n, angVelB);
+	if (!getNumBodies())
+		return;
 
-			angVelA -= (angNA * 0.1f) * n;
-			angVelB -= (angNB * 0.1f) * n;
-		}
-	}
+	b3ApplyGravityLoop loop;
+	loop.m_bodies = &m_data->m_rigidBodies[0];
+	loop.m_deltaVelocity = m_data->m_gravity * timeStep;
+	b3ParallelFor(0, getNumBodies(), 256, loop);
 }
 
-struct b3SolveTask  // : public ThreadPool::Task
+void b3CpuRigidBodyPipeline::solveContactConstraints()
 {
-	b3SolveTask(b3AlignedObjectArray<b3RigidBodyData>& bodies,
-				b3AlignedObjectArray<b3Inertia>& shapes,
-				b3AlignedObjectArray<b3ContactConstraint4>& constraints,
-				int start, int nConstraints,
-				int maxNumBatches,
-				b3AlignedObjectArray<int>* wgUsedBodies, int curWgidx)
-		: m_bodies(bodies), m_shapes(shapes), m_constraints(constraints), m_wgUsedBodies(wgUsedBodies), m_curWgidx(curWgidx), m_start(start), m_nConstraints(nConstraints), m_solveFriction(true), m_maxNumBatches(maxNumBatches)
-	{
-	}
+	B3_PROFILE("solveContactConstraints");
+	const b3AlignedObjectArray<b3Contact4Data>& contacts = m_data->m_np->getContacts();
+	int numContacts = contacts.size();
+	if (!numContacts)
+		return;
+
+	//b3Contact4 only adds methods to b3Contact4Data
+	b3Contact4* manifolds = (b3Contact4*)&contacts[0];
+	m_data->m_solver->solveGroup(&m_data->m_rigidBodies[0], &m_data->m_inertias[0], getNumBodies(), manifolds, numContacts, 0, 0, m_data->m_solverInfo);
+}
 
-	unsigned short int getType() { return 0; }
+struct b3IntegrateLoop : public b3IParallelForBody
+{
+	b3RigidBodyData* m_bodies;
+	b3InertiaData* m_inertias;
+	float m_timeStep;
 
-	void run(int tIdx)
+	void forLoop(int iBegin, int iEnd) const
 	{
-		b3AlignedObjectArray<int> usedBodies;
-		//printf("run..............\n");
-
-		for (int bb = 0; bb < m_maxNumBatches; bb++)
+		float angularDamping = 1.f;
+		b3Vector3 noGravity = b3MakeVector3(0, 0, 0);
+		for (int i = iBegin; i < iEnd; i++)
 		{
-			usedBodies.resize(0);
-			for (int ic = m_nConstraints - 1; ic >= 0; ic--)
-			//for(int ic=0; ic<m_nConstraints; ic++)
-			{
-				int i = m_start + ic;
-				if (m_constraints[i].m_batchIdx != bb)
-					continue;
-
-				float frictionCoeff = b3GetFrictionCoeff(&m_constraints[i]);
-				int aIdx = (int)m_constraints[i].m_bodyA;
-				int bIdx = (int)m_constraints[i].m_bodyB;
-				//int localBatch = m_constraints[i].m_batchIdx;
-				b3RigidBodyData& bodyA = m_bodies[aIdx];
-				b3RigidBodyData& bodyB = m_bodies[bIdx];
-
-#if 0
-				if ((bodyA.m_invMass) && (bodyB.m_invMass))
-				{
-				//	printf("aIdx=%d, bIdx=%d\n", aIdx,bIdx);
-				}
-				if (bIdx==10)
-				{
-					//printf("ic(b)=%d, localBatch=%d\n",ic,localBatch);
-				}
-#endif
-				if (aIdx == 10)
-				{
-					//printf("ic(a)=%d, localBatch=%d\n",ic,localBatch);
-				}
-				if (usedBodies.size() < (aIdx + 1))
-				{
-					usedBodies.resize(aIdx + 1, 0);
-				}
-
-				if (usedBodies.size() < (bIdx + 1))
-				{
-					usedBodies.resize(bIdx + 1, 0);
-				}
-
-				if (bodyA.m_invMass)
-				{
-					b3Assert(usedBodies[aIdx] == 0);
-					usedBodies[aIdx]++;
-				}
-
-				if (bodyB.m_invMass)
-				{
-					b3Assert(usedBodies[bIdx] == 0);
-					usedBodies[bIdx]++;
-				}
-
-				if (!m_solveFriction)
-				{
-					float maxRambdaDt[4] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
-					float minRambdaDt[4] = {0.f, 0.f, 0.f, 0.f};
+			b3RigidBodyData* body = &m_bodies[i];
+			if (body->m_invMass == 0.f)
+				continue;
 
-					b3SolveContact(m_constraints[i], (b3Vector3&)bodyA.m_pos, (b3Vector3&)bodyA.m_linVel, (b3Vector3&)bodyA.m_angVel, bodyA.m_invMass, (const b3Matrix3x3&)m_shapes[aIdx].m_invInertiaWorld,
-								   (b3Vector3&)bodyB.m_pos, (b3Vector3&)bodyB.m_linVel, (b3Vector3&)bodyB.m_angVel, bodyB.m_invMass, (const b3Matrix3x3&)m_shapes[bIdx].m_invInertiaWorld,
-								   maxRambdaDt, minRambdaDt);
-				}
-				else
-				{
-					float maxRambdaDt[4] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
-					float minRambdaDt[4] = {0.f, 0.f, 0.f, 0.f};
-
-					float sum = 0;
-					for (int j = 0; j < 4; j++)
-					{
-						sum += m_constraints[i].m_appliedRambdaDt[j];
-					}
-					frictionCoeff = 0.7f;
-					for (int j = 0; j < 4; j++)
-					{
-						maxRambdaDt[j] = frictionCoeff * sum;
-						minRambdaDt[j] = -maxRambdaDt[j];
-					}
-
-					b3SolveFriction(m_constraints[i], (b3Vector3&)bodyA.m_pos, (b3Vector3&)bodyA.m_linVel, (b3Vector3&)bodyA.m_angVel, bodyA.m_invMass, (const b3Matrix3x3&)m_shapes[aIdx].m_invInertiaWorld,
-									(b3Vector3&)bodyB.m_pos, (b3Vector3&)bodyB.m_linVel, (b3Vector3&)bodyB.m_angVel, bodyB.m_invMass, (const b3Matrix3x3&)m_shapes[bIdx].m_invInertiaWorld,
-									maxRambdaDt, minRambdaDt);
-				}
-			}
+			b3IntegrateTransform(body, m_timeStep, angularDamping, noGravity);
 
-			if (m_wgUsedBodies)
-			{
-				if (m_wgUsedBodies[m_curWgidx].size() < usedBodies.size())
-				{
-					m_wgUsedBodies[m_curWgidx].resize(usedBodies.size());
-				}
-				for (int i = 0; i < usedBodies.size(); i++)
-				{
-					if (usedBodies[i])
-					{
-						//printf("cell %d uses body %d\n", m_curWgidx,i);
-						m_wgUsedBodies[m_curWgidx][i] = 1;
-					}
-				}
-			}
+			b3Matrix3x3 rotation(body->m_quat);
+			m_inertias[i].m_invInertiaWorld = (rotation * m_inertias[i].m_initInvInertia).timesTranspose(rotation);
 		}
 	}
-
-	b3AlignedObjectArray<b3RigidBodyData>& m_bodies;
-	b3AlignedObjectArray<b3Inertia>& m_shapes;
-	b3AlignedObjectArray<b3ContactConstraint4>& m_constraints;
-	b3AlignedObjectArray<int>* m_wgUsedBodies;
-	int m_curWgidx;
-	int m_start;
-	int m_nConstraints;
-	bool m_solveFriction;
-	int m_maxNumBatches;
 };
 
-void b3CpuRigidBodyPipeline::solveContactConstraints()
+void b3CpuRigidBodyPipeline::integrate(float deltaTime)
 {
-	int m_nIterations = 4;
-
-	b3AlignedObjectArray<b3ContactConstraint4> contactConstraints;
-	//	const b3AlignedObjectArray<b3Contact4Data>& contacts = m_data->m_np->getContacts();
-	int n = contactConstraints.size();
-	//convert contacts...
-
-	int maxNumBatches = 250;
+	B3_PROFILE("integrate");
+	if (!getNumBodies())
+		return;
+
+	//gravity was applied to the velocities before solving
+	b3IntegrateLoop loop;
+	loop.m_bodies = &m_data->m_rigidBodies[0];
+	loop.m_inertias = &m_data->m_inertias[0];
+	loop.m_timeStep = deltaTime;
+	b3ParallelFor(0, getNumBodies(), 256, loop);
+}
 
-	for (int iter = 0; iter < m_nIterations; iter++)
-	{
-		b3SolveTask task(m_data->m_rigidBodies, m_data->m_inertias, contactConstraints, 0, n, maxNumBatches, 0, 0);
-		task.m_solveFriction = false;
-		task.run(0);
-	}
+void b3CpuRigidBodyPipeline::setGravity(const float* grav)
+{
+	m_data->m_gravity = b3MakeVector3(grav[0], grav[1], grav[2]);
+}
 
-	for (int iter = 0; iter < m_nIterations; iter++)
-	{
-		b3SolveTask task(m_data->m_rigidBodies, m_data->m_inertias, contactConstraints, 0, n, maxNumBatches, 0, 0);
-		task.m_solveFriction = true;
-		task.run(0);
-	}
+void b3CpuRigidBodyPipeline::setNumSolverIterations(int numIterations)
+{
+	m_data->m_solverInfo.m_numIterations = numIterations;
 }
 
-void b3CpuRigidBodyPipeline::integrate(float deltaTime)
+void b3CpuRigidBodyPipeline::setBodyVelocity(int bodyIndex, const float* linVel, const float* angVel)
 {
-	float angDamping = 0.f;
-	b3Vector3 gravityAcceleration = b3MakeVector3(0, -9, 0);
+	b3RigidBodyData& body = m_data->m_rigidBodies[bodyIndex];
+	body.m_linVel.setValue(linVel[0], linVel[1], linVel[2]);
+	body.m_angVel.setValue(angVel[0], angVel[1], angVel[2]);
+}
 
-	//integrate transforms (external forces/gravity should be moved into constraint solver)
-	for (int i = 0; i < m_data->m_rigidBodies.size(); i++)
-	{
-		b3IntegrateTransform(&m_data->m_rigidBodies[i], deltaTime, angDamping, gravityAcceleration);
-	}
+void b3CpuRigidBodyPipeline::setBodyMaterial(int bodyIndex, float friction, float restitution)
+{
+	b3RigidBodyData& body = m_data->m_rigidBodies[bodyIndex];
+	body.m_frictionCoeff = friction;
+	body.m_restituitionCoeff = restitution;
 }
 
 int b3CpuRigidBodyPipeline::registerPhysicsInstance(float mass, const float* position, const float* orientation, int collidableIndex, int userData)
@@ -407,31 +349,45 @@ int b3CpuRigidBodyPipeline::registerPhysicsInstance(float mass, const float* pos
 	body.m_quat.setValue(orientation[0], orientation[1], orientation[2], orientation[3]);
 	body.m_restituitionCoeff = 0.f;
 
+	if (collidableIndex < 0)
+	{
+		b3Error("registerPhysicsInstance using invalid collidableIndex\n");
+		return -1;
+	}
+
 	m_data->m_rigidBodies.push_back(body);
 
-	if (collidableIndex >= 0)
+	const b3Collidable& collidable = m_data->m_np->getCollidableCpu(collidableIndex);
+	b3Aabb localAabb = m_data->m_np->getLocalSpaceAabb(collidableIndex);
+	b3Vector3 localAabbMin = b3MakeVector3(localAabb.m_min[0], localAabb.m_min[1], localAabb.m_min[2]);
+	b3Vector3 localAabbMax = b3MakeVector3(localAabb.m_max[0], localAabb.m_max[1], localAabb.m_max[2]);
+
+	//sphere inertia for spheres, box inertia of the local aabb for everything else
+	b3InertiaData inertia = {};
+	b3Vector3 invInertiaLocal = b3MakeVector3(0, 0, 0);
+	if (mass != 0.f && collidable.m_shapeType == SHAPE_SPHERE)
 	{
-		b3Aabb& worldAabb = m_data->m_aabbWorldSpace.expand();
-
-		b3Aabb localAabb = m_data->m_np->getLocalSpaceAabb(collidableIndex);
-		b3Vector3 localAabbMin = b3MakeVector3(localAabb.m_min[0], localAabb.m_min[1], localAabb.m_min[2]);
-		b3Vector3 localAabbMax = b3MakeVector3(localAabb.m_max[0], localAabb.m_max[1], localAabb.m_max[2]);
-
-		b3Scalar margin = 0.01f;
-		b3Transform t;
-		t.setIdentity();
-		t.setOrigin(b3MakeVector3(position[0], position[1], position[2]));
-		t.setRotation(b3Quaternion(orientation[0], orientation[1], orientation[2], orientation[3]));
-		b3TransformAabb(localAabbMin, localAabbMax, margin, t, worldAabb.m_minVec, worldAabb.m_maxVec);
-
-		m_data->m_bp->createProxy(worldAabb.m_minVec, worldAabb.m_maxVec, bodyIndex, 0, 1, 1);
-		//		b3Vector3 aabbMin,aabbMax;
-		//	m_data->m_bp->getAabb(bodyIndex,aabbMin,aabbMax);
+		float i = 0.4f * mass * collidable.m_radius * collidable.m_radius;
+		invInertiaLocal.setValue(1.f / i, 1.f / i, 1.f / i);
 	}
-	else
+	else if (mass != 0.f && collidable.m_shapeType != SHAPE_PLANE)
 	{
-		b3Error("registerPhysicsInstance using invalid collidableIndex\n");
+		b3Vector3 extents = localAabbMax - localAabbMin;
+		b3Scalar lx = extents.x * extents.x, ly = extents.y * extents.y, lz = extents.z * extents.z;
+		invInertiaLocal.setValue(12.f / (mass * (ly + lz)), 12.f / (mass * (lx + lz)), 12.f / (mass * (lx + ly)));
 	}
+	inertia.m_initInvInertia.setIdentity();
+	inertia.m_initInvInertia = inertia.m_initInvInertia.scaled(invInertiaLocal);
+	b3Matrix3x3 rotation(body.m_quat);
+	inertia.m_invInertiaWorld = (rotation * inertia.m_initInvInertia).timesTranspose(rotation);
+	m_data->m_inertias.push_back(inertia);
+
+	b3Aabb& worldAabb = m_data->m_aabbWorldSpace.expand();
+
+	b3Scalar margin = 0.5f * B3_CPU_NARROWPHASE_CONTACT_THRESHOLD;
+	b3TransformAabb2(localAabb.m_minVec, localAabb.m_maxVec, margin, body.m_pos, body.m_quat, &worldAabb.m_minVec, &worldAabb.m_maxVec);
+
+	m_data->m_bp->createProxy(worldAabb.m_minVec, worldAabb.m_maxVec, bodyIndex, 0, 1, 1);
 
 	return bodyIndex;
 }
@@ -19,6 +19,14 @@ subject to the following restrictions:
 #include "Bullet3Common/b3AlignedObjectArray.h"
 #include "Bullet3Collision/NarrowPhaseCollision/b3RaycastInfo.h"
 
+///b3CpuRigidBodyPipeline steps the data oriented rigid body pipeline (b3RigidBodyData, b3Collidable, b3Contact4) on the CPU.
+///Each stage runs with b3ParallelFor, so it uses the task scheduler routed there with b3SetCustomParallelForFunc:
+///  - updateAabbWorldSpace computes the world aabbs in parallel and updates the broadphase trees serially
+///  - computeOverlappingPairs queries the trees in parallel, the pairs are sorted by body index and don't depend on the number of threads
+///  - computeContactPoints runs b3CpuNarrowPhase in parallel chunks of pairs
+///  - solveContactConstraints uses b3PgsJacobiSolver in Jacobi mode, which solves the manifolds as parallel batches
+///  - integrate applies the velocities and updates the world inverse inertia in parallel
+///The broadphase is switched to deferred collide: it only maintains its trees, its pair cache is not used.
 class b3CpuRigidBodyPipeline
 {
 protected:
@@ -36,6 +44,7 @@ public:
 	virtual void computeOverlappingPairs();
 	virtual void computeContactPoints();
 	virtual void solveContactConstraints();
+	virtual void applyGravity(float timeStep);
 
 	int registerConvexPolyhedron(class b3ConvexUtility* convex);
 
@@ -43,6 +52,9 @@ public:
 	void writeAllInstancesToGpu();
 	void copyConstraintsToHost();
 	void setGravity(const float* grav);
+	void setNumSolverIterations(int numIterations);
+	void setBodyVelocity(int bodyIndex, const float* linVel, const float* angVel);
+	void setBodyMaterial(int bodyIndex, float friction, float restitution);
 	void reset();
 
 	int createPoint2PointConstraint(int bodyA, int bodyB, const float* pivotInA, const float* pivotInB, float breakingThreshold);
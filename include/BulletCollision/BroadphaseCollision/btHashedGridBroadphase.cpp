@@ -0,0 +1,732 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btHashedGridBroadphase.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+#include "btParallelBroadphaseUtil.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+
+#if HG_BP_ENABLE_BENCHMARK
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#endif
+
+#define HG_BP_GRAIN_SIZE 4096
+#define HG_BP_PROXIES_PER_CHUNK 256
+#define HG_BP_BUCKETS_PER_CHUNK 4096
+//the extents are classified by powers of two from 2^-HG_BP_SIZE_BIAS to 2^(HG_BP_SIZE_CLASSES - HG_BP_SIZE_BIAS - 1),
+//class 0 holds the points and the extents below 2^-HG_BP_SIZE_BIAS, they fit in any cell and don't choose the cell size
+#define HG_BP_SIZE_CLASSES 64
+#define HG_BP_SIZE_BIAS 32
+#define HG_BP_CELL_SIZE_PERCENTILE 90
+//proxies that cover more cells are tested against all the others
+#define HG_BP_MAX_CELLS_PER_PROXY 64
+//queries that cover more cells test all proxies
+#define HG_BP_MAX_QUERY_CELLS 4096
+#define HG_BP_MAX_CELL_COORDINATE (1 << 30)
+
+static SIMD_FORCE_INLINE int btHashedGridCell(btScalar value, btScalar invCellSize)
+{
+	btScalar cell = floor(value * invCellSize);
+	cell = btMin(btMax(cell, btScalar(-HG_BP_MAX_CELL_COORDINATE)), btScalar(HG_BP_MAX_CELL_COORDINATE));
+	return int(cell);
+}
+
+///the cells of a 4x4x4 block map to 64 consecutive buckets, so neighbouring cells share cache lines
+static SIMD_FORCE_INLINE int btHashedGridBucket(int x, int y, int z, int numBuckets)
+{
+	unsigned int hash = ((unsigned int)(x >> 2) * 73856093u) ^ ((unsigned int)(y >> 2) * 19349663u) ^ ((unsigned int)(z >> 2) * 83492791u);
+	unsigned int local = (unsigned int)(x & 3) | ((unsigned int)(y & 3) << 2) | ((unsigned int)(z & 3) << 4);
+	return int((hash * 64 + local) & (unsigned int)(numBuckets - 1));
+}
+
+///the cells of a range are only counted up to the limit, so large ranges don't overflow
+static SIMD_FORCE_INLINE int btHashedGridNumCells(const int* cellMin, const int* cellMax, int limit)
+{
+	long long numCells = 1;
+	for (int k = 0; k < 3; k++)
+	{
+		numCells *= (long long)cellMax[k] - cellMin[k] + 1;
+		if (numCells > limit)
+			return limit + 1;
+	}
+	return int(numCells);
+}
+
+///a pair is only reported in the first cell that both ranges cover
+static SIMD_FORCE_INLINE bool btHashedGridIsFirstSharedCell(const int* cell, const int* queryMin, const btHashedGridBroadphase::CellRange& range)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		int first = btMax(queryMin[k], range.m_min[k]);
+		if (first != cell[k] || first > range.m_max[k])
+			return false;
+	}
+	return true;
+}
+
+struct btHashedGridSizeLoop : public btIParallelForBody
+{
+	btHashedGridProxy* const* m_proxies;
+	int* m_chunkCounts;
+	btVector3* m_chunkBounds;
+	int m_numProxies;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			int* counts = &m_chunkCounts[chunk * HG_BP_SIZE_CLASSES];
+			memset(counts, 0, sizeof(int) * HG_BP_SIZE_CLASSES);
+			btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+			btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+			int end = btMin(m_numProxies, (chunk + 1) * HG_BP_GRAIN_SIZE);
+			for (int i = chunk * HG_BP_GRAIN_SIZE; i < end; i++)
+			{
+				const btHashedGridProxy* proxy = m_proxies[i];
+				btVector3 extents = proxy->m_aabbMax - proxy->m_aabbMin;
+				btScalar extent = extents[extents.maxAxis()];
+				int sizeClass = 0;
+				if (extent > btScalar(0))
+				{
+					//extent < 2^exponent
+					int exponent;
+					frexp(extent, &exponent);
+					sizeClass = btMin(btMax(exponent + HG_BP_SIZE_BIAS, 0), HG_BP_SIZE_CLASSES - 1);
+				}
+				counts[sizeClass]++;
+				aabbMin.setMin(proxy->m_aabbMin);
+				aabbMax.setMax(proxy->m_aabbMax);
+			}
+			m_chunkBounds[chunk * 2] = aabbMin;
+			m_chunkBounds[chunk * 2 + 1] = aabbMax;
+		}
+	}
+};
+
+struct btHashedGridRangeLoop : public btIParallelForBody
+{
+	btHashedGridProxy* const* m_proxies;
+	btHashedGridBroadphase::CellRange* m_cellRanges;
+	int* m_chunkCounts;
+	btScalar m_invCellSize;
+	int m_numProxies;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			int numCells = 0;
+			int end = btMin(m_numProxies, (chunk + 1) * HG_BP_GRAIN_SIZE);
+			for (int i = chunk * HG_BP_GRAIN_SIZE; i < end; i++)
+			{
+				const btHashedGridProxy* proxy = m_proxies[i];
+				btHashedGridBroadphase::CellRange& range = m_cellRanges[i];
+				for (int k = 0; k < 3; k++)
+				{
+					range.m_min[k] = btHashedGridCell(proxy->m_aabbMin[k], m_invCellSize);
+					range.m_max[k] = btHashedGridCell(proxy->m_aabbMax[k], m_invCellSize);
+				}
+				range.m_numCells = btHashedGridNumCells(range.m_min, range.m_max, HG_BP_MAX_CELLS_PER_PROXY);
+				if (range.m_numCells > HG_BP_MAX_CELLS_PER_PROXY)
+					range.m_numCells = 0;
+				numCells += range.m_numCells;
+			}
+			m_chunkCounts[chunk] = numCells;
+		}
+	}
+};
+
+///counts the proxies per bucket, or scatters them to the buckets when m_entries is set
+struct btHashedGridInsertLoop : public btIParallelForBody
+{
+	const btHashedGridBroadphase::CellRange* m_cellRanges;
+	int* m_bucketCounters;
+	int* m_entries;
+	int m_numBuckets;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			const btHashedGridBroadphase::CellRange& range = m_cellRanges[i];
+			if (!range.m_numCells)
+				continue;
+
+			for (int z = range.m_min[2]; z <= range.m_max[2]; z++)
+			{
+				for (int y = range.m_min[1]; y <= range.m_max[1]; y++)
+				{
+					for (int x = range.m_min[0]; x <= range.m_max[0]; x++)
+					{
+						int* counter = &m_bucketCounters[btHashedGridBucket(x, y, z, m_numBuckets)];
+						if (m_entries)
+						{
+							m_entries[btAtomicAdd(counter, 1)] = i;
+						}
+						else
+						{
+							btAtomicAdd(counter, 1);
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+struct btHashedGridSortBucketsLoop : public btIParallelForBody
+{
+	const int* m_bucketStarts;
+	int* m_entries;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int bucket = iBegin; bucket < iEnd; bucket++)
+		{
+			//the buckets are short, an insertion sort is enough
+			int begin = m_bucketStarts[bucket];
+			int end = m_bucketStarts[bucket + 1];
+			for (int i = begin + 1; i < end; i++)
+			{
+				int entry = m_entries[i];
+				int j = i;
+				while (j > begin && m_entries[j - 1] > entry)
+				{
+					m_entries[j] = m_entries[j - 1];
+					j--;
+				}
+				m_entries[j] = entry;
+			}
+		}
+	}
+};
+
+struct btHashedGridPairLoop : public btIParallelForBody
+{
+	btHashedGridProxy* const* m_proxies;
+	const btHashedGridBroadphase::CellRange* m_cellRanges;
+	const int* m_bucketStarts;
+	const int* m_entries;
+	const int* m_largeProxies;
+	btAlignedObjectArray<btBroadphasePair>* m_chunkPairs;
+	int m_numLargeProxies;
+	int m_numBuckets;
+	int m_numProxies;
+
+	static void addPair(btAlignedObjectArray<btBroadphasePair>& pairs, btHashedGridProxy* proxy, btHashedGridProxy* other)
+	{
+		if (TestAabbAgainstAabb2(proxy->m_aabbMin, proxy->m_aabbMax, other->m_aabbMin, other->m_aabbMax) &&
+			(proxy->m_collisionFilterGroup & other->m_collisionFilterMask) &&
+			(other->m_collisionFilterGroup & proxy->m_collisionFilterMask))
+		{
+			pairs.push_back(btBroadphasePair(*proxy, *other));
+		}
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			btAlignedObjectArray<btBroadphasePair>& pairs = m_chunkPairs[chunk];
+			pairs.resize(0);
+
+			int end = btMin(m_numProxies, (chunk + 1) * HG_BP_PROXIES_PER_CHUNK);
+			for (int i = chunk * HG_BP_PROXIES_PER_CHUNK; i < end; i++)
+			{
+				const btHashedGridBroadphase::CellRange& range = m_cellRanges[i];
+				if (!range.m_numCells)
+					continue;
+
+				btHashedGridProxy* proxy = m_proxies[i];
+				int cell[3];
+				for (cell[2] = range.m_min[2]; cell[2] <= range.m_max[2]; cell[2]++)
+				{
+					for (cell[1] = range.m_min[1]; cell[1] <= range.m_max[1]; cell[1]++)
+					{
+						for (cell[0] = range.m_min[0]; cell[0] <= range.m_max[0]; cell[0]++)
+						{
+							int bucket = btHashedGridBucket(cell[0], cell[1], cell[2], m_numBuckets);
+							int previous = i;
+							for (int e = m_bucketStarts[bucket]; e < m_bucketStarts[bucket + 1]; e++)
+							{
+								//sorted, a proxy is in a bucket once per cell that maps to it, only the proxies after i report
+								int j = m_entries[e];
+								if (j <= previous)
+									continue;
+								previous = j;
+
+								if (btHashedGridIsFirstSharedCell(cell, range.m_min, m_cellRanges[j]))
+								{
+									addPair(pairs, proxy, m_proxies[j]);
+								}
+							}
+						}
+					}
+				}
+
+				for (int l = 0; l < m_numLargeProxies; l++)
+				{
+					addPair(pairs, proxy, m_proxies[m_largeProxies[l]]);
+				}
+			}
+		}
+	}
+};
+
+btHashedGridBroadphase::btHashedGridBroadphase(btScalar cellSize, btOverlappingPairCache* paircache)
+	: m_needsUpdate(true),
+	  m_uniqueIdCounter(0),
+	  m_numBuckets(0),
+	  m_fixedCellSize(cellSize),
+	  m_cellSize(cellSize),
+	  m_aabbMin(0, 0, 0),
+	  m_aabbMax(0, 0, 0)
+{
+	m_releasepaircache = (paircache != 0) ? false : true;
+	m_paircache = paircache ? paircache : new (btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16)) btHashedOverlappingPairCache();
+}
+
+btHashedGridBroadphase::~btHashedGridBroadphase()
+{
+	for (int i = 0; i < m_proxies.size(); i++)
+	{
+		m_proxies[i]->~btHashedGridProxy();
+		btAlignedFree(m_proxies[i]);
+	}
+
+	if (m_releasepaircache)
+	{
+		m_paircache->~btOverlappingPairCache();
+		btAlignedFree(m_paircache);
+	}
+}
+
+btBroadphaseProxy* btHashedGridBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	btHashedGridProxy* proxy = new (btAlignedAlloc(sizeof(btHashedGridProxy), 16)) btHashedGridProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = ++m_uniqueIdCounter;
+	proxy->m_proxyIndex = m_proxies.size();
+	m_proxies.push_back(proxy);
+	m_needsUpdate = true;
+	return proxy;
+}
+
+void btHashedGridBroadphase::destroyProxy(btBroadphaseProxy* absproxy, btDispatcher* dispatcher)
+{
+	btHashedGridProxy* proxy = (btHashedGridProxy*)absproxy;
+	m_paircache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+	//the queries skip it until the next update
+	if (proxy->m_gridIndex >= 0)
+	{
+		m_gridProxies[proxy->m_gridIndex] = 0;
+	}
+
+	int index = proxy->m_proxyIndex;
+	m_proxies[index] = m_proxies[m_proxies.size() - 1];
+	m_proxies[index]->m_proxyIndex = index;
+	m_proxies.pop_back();
+
+	proxy->~btHashedGridProxy();
+	btAlignedFree(proxy);
+	m_needsUpdate = true;
+}
+
+void btHashedGridBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	m_needsUpdate = true;
+}
+
+void btHashedGridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+btScalar btHashedGridBroadphase::chooseCellSize()
+{
+	const int n = m_proxies.size();
+	int numChunks = (n + HG_BP_GRAIN_SIZE - 1) / HG_BP_GRAIN_SIZE;
+	m_chunkCounts.resize(numChunks * HG_BP_SIZE_CLASSES);
+	m_chunkBounds.resize(numChunks * 2);
+
+	btHashedGridSizeLoop sizeLoop;
+	sizeLoop.m_proxies = &m_proxies[0];
+	sizeLoop.m_chunkCounts = &m_chunkCounts[0];
+	sizeLoop.m_chunkBounds = &m_chunkBounds[0];
+	sizeLoop.m_numProxies = n;
+	btParallelFor(0, numChunks, 1, sizeLoop);
+
+	m_aabbMin = m_chunkBounds[0];
+	m_aabbMax = m_chunkBounds[1];
+	for (int chunk = 1; chunk < numChunks; chunk++)
+	{
+		m_aabbMin.setMin(m_chunkBounds[chunk * 2]);
+		m_aabbMax.setMax(m_chunkBounds[chunk * 2 + 1]);
+	}
+
+	if (m_fixedCellSize > btScalar(0))
+		return m_fixedCellSize;
+
+	int numPoints = 0;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		numPoints += m_chunkCounts[chunk * HG_BP_SIZE_CLASSES];
+	}
+	if (numPoints == n)
+	{
+		//about one point per cell if they are spread evenly
+		btVector3 extents = m_aabbMax - m_aabbMin;
+		btScalar cellSize = extents[extents.maxAxis()] / btPow(btScalar(n), btScalar(1) / btScalar(3));
+		return cellSize > SIMD_EPSILON ? cellSize : btScalar(1);
+	}
+
+	//twice the smallest power of two that is larger than the given percentile of the extents,
+	//most proxies cover one or two cells per axis and there are few proxies per cell.
+	//Points would make the cells tiny and all other proxies large, they are left out
+	const int rank = ((n - numPoints - 1) * HG_BP_CELL_SIZE_PERCENTILE) / 100;
+	int count = 0;
+	for (int sizeClass = 1; sizeClass < HG_BP_SIZE_CLASSES; sizeClass++)
+	{
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			count += m_chunkCounts[chunk * HG_BP_SIZE_CLASSES + sizeClass];
+		}
+		if (count > rank)
+		{
+			return btScalar(ldexp(1.0, sizeClass + 1 - HG_BP_SIZE_BIAS));
+		}
+	}
+	return btScalar(ldexp(1.0, HG_BP_SIZE_CLASSES - HG_BP_SIZE_BIAS));
+}
+
+void btHashedGridBroadphase::update()
+{
+	BT_PROFILE("btHashedGridBroadphase::update");
+	m_needsUpdate = false;
+
+	const int n = m_proxies.size();
+	m_gridProxies.resizeNoInitialize(n);
+	for (int i = 0; i < n; i++)
+	{
+		m_gridProxies[i] = m_proxies[i];
+		m_proxies[i]->m_gridIndex = i;
+	}
+	m_largeProxies.resize(0);
+	if (!n)
+	{
+		m_numBuckets = 0;
+		m_aabbMin.setValue(0, 0, 0);
+		m_aabbMax.setValue(0, 0, 0);
+		return;
+	}
+
+	m_cellSize = chooseCellSize();
+
+	int numCells = 0;
+	{
+		BT_PROFILE("btHashedGridBroadphase::cellRanges");
+		int numChunks = (n + HG_BP_GRAIN_SIZE - 1) / HG_BP_GRAIN_SIZE;
+		m_cellRanges.resizeNoInitialize(n);
+
+		btHashedGridRangeLoop rangeLoop;
+		rangeLoop.m_proxies = &m_proxies[0];
+		rangeLoop.m_cellRanges = &m_cellRanges[0];
+		rangeLoop.m_chunkCounts = &m_chunkCounts[0];
+		rangeLoop.m_invCellSize = btScalar(1) / m_cellSize;
+		rangeLoop.m_numProxies = n;
+		btParallelFor(0, numChunks, 1, rangeLoop);
+
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			numCells += m_chunkCounts[chunk];
+		}
+		for (int i = 0; i < n; i++)
+		{
+			if (!m_cellRanges[i].m_numCells)
+				m_largeProxies.push_back(i);
+		}
+	}
+
+	//about two buckets per cell reference keeps the buckets short
+	m_numBuckets = 64;
+	while (m_numBuckets < numCells * 2)
+		m_numBuckets *= 2;
+
+	{
+		BT_PROFILE("btHashedGridBroadphase::insert");
+		m_bucketCounters.resize(m_numBuckets);
+		m_bucketStarts.resize(m_numBuckets + 1);
+		m_bucketEntries.resizeNoInitialize(numCells + 1);
+		memset(&m_bucketCounters[0], 0, sizeof(int) * m_numBuckets);
+
+		btHashedGridInsertLoop insertLoop;
+		insertLoop.m_cellRanges = &m_cellRanges[0];
+		insertLoop.m_bucketCounters = &m_bucketCounters[0];
+		insertLoop.m_entries = 0;
+		insertLoop.m_numBuckets = m_numBuckets;
+		btParallelFor(0, n, HG_BP_PROXIES_PER_CHUNK, insertLoop);
+
+		//the counters become the insert positions
+		int offset = 0;
+		for (int bucket = 0; bucket < m_numBuckets; bucket++)
+		{
+			int count = m_bucketCounters[bucket];
+			m_bucketStarts[bucket] = offset;
+			m_bucketCounters[bucket] = offset;
+			offset += count;
+		}
+		m_bucketStarts[m_numBuckets] = offset;
+
+		insertLoop.m_entries = &m_bucketEntries[0];
+		btParallelFor(0, n, HG_BP_PROXIES_PER_CHUNK, insertLoop);
+
+		//the order within a bucket depends on the threads
+		btHashedGridSortBucketsLoop sortLoop;
+		sortLoop.m_bucketStarts = &m_bucketStarts[0];
+		sortLoop.m_entries = &m_bucketEntries[0];
+		btParallelFor(0, m_numBuckets, HG_BP_BUCKETS_PER_CHUNK, sortLoop);
+	}
+}
+
+void btHashedGridBroadphase::findPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btHashedGridBroadphase::findPairs");
+
+	btRemoveSeparatedPairs(m_paircache, dispatcher);
+
+	const int n = m_proxies.size();
+	if (n < 2)
+		return;
+
+	//one more chunk for the pairs of large proxies
+	int numChunks = (n + HG_BP_PROXIES_PER_CHUNK - 1) / HG_BP_PROXIES_PER_CHUNK;
+	if (m_chunkPairs.size() < numChunks + 1)
+		m_chunkPairs.resize(numChunks + 1);
+
+	btHashedGridPairLoop pairLoop;
+	pairLoop.m_proxies = &m_proxies[0];
+	pairLoop.m_cellRanges = &m_cellRanges[0];
+	pairLoop.m_bucketStarts = &m_bucketStarts[0];
+	pairLoop.m_entries = &m_bucketEntries[0];
+	pairLoop.m_largeProxies = m_largeProxies.size() ? &m_largeProxies[0] : 0;
+	pairLoop.m_chunkPairs = &m_chunkPairs[0];
+	pairLoop.m_numLargeProxies = m_largeProxies.size();
+	pairLoop.m_numBuckets = m_numBuckets;
+	pairLoop.m_numProxies = n;
+	btParallelFor(0, numChunks, 1, pairLoop);
+
+	btAlignedObjectArray<btBroadphasePair>& largePairs = m_chunkPairs[numChunks];
+	largePairs.resize(0);
+	for (int i = 0; i < m_largeProxies.size(); i++)
+	{
+		for (int j = i + 1; j < m_largeProxies.size(); j++)
+		{
+			btHashedGridPairLoop::addPair(largePairs, m_proxies[m_largeProxies[i]], m_proxies[m_largeProxies[j]]);
+		}
+	}
+
+	btAddChunkPairs(m_paircache, m_chunkPairs, numChunks + 1);
+}
+
+void btHashedGridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btHashedGridBroadphase::calculateOverlappingPairs");
+	updateGrid();
+	findPairs(dispatcher);
+}
+
+void btHashedGridBroadphase::updateGrid()
+{
+	if (m_needsUpdate)
+		update();
+}
+
+void btHashedGridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	btBroadphaseRayAabbCallback callback(rayCallback, rayFrom, aabbMin, aabbMax);
+	btVector3 queryMin, queryMax;
+	callback.getQueryAabb(rayTo, queryMin, queryMax);
+	aabbTest(queryMin, queryMax, callback);
+}
+
+void btHashedGridBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	if (!m_gridProxies.size())
+		return;
+
+	const btScalar invCellSize = btScalar(1) / m_cellSize;
+	int queryMin[3];
+	int queryMax[3];
+	for (int k = 0; k < 3; k++)
+	{
+		queryMin[k] = btHashedGridCell(aabbMin[k], invCellSize);
+		queryMax[k] = btHashedGridCell(aabbMax[k], invCellSize);
+	}
+
+	if (btHashedGridNumCells(queryMin, queryMax, HG_BP_MAX_QUERY_CELLS) > HG_BP_MAX_QUERY_CELLS)
+	{
+		for (int i = 0; i < m_gridProxies.size(); i++)
+		{
+			btHashedGridProxy* proxy = m_gridProxies[i];
+			if (proxy && TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+				callback.process(proxy);
+		}
+		return;
+	}
+
+	int cell[3];
+	for (cell[2] = queryMin[2]; cell[2] <= queryMax[2]; cell[2]++)
+	{
+		for (cell[1] = queryMin[1]; cell[1] <= queryMax[1]; cell[1]++)
+		{
+			for (cell[0] = queryMin[0]; cell[0] <= queryMax[0]; cell[0]++)
+			{
+				int bucket = btHashedGridBucket(cell[0], cell[1], cell[2], m_numBuckets);
+				int previous = -1;
+				for (int e = m_bucketStarts[bucket]; e < m_bucketStarts[bucket + 1]; e++)
+				{
+					int j = m_bucketEntries[e];
+					if (j == previous)
+						continue;
+					previous = j;
+
+					btHashedGridProxy* proxy = m_gridProxies[j];
+					if (proxy && btHashedGridIsFirstSharedCell(cell, queryMin, m_cellRanges[j]) &&
+						TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+					{
+						callback.process(proxy);
+					}
+				}
+			}
+		}
+	}
+
+	for (int l = 0; l < m_largeProxies.size(); l++)
+	{
+		btHashedGridProxy* proxy = m_gridProxies[m_largeProxies[l]];
+		if (proxy && TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+			callback.process(proxy);
+	}
+}
+
+void btHashedGridBroadphase::resetPool(btDispatcher* /*dispatcher*/)
+{
+	if (!m_proxies.size())
+	{
+		m_gridProxies.clear();
+		m_largeProxies.clear();
+		m_cellRanges.clear();
+		m_bucketStarts.clear();
+		m_bucketCounters.clear();
+		m_bucketEntries.clear();
+		m_chunkCounts.clear();
+		m_chunkBounds.clear();
+		m_chunkPairs.clear();
+		m_numBuckets = 0;
+		m_uniqueIdCounter = 0;
+		m_needsUpdate = true;
+	}
+}
+
+void btHashedGridBroadphase::printStats()
+{
+	printf("btHashedGridBroadphase.numProxies = %d\n", m_proxies.size());
+	printf("btHashedGridBroadphase.numLargeProxies = %d\n", m_largeProxies.size());
+	printf("btHashedGridBroadphase.cellSize = %f\n", (double)m_cellSize);
+	printf("btHashedGridBroadphase.numBuckets = %d\n", m_numBuckets);
+	printf("btHashedGridBroadphase.numCellEntries = %d\n", m_numBuckets ? m_bucketStarts[m_numBuckets] : 0);
+	printf("btHashedGridBroadphase.numPairs = %d\n", m_paircache->getNumOverlappingPairs());
+}
+
+//
+#if HG_BP_ENABLE_BENCHMARK
+
+void btHashedGridBroadphase::benchmark()
+{
+	typedef btParallelBroadphaseBenchmark Benchmark;
+
+	//objects of a similar size in a layer on the surface of a planet, the planet itself is one large static proxy
+	static const Benchmark::Experiment experiments[] =
+		{
+			{"1024o.90%", 1024, 90, 256, (btScalar)0.005, (btScalar)2},
+			{"10240o.90%", 10240, 90, 32, (btScalar)0.005, (btScalar)2},
+			{"102400o.90%", 102400, 90, 8, (btScalar)0.005, (btScalar)2},
+			{"102400o.10%", 102400, 10, 8, (btScalar)0.005, (btScalar)2},
+		};
+	static const int nexperiments = sizeof(experiments) / sizeof(experiments[0]);
+	const btScalar planetRadius = (btScalar)6360000;
+	const btVector3 regionOrigin(0, planetRadius, 0);
+
+	btAlignedObjectArray<Benchmark::Object> objects;
+	btAlignedObjectArray<btBroadphaseProxy*> proxies;
+	for (int iexp = 0; iexp < nexperiments; ++iexp)
+	{
+		const Benchmark::Experiment& experiment = experiments[iexp];
+		const int object_count = experiment.object_count;
+		const int update_count = (object_count * experiment.update_count) / 100;
+		//keep the density of the objects
+		const btScalar regionSize = btSqrt(btScalar(object_count) / 1024) * 200;
+		const btVector3 regionExtents(regionSize, 10, regionSize);
+		printf("Experiment #%u '%s': %u objects, %u moving, %u iterations\n", iexp, experiment.name, object_count, update_count, experiment.iterations);
+
+		for (int ibp = 0; ibp < 2; ++ibp)
+		{
+			btBroadphaseInterface* pbi = 0;
+			const char* name = 0;
+			switch (ibp)
+			{
+				case 0:
+					pbi = new btHashedGridBroadphase();
+					name = "btHashedGridBroadphase";
+					break;
+				default:
+					pbi = new btDbvtBroadphase();
+					name = "btDbvtBroadphase";
+					break;
+			}
+
+			btBroadphaseProxy* planet = pbi->createProxy(btVector3(-planetRadius, -planetRadius, -planetRadius), btVector3(planetRadius, planetRadius, planetRadius), 0, 0, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter, 0);
+
+			srand(180673);
+			objects.resize(object_count);
+			proxies.resize(object_count);
+			for (int i = 0; i < object_count; ++i)
+			{
+				Benchmark::Object& po = objects[i];
+				po.origin = regionOrigin + btVector3(Benchmark::UnitRand(), Benchmark::UnitRand(), Benchmark::UnitRand()) * regionExtents;
+				po.extents = btVector3(Benchmark::UnitRand(), Benchmark::UnitRand(), Benchmark::UnitRand()) * btScalar(0.5) + btVector3(0.5, 0.5, 0.5);
+				po.time = Benchmark::UnitRand() * 2000;
+				po.update(0, experiment.amplitude);
+				proxies[i] = pbi->createProxy(po.center - po.extents, po.center + po.extents, 0, &po, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter, 0);
+			}
+			Benchmark::run(pbi, name, experiment, objects, proxies);
+			pbi->destroyProxy(planet, 0);
+			delete pbi;
+		}
+	}
+}
+#else
+void btHashedGridBroadphase::benchmark()
+{
+}
+#endif
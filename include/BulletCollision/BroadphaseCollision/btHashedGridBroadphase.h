@@ -0,0 +1,159 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_HASHED_GRID_BROADPHASE_H
+#define BT_HASHED_GRID_BROADPHASE_H
+
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+//
+// Compile time config
+//
+
+#define HG_BP_ENABLE_BENCHMARK 0
+
+struct btHashedGridProxy : btBroadphaseProxy
+{
+	int m_proxyIndex;  //in btHashedGridBroadphase::m_proxies
+	int m_gridIndex;   //in the grid of the last update, -1 before
+
+	btHashedGridProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask), m_proxyIndex(-1), m_gridIndex(-1)
+	{
+	}
+};
+
+///The btHashedGridBroadphase hashes the proxies into a uniform grid of cubic cells, the CPU version of b3GpuGridBroadphase.
+///It suits many objects of a similar size, the grid is rebuilt in every calculateOverlappingPairs.
+///Each update:
+///  - picks the cell size from the sizes of the aabbs: twice the power of two that is at least as large as 90% of them,
+///    unless a fixed cell size was set. Points are left out, unless there are only points
+///  - moves proxies that would cover too many cells, like the ground or a planet, to a list of large proxies
+///  - counts the proxies per hash bucket and scatters them with atomic per-bucket counters in parallel,
+///    then sorts every bucket by proxy, so the result doesn't depend on the order of the threads
+///  - finds the pairs of every proxy in parallel, a pair is only reported in the first cell that both proxies cover.
+///    Large proxies are tested against all the others.
+///The pairs are added to the pair cache on the calling thread, pairs that stopped overlapping are removed.
+///rayTest and aabbTest only read the grid of the last calculateOverlappingPairs or updateGrid, so they can run concurrently.
+///Proxies created or moved since then are found in their old cells or not at all, destroyed proxies are skipped.
+class btHashedGridBroadphase : public btBroadphaseInterface
+{
+public:
+	struct CellRange
+	{
+		int m_min[3];
+		int m_max[3];
+		int m_numCells;  //0 for large proxies
+	};
+
+protected:
+	btAlignedObjectArray<btHashedGridProxy*> m_proxies;
+	btAlignedObjectArray<btHashedGridProxy*> m_gridProxies;  //m_proxies at the last update, destroyed proxies are 0 until the next one
+	btAlignedObjectArray<int> m_largeProxies;        //proxy indices
+	btAlignedObjectArray<CellRange> m_cellRanges;    //per proxy
+	btAlignedObjectArray<int> m_bucketStarts;        //m_numBuckets + 1 offsets into m_bucketEntries
+	btAlignedObjectArray<int> m_bucketCounters;
+	btAlignedObjectArray<int> m_bucketEntries;       //proxy indices, sorted in every bucket
+	btAlignedObjectArray<int> m_chunkCounts;
+	btAlignedObjectArray<btVector3> m_chunkBounds;
+	btAlignedObjectArray<btAlignedObjectArray<btBroadphasePair> > m_chunkPairs;
+
+	btOverlappingPairCache* m_paircache;
+	bool m_releasepaircache;
+	bool m_needsUpdate;
+	int m_uniqueIdCounter;
+	int m_numBuckets;
+	btScalar m_fixedCellSize;
+	btScalar m_cellSize;
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+
+	void update();
+	void findPairs(btDispatcher* dispatcher);
+	btScalar chooseCellSize();
+
+public:
+	///the cell size is chosen from the proxies in every update, unless a fixed cellSize is given
+	btHashedGridBroadphase(btScalar cellSize = btScalar(0), btOverlappingPairCache* paircache = 0);
+
+	virtual ~btHashedGridBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	///rebuilds the grid for rayTest and aabbTest when proxies changed since the last update, without updating the pairs
+	void updateGrid();
+
+	virtual btOverlappingPairCache* getOverlappingPairCache()
+	{
+		return m_paircache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const
+	{
+		return m_paircache;
+	}
+
+	///bounds of all proxies at the last update
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin = m_aabbMin;
+		aabbMax = m_aabbMax;
+	}
+
+	virtual void resetPool(btDispatcher* dispatcher);
+
+	virtual void printStats();
+
+	///0 chooses the cell size from the proxies in every update
+	void setFixedCellSize(btScalar cellSize)
+	{
+		m_fixedCellSize = cellSize;
+		m_needsUpdate = true;
+	}
+	btScalar getFixedCellSize() const
+	{
+		return m_fixedCellSize;
+	}
+
+	///cell size of the last update
+	btScalar getCellSize() const
+	{
+		return m_cellSize;
+	}
+
+	int getNumProxies() const
+	{
+		return m_proxies.size();
+	}
+
+	int getNumLargeProxies() const
+	{
+		return m_largeProxies.size();
+	}
+
+	///head to head with btDbvtBroadphase from 1k to 100k objects, see HG_BP_ENABLE_BENCHMARK
+	static void benchmark();
+};
+
+#endif  //BT_HASHED_GRID_BROADPHASE_H
@@ -0,0 +1,670 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btLinearBvhBroadphase.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btRadixSort.h"
+#include "LinearMath/btQuickprof.h"
+#include "btParallelBroadphaseUtil.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#if LBVH_BP_ENABLE_BENCHMARK
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btAxisSweep3.h"
+#endif
+
+#define LBVH_BP_GRAIN_SIZE 4096
+#define LBVH_BP_LEAVES_PER_CHUNK 256
+#define LBVH_BP_REFIT_SUBTREES 128
+
+static SIMD_FORCE_INLINE int btCountLeadingZeros64(unsigned long long v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	return _BitScanReverse64(&index, v) ? 63 - (int)index : 64;
+#elif defined(__GNUC__)
+	return v ? __builtin_clzll(v) : 64;
+#else
+	int n = 0;
+	for (unsigned long long bit = 1ull << 63; bit && !(v & bit); bit >>= 1)
+		n++;
+	return n;
+#endif
+}
+
+///spreads the low 21 bits of v to every third bit
+static SIMD_FORCE_INLINE unsigned long long btExpandBits21(unsigned long long v)
+{
+	v &= 0x1fffff;
+	v = (v | v << 32) & 0x1f00000000ffffull;
+	v = (v | v << 16) & 0x1f0000ff0000ffull;
+	v = (v | v << 8) & 0x100f00f00f00f00full;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+}
+
+struct btLbvhBoundsLoop : public btIParallelForBody
+{
+	btLinearBvhProxy* const* m_proxies;
+	btVector3* m_chunkBounds;
+	int m_numProxies;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			btVector3 centerMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+			btVector3 centerMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+			int end = btMin(m_numProxies, (chunk + 1) * LBVH_BP_GRAIN_SIZE);
+			for (int i = chunk * LBVH_BP_GRAIN_SIZE; i < end; i++)
+			{
+				btVector3 center = (m_proxies[i]->m_aabbMin + m_proxies[i]->m_aabbMax) * btScalar(0.5);
+				centerMin.setMin(center);
+				centerMax.setMax(center);
+			}
+			m_chunkBounds[chunk * 2] = centerMin;
+			m_chunkBounds[chunk * 2 + 1] = centerMax;
+		}
+	}
+};
+
+struct btLbvhCodeLoop : public btIParallelForBody
+{
+	btLinearBvhProxy* const* m_proxies;
+	btLinearBvhBroadphase::SortEntry* m_entries;
+	btVector3 m_centerMin;
+	btVector3 m_scale;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const btScalar maxCell = btScalar((1 << 21) - 1);
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			btVector3 center = (m_proxies[i]->m_aabbMin + m_proxies[i]->m_aabbMax) * btScalar(0.5);
+			btVector3 cell = (center - m_centerMin) * m_scale;
+			unsigned long long x = (unsigned long long)btMin(btMax(cell.x(), btScalar(0)), maxCell);
+			unsigned long long y = (unsigned long long)btMin(btMax(cell.y(), btScalar(0)), maxCell);
+			unsigned long long z = (unsigned long long)btMin(btMax(cell.z(), btScalar(0)), maxCell);
+
+			m_entries[i].m_code = (btExpandBits21(x) << 2) | (btExpandBits21(y) << 1) | btExpandBits21(z);
+			m_entries[i].m_proxyIndex = i;
+			m_entries[i].m_padding = 0;
+		}
+	}
+};
+
+struct btLbvhSortKey
+{
+	unsigned long long operator()(const btLinearBvhBroadphase::SortEntry& entry) const { return entry.m_code; }
+};
+
+struct btLbvhBuildLoop : public btIParallelForBody
+{
+	const btLinearBvhBroadphase::SortEntry* m_entries;
+	btLinearBvhBroadphase::Node* m_nodes;
+	int m_numLeaves;
+
+	///length of the common prefix of the keys of leaves i and j, equal codes are told apart by the leaf index
+	SIMD_FORCE_INLINE int delta(int i, int j) const
+	{
+		if (j < 0 || j >= m_numLeaves)
+			return -1;
+		unsigned long long codeI = m_entries[i].m_code;
+		unsigned long long codeJ = m_entries[j].m_code;
+		if (codeI == codeJ)
+			return 64 + btCountLeadingZeros64((unsigned long long)(unsigned int)(i ^ j)) - 32;
+		return btCountLeadingZeros64(codeI ^ codeJ);
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const int numInternal = m_numLeaves - 1;
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			//direction of the range of node i
+			int d = (delta(i, i + 1) - delta(i, i - 1)) >= 0 ? 1 : -1;
+			int deltaMin = delta(i, i - d);
+
+			//upper bound of the length of the range, then its exact length by binary search
+			int lengthMax = 2;
+			while (delta(i, i + lengthMax * d) > deltaMin)
+				lengthMax *= 2;
+			int length = 0;
+			for (int t = lengthMax / 2; t >= 1; t /= 2)
+			{
+				if (delta(i, i + (length + t) * d) > deltaMin)
+					length += t;
+			}
+			int j = i + length * d;
+
+			//split position by binary search on the common prefix of the range
+			int deltaNode = delta(i, j);
+			int split = 0;
+			int t = length;
+			do
+			{
+				t = (t + 1) >> 1;
+				if (delta(i, i + (split + t) * d) > deltaNode)
+					split += t;
+			} while (t > 1);
+			int gamma = i + split * d + btMin(d, 0);
+
+			btLinearBvhBroadphase::Node& node = m_nodes[i];
+			node.m_children[0] = (btMin(i, j) == gamma) ? numInternal + gamma : gamma;
+			node.m_children[1] = (btMax(i, j) == gamma + 1) ? numInternal + gamma + 1 : gamma + 1;
+			node.m_lastLeaf = btMax(i, j);
+		}
+	}
+};
+
+static void btRefitSubtree(btLinearBvhBroadphase::Node* nodes, int nodeIndex, int numInternal, btLinearBvhProxy* const* leaves)
+{
+	btLinearBvhBroadphase::Node& node = nodes[nodeIndex];
+	if (nodeIndex >= numInternal)
+	{
+		const btLinearBvhProxy* proxy = leaves[nodeIndex - numInternal];
+		node.m_aabbMin = proxy->m_aabbMin;
+		node.m_aabbMax = proxy->m_aabbMax;
+		return;
+	}
+
+	btRefitSubtree(nodes, node.m_children[0], numInternal, leaves);
+	btRefitSubtree(nodes, node.m_children[1], numInternal, leaves);
+	node.m_aabbMin = nodes[node.m_children[0]].m_aabbMin;
+	node.m_aabbMax = nodes[node.m_children[0]].m_aabbMax;
+	node.m_aabbMin.setMin(nodes[node.m_children[1]].m_aabbMin);
+	node.m_aabbMax.setMax(nodes[node.m_children[1]].m_aabbMax);
+}
+
+struct btLbvhRefitLoop : public btIParallelForBody
+{
+	btLinearBvhBroadphase::Node* m_nodes;
+	const int* m_roots;
+	btLinearBvhProxy* const* m_leaves;
+	int m_numInternal;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			btRefitSubtree(m_nodes, m_roots[i], m_numInternal, m_leaves);
+		}
+	}
+};
+
+struct btLbvhPairLoop : public btIParallelForBody
+{
+	const btLinearBvhBroadphase::Node* m_nodes;
+	btLinearBvhProxy* const* m_leaves;
+	btAlignedObjectArray<btBroadphasePair>* m_chunkPairs;
+	int m_numLeaves;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const int numInternal = m_numLeaves - 1;
+		btAlignedObjectArray<int> stack;
+		stack.reserve(128);
+
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			btAlignedObjectArray<btBroadphasePair>& pairs = m_chunkPairs[chunk];
+			pairs.resize(0);
+
+			int end = btMin(m_numLeaves, (chunk + 1) * LBVH_BP_LEAVES_PER_CHUNK);
+			for (int i = chunk * LBVH_BP_LEAVES_PER_CHUNK; i < end; i++)
+			{
+				btLinearBvhProxy* proxy = m_leaves[i];
+				stack.resize(0);
+				stack.push_back(0);
+				while (stack.size())
+				{
+					int nodeIndex = stack[stack.size() - 1];
+					stack.pop_back();
+					const btLinearBvhBroadphase::Node& node = m_nodes[nodeIndex];
+
+					//only the leaves after i, the others report the pair themselves
+					if (node.m_lastLeaf <= i)
+						continue;
+					if (!TestAabbAgainstAabb2(proxy->m_aabbMin, proxy->m_aabbMax, node.m_aabbMin, node.m_aabbMax))
+						continue;
+
+					if (nodeIndex >= numInternal)
+					{
+						btLinearBvhProxy* other = m_leaves[nodeIndex - numInternal];
+						if ((proxy->m_collisionFilterGroup & other->m_collisionFilterMask) &&
+							(other->m_collisionFilterGroup & proxy->m_collisionFilterMask))
+						{
+							pairs.push_back(btBroadphasePair(*proxy, *other));
+						}
+					}
+					else
+					{
+						stack.push_back(node.m_children[1]);
+						stack.push_back(node.m_children[0]);
+					}
+				}
+			}
+		}
+	}
+};
+
+btLinearBvhBroadphase::btLinearBvhBroadphase(const btVector3& worldAabbMin, const btVector3& worldAabbMax, btOverlappingPairCache* paircache)
+	: m_needsRebuild(true),
+	  m_uniqueIdCounter(0),
+	  m_worldAabbMin(worldAabbMin),
+	  m_worldAabbMax(worldAabbMax)
+{
+	m_releasepaircache = (paircache != 0) ? false : true;
+	m_paircache = paircache ? paircache : new (btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16)) btHashedOverlappingPairCache();
+}
+
+btLinearBvhBroadphase::~btLinearBvhBroadphase()
+{
+	for (int i = 0; i < m_proxies.size(); i++)
+	{
+		m_proxies[i]->~btLinearBvhProxy();
+		btAlignedFree(m_proxies[i]);
+	}
+
+	if (m_releasepaircache)
+	{
+		m_paircache->~btOverlappingPairCache();
+		btAlignedFree(m_paircache);
+	}
+}
+
+btBroadphaseProxy* btLinearBvhBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	btLinearBvhProxy* proxy = new (btAlignedAlloc(sizeof(btLinearBvhProxy), 16)) btLinearBvhProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = ++m_uniqueIdCounter;
+	proxy->m_proxyIndex = m_proxies.size();
+	m_proxies.push_back(proxy);
+	m_needsRebuild = true;
+	return proxy;
+}
+
+void btLinearBvhBroadphase::destroyProxy(btBroadphaseProxy* absproxy, btDispatcher* dispatcher)
+{
+	btLinearBvhProxy* proxy = (btLinearBvhProxy*)absproxy;
+	m_paircache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+	//the queries skip it until the next rebuild
+	if (proxy->m_leafIndex >= 0)
+	{
+		m_sortedProxies[proxy->m_leafIndex] = 0;
+	}
+
+	int index = proxy->m_proxyIndex;
+	m_proxies[index] = m_proxies[m_proxies.size() - 1];
+	m_proxies[index]->m_proxyIndex = index;
+	m_proxies.pop_back();
+
+	proxy->~btLinearBvhProxy();
+	btAlignedFree(proxy);
+	m_needsRebuild = true;
+}
+
+void btLinearBvhBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	m_needsRebuild = true;
+}
+
+void btLinearBvhBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void btLinearBvhBroadphase::buildTree()
+{
+	BT_PROFILE("btLinearBvhBroadphase::buildTree");
+	const int numLeaves = m_proxies.size();
+	m_needsRebuild = false;
+	if (!numLeaves)
+	{
+		m_sortedProxies.resize(0);
+		m_nodes.resize(0);
+		return;
+	}
+
+	//bounds of the centers, the codes use the full resolution for the populated region
+	int numChunks = (numLeaves + LBVH_BP_GRAIN_SIZE - 1) / LBVH_BP_GRAIN_SIZE;
+	m_chunkBounds.resize(numChunks * 2);
+	btLbvhBoundsLoop boundsLoop;
+	boundsLoop.m_proxies = &m_proxies[0];
+	boundsLoop.m_chunkBounds = &m_chunkBounds[0];
+	boundsLoop.m_numProxies = numLeaves;
+	btParallelFor(0, numChunks, 1, boundsLoop);
+
+	btVector3 centerMin = m_chunkBounds[0];
+	btVector3 centerMax = m_chunkBounds[1];
+	for (int chunk = 1; chunk < numChunks; chunk++)
+	{
+		centerMin.setMin(m_chunkBounds[chunk * 2]);
+		centerMax.setMax(m_chunkBounds[chunk * 2 + 1]);
+	}
+
+	btVector3 extents = centerMax - centerMin;
+	btVector3 scale;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		scale[axis] = extents[axis] > btScalar(0) ? btScalar((1 << 21) - 1) / extents[axis] : btScalar(0);
+	}
+
+	m_sortEntries.resizeNoInitialize(numLeaves);
+	btLbvhCodeLoop codeLoop;
+	codeLoop.m_proxies = &m_proxies[0];
+	codeLoop.m_entries = &m_sortEntries[0];
+	codeLoop.m_centerMin = centerMin;
+	codeLoop.m_scale = scale;
+	btParallelFor(0, numLeaves, LBVH_BP_GRAIN_SIZE, codeLoop);
+
+	{
+		BT_PROFILE("sort");
+		//the entries start in proxy order, so equal codes stay ordered by proxy
+		btRadixSort(m_sortEntries, m_sortBuffer, m_sortHistograms, btLbvhSortKey(), 63, LBVH_BP_GRAIN_SIZE);
+	}
+
+	m_sortedProxies.resizeNoInitialize(numLeaves);
+	for (int i = 0; i < numLeaves; i++)
+	{
+		m_sortedProxies[i] = m_proxies[m_sortEntries[i].m_proxyIndex];
+		m_sortedProxies[i]->m_leafIndex = i;
+	}
+
+	//numLeaves - 1 internal nodes followed by the leaves, a single leaf is the root
+	m_nodes.resizeNoInitialize(2 * numLeaves - 1);
+	for (int i = 0; i < numLeaves; i++)
+	{
+		Node& leaf = m_nodes[numLeaves - 1 + i];
+		leaf.m_children[0] = leaf.m_children[1] = -1;
+		leaf.m_lastLeaf = i;
+	}
+
+	btLbvhBuildLoop buildLoop;
+	buildLoop.m_entries = &m_sortEntries[0];
+	buildLoop.m_nodes = &m_nodes[0];
+	buildLoop.m_numLeaves = numLeaves;
+	btParallelFor(0, numLeaves - 1, LBVH_BP_GRAIN_SIZE / 4, buildLoop);
+}
+
+void btLinearBvhBroadphase::refit()
+{
+	BT_PROFILE("btLinearBvhBroadphase::refit");
+	const int numLeaves = m_sortedProxies.size();
+	if (!numLeaves)
+		return;
+	const int numInternal = numLeaves - 1;
+
+	//expand the top of the tree level by level until there are enough subtrees for the threads
+	m_refitTop.resize(0);
+	m_refitRoots.resize(0);
+	m_refitRoots.push_back(0);
+	int begin = 0;
+	while (m_refitRoots.size() - begin < LBVH_BP_REFIT_SUBTREES)
+	{
+		int end = m_refitRoots.size();
+		bool expanded = false;
+		for (int i = begin; i < end; i++)
+		{
+			int nodeIndex = m_refitRoots[i];
+			if (nodeIndex < numInternal)
+			{
+				m_refitTop.push_back(nodeIndex);
+				m_refitRoots.push_back(m_nodes[nodeIndex].m_children[0]);
+				m_refitRoots.push_back(m_nodes[nodeIndex].m_children[1]);
+				expanded = true;
+			}
+			else
+			{
+				m_refitRoots.push_back(nodeIndex);
+			}
+		}
+		begin = end;
+		if (!expanded)
+			break;
+	}
+
+	btLbvhRefitLoop refitLoop;
+	refitLoop.m_nodes = &m_nodes[0];
+	refitLoop.m_roots = &m_refitRoots[begin];
+	refitLoop.m_leaves = &m_sortedProxies[0];
+	refitLoop.m_numInternal = numInternal;
+	btParallelFor(0, m_refitRoots.size() - begin, 1, refitLoop);
+
+	//children before parents
+	for (int i = m_refitTop.size() - 1; i >= 0; i--)
+	{
+		Node& node = m_nodes[m_refitTop[i]];
+		node.m_aabbMin = m_nodes[node.m_children[0]].m_aabbMin;
+		node.m_aabbMax = m_nodes[node.m_children[0]].m_aabbMax;
+		node.m_aabbMin.setMin(m_nodes[node.m_children[1]].m_aabbMin);
+		node.m_aabbMax.setMax(m_nodes[node.m_children[1]].m_aabbMax);
+	}
+}
+
+void btLinearBvhBroadphase::findPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btLinearBvhBroadphase::findPairs");
+
+	btRemoveSeparatedPairs(m_paircache, dispatcher);
+
+	const int numLeaves = m_sortedProxies.size();
+	if (numLeaves < 2)
+		return;
+
+	int numChunks = (numLeaves + LBVH_BP_LEAVES_PER_CHUNK - 1) / LBVH_BP_LEAVES_PER_CHUNK;
+	if (m_chunkPairs.size() < numChunks)
+		m_chunkPairs.resize(numChunks);
+
+	btLbvhPairLoop pairLoop;
+	pairLoop.m_nodes = &m_nodes[0];
+	pairLoop.m_leaves = &m_sortedProxies[0];
+	pairLoop.m_chunkPairs = &m_chunkPairs[0];
+	pairLoop.m_numLeaves = numLeaves;
+	btParallelFor(0, numChunks, 1, pairLoop);
+
+	btAddChunkPairs(m_paircache, m_chunkPairs, numChunks);
+}
+
+void btLinearBvhBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btLinearBvhBroadphase::calculateOverlappingPairs");
+	updateTree();
+	findPairs(dispatcher);
+}
+
+void btLinearBvhBroadphase::updateTree()
+{
+	if (m_needsRebuild)
+	{
+		buildTree();
+		refit();
+	}
+}
+
+void btLinearBvhBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	(void)rayTo;
+	if (!m_nodes.size())
+		return;
+
+	const int numInternal = m_sortedProxies.size() - 1;
+	btAlignedObjectArray<int> stack;
+	stack.reserve(128);
+	stack.push_back(0);
+	while (stack.size())
+	{
+		int nodeIndex = stack[stack.size() - 1];
+		stack.pop_back();
+		const Node& node = m_nodes[nodeIndex];
+
+		if (!btRayTestSweptBounds(rayFrom, rayCallback, node.m_aabbMin, node.m_aabbMax, aabbMin, aabbMax))
+			continue;
+
+		if (nodeIndex >= numInternal)
+		{
+			btLinearBvhProxy* proxy = m_sortedProxies[nodeIndex - numInternal];
+			if (proxy)
+				rayCallback.process(proxy);
+		}
+		else
+		{
+			stack.push_back(node.m_children[1]);
+			stack.push_back(node.m_children[0]);
+		}
+	}
+}
+
+void btLinearBvhBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	if (!m_nodes.size())
+		return;
+
+	const int numInternal = m_sortedProxies.size() - 1;
+	btAlignedObjectArray<int> stack;
+	stack.reserve(128);
+	stack.push_back(0);
+	while (stack.size())
+	{
+		int nodeIndex = stack[stack.size() - 1];
+		stack.pop_back();
+		const Node& node = m_nodes[nodeIndex];
+		if (!TestAabbAgainstAabb2(aabbMin, aabbMax, node.m_aabbMin, node.m_aabbMax))
+			continue;
+
+		if (nodeIndex >= numInternal)
+		{
+			btLinearBvhProxy* proxy = m_sortedProxies[nodeIndex - numInternal];
+			if (proxy)
+				callback.process(proxy);
+		}
+		else
+		{
+			stack.push_back(node.m_children[1]);
+			stack.push_back(node.m_children[0]);
+		}
+	}
+}
+
+void btLinearBvhBroadphase::resetPool(btDispatcher* /*dispatcher*/)
+{
+	if (!m_proxies.size())
+	{
+		m_sortEntries.clear();
+		m_sortBuffer.clear();
+		m_sortHistograms.clear();
+		m_sortedProxies.clear();
+		m_nodes.clear();
+		m_refitTop.clear();
+		m_refitRoots.clear();
+		m_chunkBounds.clear();
+		m_chunkPairs.clear();
+		m_uniqueIdCounter = 0;
+		m_needsRebuild = true;
+	}
+}
+
+void btLinearBvhBroadphase::printStats()
+{
+	printf("btLinearBvhBroadphase.numProxies = %d\n", m_proxies.size());
+	printf("btLinearBvhBroadphase.numNodes = %d\n", m_nodes.size());
+	printf("btLinearBvhBroadphase.numPairs = %d\n", m_paircache->getNumOverlappingPairs());
+}
+
+//
+#if LBVH_BP_ENABLE_BENCHMARK
+
+void btLinearBvhBroadphase::benchmark()
+{
+	typedef btParallelBroadphaseBenchmark Benchmark;
+
+	//the region is far from the origin, like a spawn area on the surface of a planet
+	static const Benchmark::Experiment experiments[] =
+		{
+			{"1024o.90%", 1024, 90, 512, (btScalar)0.005, (btScalar)2},
+			{"8192o.90%", 8192, 90, 128, (btScalar)0.005, (btScalar)2},
+			{"32768o.90%", 32768, 90, 32, (btScalar)0.005, (btScalar)2},
+			{"32768o.10%", 32768, 10, 32, (btScalar)0.005, (btScalar)2},
+		};
+	static const int nexperiments = sizeof(experiments) / sizeof(experiments[0]);
+	const btScalar planetRadius = (btScalar)6360000;
+	const btVector3 regionOrigin(0, planetRadius, 0);
+	const btVector3 worldMin(-planetRadius * 2, -planetRadius * 2, -planetRadius * 2);
+	const btVector3 worldMax(planetRadius * 2, planetRadius * 2, planetRadius * 2);
+
+	btAlignedObjectArray<Benchmark::Object> objects;
+	btAlignedObjectArray<btBroadphaseProxy*> proxies;
+	for (int iexp = 0; iexp < nexperiments; ++iexp)
+	{
+		const Benchmark::Experiment& experiment = experiments[iexp];
+		const int object_count = experiment.object_count;
+		const int update_count = (object_count * experiment.update_count) / 100;
+		//keep the density of the objects
+		const btScalar regionSize = btPow(btScalar(object_count) / 1024, btScalar(1) / 3) * 50;
+		printf("Experiment #%u '%s': %u objects, %u moving, %u iterations\n", iexp, experiment.name, object_count, update_count, experiment.iterations);
+
+		for (int ibp = 0; ibp < 3; ++ibp)
+		{
+			btBroadphaseInterface* pbi = 0;
+			const char* name = 0;
+			switch (ibp)
+			{
+				case 0:
+					pbi = new btLinearBvhBroadphase(worldMin, worldMax);
+					name = "btLinearBvhBroadphase";
+					break;
+				case 1:
+					pbi = new btDbvtBroadphase();
+					name = "btDbvtBroadphase";
+					break;
+				default:
+					pbi = new bt32BitAxisSweep3(regionOrigin - btVector3(regionSize, regionSize, regionSize) * 2, regionOrigin + btVector3(regionSize, regionSize, regionSize) * 2, object_count + 1);
+					name = "bt32BitAxisSweep3";
+					break;
+			}
+
+			srand(180673);
+			objects.resize(object_count);
+			proxies.resize(object_count);
+			for (int i = 0; i < object_count; ++i)
+			{
+				Benchmark::Object& po = objects[i];
+				po.origin = regionOrigin + btVector3(Benchmark::UnitRand(), Benchmark::UnitRand(), Benchmark::UnitRand()) * regionSize;
+				po.extents = btVector3(Benchmark::UnitRand(), Benchmark::UnitRand(), Benchmark::UnitRand()) * btScalar(0.5) + btVector3(0.5, 0.5, 0.5);
+				po.time = Benchmark::UnitRand() * 2000;
+				po.update(0, experiment.amplitude);
+				proxies[i] = pbi->createProxy(po.center - po.extents, po.center + po.extents, 0, &po, 1, 1, 0);
+			}
+			Benchmark::run(pbi, name, experiment, objects, proxies);
+			delete pbi;
+		}
+	}
+}
+#else
+void btLinearBvhBroadphase::benchmark()
+{
+}
+#endif
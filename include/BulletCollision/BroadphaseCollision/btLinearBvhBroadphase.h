@@ -0,0 +1,148 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_LINEAR_BVH_BROADPHASE_H
+#define BT_LINEAR_BVH_BROADPHASE_H
+
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+//
+// Compile time config
+//
+
+#define LBVH_BP_ENABLE_BENCHMARK 0
+
+struct btLinearBvhProxy : btBroadphaseProxy
+{
+	int m_proxyIndex;  //in btLinearBvhBroadphase::m_proxies
+	int m_leafIndex;   //in the hierarchy of the last rebuild, -1 before
+
+	btLinearBvhProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask), m_proxyIndex(-1), m_leafIndex(-1)
+	{
+	}
+};
+
+///The btLinearBvhBroadphase rebuilds a linear bounding volume hierarchy (LBVH) of all proxies in every calculateOverlappingPairs after proxies changed,
+///the CPU version of b3GpuParallelLinearBvhBroadphase. When most objects move, for example in scenes that spawn many bodies,
+///a full parallel rebuild can be cheaper than the incremental updates of btDbvtBroadphase.
+///Each rebuild:
+///  - computes 63 bit Morton codes of the aabb centers, quantized to the bounds of all centers, so the resolution does not depend on
+///    the world size (large, planet centred worlds keep 21 bits per axis for the region that is populated)
+///  - sorts them with a parallel radix sort, ties are ordered by proxy, so the order is deterministic
+///  - builds the hierarchy of Karras (Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees, 2012) in parallel
+///  - refits the node bounds, the subtrees below the top of the tree in parallel
+///  - finds the pairs with one parallel traversal per leaf, each leaf only tests the leaves after it in Morton order
+///The pairs are added to the pair cache in sorted order on the calling thread, pairs that stopped overlapping are removed.
+///All loops run with btParallelFor, the pairs don't depend on the number of threads.
+///rayTest and aabbTest only read the hierarchy of the last calculateOverlappingPairs or updateTree, so they can run concurrently.
+///Proxies created or moved since then are found at their old bounds or not at all, destroyed proxies are skipped.
+class btLinearBvhBroadphase : public btBroadphaseInterface
+{
+public:
+	struct Node
+	{
+		btVector3 m_aabbMin;
+		btVector3 m_aabbMax;
+		int m_children[2];  //node indices, leaf i is node numLeaves - 1 + i
+		int m_lastLeaf;     //largest leaf index of the subtree
+	};
+
+	struct SortEntry
+	{
+		unsigned long long m_code;
+		int m_proxyIndex;
+		int m_padding;
+	};
+
+protected:
+	btAlignedObjectArray<btLinearBvhProxy*> m_proxies;
+	btAlignedObjectArray<SortEntry> m_sortEntries;
+	btAlignedObjectArray<SortEntry> m_sortBuffer;
+	btAlignedObjectArray<unsigned int> m_sortHistograms;
+	btAlignedObjectArray<btLinearBvhProxy*> m_sortedProxies;  //the leaves
+	btAlignedObjectArray<Node> m_nodes;                       //internal nodes first, node 0 is the root
+	btAlignedObjectArray<int> m_refitTop;    //nodes above m_refitRoots, in breadth first order
+	btAlignedObjectArray<int> m_refitRoots;  //subtrees refitted in parallel
+	btAlignedObjectArray<btVector3> m_chunkBounds;
+	btAlignedObjectArray<btAlignedObjectArray<btBroadphasePair> > m_chunkPairs;
+
+	btOverlappingPairCache* m_paircache;
+	bool m_releasepaircache;
+	bool m_needsRebuild;
+	int m_uniqueIdCounter;
+	btVector3 m_worldAabbMin;
+	btVector3 m_worldAabbMax;
+
+	void buildTree();
+	void refit();
+	void findPairs(btDispatcher* dispatcher);
+
+public:
+	///worldAabbMin/Max are only reported by getBroadphaseAabb, the codes are quantized to the bounds of the proxies
+	btLinearBvhBroadphase(const btVector3& worldAabbMin, const btVector3& worldAabbMax, btOverlappingPairCache* paircache = 0);
+
+	virtual ~btLinearBvhBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	///rebuilds the hierarchy for rayTest and aabbTest when proxies changed since the last rebuild, without updating the pairs
+	void updateTree();
+
+	virtual btOverlappingPairCache* getOverlappingPairCache()
+	{
+		return m_paircache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const
+	{
+		return m_paircache;
+	}
+
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin = m_worldAabbMin;
+		aabbMax = m_worldAabbMax;
+	}
+
+	virtual void resetPool(btDispatcher* dispatcher);
+
+	virtual void printStats();
+
+	int getNumProxies() const
+	{
+		return m_proxies.size();
+	}
+
+	///nodes of the last rebuild
+	const btAlignedObjectArray<Node>& getNodes() const
+	{
+		return m_nodes;
+	}
+
+	///head to head with btDbvtBroadphase and btAxisSweep3 on scenes where most objects move, see LBVH_BP_ENABLE_BENCHMARK
+	static void benchmark();
+};
+
+#endif  //BT_LINEAR_BVH_BROADPHASE_H
@@ -171,6 +171,38 @@ void btHashedOverlappingPairCache::growTables()
 	}
 }
 
+void btHashedOverlappingPairCache::rebuildHashTable()
+{
+	//the hash mask needs a power of two capacity, like the one growTables maintains
+	int capacity = 2;
+	while (capacity < m_overlappingPairArray.capacity())
+	{
+		capacity <<= 1;
+	}
+	m_overlappingPairArray.reserve(capacity);
+
+	m_hashTable.resize(capacity);
+	m_next.resize(capacity);
+
+	int i;
+
+	for (i = 0; i < capacity; ++i)
+	{
+		m_hashTable[i] = BT_NULL_PAIR;
+		m_next[i] = BT_NULL_PAIR;
+	}
+
+	for (i = 0; i < m_overlappingPairArray.size(); i++)
+	{
+		const btBroadphasePair& pair = m_overlappingPairArray[i];
+		int proxyId1 = pair.m_pProxy0->getUid();
+		int proxyId2 = pair.m_pProxy1->getUid();
+		int hashValue = static_cast<int>(getHash(static_cast<unsigned int>(proxyId1), static_cast<unsigned int>(proxyId2)) & (capacity - 1));
+		m_next[i] = m_hashTable[hashValue];
+		m_hashTable[hashValue] = i;
+	}
+}
+
 btBroadphasePair* btHashedOverlappingPairCache::internalAddPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
 {
 	if (proxy0->m_uniqueId > proxy1->m_uniqueId)
@@ -174,6 +174,9 @@ public:
 		return m_overlappingPairArray.size();
 	}
 
+	///rebuildHashTable recomputes the hash table after the pair array was overwritten in place, for example by a checkpoint restore
+	void rebuildHashTable();
+
 private:
 	btBroadphasePair* internalAddPair(btBroadphaseProxy * proxy0, btBroadphaseProxy * proxy1);
 
@@ -0,0 +1,72 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btParallelBroadphaseUtil.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <stdio.h>
+
+void btRemoveSeparatedPairs(btOverlappingPairCache* paircache, btDispatcher* dispatcher)
+{
+	btBroadphasePairArray& cachedPairs = paircache->getOverlappingPairArray();
+	for (int i = 0; i < cachedPairs.size(); i++)
+	{
+		btBroadphasePair& pair = cachedPairs[i];
+		if (!TestAabbAgainstAabb2(pair.m_pProxy0->m_aabbMin, pair.m_pProxy0->m_aabbMax, pair.m_pProxy1->m_aabbMin, pair.m_pProxy1->m_aabbMax))
+		{
+			//the last pair is moved to i
+			paircache->removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+			--i;
+		}
+	}
+}
+
+void btAddChunkPairs(btOverlappingPairCache* paircache, const btAlignedObjectArray<btAlignedObjectArray<btBroadphasePair> >& chunkPairs, int numChunks)
+{
+	btAssert(numChunks <= chunkPairs.size());
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		const btAlignedObjectArray<btBroadphasePair>& pairs = chunkPairs[chunk];
+		for (int i = 0; i < pairs.size(); i++)
+		{
+			paircache->addOverlappingPair(pairs[i].m_pProxy0, pairs[i].m_pProxy1);
+		}
+	}
+}
+
+void btParallelBroadphaseBenchmark::run(btBroadphaseInterface* pbi, const char* name, const Experiment& experiment, btAlignedObjectArray<Object>& objects, btAlignedObjectArray<btBroadphaseProxy*>& proxies)
+{
+	const int update_count = (experiment.object_count * experiment.update_count) / 100;
+	pbi->calculateOverlappingPairs(0);
+
+	btClock wallclock;
+	for (int it = 0; it < experiment.iterations; ++it)
+	{
+		for (int j = 0; j < update_count; ++j)
+		{
+			Object& po = objects[j];
+			po.update(experiment.speed, experiment.amplitude);
+			pbi->setAabb(proxies[j], po.center - po.extents, po.center + po.extents, 0);
+		}
+		pbi->calculateOverlappingPairs(0);
+	}
+	const unsigned long us = wallclock.getTimeMicroseconds();
+	printf("\t%-24s: %8lu us, %8.1f us/update, %d pairs\n", name, us, us / (double)experiment.iterations, pbi->getOverlappingPairCache()->getNumOverlappingPairs());
+
+	for (int i = 0; i < proxies.size(); ++i)
+	{
+		pbi->destroyProxy(proxies[i], 0);
+	}
+}
@@ -0,0 +1,114 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_PARALLEL_BROADPHASE_UTIL_H
+#define BT_PARALLEL_BROADPHASE_UTIL_H
+
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btAabbUtil2.h"
+
+///Pair bookkeeping shared by btHashedGridBroadphase, btParallelSapBroadphase and btLinearBvhBroadphase.
+///They find the pairs of an update in parallel, each chunk of proxies into its own array, and then merge them into the pair cache on the calling thread.
+
+///removes the pairs of the cache whose aabbs stopped overlapping
+void btRemoveSeparatedPairs(btOverlappingPairCache* paircache, btDispatcher* dispatcher);
+
+///adds the pairs of the first numChunks chunks in chunk order, so the cache doesn't depend on the number of threads.
+///Pairs that already exist are found by the cache.
+void btAddChunkPairs(btOverlappingPairCache* paircache, const btAlignedObjectArray<btAlignedObjectArray<btBroadphasePair> >& chunkPairs, int numChunks);
+
+///rayTest of the broadphases: the bounds are grown by the aabb of the swept shape
+SIMD_FORCE_INLINE bool btRayTestSweptBounds(const btVector3& rayFrom, const btBroadphaseRayCallback& rayCallback, const btVector3& boundsMin, const btVector3& boundsMax, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	btVector3 bounds[2];
+	bounds[0] = boundsMin - aabbMax;
+	bounds[1] = boundsMax - aabbMin;
+	btScalar tmin = btScalar(1);
+	return btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, tmin, btScalar(0), rayCallback.m_lambda_max);
+}
+
+///runs a rayTest as an aabbTest of the aabb around the swept ray, the proxies that the ray misses are not reported
+struct btBroadphaseRayAabbCallback : public btBroadphaseAabbCallback
+{
+	btBroadphaseRayCallback& m_rayCallback;
+	btVector3 m_rayFrom;
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+
+	btBroadphaseRayAabbCallback(btBroadphaseRayCallback& rayCallback, const btVector3& rayFrom, const btVector3& aabbMin, const btVector3& aabbMax)
+		: m_rayCallback(rayCallback),
+		  m_rayFrom(rayFrom),
+		  m_aabbMin(aabbMin),
+		  m_aabbMax(aabbMax)
+	{
+	}
+
+	///the aabb to pass to aabbTest
+	void getQueryAabb(const btVector3& rayTo, btVector3& queryMin, btVector3& queryMax) const
+	{
+		queryMin = m_rayFrom;
+		queryMax = m_rayFrom;
+		queryMin.setMin(rayTo);
+		queryMax.setMax(rayTo);
+		queryMin += m_aabbMin;
+		queryMax += m_aabbMax;
+	}
+
+	virtual bool process(const btBroadphaseProxy* proxy)
+	{
+		if (btRayTestSweptBounds(m_rayFrom, m_rayCallback, proxy->m_aabbMin, proxy->m_aabbMax, m_aabbMin, m_aabbMax))
+		{
+			return m_rayCallback.process(proxy);
+		}
+		return true;
+	}
+};
+
+///the scenes of the benchmarks of the broadphases above: objects of similar size that oscillate around their origin
+struct btParallelBroadphaseBenchmark
+{
+	struct Experiment
+	{
+		const char* name;
+		int object_count;
+		int update_count;  //percent of the objects that move every iteration
+		int iterations;
+		btScalar speed;
+		btScalar amplitude;
+	};
+	struct Object
+	{
+		btVector3 origin;
+		btVector3 center;
+		btVector3 extents;
+		btScalar time;
+		void update(btScalar speed, btScalar amplitude)
+		{
+			time += speed;
+			center[0] = origin[0] + btCos(time * (btScalar)2.17) * amplitude + btSin(time) * amplitude / 2;
+			center[1] = origin[1] + btCos(time * (btScalar)1.38) * amplitude + btSin(time) * amplitude;
+			center[2] = origin[2] + btSin(time * (btScalar)0.777) * amplitude;
+		}
+	};
+	static int UnsignedRand(int range = RAND_MAX - 1) { return (rand() % (range + 1)); }
+	static btScalar UnitRand() { return (UnsignedRand(16384) / (btScalar)16384); }
+
+	///moves the first objects of the experiment in every iteration and prints the time of the updates, then destroys the proxies
+	static void run(btBroadphaseInterface* pbi, const char* name, const Experiment& experiment, btAlignedObjectArray<Object>& objects, btAlignedObjectArray<btBroadphaseProxy*>& proxies);
+};
+
+#endif  //BT_PARALLEL_BROADPHASE_UTIL_H
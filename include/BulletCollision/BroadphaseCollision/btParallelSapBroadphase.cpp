@@ -0,0 +1,624 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btParallelSapBroadphase.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btRadixSort.h"
+#include "LinearMath/btQuickprof.h"
+#include "btParallelBroadphaseUtil.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#if defined(BT_USE_SSE) || defined(__SSE2__) || defined(_M_X64)
+#define SAP_BP_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#if SAP_BP_ENABLE_BENCHMARK
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btAxisSweep3.h"
+#include "BulletCollision/BroadphaseCollision/btLinearBvhBroadphase.h"
+#endif
+
+#define SAP_BP_GRAIN_SIZE 4096
+#define SAP_BP_PROXIES_PER_CHUNK 256
+//another axis is only chosen when its variance is this much larger, every change of the axis needs a full sort
+#define SAP_BP_AXIS_HYSTERESIS 1.5f
+//the insertion sort gives up after this many moves per proxy
+#define SAP_BP_INSERTION_SORT_MOVES 1
+
+///the same rounding for all bounds keeps the float order consistent with the btScalar order
+static SIMD_FORCE_INLINE float btSapLocal(btScalar value, btScalar origin)
+{
+	return float(value - origin);
+}
+
+///unsigned key with the order of the floats
+static SIMD_FORCE_INLINE unsigned int btSapFloatFlip(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int mask = (unsigned int)(-(int)(bits >> 31)) | 0x80000000;
+	return bits ^ mask;
+}
+
+struct btSapStatsLoop : public btIParallelForBody
+{
+	btParallelSapProxy* const* m_proxies;
+	btVector3* m_chunkStats;
+	btVector3 m_reference;
+	int m_numProxies;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			btVector3 sum(0, 0, 0);
+			btVector3 sum2(0, 0, 0);
+			btVector3 aabbMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+			btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+			int end = btMin(m_numProxies, (chunk + 1) * SAP_BP_GRAIN_SIZE);
+			for (int i = chunk * SAP_BP_GRAIN_SIZE; i < end; i++)
+			{
+				//relative to a reference center, the sums of squares stay accurate far from the origin
+				btVector3 center = (m_proxies[i]->m_aabbMin + m_proxies[i]->m_aabbMax) * btScalar(0.5) - m_reference;
+				sum += center;
+				sum2 += center * center;
+				aabbMin.setMin(m_proxies[i]->m_aabbMin);
+				aabbMax.setMax(m_proxies[i]->m_aabbMax);
+			}
+			m_chunkStats[chunk * 4] = sum;
+			m_chunkStats[chunk * 4 + 1] = sum2;
+			m_chunkStats[chunk * 4 + 2] = aabbMin;
+			m_chunkStats[chunk * 4 + 3] = aabbMax;
+		}
+	}
+};
+
+struct btSapKeyLoop : public btIParallelForBody
+{
+	btParallelSapProxy* const* m_proxies;
+	btParallelSapBroadphase::SortEntry* m_entries;
+	btScalar m_origin;
+	int m_axis;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			m_entries[i].m_key = btSapFloatFlip(btSapLocal(m_proxies[i]->m_aabbMin[m_axis], m_origin));
+			m_entries[i].m_index = i;
+		}
+	}
+};
+
+struct btSapSortKey
+{
+	unsigned long long operator()(const btParallelSapBroadphase::SortEntry& entry) const { return entry.m_key; }
+};
+
+struct btSapGatherLoop : public btIParallelForBody
+{
+	const btParallelSapBroadphase::SortEntry* m_entries;
+	btParallelSapProxy* const* m_src;
+	btParallelSapProxy** m_dst;
+	float* m_soaMin[3];
+	float* m_soaMax[3];
+	btVector3 m_origin;
+	int m_axes[3];
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			btParallelSapProxy* proxy = m_src[m_entries[i].m_index];
+			proxy->m_sortedIndex = i;
+			m_dst[i] = proxy;
+			for (int k = 0; k < 3; k++)
+			{
+				int axis = m_axes[k];
+				m_soaMin[k][i] = btSapLocal(proxy->m_aabbMin[axis], m_origin[axis]);
+				m_soaMax[k][i] = btSapLocal(proxy->m_aabbMax[axis], m_origin[axis]);
+			}
+		}
+	}
+};
+
+struct btSapPairLoop : public btIParallelForBody
+{
+	btParallelSapProxy* const* m_proxies;
+	const float* m_soaMin[3];
+	const float* m_soaMax[3];
+	btAlignedObjectArray<btBroadphasePair>* m_chunkPairs;
+	int m_numProxies;
+
+	void addPair(btAlignedObjectArray<btBroadphasePair>& pairs, btParallelSapProxy* proxy, int j) const
+	{
+		btParallelSapProxy* other = m_proxies[j];
+		if (TestAabbAgainstAabb2(proxy->m_aabbMin, proxy->m_aabbMax, other->m_aabbMin, other->m_aabbMax) &&
+			(proxy->m_collisionFilterGroup & other->m_collisionFilterMask) &&
+			(other->m_collisionFilterGroup & proxy->m_collisionFilterMask))
+		{
+			pairs.push_back(btBroadphasePair(*proxy, *other));
+		}
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		const int n = m_numProxies;
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			btAlignedObjectArray<btBroadphasePair>& pairs = m_chunkPairs[chunk];
+			pairs.resize(0);
+
+			int end = btMin(n, (chunk + 1) * SAP_BP_PROXIES_PER_CHUNK);
+			for (int i = chunk * SAP_BP_PROXIES_PER_CHUNK; i < end; i++)
+			{
+				btParallelSapProxy* proxy = m_proxies[i];
+#ifdef SAP_BP_USE_SSE
+				const __m128 sweepMax = _mm_set1_ps(m_soaMax[0][i]);
+				const __m128 min1 = _mm_set1_ps(m_soaMin[1][i]);
+				const __m128 max1 = _mm_set1_ps(m_soaMax[1][i]);
+				const __m128 min2 = _mm_set1_ps(m_soaMin[2][i]);
+				const __m128 max2 = _mm_set1_ps(m_soaMax[2][i]);
+				//the arrays are padded, the lanes past the end are masked
+				for (int j = i + 1; j < n; j += 4)
+				{
+					int inRange = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&m_soaMin[0][j]), sweepMax));
+					if (n - j < 4)
+						inRange &= (1 << (n - j)) - 1;
+					//sorted by the minimum, nothing after the first proxy that starts past our maximum overlaps
+					if (!inRange)
+						break;
+
+					__m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&m_soaMin[1][j]), max1), _mm_cmpge_ps(_mm_loadu_ps(&m_soaMax[1][j]), min1));
+					overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&m_soaMin[2][j]), max2), _mm_cmpge_ps(_mm_loadu_ps(&m_soaMax[2][j]), min2)));
+					int mask = inRange & _mm_movemask_ps(overlap);
+					for (int k = 0; mask; k++, mask >>= 1)
+					{
+						if (mask & 1)
+							addPair(pairs, proxy, j + k);
+					}
+				}
+#else
+				const float sweepMax = m_soaMax[0][i];
+				for (int j = i + 1; j < n && m_soaMin[0][j] <= sweepMax; j++)
+				{
+					if (m_soaMin[1][j] <= m_soaMax[1][i] && m_soaMax[1][j] >= m_soaMin[1][i] &&
+						m_soaMin[2][j] <= m_soaMax[2][i] && m_soaMax[2][j] >= m_soaMin[2][i])
+					{
+						addPair(pairs, proxy, j);
+					}
+				}
+#endif
+			}
+		}
+	}
+};
+
+btParallelSapBroadphase::btParallelSapBroadphase(btOverlappingPairCache* paircache)
+	: m_needsUpdate(true),
+	  m_incrementalSort(true),
+	  m_numRemoved(0),
+	  m_numSorted(0),
+	  m_uniqueIdCounter(0),
+	  m_axis(-1),
+	  m_numIncrementalSorts(0),
+	  m_numFullSorts(0),
+	  m_origin(0, 0, 0),
+	  m_aabbMin(0, 0, 0),
+	  m_aabbMax(0, 0, 0)
+{
+	m_releasepaircache = (paircache != 0) ? false : true;
+	m_paircache = paircache ? paircache : new (btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16)) btHashedOverlappingPairCache();
+}
+
+btParallelSapBroadphase::~btParallelSapBroadphase()
+{
+	for (int i = 0; i < m_sortedProxies.size(); i++)
+	{
+		if (m_sortedProxies[i])
+		{
+			m_sortedProxies[i]->~btParallelSapProxy();
+			btAlignedFree(m_sortedProxies[i]);
+		}
+	}
+
+	if (m_releasepaircache)
+	{
+		m_paircache->~btOverlappingPairCache();
+		btAlignedFree(m_paircache);
+	}
+}
+
+btBroadphaseProxy* btParallelSapBroadphase::createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int /*shapeType*/, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* /*dispatcher*/)
+{
+	btParallelSapProxy* proxy = new (btAlignedAlloc(sizeof(btParallelSapProxy), 16)) btParallelSapProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = ++m_uniqueIdCounter;
+	//appended to the previous order, the next sort moves it
+	proxy->m_sortedIndex = m_sortedProxies.size();
+	m_sortedProxies.push_back(proxy);
+	m_needsUpdate = true;
+	return proxy;
+}
+
+void btParallelSapBroadphase::destroyProxy(btBroadphaseProxy* absproxy, btDispatcher* dispatcher)
+{
+	btParallelSapProxy* proxy = (btParallelSapProxy*)absproxy;
+	m_paircache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+	//the slot is removed by the next update, so the order of the others is kept
+	m_sortedProxies[proxy->m_sortedIndex] = 0;
+	m_numRemoved++;
+
+	proxy->~btParallelSapProxy();
+	btAlignedFree(proxy);
+	m_needsUpdate = true;
+}
+
+void btParallelSapBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* /*dispatcher*/)
+{
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+	m_needsUpdate = true;
+}
+
+void btParallelSapBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+bool btParallelSapBroadphase::insertionSort()
+{
+	BT_PROFILE("btParallelSapBroadphase::insertionSort");
+	const int n = m_sortEntries.size();
+	int movesLeft = n * SAP_BP_INSERTION_SORT_MOVES;
+	SortEntry* entries = &m_sortEntries[0];
+	for (int i = 1; i < n; i++)
+	{
+		if (entries[i - 1].m_key <= entries[i].m_key)
+			continue;
+
+		SortEntry entry = entries[i];
+		int j = i;
+		do
+		{
+			entries[j] = entries[j - 1];
+			j--;
+		} while (j > 0 && entries[j - 1].m_key > entry.m_key);
+		entries[j] = entry;
+
+		movesLeft -= i - j;
+		if (movesLeft < 0)
+			return false;
+	}
+	return true;
+}
+
+void btParallelSapBroadphase::update()
+{
+	BT_PROFILE("btParallelSapBroadphase::update");
+
+	if (m_numRemoved)
+	{
+		int numProxies = 0;
+		for (int i = 0; i < m_sortedProxies.size(); i++)
+		{
+			if (m_sortedProxies[i])
+				m_sortedProxies[numProxies++] = m_sortedProxies[i];
+		}
+		m_sortedProxies.resize(numProxies);
+		m_numRemoved = 0;
+	}
+	m_needsUpdate = false;
+
+	const int n = m_sortedProxies.size();
+	m_numSorted = n;
+	for (int k = 0; k < 3; k++)
+	{
+		m_soaMin[k].resize(0);
+		m_soaMax[k].resize(0);
+	}
+	if (!n)
+	{
+		m_aabbMin.setValue(0, 0, 0);
+		m_aabbMax.setValue(0, 0, 0);
+		return;
+	}
+
+	int previousAxis = m_axis;
+	{
+		BT_PROFILE("btParallelSapBroadphase::chooseAxis");
+		const btVector3 reference = (m_sortedProxies[0]->m_aabbMin + m_sortedProxies[0]->m_aabbMax) * btScalar(0.5);
+		int numChunks = (n + SAP_BP_GRAIN_SIZE - 1) / SAP_BP_GRAIN_SIZE;
+		m_chunkStats.resize(numChunks * 4);
+
+		btSapStatsLoop statsLoop;
+		statsLoop.m_proxies = &m_sortedProxies[0];
+		statsLoop.m_chunkStats = &m_chunkStats[0];
+		statsLoop.m_reference = reference;
+		statsLoop.m_numProxies = n;
+		btParallelFor(0, numChunks, 1, statsLoop);
+
+		//summed in chunk order, so the axis doesn't depend on the number of threads
+		btVector3 sum(0, 0, 0);
+		btVector3 sum2(0, 0, 0);
+		m_aabbMin = m_chunkStats[2];
+		m_aabbMax = m_chunkStats[3];
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			sum += m_chunkStats[chunk * 4];
+			sum2 += m_chunkStats[chunk * 4 + 1];
+			m_aabbMin.setMin(m_chunkStats[chunk * 4 + 2]);
+			m_aabbMax.setMax(m_chunkStats[chunk * 4 + 3]);
+		}
+
+		btVector3 mean = sum / btScalar(n);
+		btVector3 variance = sum2 / btScalar(n) - mean * mean;
+		int bestAxis = variance.maxAxis();
+		if (m_axis < 0 || variance[bestAxis] > variance[m_axis] * btScalar(SAP_BP_AXIS_HYSTERESIS))
+		{
+			m_axis = bestAxis;
+		}
+		m_origin = reference + mean;
+	}
+
+	{
+		BT_PROFILE("btParallelSapBroadphase::sort");
+		m_sortEntries.resizeNoInitialize(n);
+
+		btSapKeyLoop keyLoop;
+		keyLoop.m_proxies = &m_sortedProxies[0];
+		keyLoop.m_entries = &m_sortEntries[0];
+		keyLoop.m_origin = m_origin[m_axis];
+		keyLoop.m_axis = m_axis;
+		btParallelFor(0, n, SAP_BP_GRAIN_SIZE, keyLoop);
+
+		//the previous order is nearly sorted while the axis stays the same
+		if (m_incrementalSort && m_axis == previousAxis && insertionSort())
+		{
+			m_numIncrementalSorts++;
+		}
+		else
+		{
+			btRadixSort(m_sortEntries, m_sortBuffer, m_sortHistograms, btSapSortKey(), 32, SAP_BP_GRAIN_SIZE);
+			m_numFullSorts++;
+		}
+	}
+
+	{
+		BT_PROFILE("btParallelSapBroadphase::gather");
+		m_gatherBuffer.resizeNoInitialize(n);
+
+		btSapGatherLoop gatherLoop;
+		gatherLoop.m_entries = &m_sortEntries[0];
+		gatherLoop.m_src = &m_sortedProxies[0];
+		gatherLoop.m_dst = &m_gatherBuffer[0];
+		gatherLoop.m_origin = m_origin;
+		gatherLoop.m_axes[0] = m_axis;
+		gatherLoop.m_axes[1] = (m_axis + 1) % 3;
+		gatherLoop.m_axes[2] = (m_axis + 2) % 3;
+		for (int k = 0; k < 3; k++)
+		{
+			//padded for the four wide loads of the sweep
+			m_soaMin[k].resize(n + 4, BT_LARGE_FLOAT);
+			m_soaMax[k].resize(n + 4, -BT_LARGE_FLOAT);
+			gatherLoop.m_soaMin[k] = &m_soaMin[k][0];
+			gatherLoop.m_soaMax[k] = &m_soaMax[k][0];
+		}
+		btParallelFor(0, n, SAP_BP_GRAIN_SIZE, gatherLoop);
+
+		memcpy(&m_sortedProxies[0], &m_gatherBuffer[0], sizeof(btParallelSapProxy*) * n);
+	}
+}
+
+void btParallelSapBroadphase::findPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btParallelSapBroadphase::findPairs");
+
+	btRemoveSeparatedPairs(m_paircache, dispatcher);
+
+	const int n = m_sortedProxies.size();
+	if (n < 2)
+		return;
+
+	int numChunks = (n + SAP_BP_PROXIES_PER_CHUNK - 1) / SAP_BP_PROXIES_PER_CHUNK;
+	if (m_chunkPairs.size() < numChunks)
+		m_chunkPairs.resize(numChunks);
+
+	btSapPairLoop pairLoop;
+	pairLoop.m_proxies = &m_sortedProxies[0];
+	for (int k = 0; k < 3; k++)
+	{
+		pairLoop.m_soaMin[k] = &m_soaMin[k][0];
+		pairLoop.m_soaMax[k] = &m_soaMax[k][0];
+	}
+	pairLoop.m_chunkPairs = &m_chunkPairs[0];
+	pairLoop.m_numProxies = n;
+	btParallelFor(0, numChunks, 1, pairLoop);
+
+	btAddChunkPairs(m_paircache, m_chunkPairs, numChunks);
+}
+
+void btParallelSapBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	BT_PROFILE("btParallelSapBroadphase::calculateOverlappingPairs");
+	updateSort();
+	findPairs(dispatcher);
+}
+
+void btParallelSapBroadphase::updateSort()
+{
+	if (m_needsUpdate)
+		update();
+}
+
+int btParallelSapBroadphase::sweepRangeEnd(btScalar maxValue) const
+{
+	//first proxy that starts after maxValue
+	const float value = btSapLocal(maxValue, m_origin[m_axis]);
+	const float* soaMin = &m_soaMin[0][0];
+	int begin = 0;
+	int end = m_numSorted;
+	while (begin < end)
+	{
+		int mid = (begin + end) / 2;
+		if (soaMin[mid] <= value)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+	return begin;
+}
+
+void btParallelSapBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	btBroadphaseRayAabbCallback callback(rayCallback, rayFrom, aabbMin, aabbMax);
+	btVector3 queryMin, queryMax;
+	callback.getQueryAabb(rayTo, queryMin, queryMax);
+	aabbTest(queryMin, queryMax, callback);
+}
+
+void btParallelSapBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback)
+{
+	if (!m_numSorted)
+		return;
+
+	const int end = sweepRangeEnd(aabbMax[m_axis]);
+	for (int i = 0; i < end; i++)
+	{
+		btParallelSapProxy* proxy = m_sortedProxies[i];
+		if (proxy && TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax))
+		{
+			callback.process(proxy);
+		}
+	}
+}
+
+void btParallelSapBroadphase::resetPool(btDispatcher* /*dispatcher*/)
+{
+	if (!getNumProxies())
+	{
+		m_sortedProxies.clear();
+		m_gatherBuffer.clear();
+		m_sortEntries.clear();
+		m_sortBuffer.clear();
+		m_sortHistograms.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			m_soaMin[k].clear();
+			m_soaMax[k].clear();
+		}
+		m_chunkStats.clear();
+		m_chunkPairs.clear();
+		m_numRemoved = 0;
+		m_numSorted = 0;
+		m_uniqueIdCounter = 0;
+		m_axis = -1;
+		m_needsUpdate = true;
+	}
+}
+
+void btParallelSapBroadphase::printStats()
+{
+	printf("btParallelSapBroadphase.numProxies = %d\n", getNumProxies());
+	printf("btParallelSapBroadphase.axis = %d\n", m_axis);
+	printf("btParallelSapBroadphase.incrementalSorts = %d\n", m_numIncrementalSorts);
+	printf("btParallelSapBroadphase.fullSorts = %d\n", m_numFullSorts);
+	printf("btParallelSapBroadphase.numPairs = %d\n", m_paircache->getNumOverlappingPairs());
+}
+
+//
+#if SAP_BP_ENABLE_BENCHMARK
+
+void btParallelSapBroadphase::benchmark()
+{
+	typedef btParallelBroadphaseBenchmark Benchmark;
+
+	//a flat layer of objects spread evenly over a region far from the origin, like debris on the surface of a planet
+	static const Benchmark::Experiment experiments[] =
+		{
+			{"1024o.90%", 1024, 90, 512, (btScalar)0.005, (btScalar)2},
+			{"8192o.90%", 8192, 90, 128, (btScalar)0.005, (btScalar)2},
+			{"32768o.90%", 32768, 90, 32, (btScalar)0.005, (btScalar)2},
+			{"32768o.10%", 32768, 10, 32, (btScalar)0.005, (btScalar)2},
+		};
+	static const int nexperiments = sizeof(experiments) / sizeof(experiments[0]);
+	const btScalar planetRadius = (btScalar)6360000;
+	const btVector3 regionOrigin(0, planetRadius, 0);
+	const btVector3 worldMin(-planetRadius * 2, -planetRadius * 2, -planetRadius * 2);
+	const btVector3 worldMax(planetRadius * 2, planetRadius * 2, planetRadius * 2);
+
+	btAlignedObjectArray<Benchmark::Object> objects;
+	btAlignedObjectArray<btBroadphaseProxy*> proxies;
+	for (int iexp = 0; iexp < nexperiments; ++iexp)
+	{
+		const Benchmark::Experiment& experiment = experiments[iexp];
+		const int object_count = experiment.object_count;
+		const int update_count = (object_count * experiment.update_count) / 100;
+		//keep the density of the objects
+		const btScalar regionSize = btSqrt(btScalar(object_count) / 1024) * 200;
+		const btVector3 regionExtents(regionSize, 10, regionSize);
+		printf("Experiment #%u '%s': %u objects, %u moving, %u iterations\n", iexp, experiment.name, object_count, update_count, experiment.iterations);
+
+		for (int ibp = 0; ibp < 4; ++ibp)
+		{
+			btBroadphaseInterface* pbi = 0;
+			const char* name = 0;
+			switch (ibp)
+			{
+				case 0:
+					pbi = new btParallelSapBroadphase();
+					name = "btParallelSapBroadphase";
+					break;
+				case 1:
+					pbi = new btLinearBvhBroadphase(worldMin, worldMax);
+					name = "btLinearBvhBroadphase";
+					break;
+				case 2:
+					pbi = new btDbvtBroadphase();
+					name = "btDbvtBroadphase";
+					break;
+				default:
+					pbi = new bt32BitAxisSweep3(regionOrigin - regionExtents * 2, regionOrigin + regionExtents * 2, object_count + 1);
+					name = "bt32BitAxisSweep3";
+					break;
+			}
+
+			srand(180673);
+			objects.resize(object_count);
+			proxies.resize(object_count);
+			for (int i = 0; i < object_count; ++i)
+			{
+				Benchmark::Object& po = objects[i];
+				po.origin = regionOrigin + btVector3(Benchmark::UnitRand(), Benchmark::UnitRand(), Benchmark::UnitRand()) * regionExtents;
+				po.extents = btVector3(Benchmark::UnitRand(), Benchmark::UnitRand(), Benchmark::UnitRand()) * btScalar(0.5) + btVector3(0.5, 0.5, 0.5);
+				po.time = Benchmark::UnitRand() * 2000;
+				po.update(0, experiment.amplitude);
+				proxies[i] = pbi->createProxy(po.center - po.extents, po.center + po.extents, 0, &po, 1, 1, 0);
+			}
+			Benchmark::run(pbi, name, experiment, objects, proxies);
+			delete pbi;
+		}
+	}
+}
+#else
+void btParallelSapBroadphase::benchmark()
+{
+}
+#endif
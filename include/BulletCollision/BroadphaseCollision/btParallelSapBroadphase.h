@@ -0,0 +1,154 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_PARALLEL_SAP_BROADPHASE_H
+#define BT_PARALLEL_SAP_BROADPHASE_H
+
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btAlignedObjectArray.h"
+
+//
+// Compile time config
+//
+
+#define SAP_BP_ENABLE_BENCHMARK 0
+
+struct btParallelSapProxy : btBroadphaseProxy
+{
+	int m_sortedIndex;  //in btParallelSapBroadphase::m_sortedProxies
+
+	btParallelSapProxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, int collisionFilterGroup, int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask), m_sortedIndex(-1)
+	{
+	}
+};
+
+///The btParallelSapBroadphase is a one axis sweep and prune that re-sorts all proxies in every calculateOverlappingPairs,
+///the CPU version of b3GpuSapBroadphase. It suits many bodies spread evenly over a region, where most of them move.
+///Each update:
+///  - picks the sweep axis with the largest variance of the aabb centers, it only changes when another axis is clearly better
+///  - sorts the proxies by their minimum on that axis. The previous order is sorted again with insertion sort, which is cheap
+///    while the order stays nearly the same, a parallel radix sort is used when that takes too many moves or the axis changed
+///  - stores the bounds in float SoA arrays, relative to the mean center, so far from the origin objects keep their precision
+///  - sweeps every proxy over the ones that start before its maximum in parallel, four at a time with SSE when available.
+///    The float bounds only reject pairs, the candidates are tested again with the btScalar aabbs
+///The pairs are added to the pair cache in sorted order on the calling thread, pairs that stopped overlapping are removed.
+///All loops run with btParallelFor, the pairs don't depend on the number of threads.
+///rayTest and aabbTest only read the order of the last calculateOverlappingPairs or updateSort, so they can run concurrently.
+///Proxies created or moved since then are found at their old position in the order or not at all, destroyed proxies are skipped.
+class btParallelSapBroadphase : public btBroadphaseInterface
+{
+public:
+	struct SortEntry
+	{
+		unsigned int m_key;
+		int m_index;  //in m_sortedProxies before the sort
+	};
+
+protected:
+	btAlignedObjectArray<btParallelSapProxy*> m_sortedProxies;  //in the order of the last update, destroyed proxies are 0 until then
+	btAlignedObjectArray<btParallelSapProxy*> m_gatherBuffer;
+	btAlignedObjectArray<SortEntry> m_sortEntries;
+	btAlignedObjectArray<SortEntry> m_sortBuffer;
+	btAlignedObjectArray<unsigned int> m_sortHistograms;
+	btAlignedObjectArray<float> m_soaMin[3];  //sweep axis first, in sorted order
+	btAlignedObjectArray<float> m_soaMax[3];
+	btAlignedObjectArray<btVector3> m_chunkStats;
+	btAlignedObjectArray<btAlignedObjectArray<btBroadphasePair> > m_chunkPairs;
+
+	btOverlappingPairCache* m_paircache;
+	bool m_releasepaircache;
+	bool m_needsUpdate;
+	bool m_incrementalSort;
+	int m_numRemoved;
+	int m_numSorted;  //proxies in the sorted order and the SoA arrays of the last update
+	int m_uniqueIdCounter;
+	int m_axis;
+	int m_numIncrementalSorts;
+	int m_numFullSorts;
+	btVector3 m_origin;
+	btVector3 m_aabbMin;
+	btVector3 m_aabbMax;
+
+	void update();
+	bool insertionSort();
+	void findPairs(btDispatcher* dispatcher);
+	int sweepRangeEnd(btScalar maxValue) const;
+
+public:
+	btParallelSapBroadphase(btOverlappingPairCache* paircache = 0);
+
+	virtual ~btParallelSapBroadphase();
+
+	virtual btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
+	virtual void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+	virtual void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+	virtual void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	virtual void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	virtual void aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& callback);
+
+	virtual void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	///sorts the proxies for rayTest and aabbTest when proxies changed since the last update, without updating the pairs
+	void updateSort();
+
+	virtual btOverlappingPairCache* getOverlappingPairCache()
+	{
+		return m_paircache;
+	}
+	virtual const btOverlappingPairCache* getOverlappingPairCache() const
+	{
+		return m_paircache;
+	}
+
+	///bounds of all proxies at the last update
+	virtual void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+	{
+		aabbMin = m_aabbMin;
+		aabbMax = m_aabbMax;
+	}
+
+	virtual void resetPool(btDispatcher* dispatcher);
+
+	virtual void printStats();
+
+	///when disabled, every update uses the radix sort
+	void setIncrementalSort(bool incrementalSort)
+	{
+		m_incrementalSort = incrementalSort;
+	}
+	bool getIncrementalSort() const
+	{
+		return m_incrementalSort;
+	}
+
+	int getNumProxies() const
+	{
+		return m_sortedProxies.size() - m_numRemoved;
+	}
+
+	///sweep axis of the last update
+	int getSweepAxis() const
+	{
+		return m_axis;
+	}
+
+	///head to head with btDbvtBroadphase, btLinearBvhBroadphase and btAxisSweep3 on uniformly distributed objects, see SAP_BP_ENABLE_BENCHMARK
+	static void benchmark();
+};
+
+#endif  //BT_PARALLEL_SAP_BROADPHASE_H
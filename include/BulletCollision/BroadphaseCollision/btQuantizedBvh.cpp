@@ -18,9 +18,17 @@ subject to the following restrictions:
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btSerializer.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
 
 #define RAYAABB2
 
+//binned SAH build
+#define QBVH_SAH_NUM_BINS 32
+#define QBVH_SAH_MAX_DEPTH 64           //deeper nodes use the mean split, which keeps the tree balanced
+#define QBVH_SAH_CHUNK_SIZE 16384       //leaves per task when binning large nodes
+#define QBVH_SAH_MIN_TASK_LEAVES 2048   //subtrees smaller than this are built by a single task
+
 btQuantizedBvh::btQuantizedBvh() : m_bulletVersion(BT_BULLET_VERSION),
 								   m_useQuantization(false),
 								   //m_traversalMode(TRAVERSAL_STACKLESS_CACHE_FRIENDLY)
@@ -33,7 +41,7 @@ btQuantizedBvh::btQuantizedBvh() : m_bulletVersion(BT_BULLET_VERSION),
 	m_bvhAabbMax.setValue(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY);
 }
 
-void btQuantizedBvh::buildInternal()
+void btQuantizedBvh::buildInternal(btBuildMode buildMode)
 {
 	///assumes that caller filled in the m_quantizedLeafNodes
 	m_useQuantization = true;
@@ -49,7 +57,14 @@ void btQuantizedBvh::buildInternal()
 
 	m_curNodeIndex = 0;
 
-	buildTree(0, numLeafNodes);
+	if (buildMode == BUILD_BINNED_SAH)
+	{
+		buildTreeBinnedSah(numLeafNodes);
+	}
+	else
+	{
+		buildTree(0, numLeafNodes);
+	}
 
 	///if the entire tree is small then subtree size, we need to create a header info for the tree
 	if (m_useQuantization && !m_SubtreeHeaders.size())
@@ -229,6 +244,470 @@ void btQuantizedBvh::updateSubtreeHeaders(int leftChildNodexIndex, int rightChil
 	m_subtreeHeaderCount = m_SubtreeHeaders.size();
 }
 
+///bounds of a range of leaves, on the quantized aabbs. The doubled centers min + max stay integers
+struct btSahBounds
+{
+	unsigned short m_aabbMin[3];
+	unsigned short m_aabbMax[3];
+	int m_centerMin[3];
+	int m_centerMax[3];
+
+	void reset()
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			m_aabbMin[k] = 0xffff;
+			m_aabbMax[k] = 0;
+			m_centerMin[k] = 0x7fffffff;
+			m_centerMax[k] = -1;
+		}
+	}
+
+	void addLeaf(const btQuantizedBvhNode& leaf)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			int center = int(leaf.m_quantizedAabbMin[k]) + int(leaf.m_quantizedAabbMax[k]);
+			m_aabbMin[k] = btMin(m_aabbMin[k], leaf.m_quantizedAabbMin[k]);
+			m_aabbMax[k] = btMax(m_aabbMax[k], leaf.m_quantizedAabbMax[k]);
+			m_centerMin[k] = btMin(m_centerMin[k], center);
+			m_centerMax[k] = btMax(m_centerMax[k], center);
+		}
+	}
+
+	void merge(const btSahBounds& other)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			m_aabbMin[k] = btMin(m_aabbMin[k], other.m_aabbMin[k]);
+			m_aabbMax[k] = btMax(m_aabbMax[k], other.m_aabbMax[k]);
+			m_centerMin[k] = btMin(m_centerMin[k], other.m_centerMin[k]);
+			m_centerMax[k] = btMax(m_centerMax[k], other.m_centerMax[k]);
+		}
+	}
+};
+
+struct btSahBin
+{
+	int m_count;
+	unsigned short m_aabbMin[3];
+	unsigned short m_aabbMax[3];
+
+	void reset()
+	{
+		m_count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			m_aabbMin[k] = 0xffff;
+			m_aabbMax[k] = 0;
+		}
+	}
+
+	void addLeaf(const btQuantizedBvhNode& leaf)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			m_aabbMin[k] = btMin(m_aabbMin[k], leaf.m_quantizedAabbMin[k]);
+			m_aabbMax[k] = btMax(m_aabbMax[k], leaf.m_quantizedAabbMax[k]);
+		}
+		m_count++;
+	}
+
+	void merge(const btSahBin& other)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			m_aabbMin[k] = btMin(m_aabbMin[k], other.m_aabbMin[k]);
+			m_aabbMax[k] = btMax(m_aabbMax[k], other.m_aabbMax[k]);
+		}
+		m_count += other.m_count;
+	}
+
+	btScalar area(const btVector3& scale) const
+	{
+		btScalar dx = btScalar(m_aabbMax[0] - m_aabbMin[0]) * scale[0];
+		btScalar dy = btScalar(m_aabbMax[1] - m_aabbMin[1]) * scale[1];
+		btScalar dz = btScalar(m_aabbMax[2] - m_aabbMin[2]) * scale[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+};
+
+///maps the centers of a node to its bins, small nodes use fewer bins
+struct btSahBinning
+{
+	int m_numBins;
+	int m_centerMin[3];
+	btScalar m_binScale[3];
+
+	void init(const btSahBounds& bounds, int numIndices)
+	{
+		m_numBins = btMin(numIndices, QBVH_SAH_NUM_BINS);
+		for (int k = 0; k < 3; k++)
+		{
+			m_centerMin[k] = bounds.m_centerMin[k];
+			m_binScale[k] = btScalar(m_numBins) / btScalar(bounds.m_centerMax[k] - bounds.m_centerMin[k] + 1);
+		}
+	}
+
+	SIMD_FORCE_INLINE int binIndex(const btQuantizedBvhNode& leaf, int axis) const
+	{
+		int center = int(leaf.m_quantizedAabbMin[axis]) + int(leaf.m_quantizedAabbMax[axis]);
+		return btMin(int(btScalar(center - m_centerMin[axis]) * m_binScale[axis]), m_numBins - 1);
+	}
+};
+
+static void btSahComputeBounds(const btQuantizedBvhNode* leaves, int start, int end, btSahBounds& bounds)
+{
+	bounds.reset();
+	for (int i = start; i < end; i++)
+	{
+		bounds.addLeaf(leaves[i]);
+	}
+}
+
+//bins[axis * QBVH_SAH_NUM_BINS + bin]
+static void btSahBinLeaves(const btQuantizedBvhNode* leaves, int start, int end, const btSahBinning& binning, btSahBin* bins)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int bin = 0; bin < binning.m_numBins; bin++)
+		{
+			bins[axis * QBVH_SAH_NUM_BINS + bin].reset();
+		}
+	}
+	for (int i = start; i < end; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bins[axis * QBVH_SAH_NUM_BINS + binning.binIndex(leaves[i], axis)].addLeaf(leaves[i]);
+		}
+	}
+}
+
+///bounds or bins of fixed size chunks of the leaves of a large node, the chunks are merged in order afterwards
+struct btSahChunkLoop : public btIParallelForBody
+{
+	const btQuantizedBvhNode* m_leaves;
+	int m_start;
+	int m_end;
+	const btSahBinning* m_binning;  //0 to compute the bounds
+	btSahBounds* m_chunkBounds;
+	btSahBin* m_chunkBins;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btSahChunkLoop");
+		for (int chunk = iBegin; chunk < iEnd; chunk++)
+		{
+			int start = m_start + chunk * QBVH_SAH_CHUNK_SIZE;
+			int end = btMin(start + QBVH_SAH_CHUNK_SIZE, m_end);
+			if (m_binning)
+			{
+				btSahBinLeaves(m_leaves, start, end, *m_binning, &m_chunkBins[chunk * 3 * QBVH_SAH_NUM_BINS]);
+			}
+			else
+			{
+				btSahComputeBounds(m_leaves, start, end, m_chunkBounds[chunk]);
+			}
+		}
+	}
+};
+
+static void btSahParallelBounds(const btQuantizedBvhNode* leaves, int start, int end, btSahBounds& bounds)
+{
+	int numChunks = (end - start + QBVH_SAH_CHUNK_SIZE - 1) / QBVH_SAH_CHUNK_SIZE;
+	btAlignedObjectArray<btSahBounds> chunkBounds;
+	chunkBounds.resizeNoInitialize(numChunks);
+
+	btSahChunkLoop loop;
+	loop.m_leaves = leaves;
+	loop.m_start = start;
+	loop.m_end = end;
+	loop.m_binning = 0;
+	loop.m_chunkBounds = &chunkBounds[0];
+	loop.m_chunkBins = 0;
+	btParallelFor(0, numChunks, 1, loop);
+
+	bounds = chunkBounds[0];
+	for (int chunk = 1; chunk < numChunks; chunk++)
+	{
+		bounds.merge(chunkBounds[chunk]);
+	}
+}
+
+static void btSahParallelBinLeaves(const btQuantizedBvhNode* leaves, int start, int end, const btSahBinning& binning, btSahBin* bins)
+{
+	int numChunks = (end - start + QBVH_SAH_CHUNK_SIZE - 1) / QBVH_SAH_CHUNK_SIZE;
+	btAlignedObjectArray<btSahBin> chunkBins;
+	chunkBins.resizeNoInitialize(numChunks * 3 * QBVH_SAH_NUM_BINS);
+
+	btSahChunkLoop loop;
+	loop.m_leaves = leaves;
+	loop.m_start = start;
+	loop.m_end = end;
+	loop.m_binning = &binning;
+	loop.m_chunkBounds = 0;
+	loop.m_chunkBins = &chunkBins[0];
+	btParallelFor(0, numChunks, 1, loop);
+
+	for (int j = 0; j < 3 * QBVH_SAH_NUM_BINS; j++)
+	{
+		bins[j] = chunkBins[j];
+		for (int chunk = 1; chunk < numChunks; chunk++)
+		{
+			bins[j].merge(chunkBins[chunk * 3 * QBVH_SAH_NUM_BINS + j]);
+		}
+	}
+}
+
+///partitions the leaves of a node, returns the first leaf of the right child and the bounds of both children
+static int btSahSplitLeaves(btQuantizedBvhNode* leaves, int start, int end, int depth, const btSahBounds& bounds, const btVector3& scale, bool parallel, btSahBounds& leftBounds, btSahBounds& rightBounds)
+{
+	const int numIndices = end - start;
+	if (numIndices == 2)
+	{
+		btSahComputeBounds(leaves, start, start + 1, leftBounds);
+		btSahComputeBounds(leaves, start + 1, end, rightBounds);
+		return start + 1;
+	}
+
+	int bestAxis = -1;
+	int bestBin = -1;
+	btSahBinning binning;
+	binning.init(bounds, numIndices);
+	if (depth < QBVH_SAH_MAX_DEPTH)
+	{
+		btSahBin bins[3 * QBVH_SAH_NUM_BINS];
+		if (parallel && numIndices > QBVH_SAH_CHUNK_SIZE)
+		{
+			btSahParallelBinLeaves(leaves, start, end, binning, bins);
+		}
+		else
+		{
+			btSahBinLeaves(leaves, start, end, binning, bins);
+		}
+
+		//cost of splitting behind every bin, the first minimum wins, so the choice doesn't depend on the binning order
+		btScalar bestCost = SIMD_INFINITY;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (bounds.m_centerMax[axis] == bounds.m_centerMin[axis])
+				continue;
+			const btSahBin* axisBins = &bins[axis * QBVH_SAH_NUM_BINS];
+			btScalar rightCost[QBVH_SAH_NUM_BINS];
+			btSahBin side;
+			side.reset();
+			for (int bin = binning.m_numBins - 1; bin > 0; bin--)
+			{
+				side.merge(axisBins[bin]);
+				rightCost[bin] = side.m_count ? side.area(scale) * btScalar(side.m_count) : btScalar(0);
+			}
+			side.reset();
+			for (int bin = 0; bin < binning.m_numBins - 1; bin++)
+			{
+				side.merge(axisBins[bin]);
+				if (side.m_count == 0 || side.m_count == numIndices)
+					continue;
+				btScalar cost = side.area(scale) * btScalar(side.m_count) + rightCost[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+	}
+
+	int splitIndex = start;
+	if (bestAxis >= 0)
+	{
+		leftBounds.reset();
+		rightBounds.reset();
+		int last = end - 1;
+		while (splitIndex <= last)
+		{
+			if (binning.binIndex(leaves[splitIndex], bestAxis) <= bestBin)
+			{
+				leftBounds.addLeaf(leaves[splitIndex]);
+				splitIndex++;
+			}
+			else
+			{
+				rightBounds.addLeaf(leaves[splitIndex]);
+				btSwap(leaves[splitIndex], leaves[last]);
+				last--;
+			}
+		}
+		return splitIndex;
+	}
+
+	//too deep or all centers are the same: split at the mean of the centers along their largest extent, like sortAndCalcSplittingIndex
+	int splitAxis = 0;
+	for (int axis = 1; axis < 3; axis++)
+	{
+		if (bounds.m_centerMax[axis] - bounds.m_centerMin[axis] > bounds.m_centerMax[splitAxis] - bounds.m_centerMin[splitAxis])
+			splitAxis = axis;
+	}
+	long long sum = 0;
+	for (int i = start; i < end; i++)
+	{
+		sum += int(leaves[i].m_quantizedAabbMin[splitAxis]) + int(leaves[i].m_quantizedAabbMax[splitAxis]);
+	}
+	for (int i = start; i < end; i++)
+	{
+		long long center = int(leaves[i].m_quantizedAabbMin[splitAxis]) + int(leaves[i].m_quantizedAabbMax[splitAxis]);
+		if (center * numIndices > sum)
+		{
+			btSwap(leaves[i], leaves[splitIndex]);
+			splitIndex++;
+		}
+	}
+	int rangeBalancedIndices = numIndices / 3;
+	if ((splitIndex <= (start + rangeBalancedIndices)) || (splitIndex >= (end - 1 - rangeBalancedIndices)))
+	{
+		splitIndex = start + (numIndices >> 1);
+	}
+	btSahComputeBounds(leaves, start, splitIndex, leftBounds);
+	btSahComputeBounds(leaves, splitIndex, end, rightBounds);
+	return splitIndex;
+}
+
+static void btSahSetInternalNode(btQuantizedBvhNode& node, const btSahBounds& bounds, int numIndices)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		node.m_quantizedAabbMin[k] = bounds.m_aabbMin[k];
+		node.m_quantizedAabbMax[k] = bounds.m_aabbMax[k];
+	}
+	//escape index, a subtree of n leaves has 2n-1 nodes
+	node.m_escapeIndexOrTriangleIndex = -(2 * numIndices - 1);
+}
+
+//the left child follows its parent, the right child follows the 2 * numLeft - 1 nodes of the left subtree
+static void btSahBuildSubtree(btQuantizedBvhNode* leaves, btQuantizedBvhNode* nodes, int start, int end, int nodeIndex, int depth, const btSahBounds& bounds, const btVector3& scale)
+{
+	if (end - start == 1)
+	{
+		nodes[nodeIndex] = leaves[start];
+		return;
+	}
+	btSahSetInternalNode(nodes[nodeIndex], bounds, end - start);
+	btSahBounds leftBounds, rightBounds;
+	int splitIndex = btSahSplitLeaves(leaves, start, end, depth, bounds, scale, false, leftBounds, rightBounds);
+	btSahBuildSubtree(leaves, nodes, start, splitIndex, nodeIndex + 1, depth + 1, leftBounds, scale);
+	btSahBuildSubtree(leaves, nodes, splitIndex, end, nodeIndex + 2 * (splitIndex - start), depth + 1, rightBounds, scale);
+}
+
+struct btSahSubtreeTask
+{
+	int m_start;
+	int m_end;
+	int m_nodeIndex;
+	int m_depth;
+	btSahBounds m_bounds;
+};
+
+struct btSahBuildSubtreesLoop : public btIParallelForBody
+{
+	btQuantizedBvhNode* m_leaves;
+	btQuantizedBvhNode* m_nodes;
+	const btSahSubtreeTask* m_tasks;
+	btVector3 m_scale;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btSahBuildSubtreesLoop");
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			const btSahSubtreeTask& task = m_tasks[i];
+			btSahBuildSubtree(m_leaves, m_nodes, task.m_start, task.m_end, task.m_nodeIndex, task.m_depth, task.m_bounds, m_scale);
+		}
+	}
+};
+
+void btQuantizedBvh::buildTreeBinnedSah(int numLeafNodes)
+{
+	BT_PROFILE("buildTreeBinnedSah");
+	if (!m_useQuantization)
+	{
+		buildTree(0, numLeafNodes);
+		return;
+	}
+	btAssert(numLeafNodes > 0);
+	btAssert(m_quantizedContiguousNodes.size() >= 2 * numLeafNodes - 1);
+
+	btQuantizedBvhNode* leaves = &m_quantizedLeafNodes[0];
+	btQuantizedBvhNode* nodes = &m_quantizedContiguousNodes[0];
+	//the areas are measured in world units, the quantization can differ per axis
+	btVector3 scale(btScalar(1) / m_bvhQuantization.getX(), btScalar(1) / m_bvhQuantization.getY(), btScalar(1) / m_bvhQuantization.getZ());
+
+	//split the top of the tree breadth first, binning large nodes in parallel, until the subtrees are small enough for one task.
+	//Every split only depends on the leaves of its node, so the tree is the same for any number of threads
+	btAlignedObjectArray<btSahSubtreeTask> queue;
+	btAlignedObjectArray<btSahSubtreeTask> tasks;
+	btSahSubtreeTask root;
+	root.m_start = 0;
+	root.m_end = numLeafNodes;
+	root.m_nodeIndex = 0;
+	root.m_depth = 0;
+	btSahParallelBounds(leaves, 0, numLeafNodes, root.m_bounds);
+	queue.push_back(root);
+	{
+		BT_PROFILE("splitTop");
+		for (int i = 0; i < queue.size(); i++)
+		{
+			btSahSubtreeTask task = queue[i];
+			int numIndices = task.m_end - task.m_start;
+			if (numIndices < QBVH_SAH_MIN_TASK_LEAVES)
+			{
+				tasks.push_back(task);
+				continue;
+			}
+			btSahSetInternalNode(nodes[task.m_nodeIndex], task.m_bounds, numIndices);
+			btSahSubtreeTask left = task;
+			btSahSubtreeTask right = task;
+			int splitIndex = btSahSplitLeaves(leaves, task.m_start, task.m_end, task.m_depth, task.m_bounds, scale, true, left.m_bounds, right.m_bounds);
+			left.m_end = splitIndex;
+			left.m_nodeIndex = task.m_nodeIndex + 1;
+			left.m_depth = task.m_depth + 1;
+			right.m_start = splitIndex;
+			right.m_nodeIndex = task.m_nodeIndex + 2 * (splitIndex - task.m_start);
+			right.m_depth = task.m_depth + 1;
+			queue.push_back(left);
+			queue.push_back(right);
+		}
+	}
+
+	{
+		BT_PROFILE("buildSubtrees");
+		btSahBuildSubtreesLoop loop;
+		loop.m_leaves = leaves;
+		loop.m_nodes = nodes;
+		loop.m_tasks = &tasks[0];
+		loop.m_scale = scale;
+		btParallelFor(0, tasks.size(), 1, loop);
+	}
+
+	m_curNodeIndex = 2 * numLeafNodes - 1;
+
+	updateSubtreeHeadersRecursive(0);
+}
+
+void btQuantizedBvh::updateSubtreeHeadersRecursive(int nodeIndex)
+{
+	//same order as buildTree: the headers of both children first, then the ones of this node
+	const btQuantizedBvhNode& node = m_quantizedContiguousNodes[nodeIndex];
+	if (node.isLeafNode() || node.getEscapeIndex() * static_cast<int>(sizeof(btQuantizedBvhNode)) <= MAX_SUBTREE_SIZE_IN_BYTES)
+		return;
+	int leftChildNodexIndex = nodeIndex + 1;
+	const btQuantizedBvhNode& leftChildNode = m_quantizedContiguousNodes[leftChildNodexIndex];
+	int rightChildNodexIndex = leftChildNodexIndex + (leftChildNode.isLeafNode() ? 1 : leftChildNode.getEscapeIndex());
+	updateSubtreeHeadersRecursive(leftChildNodexIndex);
+	updateSubtreeHeadersRecursive(rightChildNodexIndex);
+	updateSubtreeHeaders(leftChildNodexIndex, rightChildNodexIndex);
+}
+
 int btQuantizedBvh::sortAndCalcSplittingIndex(int startIndex, int endIndex, int splitAxis)
 {
 	int i;
@@ -174,6 +174,12 @@ public:
 		TRAVERSAL_RECURSIVE
 	};
 
+	enum btBuildMode
+	{
+		BUILD_MEDIAN_SPLIT = 0,  //splits at the mean of the centers along the axis of largest variance
+		BUILD_BINNED_SAH         //binned surface area heuristic, the top of the tree is split in parallel (quantized trees only)
+	};
+
 protected:
 	btVector3 m_bvhAabbMin;
 	btVector3 m_bvhAabbMax;
@@ -284,6 +290,11 @@ protected:
 protected:
 	void buildTree(int startIndex, int endIndex);
 
+	///builds the same node and subtree header layout as buildTree(0, numLeafNodes) with binned SAH splits
+	void buildTreeBinnedSah(int numLeafNodes);
+
+	void updateSubtreeHeadersRecursive(int nodeIndex);
+
 	int calcSplittingAxis(int startIndex, int endIndex);
 
 	int sortAndCalcSplittingIndex(int startIndex, int endIndex, int splitAxis);
@@ -316,7 +327,7 @@ public:
 	void setQuantizationValues(const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, btScalar quantizationMargin = btScalar(1.0));
 	QuantizedNodeArray& getLeafNodeArray() { return m_quantizedLeafNodes; }
 	///buildInternal is expert use only: assumes that setQuantizationValues and LeafNodeArray are initialized
-	void buildInternal();
+	void buildInternal(btBuildMode buildMode = BUILD_MEDIAN_SPLIT);
 	///***************************************** expert/internal use only *************************
 
 	void reportAabbOverlappingNodex(btNodeOverlapCallback * nodeCallback, const btVector3& aabbMin, const btVector3& aabbMax) const;
@@ -415,6 +426,11 @@ public:
 		m_traversalMode = traversalMode;
 	}
 
+	btTraversalMode getTraversalMode() const
+	{
+		return m_traversalMode;
+	}
+
 	SIMD_FORCE_INLINE QuantizedNodeArray& getQuantizedNodeArray()
 	{
 		return m_quantizedContiguousNodes;
@@ -91,6 +91,18 @@ public:
 		return m_manifoldsPtr.size() ? &m_manifoldsPtr[0] : 0;
 	}
 
+	///replace the manifold array, used by btDynamicsWorldCheckpoint. The manifolds have to be allocated by this dispatcher
+	///and their m_index1a has to match their new position.
+	void setInternalManifolds(btPersistentManifold* const* manifolds, int numManifolds)
+	{
+		m_manifoldsPtr.resize(numManifolds);
+		for (int i = 0; i < numManifolds; i++)
+		{
+			btAssert(manifolds[i]->m_index1a == i);
+			m_manifoldsPtr[i] = manifolds[i];
+		}
+	}
+
 	btPersistentManifold* getManifoldByIndexInternal(int index)
 	{
 		btAssert(index>=0);
@@ -31,10 +31,98 @@ btCollisionDispatcherMt::btCollisionDispatcherMt(btCollisionConfiguration* confi
 	m_batchManifoldsPtr.resize(btGetTaskScheduler()->getNumThreads());
 	m_batchReleasePtr.resize(btGetTaskScheduler()->getNumThreads());
 
+	// indexed by btGetCurrentThreadIndex(), which is not bounded by the current number of scheduler threads
+	m_manifoldThreadPools.resize(BT_MAX_THREAD_COUNT);
+	m_algorithmThreadPools.resize(BT_MAX_THREAD_COUNT);
+
 	m_batchUpdating = false;
 	m_grainSize = grainSize;  // iterations per task
 }
 
+btCollisionDispatcherMt::~btCollisionDispatcherMt()
+{
+	flushThreadLocalPools();
+}
+
+static void* threadPoolAllocate(btCollisionDispatcherMt::btThreadLocalPool& local, btPoolAllocator* pool)
+{
+	if (local.m_numFree == 0)
+	{
+		local.m_numFree = pool->allocateBatch(local.m_freeElements, btCollisionDispatcherMt::BT_DISPATCHER_POOL_BATCH_SIZE);
+		local.m_numRefills++;
+		if (local.m_numFree == 0)
+		{
+			return NULL;
+		}
+	}
+	return local.m_freeElements[--local.m_numFree];
+}
+
+static void threadPoolFree(btCollisionDispatcherMt::btThreadLocalPool& local, btPoolAllocator* pool, void* ptr)
+{
+	const int batchSize = btCollisionDispatcherMt::BT_DISPATCHER_POOL_BATCH_SIZE;
+	if (local.m_numFree == 2 * batchSize)
+	{
+		// hand the oldest half back to the global pool, keep the recently freed (cache-warm) half
+		pool->freeMemoryBatch(local.m_freeElements, batchSize);
+		for (int i = 0; i < batchSize; ++i)
+		{
+			local.m_freeElements[i] = local.m_freeElements[i + batchSize];
+		}
+		local.m_numFree = batchSize;
+		local.m_numReturns++;
+	}
+	local.m_freeElements[local.m_numFree++] = ptr;
+}
+
+void btCollisionDispatcherMt::flushThreadLocalPools()
+{
+	btAssert(!m_batchUpdating);
+	for (int i = 0; i < m_manifoldThreadPools.size(); ++i)
+	{
+		btThreadLocalPool& local = m_manifoldThreadPools[i];
+		m_persistentManifoldPoolAllocator->freeMemoryBatch(local.m_freeElements, local.m_numFree);
+		local.m_numFree = 0;
+	}
+	for (int i = 0; i < m_algorithmThreadPools.size(); ++i)
+	{
+		btThreadLocalPool& local = m_algorithmThreadPools[i];
+		m_collisionAlgorithmPoolAllocator->freeMemoryBatch(local.m_freeElements, local.m_numFree);
+		local.m_numFree = 0;
+	}
+}
+
+void btCollisionDispatcherMt::getMemoryStats(btCollisionDispatcherMemoryStats& stats) const
+{
+	stats.m_manifoldPoolCapacity = m_persistentManifoldPoolAllocator->getMaxCount();
+	stats.m_manifoldPoolUsed = m_persistentManifoldPoolAllocator->getUsedCount();
+	stats.m_manifoldThreadCached = 0;
+	stats.m_manifoldHeapAllocated = 0;
+	stats.m_algorithmPoolCapacity = m_collisionAlgorithmPoolAllocator->getMaxCount();
+	stats.m_algorithmPoolUsed = m_collisionAlgorithmPoolAllocator->getUsedCount();
+	stats.m_algorithmThreadCached = 0;
+	stats.m_algorithmHeapAllocated = 0;
+	stats.m_globalPoolRefills = 0;
+	stats.m_globalPoolReturns = 0;
+
+	for (int i = 0; i < m_manifoldThreadPools.size(); ++i)
+	{
+		const btThreadLocalPool& local = m_manifoldThreadPools[i];
+		stats.m_manifoldThreadCached += local.m_numFree;
+		stats.m_manifoldHeapAllocated += local.m_heapAllocated;
+		stats.m_globalPoolRefills += local.m_numRefills;
+		stats.m_globalPoolReturns += local.m_numReturns;
+	}
+	for (int i = 0; i < m_algorithmThreadPools.size(); ++i)
+	{
+		const btThreadLocalPool& local = m_algorithmThreadPools[i];
+		stats.m_algorithmThreadCached += local.m_numFree;
+		stats.m_algorithmHeapAllocated += local.m_heapAllocated;
+		stats.m_globalPoolRefills += local.m_numRefills;
+		stats.m_globalPoolReturns += local.m_numReturns;
+	}
+}
+
 btPersistentManifold* btCollisionDispatcherMt::getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1)
 {
 	//optional relative contact breaking threshold, turned on by default (use setDispatcherFlags to switch off feature for improved performance)
@@ -44,13 +132,15 @@ btPersistentManifold* btCollisionDispatcherMt::getNewManifold(const btCollisionO
 
 	btScalar contactProcessingThreshold = btMin(body0->getContactProcessingThreshold(), body1->getContactProcessingThreshold());
 
-	void* mem = m_persistentManifoldPoolAllocator->allocate(sizeof(btPersistentManifold));
+	btThreadLocalPool& localPool = m_manifoldThreadPools[btGetCurrentThreadIndex()];
+	void* mem = threadPoolAllocate(localPool, m_persistentManifoldPoolAllocator);
 	if (NULL == mem)
 	{
 		//we got a pool memory overflow, by default we fallback to dynamically allocate memory. If we require a contiguous contact pool then assert.
 		if ((m_dispatcherFlags & CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION) == 0)
 		{
 			mem = btAlignedAlloc(sizeof(btPersistentManifold), 16);
+			localPool.m_heapAllocated++;
 		}
 		else
 		{
@@ -96,13 +186,45 @@ void btCollisionDispatcherMt::releaseManifold(btPersistentManifold* manifold)
 	}
 
 	manifold->~btPersistentManifold();
+	btThreadLocalPool& localPool = m_manifoldThreadPools[btGetCurrentThreadIndex()];
 	if (m_persistentManifoldPoolAllocator->validPtr(manifold))
 	{
-		m_persistentManifoldPoolAllocator->freeMemory(manifold);
+		threadPoolFree(localPool, m_persistentManifoldPoolAllocator, manifold);
 	}
 	else
 	{
 		btAlignedFree(manifold);
+		localPool.m_heapAllocated--;
+	}
+}
+
+void* btCollisionDispatcherMt::allocateCollisionAlgorithm(int size)
+{
+	btThreadLocalPool& localPool = m_algorithmThreadPools[btGetCurrentThreadIndex()];
+	void* mem = NULL;
+	if (size <= m_collisionAlgorithmPoolAllocator->getElementSize())
+	{
+		mem = threadPoolAllocate(localPool, m_collisionAlgorithmPoolAllocator);
+	}
+	if (NULL == mem)
+	{
+		localPool.m_heapAllocated++;
+		return btAlignedAlloc(static_cast<size_t>(size), 16);
+	}
+	return mem;
+}
+
+void btCollisionDispatcherMt::freeCollisionAlgorithm(void* ptr)
+{
+	btThreadLocalPool& localPool = m_algorithmThreadPools[btGetCurrentThreadIndex()];
+	if (m_collisionAlgorithmPoolAllocator->validPtr(ptr))
+	{
+		threadPoolFree(localPool, m_collisionAlgorithmPoolAllocator, ptr);
+	}
+	else if (ptr)
+	{
+		btAlignedFree(ptr);
+		localPool.m_heapAllocated--;
 	}
 }
 
@@ -19,19 +19,70 @@ subject to the following restrictions:
 #include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
 #include "LinearMath/btThreads.h"
 
+///btCollisionDispatcherMemoryStats reports how the manifold and collision algorithm memory is used.
+///'Used' counts include elements parked in the per-thread caches, since those are taken from the global pool.
+struct btCollisionDispatcherMemoryStats
+{
+	int m_manifoldPoolCapacity;
+	int m_manifoldPoolUsed;
+	int m_manifoldThreadCached;
+	int m_manifoldHeapAllocated;
+
+	int m_algorithmPoolCapacity;
+	int m_algorithmPoolUsed;
+	int m_algorithmThreadCached;
+	int m_algorithmHeapAllocated;
+
+	///number of batches taken from / given back to the global pools, each costs one lock
+	int m_globalPoolRefills;
+	int m_globalPoolReturns;
+};
+
+///btCollisionDispatcherMt keeps a small free list per thread in front of the shared manifold and algorithm pools.
+///Threads only touch the global btPoolAllocator (and its mutex) to move BT_DISPATCHER_POOL_BATCH_SIZE elements at a time.
 class btCollisionDispatcherMt : public btCollisionDispatcher
 {
 public:
+	enum
+	{
+		BT_DISPATCHER_POOL_BATCH_SIZE = 32
+	};
+
 	btCollisionDispatcherMt(btCollisionConfiguration* config, int grainSize = 40);
 
+	virtual ~btCollisionDispatcherMt();
+
 	virtual btPersistentManifold* getNewManifold(const btCollisionObject* body0, const btCollisionObject* body1) BT_OVERRIDE;
 	virtual void releaseManifold(btPersistentManifold* manifold) BT_OVERRIDE;
 
 	virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher) BT_OVERRIDE;
 
+	virtual void* allocateCollisionAlgorithm(int size) BT_OVERRIDE;
+
+	virtual void freeCollisionAlgorithm(void* ptr) BT_OVERRIDE;
+
+	///return all per-thread cached elements to the global pools. Must not be called while threads are running.
+	void flushThreadLocalPools();
+
+	///must not be called while threads are running
+	void getMemoryStats(btCollisionDispatcherMemoryStats& stats) const;
+
+	///per-thread free list, padded so neighbouring threads do not share a cache line
+	struct btThreadLocalPool
+	{
+		void* m_freeElements[2 * BT_DISPATCHER_POOL_BATCH_SIZE];
+		int m_numFree;
+		int m_heapAllocated;
+		int m_numRefills;
+		int m_numReturns;
+		char m_padding[64];
+	};
+
 protected:
 	btAlignedObjectArray<btAlignedObjectArray<btPersistentManifold*> > m_batchManifoldsPtr;
 	btAlignedObjectArray<btAlignedObjectArray<btPersistentManifold*> > m_batchReleasePtr;
+	btAlignedObjectArray<btThreadLocalPool> m_manifoldThreadPools;
+	btAlignedObjectArray<btThreadLocalPool> m_algorithmThreadPools;
 	bool m_batchUpdating;
 	int m_grainSize;
 };
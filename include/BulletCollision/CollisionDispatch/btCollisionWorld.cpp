@@ -283,6 +283,265 @@ void btCollisionWorld::rayTestSingle(const btTransform& rayFromTrans, const btTr
 	btCollisionWorld::rayTestSingleInternal(rayFromTrans, rayToTrans, &colObWrap, resultCallback);
 }
 
+///entry and exit of the line from + t * dir through the sphere of the given radius at the origin.
+///The near root is computed as c / q, which stays precise if the ray starts close to a large sphere
+static bool btRaySphereInterval(const btVector3& from, const btVector3& dir, btScalar radius, btScalar& tEnter, btScalar& tExit)
+{
+	btScalar fromLength = from.length();
+	btScalar a = dir.length2();
+	if (a == btScalar(0))
+	{
+		if (fromLength > radius)
+			return false;
+		tEnter = -BT_LARGE_FLOAT;
+		tExit = BT_LARGE_FLOAT;
+		return true;
+	}
+	btScalar b = from.dot(dir);
+	//distance of the line to the center
+	btScalar h = (from - dir * (b / a)).length();
+	if (h > radius)
+		return false;
+	btScalar s = btSqrt(a * (radius - h) * (radius + h));
+	btScalar c = (fromLength - radius) * (fromLength + radius);
+	btScalar q = b < btScalar(0) ? s - b : -(s + b);
+	if (q == btScalar(0))
+	{
+		tEnter = tExit = btScalar(0);
+		return true;
+	}
+	btScalar t0 = q / a;
+	btScalar t1 = c / q;
+	tEnter = btMin(t0, t1);
+	tExit = btMax(t0, t1);
+	return true;
+}
+
+///the radial part of the ray against the infinite cylinder around the axis
+static bool btRayCylinderInterval(const btVector3& from, const btVector3& dir, int axis, btScalar radius, btScalar& tEnter, btScalar& tExit)
+{
+	btVector3 radialFrom = from;
+	btVector3 radialDir = dir;
+	radialFrom[axis] = btScalar(0);
+	radialDir[axis] = btScalar(0);
+	return btRaySphereInterval(radialFrom, radialDir, radius, tEnter, tExit);
+}
+
+///closed form ray test against spheres, boxes, capsules, cylinders, planes and convex hulls with polyhedral features, in the space of the shape.
+///Returns false for other shapes. Rays that start inside a convex shape don't hit it.
+///The convex shapes include their margin: boxes, cylinders and hulls as sharp shapes grown by the margin, like getHalfExtentsWithMargin.
+static bool btRayTestPrimitive(const btCollisionShape* shape, const btVector3& from, const btVector3& to, unsigned int flags, bool& hasHit, btScalar& hitFraction, btVector3& hitNormal)
+{
+	btVector3 dir = to - from;
+	hasHit = false;
+	switch (shape->getShapeType())
+	{
+		case SPHERE_SHAPE_PROXYTYPE:
+		{
+			btScalar radius = ((const btSphereShape*)shape)->getRadius();
+			btScalar tEnter, tExit;
+			if (btRaySphereInterval(from, dir, radius, tEnter, tExit) && tEnter >= btScalar(0) && tEnter <= btScalar(1))
+			{
+				hasHit = true;
+				hitFraction = tEnter;
+				hitNormal = (from + dir * tEnter).normalized();
+			}
+			return true;
+		}
+		case BOX_SHAPE_PROXYTYPE:
+		{
+			btVector3 halfExtents = ((const btBoxShape*)shape)->getHalfExtentsWithMargin();
+			btScalar tEnter = -BT_LARGE_FLOAT;
+			btScalar tExit = BT_LARGE_FLOAT;
+			int enterAxis = -1;
+			for (int i = 0; i < 3; i++)
+			{
+				if (dir[i] == btScalar(0))
+				{
+					if (btFabs(from[i]) > halfExtents[i])
+						return true;
+					continue;
+				}
+				btScalar t0 = (-halfExtents[i] - from[i]) / dir[i];
+				btScalar t1 = (halfExtents[i] - from[i]) / dir[i];
+				if (t0 > t1)
+					btSwap(t0, t1);
+				if (t0 > tEnter)
+				{
+					tEnter = t0;
+					enterAxis = i;
+				}
+				tExit = btMin(tExit, t1);
+				if (tEnter > tExit)
+					return true;
+			}
+			if (enterAxis >= 0 && tEnter >= btScalar(0) && tEnter <= btScalar(1))
+			{
+				hasHit = true;
+				hitFraction = tEnter;
+				hitNormal.setValue(0, 0, 0);
+				hitNormal[enterAxis] = dir[enterAxis] > btScalar(0) ? btScalar(-1) : btScalar(1);
+			}
+			return true;
+		}
+		case CAPSULE_SHAPE_PROXYTYPE:
+		{
+			const btCapsuleShape* capsule = (const btCapsuleShape*)shape;
+			int axis = capsule->getUpAxis();
+			btScalar radius = capsule->getRadius();
+			btScalar halfHeight = capsule->getHalfHeight();
+			btVector3 center(0, 0, 0);
+			center[axis] = halfHeight;
+
+			//the capsule is the union of the side and the two caps, the ray enters it at the first entry of any of them
+			btScalar tEnter, tExit;
+			if (btRayCylinderInterval(from, dir, axis, radius, tEnter, tExit))
+			{
+				btScalar height = from[axis] + dir[axis] * tEnter;
+				if (tEnter <= btScalar(0) && tExit >= btScalar(0) && btFabs(from[axis]) <= halfHeight)
+					return true;
+				if (tEnter >= btScalar(0) && tEnter <= btScalar(1) && btFabs(height) <= halfHeight)
+				{
+					hasHit = true;
+					hitFraction = tEnter;
+					hitNormal = from + dir * tEnter;
+					hitNormal[axis] = btScalar(0);
+					hitNormal.normalize();
+				}
+			}
+			for (int side = 0; side < 2; side++)
+			{
+				btVector3 capFrom = side ? from + center : from - center;
+				if (!btRaySphereInterval(capFrom, dir, radius, tEnter, tExit))
+					continue;
+				if (tEnter <= btScalar(0) && tExit >= btScalar(0))
+				{
+					hasHit = false;
+					return true;
+				}
+				if (tEnter >= btScalar(0) && tEnter <= btScalar(1) && (!hasHit || tEnter < hitFraction))
+				{
+					hasHit = true;
+					hitFraction = tEnter;
+					hitNormal = (capFrom + dir * tEnter).normalized();
+				}
+			}
+			return true;
+		}
+		case CYLINDER_SHAPE_PROXYTYPE:
+		{
+			const btCylinderShape* cylinder = (const btCylinderShape*)shape;
+			int axis = cylinder->getUpAxis();
+			btScalar halfHeight = cylinder->getHalfExtentsWithMargin()[axis];
+
+			//the intersection of the infinite cylinder and the slab between the caps
+			btScalar tEnter, tExit;
+			if (!btRayCylinderInterval(from, dir, axis, cylinder->getRadius(), tEnter, tExit))
+				return true;
+			btVector3 normal = from + dir * tEnter;
+			normal[axis] = btScalar(0);
+			if (dir[axis] != btScalar(0))
+			{
+				btScalar t0 = (-halfHeight - from[axis]) / dir[axis];
+				btScalar t1 = (halfHeight - from[axis]) / dir[axis];
+				if (t0 > t1)
+					btSwap(t0, t1);
+				if (t0 > tEnter)
+				{
+					tEnter = t0;
+					normal.setValue(0, 0, 0);
+					normal[axis] = dir[axis] > btScalar(0) ? btScalar(-1) : btScalar(1);
+				}
+				tExit = btMin(tExit, t1);
+			}
+			else if (btFabs(from[axis]) > halfHeight)
+			{
+				return true;
+			}
+			if (tEnter <= tExit && tEnter >= btScalar(0) && tEnter <= btScalar(1) && normal.length2() > btScalar(0))
+			{
+				hasHit = true;
+				hitFraction = tEnter;
+				hitNormal = normal.normalized();
+			}
+			return true;
+		}
+		case STATIC_PLANE_PROXYTYPE:
+		{
+			//the triangles that btStaticPlaneShape reports to btTriangleRaycastCallback wind against the plane normal,
+			//so like there rays from the side of the normal are backfaces and the unflipped normal is -planeNormal
+			const btStaticPlaneShape* plane = (const btStaticPlaneShape*)shape;
+			const btVector3& planeNormal = plane->getPlaneNormal();
+			btScalar distFrom = planeNormal.dot(from) - plane->getPlaneConstant();
+			btScalar distTo = planeNormal.dot(to) - plane->getPlaneConstant();
+			if (distFrom * distTo >= btScalar(0))
+				return true;
+			bool backface = distFrom > btScalar(0);
+			if (backface && (flags & btTriangleRaycastCallback::kF_FilterBackfaces))
+				return true;
+			hasHit = true;
+			hitFraction = distFrom / (distFrom - distTo);
+			hitNormal = (backface && !(flags & btTriangleRaycastCallback::kF_KeepUnflippedNormal)) ? planeNormal : -planeNormal;
+			return true;
+		}
+		case TETRAHEDRAL_SHAPE_PROXYTYPE:
+		case CONVEX_TRIANGLEMESH_SHAPE_PROXYTYPE:
+		case CONVEX_HULL_SHAPE_PROXYTYPE:
+		case CONVEX_POINT_CLOUD_SHAPE_PROXYTYPE:
+			break;
+		default:
+			return false;
+	}
+
+	//convex hulls with polyhedral features, clipped by the planes of their faces
+	const btPolyhedralConvexShape* polyhedralShape = (const btPolyhedralConvexShape*)shape;
+	const btConvexPolyhedron* polyhedron = polyhedralShape->getConvexPolyhedron();
+	if (!polyhedron || !polyhedron->m_faces.size())
+		return false;
+
+	//initializePolyhedralFeatures(1) already shifted the faces by the margin
+	btScalar margin = polyhedralShape->getMargin() - polyhedralShape->getConvexPolyhedronMargin();
+	btScalar tEnter = -BT_LARGE_FLOAT;
+	btScalar tExit = BT_LARGE_FLOAT;
+	int enterFace = -1;
+	for (int i = 0; i < polyhedron->m_faces.size(); i++)
+	{
+		const btFace& face = polyhedron->m_faces[i];
+		btVector3 faceNormal(face.m_plane[0], face.m_plane[1], face.m_plane[2]);
+		btScalar dist = faceNormal.dot(from) + face.m_plane[3] - margin;
+		btScalar denom = faceNormal.dot(dir);
+		if (denom == btScalar(0))
+		{
+			if (dist > btScalar(0))
+				return true;
+			continue;
+		}
+		btScalar t = -dist / denom;
+		if (denom < btScalar(0))
+		{
+			if (t > tEnter)
+			{
+				tEnter = t;
+				enterFace = i;
+			}
+		}
+		else
+		{
+			tExit = btMin(tExit, t);
+		}
+		if (tEnter > tExit)
+			return true;
+	}
+	if (enterFace >= 0 && tEnter >= btScalar(0) && tEnter <= btScalar(1))
+	{
+		const btFace& face = polyhedron->m_faces[enterFace];
+		hasHit = true;
+		hitFraction = tEnter;
+		hitNormal.setValue(face.m_plane[0], face.m_plane[1], face.m_plane[2]);
+	}
+	return true;
+}
+
 void btCollisionWorld::rayTestSingleInternal(const btTransform& rayFromTrans, const btTransform& rayToTrans,
 											 const btCollisionObjectWrapper* collisionObjectWrap,
 											 RayResultCallback& resultCallback)
@@ -293,6 +552,31 @@ void btCollisionWorld::rayTestSingleInternal(const btTransform& rayFromTrans, co
 	const btCollisionShape* collisionShape = collisionObjectWrap->getCollisionShape();
 	const btTransform& colObjWorldTransform = collisionObjectWrap->getWorldTransform();
 
+	if (!(resultCallback.m_flags & btTriangleRaycastCallback::kF_DisableAnalyticRaytest))
+	{
+		btTransform worldTocollisionObject = colObjWorldTransform.inverse();
+		btVector3 rayFromLocal = worldTocollisionObject * rayFromTrans.getOrigin();
+		btVector3 rayToLocal = worldTocollisionObject * rayToTrans.getOrigin();
+		bool hasHit;
+		btScalar hitFraction;
+		btVector3 hitNormalLocal;
+		if (btRayTestPrimitive(collisionShape, rayFromLocal, rayToLocal, resultCallback.m_flags, hasHit, hitFraction, hitNormalLocal))
+		{
+			if (hasHit && hitFraction < resultCallback.m_closestHitFraction)
+			{
+				btCollisionWorld::LocalRayResult localRayResult(
+					collisionObjectWrap->getCollisionObject(),
+					0,
+					colObjWorldTransform.getBasis() * hitNormalLocal,
+					hitFraction);
+
+				bool normalInWorldSpace = true;
+				resultCallback.addSingleResult(localRayResult, normalInWorldSpace);
+			}
+			return;
+		}
+	}
+
 	if (collisionShape->isConvex())
 	{
 		//		BT_PROFILE("rayTestConvex");
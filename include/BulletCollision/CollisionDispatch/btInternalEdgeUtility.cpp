@@ -9,6 +9,10 @@
 #include "BulletCollision/NarrowPhaseCollision/btManifoldPoint.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btRadixSort.h"
+#include "LinearMath/btQuickprof.h"
+#include <string.h>
 
 //#define DEBUG_INTERNAL_EDGE
 
@@ -46,12 +50,26 @@ static btScalar btGetAngle(const btVector3& edgeA, const btVector3& normalA, con
 	return angle;
 }
 
+#define BT_SHARED_EDGE_FOUND 8
+
 struct btConnectivityProcessor : public btTriangleCallback
 {
 	int m_partIdA;
 	int m_triangleIndexA;
 	btVector3* m_triangleVerticesA;
 	btTriangleInfoMap* m_triangleInfoMap;
+	btTriangleInfo* m_sharedEdgeInfo;  //if set, shared edges update this info instead of the map entry of triangle A
+	int m_sharedEdges;                 //TRI_INFO_*_CONVEX bits of the edges written to m_sharedEdgeInfo, BT_SHARED_EDGE_FOUND
+
+	btConnectivityProcessor()
+		: m_partIdA(0),
+		  m_triangleIndexA(0),
+		  m_triangleVerticesA(0),
+		  m_triangleInfoMap(0),
+		  m_sharedEdgeInfo(0),
+		  m_sharedEdges(0)
+	{
+	}
 
 	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
 	{
@@ -133,14 +151,22 @@ struct btConnectivityProcessor : public btTriangleCallback
 					sharedVertsB[0] = tmp;
 				}
 
-				int hash = btGetHash(m_partIdA, m_triangleIndexA);
-
-				btTriangleInfo* info = m_triangleInfoMap->find(hash);
-				if (!info)
+				btTriangleInfo* info = m_sharedEdgeInfo;
+				if (info)
 				{
-					btTriangleInfo tmp;
-					m_triangleInfoMap->insert(hash, tmp);
+					m_sharedEdges |= BT_SHARED_EDGE_FOUND;
+				}
+				else
+				{
+					int hash = btGetHash(m_partIdA, m_triangleIndexA);
+
 					info = m_triangleInfoMap->find(hash);
+					if (!info)
+					{
+						btTriangleInfo tmp;
+						m_triangleInfoMap->insert(hash, tmp);
+						info = m_triangleInfoMap->find(hash);
+					}
 				}
 
 				int sumvertsA = sharedVertsA[0] + sharedVertsA[1];
@@ -232,6 +258,7 @@ struct btConnectivityProcessor : public btTriangleCallback
 #endif  //DEBUG_INTERNAL_EDGE
 
 						info->m_edgeV0V1Angle = -correctedAngle;
+						m_sharedEdges |= TRI_INFO_V0V1_CONVEX;
 
 						if (isConvex)
 							info->m_flags |= TRI_INFO_V0V1_CONVEX;
@@ -255,6 +282,7 @@ struct btConnectivityProcessor : public btTriangleCallback
 						}
 #endif  //DEBUG_INTERNAL_EDGE
 						info->m_edgeV2V0Angle = -correctedAngle;
+						m_sharedEdges |= TRI_INFO_V2V0_CONVEX;
 						if (isConvex)
 							info->m_flags |= TRI_INFO_V2V0_CONVEX;
 						break;
@@ -276,6 +304,7 @@ struct btConnectivityProcessor : public btTriangleCallback
 						}
 #endif  //DEBUG_INTERNAL_EDGE
 						info->m_edgeV1V2Angle = -correctedAngle;
+						m_sharedEdges |= TRI_INFO_V1V2_CONVEX;
 
 						if (isConvex)
 							info->m_flags |= TRI_INFO_V1V2_CONVEX;
@@ -424,6 +453,898 @@ void btGenerateInternalEdgeInfo(btHeightfieldTerrainShape* heightfieldShape, btT
 
 }
 
+/////////////////////////////////////////////////////////
+// btGenerateInternalEdgeInfoMt
+/////////////////////////////////////////////////////////
+
+#define BT_INTERNAL_EDGE_BATCH_SIZE (64 * 1024)  //triangles A per btParallelFor, their infos are merged into the map in order after each batch
+#define BT_INTERNAL_EDGE_CHUNK_SIZE (16 * 1024)
+
+///adds the shared edges that btConnectivityProcessor found for triangle A to the map, with the same result as if it had updated the map entry
+static void btMergeSharedEdgeInfo(btTriangleInfoMap* triangleInfoMap, int partId, int triangleIndex, const btTriangleInfo& info, int sharedEdges)
+{
+	if (!(sharedEdges & BT_SHARED_EDGE_FOUND))
+		return;
+
+	int hash = btGetHash(partId, triangleIndex);
+	btTriangleInfo* entry = triangleInfoMap->find(hash);
+	if (!entry)
+	{
+		btTriangleInfo tmp;
+		triangleInfoMap->insert(hash, tmp);
+		entry = triangleInfoMap->find(hash);
+	}
+	entry->m_flags |= info.m_flags;
+	if (sharedEdges & TRI_INFO_V0V1_CONVEX)
+		entry->m_edgeV0V1Angle = info.m_edgeV0V1Angle;
+	if (sharedEdges & TRI_INFO_V1V2_CONVEX)
+		entry->m_edgeV1V2Angle = info.m_edgeV1V2Angle;
+	if (sharedEdges & TRI_INFO_V2V0_CONVEX)
+		entry->m_edgeV2V0Angle = info.m_edgeV2V0Angle;
+}
+
+struct btWeldedEdge
+{
+	int m_vertex;  //the higher welded vertex, the edges are grouped by the lower one
+	int m_triangle;
+};
+
+struct btWeldedEdgeLess
+{
+	bool operator()(const btWeldedEdge& a, const btWeldedEdge& b) const
+	{
+		return a.m_vertex < b.m_vertex || (a.m_vertex == b.m_vertex && a.m_triangle < b.m_triangle);
+	}
+};
+
+///all triangles of a btBvhTriangleMeshShape, with the vertices welded by m_equalVertexThreshold.
+///Triangles that share a welded edge, or a welded vertex if one of them is collapsed, are the only ones btConnectivityProcessor can find a shared edge for.
+struct btInternalEdgeMesh
+{
+	btAlignedObjectArray<btVector3> m_verticesA;  //scaled like btGenerateInternalEdgeInfo does for triangle A
+	btAlignedObjectArray<btVector3> m_verticesB;  //scaled like btBvhTriangleMeshShape::processAllTriangles, empty if the same as m_verticesA
+	btAlignedObjectArray<int> m_partVertexOffsets;
+	btAlignedObjectArray<int> m_partTriangleOffsets;
+	btAlignedObjectArray<int> m_triangleVertices;  //3 per triangle
+	btAlignedObjectArray<int> m_triangleParts;
+	btAlignedObjectArray<int> m_weldedVertices;       //per vertex
+	btAlignedObjectArray<unsigned char> m_collapsed;  //per triangle, two of its vertices are welded together
+	btAlignedObjectArray<int> m_edgeStarts;           //per welded vertex
+	btAlignedObjectArray<btWeldedEdge> m_edges;
+	btAlignedObjectArray<int> m_vertexTriangleStarts;  //per welded vertex, only if there are collapsed triangles
+	btAlignedObjectArray<int> m_vertexTriangles;
+	btAlignedObjectArray<int> m_leafNodes;  //per triangle, in the quantized bvh
+	btAlignedObjectArray<int> m_ranks;      //per triangle, the order in which reportAabbOverlappingNodex reports the leaves
+
+	const btVector3& getVertexB(int vertex) const
+	{
+		return m_verticesB.size() ? m_verticesB[vertex] : m_verticesA[vertex];
+	}
+
+	int getTriangleIndex(int triangle) const
+	{
+		return triangle - m_partTriangleOffsets[m_triangleParts[triangle]];
+	}
+
+	void getWeldedVertices(int triangle, int* welded) const
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			welded[j] = m_weldedVertices[m_triangleVertices[triangle * 3 + j]];
+		}
+	}
+
+	///triangles that may share an edge with triangle, in any order and with duplicates
+	void findCandidates(int triangle, btAlignedObjectArray<int>& candidates) const
+	{
+		candidates.resize(0);
+		int welded[3];
+		getWeldedVertices(triangle, welded);
+		bool collapsed = m_collapsed[triangle] != 0;
+		if (!collapsed)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				int lo = btMin(welded[j], welded[(j + 1) % 3]);
+				int hi = btMax(welded[j], welded[(j + 1) % 3]);
+				int begin = m_edgeStarts[lo];
+				int end = m_edgeStarts[lo + 1];
+				while (begin < end)
+				{
+					int mid = (begin + end) / 2;
+					if (m_edges[mid].m_vertex < hi)
+						begin = mid + 1;
+					else
+						end = mid;
+				}
+				for (int i = begin; i < m_edgeStarts[lo + 1] && m_edges[i].m_vertex == hi; i++)
+				{
+					candidates.push_back(m_edges[i].m_triangle);
+				}
+			}
+		}
+		if (m_vertexTriangleStarts.size())
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				if ((j > 0 && welded[j] == welded[0]) || (j > 1 && welded[j] == welded[1]))
+					continue;
+				for (int i = m_vertexTriangleStarts[welded[j]]; i < m_vertexTriangleStarts[welded[j] + 1]; i++)
+				{
+					int other = m_vertexTriangles[i];
+					if (collapsed || m_collapsed[other])
+						candidates.push_back(other);
+				}
+			}
+		}
+	}
+};
+
+struct btInternalEdgeGatherLoop : public btIParallelForBody
+{
+	btInternalEdgeMesh* m_mesh;
+	const unsigned char* m_vertexbase;
+	PHY_ScalarType m_type;
+	int m_stride;
+	const unsigned char* m_indexbase;
+	int m_indexstride;
+	PHY_ScalarType m_indicestype;
+	btVector3 m_meshScaling;
+	int m_partId;
+	bool m_gatherVertices;  //or the triangles
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btInternalEdgeGatherLoop");
+		btInternalEdgeMesh& mesh = *m_mesh;
+		if (m_gatherVertices)
+		{
+			int offset = mesh.m_partVertexOffsets[m_partId];
+			for (int i = iBegin; i < iEnd; i++)
+			{
+				if (m_type == PHY_FLOAT)
+				{
+					float* graphicsbase = (float*)(m_vertexbase + i * m_stride);
+					mesh.m_verticesA[offset + i] = btVector3(
+						graphicsbase[0] * m_meshScaling.getX(),
+						graphicsbase[1] * m_meshScaling.getY(),
+						graphicsbase[2] * m_meshScaling.getZ());
+					if (mesh.m_verticesB.size())
+						mesh.m_verticesB[offset + i] = mesh.m_verticesA[offset + i];
+				}
+				else
+				{
+					double* graphicsbase = (double*)(m_vertexbase + i * m_stride);
+					mesh.m_verticesA[offset + i] = btVector3(btScalar(graphicsbase[0] * m_meshScaling.getX()), btScalar(graphicsbase[1] * m_meshScaling.getY()), btScalar(graphicsbase[2] * m_meshScaling.getZ()));
+					if (mesh.m_verticesB.size())
+					{
+						mesh.m_verticesB[offset + i] = btVector3(
+							btScalar(graphicsbase[0]) * m_meshScaling.getX(),
+							btScalar(graphicsbase[1]) * m_meshScaling.getY(),
+							btScalar(graphicsbase[2]) * m_meshScaling.getZ());
+					}
+				}
+			}
+		}
+		else
+		{
+			int vertexOffset = mesh.m_partVertexOffsets[m_partId];
+			int offset = mesh.m_partTriangleOffsets[m_partId];
+			for (int triangleIndex = iBegin; triangleIndex < iEnd; triangleIndex++)
+			{
+				unsigned int* gfxbase = (unsigned int*)(m_indexbase + triangleIndex * m_indexstride);
+				for (int j = 0; j < 3; j++)
+				{
+					int graphicsindex = 0;
+					switch (m_indicestype)
+					{
+						case PHY_INTEGER: graphicsindex = gfxbase[j]; break;
+						case PHY_SHORT: graphicsindex = ((unsigned short*)gfxbase)[j]; break;
+						case PHY_UCHAR: graphicsindex = ((unsigned char*)gfxbase)[j]; break;
+						default: btAssert(0);
+					}
+					mesh.m_triangleVertices[(offset + triangleIndex) * 3 + j] = vertexOffset + graphicsindex;
+				}
+				mesh.m_triangleParts[offset + triangleIndex] = m_partId;
+			}
+		}
+	}
+};
+
+///returns how far the vertices of triangle B may be from the ones of triangle A
+static btScalar btGatherInternalEdgeMesh(btStridingMeshInterface* meshInterface, btInternalEdgeMesh& mesh)
+{
+	BT_PROFILE("btGatherInternalEdgeMesh");
+	int numParts = meshInterface->getNumSubParts();
+	mesh.m_partVertexOffsets.resize(numParts + 1);
+	mesh.m_partTriangleOffsets.resize(numParts + 1);
+	mesh.m_partVertexOffsets[0] = 0;
+	mesh.m_partTriangleOffsets[0] = 0;
+	bool differentVerticesB = false;
+	for (int partId = 0; partId < numParts; partId++)
+	{
+		const unsigned char* vertexbase = 0;
+		int numverts = 0;
+		PHY_ScalarType type = PHY_INTEGER;
+		int stride = 0;
+		const unsigned char* indexbase = 0;
+		int indexstride = 0;
+		int numfaces = 0;
+		PHY_ScalarType indicestype = PHY_INTEGER;
+		meshInterface->getLockedReadOnlyVertexIndexBase(&vertexbase, numverts, type, stride, &indexbase, indexstride, numfaces, indicestype, partId);
+		meshInterface->unLockReadOnlyVertexBase(partId);
+		mesh.m_partVertexOffsets[partId + 1] = mesh.m_partVertexOffsets[partId] + numverts;
+		mesh.m_partTriangleOffsets[partId + 1] = mesh.m_partTriangleOffsets[partId] + numfaces;
+#ifndef BT_USE_DOUBLE_PRECISION
+		//double vertices are converted before the scaling for triangle B
+		differentVerticesB |= (type != PHY_FLOAT);
+#endif
+	}
+
+	int numVertices = mesh.m_partVertexOffsets[numParts];
+	int numTriangles = mesh.m_partTriangleOffsets[numParts];
+	mesh.m_verticesA.resizeNoInitialize(numVertices);
+	mesh.m_verticesB.resizeNoInitialize(differentVerticesB ? numVertices : 0);
+	mesh.m_triangleVertices.resizeNoInitialize(numTriangles * 3);
+	mesh.m_triangleParts.resizeNoInitialize(numTriangles);
+
+	btInternalEdgeGatherLoop loop;
+	loop.m_mesh = &mesh;
+	loop.m_meshScaling = meshInterface->getScaling();
+	for (int partId = 0; partId < numParts; partId++)
+	{
+		int numverts = 0;
+		int numfaces = 0;
+		meshInterface->getLockedReadOnlyVertexIndexBase(&loop.m_vertexbase, numverts, loop.m_type, loop.m_stride, &loop.m_indexbase, loop.m_indexstride, numfaces, loop.m_indicestype, partId);
+		loop.m_partId = partId;
+		loop.m_gatherVertices = true;
+		btParallelFor(0, numverts, BT_INTERNAL_EDGE_CHUNK_SIZE, loop);
+		loop.m_gatherVertices = false;
+		btParallelFor(0, numfaces, BT_INTERNAL_EDGE_CHUNK_SIZE, loop);
+		meshInterface->unLockReadOnlyVertexBase(partId);
+	}
+
+	btScalar maxDistance(0);
+	for (int i = 0; i < mesh.m_verticesB.size(); i++)
+	{
+		maxDistance = btMax(maxDistance, (mesh.m_verticesB[i] - mesh.m_verticesA[i]).length());
+	}
+	return maxDistance;
+}
+
+struct btWeldEntry
+{
+	unsigned long long m_cell;  //21 bits per axis, x major
+	int m_vertex;
+	int m_padding;
+};
+
+struct btWeldCellKey
+{
+	unsigned long long operator()(const btWeldEntry& entry) const { return entry.m_cell; }
+};
+
+struct btWeldPositionLess
+{
+	const btVector3* m_positions;
+
+	bool operator()(const btWeldEntry& a, const btWeldEntry& b) const
+	{
+		const btVector3& pa = m_positions[a.m_vertex];
+		const btVector3& pb = m_positions[b.m_vertex];
+		for (int k = 0; k < 3; k++)
+		{
+			if (pa[k] != pb[k])
+				return pa[k] < pb[k];
+		}
+		return a.m_vertex < b.m_vertex;
+	}
+};
+
+///welds the positions of a cell that are equal to the first of them, then finds the pairs of different positions closer than the radius
+struct btWeldCellLoop : public btIParallelForBody
+{
+	const btVector3* m_positions;
+	btAlignedObjectArray<btWeldEntry>* m_entries;  //sorted by cell
+	const int* m_cellStarts;
+	int m_numCells;
+	int* m_welded;
+	btVector3 m_gridMin;
+	btScalar m_cellSize;
+	btScalar m_radius;
+	int m_maxCell;
+	bool m_findPairs;
+	btAlignedObjectArray<int>* m_chunkPairs;
+
+	unsigned long long getCell(const btVector3& position) const
+	{
+		unsigned long long cell = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			btScalar c = (position[k] - m_gridMin[k]) / m_cellSize;
+			unsigned long long ck = c > btScalar(0) ? (unsigned long long)btMin(c, btScalar(m_maxCell)) : 0;
+			cell = (cell << 21) | ck;
+		}
+		return cell;
+	}
+
+	int findCell(unsigned long long cell) const
+	{
+		const btWeldEntry* entries = &(*m_entries)[0];
+		int begin = 0;
+		int end = m_numCells;
+		while (begin < end)
+		{
+			int mid = (begin + end) / 2;
+			if (entries[m_cellStarts[mid]].m_cell < cell)
+				begin = mid + 1;
+			else
+				end = mid;
+		}
+		return (begin < m_numCells && entries[m_cellStarts[begin]].m_cell == cell) ? begin : -1;
+	}
+
+	void findPairs(int vertex, int cellIndex, btAlignedObjectArray<int>& pairs) const
+	{
+		const btWeldEntry* entries = &(*m_entries)[0];
+		btScalar radius2 = m_radius * m_radius;
+		for (int i = m_cellStarts[cellIndex]; i < m_cellStarts[cellIndex + 1]; i++)
+		{
+			int other = entries[i].m_vertex;
+			if (m_welded[other] == other && other > vertex && (m_positions[other] - m_positions[vertex]).length2() <= radius2)
+			{
+				pairs.push_back(vertex);
+				pairs.push_back(other);
+			}
+		}
+	}
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btWeldCellLoop");
+		btWeldEntry* entries = &(*m_entries)[0];
+		int chunkBegin = iBegin * BT_INTERNAL_EDGE_CHUNK_SIZE;
+		int chunkEnd = btMin(iEnd * BT_INTERNAL_EDGE_CHUNK_SIZE, m_numCells);
+		for (int cellIndex = chunkBegin; cellIndex < chunkEnd; cellIndex++)
+		{
+			int begin = m_cellStarts[cellIndex];
+			int end = m_cellStarts[cellIndex + 1];
+			if (!m_findPairs)
+			{
+				if (end - begin > 1)
+				{
+					btWeldPositionLess positionLess;
+					positionLess.m_positions = m_positions;
+					m_entries->quickSortInternal(positionLess, begin, end - 1);
+				}
+				int first = entries[begin].m_vertex;
+				for (int i = begin; i < end; i++)
+				{
+					int vertex = entries[i].m_vertex;
+					if (m_positions[vertex] != m_positions[first])
+						first = vertex;
+					m_welded[vertex] = first;
+				}
+				continue;
+			}
+
+			btAlignedObjectArray<int>& pairs = m_chunkPairs[cellIndex / BT_INTERNAL_EDGE_CHUNK_SIZE];
+			for (int i = begin; i < end; i++)
+			{
+				int vertex = entries[i].m_vertex;
+				if (m_welded[vertex] != vertex)
+					continue;
+
+				//twice the radius, the cells are at least 64 times the radius so the neighbours are at most one cell away
+				const btVector3& position = m_positions[vertex];
+				btVector3 margin(2 * m_radius, 2 * m_radius, 2 * m_radius);
+				unsigned long long cellMin = getCell(position - margin);
+				unsigned long long cellMax = getCell(position + margin);
+				const unsigned long long mask = (1 << 21) - 1;
+				for (unsigned long long x = cellMin >> 42; x <= cellMax >> 42; x++)
+				{
+					for (unsigned long long y = (cellMin >> 21) & mask; y <= ((cellMax >> 21) & mask); y++)
+					{
+						for (unsigned long long z = cellMin & mask; z <= (cellMax & mask); z++)
+						{
+							unsigned long long cell = (x << 42) | (y << 21) | z;
+							int otherIndex = cell == entries[begin].m_cell ? cellIndex : findCell(cell);
+							if (otherIndex >= 0)
+								findPairs(vertex, otherIndex, pairs);
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+static int btWeldFind(btAlignedObjectArray<int>& parents, int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+///welds the vertices that are equal or closer than the radius, directly or through other vertices, to the lowest of them
+static void btWeldVertices(const btAlignedObjectArray<btVector3>& positions, btScalar radius, btAlignedObjectArray<int>& welded)
+{
+	BT_PROFILE("btWeldVertices");
+	int numVertices = positions.size();
+	welded.resizeNoInitialize(numVertices);
+	if (!numVertices)
+		return;
+
+	btVector3 gridMin = positions[0];
+	btVector3 gridMax = positions[0];
+	for (int i = 1; i < numVertices; i++)
+	{
+		gridMin.setMin(positions[i]);
+		gridMax.setMax(positions[i]);
+	}
+	btVector3 extent = gridMax - gridMin;
+
+	btWeldCellLoop loop;
+	btAlignedObjectArray<btWeldEntry> entries;
+	loop.m_positions = &positions[0];
+	loop.m_entries = &entries;
+	loop.m_welded = &welded[0];
+	loop.m_gridMin = gridMin;
+	loop.m_cellSize = btMax(64 * radius, extent[extent.maxAxis()] / btScalar(1 << 20));
+	loop.m_radius = radius;
+	loop.m_maxCell = (1 << 21) - 1;
+	entries.resizeNoInitialize(numVertices);
+	for (int i = 0; i < numVertices; i++)
+	{
+		entries[i].m_cell = loop.getCell(positions[i]);
+		entries[i].m_vertex = i;
+		entries[i].m_padding = 0;
+	}
+	//the entries start in vertex order, so the vertices of a cell stay ordered
+	btAlignedObjectArray<btWeldEntry> sortBuffer;
+	btAlignedObjectArray<unsigned int> sortHistograms;
+	btRadixSort(entries, sortBuffer, sortHistograms, btWeldCellKey(), 63, BT_INTERNAL_EDGE_CHUNK_SIZE);
+
+	btAlignedObjectArray<int> cellStarts;
+	for (int i = 0; i < numVertices; i++)
+	{
+		if (!i || entries[i].m_cell != entries[i - 1].m_cell)
+			cellStarts.push_back(i);
+	}
+	int numCells = cellStarts.size();
+	cellStarts.push_back(numVertices);
+	loop.m_cellStarts = &cellStarts[0];
+	loop.m_numCells = numCells;
+
+	int numChunks = (numCells + BT_INTERNAL_EDGE_CHUNK_SIZE - 1) / BT_INTERNAL_EDGE_CHUNK_SIZE;
+	btAlignedObjectArray<btAlignedObjectArray<int> > chunkPairs;
+	chunkPairs.resize(numChunks);
+	loop.m_chunkPairs = &chunkPairs[0];
+	loop.m_findPairs = false;
+	btParallelFor(0, numChunks, 1, loop);
+	loop.m_findPairs = true;
+	btParallelFor(0, numChunks, 1, loop);
+
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		const btAlignedObjectArray<int>& pairs = chunkPairs[chunk];
+		for (int i = 0; i < pairs.size(); i += 2)
+		{
+			int a = btWeldFind(welded, pairs[i]);
+			int b = btWeldFind(welded, pairs[i + 1]);
+			if (a != b)
+				welded[btMax(a, b)] = btMin(a, b);
+		}
+	}
+	for (int i = 0; i < numVertices; i++)
+	{
+		welded[i] = btWeldFind(welded, i);
+	}
+}
+
+struct btInternalEdgeSortLoop : public btIParallelForBody
+{
+	btAlignedObjectArray<btWeldedEdge>* m_edges;
+	const int* m_edgeStarts;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btInternalEdgeSortLoop");
+		for (int vertex = iBegin; vertex < iEnd; vertex++)
+		{
+			if (m_edgeStarts[vertex + 1] - m_edgeStarts[vertex] > 1)
+				m_edges->quickSortInternal(btWeldedEdgeLess(), m_edgeStarts[vertex], m_edgeStarts[vertex + 1] - 1);
+		}
+	}
+};
+
+///groups the edges of the triangles by their welded vertices, and the triangles by vertex if there are collapsed triangles
+static void btBuildInternalEdges(btInternalEdgeMesh& mesh)
+{
+	BT_PROFILE("btBuildInternalEdges");
+	int numWelded = mesh.m_weldedVertices.size();
+	int numTriangles = mesh.m_triangleParts.size();
+	mesh.m_collapsed.resizeNoInitialize(numTriangles);
+	mesh.m_edgeStarts.resize(numWelded + 1, 0);
+	int numCollapsed = 0;
+	for (int i = 0; i < numTriangles; i++)
+	{
+		int welded[3];
+		mesh.getWeldedVertices(i, welded);
+		bool collapsed = welded[0] == welded[1] || welded[1] == welded[2] || welded[2] == welded[0];
+		mesh.m_collapsed[i] = collapsed;
+		if (collapsed)
+		{
+			numCollapsed++;
+			continue;
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			mesh.m_edgeStarts[btMin(welded[j], welded[(j + 1) % 3]) + 1]++;
+		}
+	}
+	for (int i = 0; i < numWelded; i++)
+	{
+		mesh.m_edgeStarts[i + 1] += mesh.m_edgeStarts[i];
+	}
+
+	btAlignedObjectArray<int> cursors;
+	cursors.resizeNoInitialize(numWelded);
+	for (int i = 0; i < numWelded; i++)
+	{
+		cursors[i] = mesh.m_edgeStarts[i];
+	}
+	mesh.m_edges.resizeNoInitialize(mesh.m_edgeStarts[numWelded]);
+	for (int i = 0; i < numTriangles; i++)
+	{
+		if (mesh.m_collapsed[i])
+			continue;
+		int welded[3];
+		mesh.getWeldedVertices(i, welded);
+		for (int j = 0; j < 3; j++)
+		{
+			btWeldedEdge& edge = mesh.m_edges[cursors[btMin(welded[j], welded[(j + 1) % 3])]++];
+			edge.m_vertex = btMax(welded[j], welded[(j + 1) % 3]);
+			edge.m_triangle = i;
+		}
+	}
+	btInternalEdgeSortLoop loop;
+	loop.m_edges = &mesh.m_edges;
+	loop.m_edgeStarts = &mesh.m_edgeStarts[0];
+	btParallelFor(0, numWelded, BT_INTERNAL_EDGE_CHUNK_SIZE, loop);
+
+	if (!numCollapsed)
+		return;
+
+	mesh.m_vertexTriangleStarts.resize(numWelded + 1, 0);
+	for (int i = 0; i < numTriangles; i++)
+	{
+		int welded[3];
+		mesh.getWeldedVertices(i, welded);
+		for (int j = 0; j < 3; j++)
+		{
+			if ((j > 0 && welded[j] == welded[0]) || (j > 1 && welded[j] == welded[1]))
+				continue;
+			mesh.m_vertexTriangleStarts[welded[j] + 1]++;
+		}
+	}
+	for (int i = 0; i < numWelded; i++)
+	{
+		mesh.m_vertexTriangleStarts[i + 1] += mesh.m_vertexTriangleStarts[i];
+		cursors[i] = mesh.m_vertexTriangleStarts[i];
+	}
+	mesh.m_vertexTriangles.resizeNoInitialize(mesh.m_vertexTriangleStarts[numWelded]);
+	for (int i = 0; i < numTriangles; i++)
+	{
+		int welded[3];
+		mesh.getWeldedVertices(i, welded);
+		for (int j = 0; j < 3; j++)
+		{
+			if ((j > 0 && welded[j] == welded[0]) || (j > 1 && welded[j] == welded[1]))
+				continue;
+			mesh.m_vertexTriangles[cursors[welded[j]]++] = i;
+		}
+	}
+}
+
+static void btRankLeafNodes(const btQuantizedBvhNode* nodes, int nodeBegin, int nodeEnd, btInternalEdgeMesh& mesh, int& rank)
+{
+	for (int i = nodeBegin; i < nodeEnd; i++)
+	{
+		if (nodes[i].isLeafNode())
+		{
+			int partId = nodes[i].getPartId();
+			btAssert(partId < mesh.m_partTriangleOffsets.size() - 1);
+			int triangle = mesh.m_partTriangleOffsets[partId] + nodes[i].getTriangleIndex();
+			mesh.m_ranks[triangle] = rank++;
+			mesh.m_leafNodes[triangle] = i;
+		}
+	}
+}
+
+///the order of the leaves in reportAabbOverlappingNodex, the stackless and recursive traversals report them in node order
+static void btRankLeafNodes(btOptimizedBvh* bvh, btInternalEdgeMesh& mesh)
+{
+	int numTriangles = mesh.m_triangleParts.size();
+	mesh.m_ranks.resize(numTriangles, -1);
+	mesh.m_leafNodes.resize(numTriangles, -1);
+	const btQuantizedBvhNode* nodes = &bvh->getQuantizedNodeArray()[0];
+	int rank = 0;
+	if (bvh->getTraversalMode() == btQuantizedBvh::TRAVERSAL_STACKLESS_CACHE_FRIENDLY)
+	{
+		const BvhSubtreeInfoArray& subtrees = bvh->getSubtreeInfoArray();
+		for (int i = 0; i < subtrees.size(); i++)
+		{
+			btRankLeafNodes(nodes, subtrees[i].m_rootNodeIndex, subtrees[i].m_rootNodeIndex + subtrees[i].m_subtreeSize, mesh, rank);
+		}
+	}
+	else
+	{
+		int numNodes = nodes[0].isLeafNode() ? 1 : nodes[0].getEscapeIndex();
+		btRankLeafNodes(nodes, 0, numNodes, mesh, rank);
+	}
+}
+
+struct btInternalEdgeRankLess
+{
+	const int* m_ranks;
+
+	bool operator()(int a, int b) const
+	{
+		return m_ranks[a] < m_ranks[b];
+	}
+};
+
+///runs btConnectivityProcessor for a batch of triangles A against the candidates that processAllTriangles would report, in the same order
+struct btInternalEdgeInfoLoop : public btIParallelForBody
+{
+	const btInternalEdgeMesh* m_mesh;
+	btOptimizedBvh* m_bvh;
+	btTriangleInfoMap* m_triangleInfoMap;
+	btTriangleInfo* m_infos;
+	int* m_sharedEdges;
+	int m_batchBegin;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btInternalEdgeInfoLoop");
+		const btInternalEdgeMesh& mesh = *m_mesh;
+		const btQuantizedBvhNode* nodes = &m_bvh->getQuantizedNodeArray()[0];
+		btInternalEdgeRankLess rankLess;
+		rankLess.m_ranks = &mesh.m_ranks[0];
+		btAlignedObjectArray<int> candidates;
+		for (int triangle = iBegin; triangle < iEnd; triangle++)
+		{
+			btTriangleInfo& info = m_infos[triangle - m_batchBegin];
+			info = btTriangleInfo();
+
+			btVector3 triangleVerts[3];
+			btVector3 aabbMin, aabbMax;
+			aabbMin.setValue(btScalar(BT_LARGE_FLOAT), btScalar(BT_LARGE_FLOAT), btScalar(BT_LARGE_FLOAT));
+			aabbMax.setValue(btScalar(-BT_LARGE_FLOAT), btScalar(-BT_LARGE_FLOAT), btScalar(-BT_LARGE_FLOAT));
+			for (int j = 0; j < 3; j++)
+			{
+				triangleVerts[j] = mesh.m_verticesA[mesh.m_triangleVertices[triangle * 3 + j]];
+				aabbMin.setMin(triangleVerts[j]);
+				aabbMax.setMax(triangleVerts[j]);
+			}
+			unsigned short int quantizedAabbMin[3];
+			unsigned short int quantizedAabbMax[3];
+			m_bvh->quantizeWithClamp(quantizedAabbMin, aabbMin, 0);
+			m_bvh->quantizeWithClamp(quantizedAabbMax, aabbMax, 1);
+
+			mesh.findCandidates(triangle, candidates);
+			int numCandidates = 0;
+			for (int i = 0; i < candidates.size(); i++)
+			{
+				int leaf = mesh.m_leafNodes[candidates[i]];
+				if (leaf >= 0 && testQuantizedAabbAgainstQuantizedAabb(quantizedAabbMin, quantizedAabbMax, nodes[leaf].m_quantizedAabbMin, nodes[leaf].m_quantizedAabbMax))
+					candidates[numCandidates++] = candidates[i];
+			}
+			candidates.resize(numCandidates);
+			candidates.quickSort(rankLess);
+
+			btConnectivityProcessor connectivityProcessor;
+			connectivityProcessor.m_partIdA = mesh.m_triangleParts[triangle];
+			connectivityProcessor.m_triangleIndexA = mesh.getTriangleIndex(triangle);
+			connectivityProcessor.m_triangleVerticesA = &triangleVerts[0];
+			connectivityProcessor.m_triangleInfoMap = m_triangleInfoMap;
+			connectivityProcessor.m_sharedEdgeInfo = &info;
+			for (int i = 0; i < numCandidates; i++)
+			{
+				int other = candidates[i];
+				if (i > 0 && other == candidates[i - 1])
+					continue;
+				btVector3 otherVerts[3];
+				for (int j = 0; j < 3; j++)
+				{
+					otherVerts[j] = mesh.getVertexB(mesh.m_triangleVertices[other * 3 + j]);
+				}
+				connectivityProcessor.processTriangle(otherVerts, mesh.m_triangleParts[other], mesh.getTriangleIndex(other));
+			}
+			m_sharedEdges[triangle - m_batchBegin] = connectivityProcessor.m_sharedEdges;
+		}
+	}
+};
+
+void btGenerateInternalEdgeInfoMt(btBvhTriangleMeshShape* trimeshShape, btTriangleInfoMap* triangleInfoMap)
+{
+	//the user pointer shouldn't already be used for other purposes, we intend to store connectivity info there!
+	if (trimeshShape->getTriangleInfoMap())
+		return;
+
+	btOptimizedBvh* bvh = trimeshShape->getOptimizedBvh();
+	if (!bvh || !bvh->isQuantized())
+	{
+		//the candidates are ordered like the quantized traversal
+		btGenerateInternalEdgeInfo(trimeshShape, triangleInfoMap);
+		return;
+	}
+
+	trimeshShape->setTriangleInfoMap(triangleInfoMap);
+
+	BT_PROFILE("btGenerateInternalEdgeInfoMt");
+
+	//no vertices are shared otherwise
+	if (!(triangleInfoMap->m_equalVertexThreshold > btScalar(0)))
+		return;
+
+	btInternalEdgeMesh mesh;
+	btScalar maxDistanceB = btGatherInternalEdgeMesh(trimeshShape->getMeshInterface(), mesh);
+	int numTriangles = mesh.m_triangleParts.size();
+	if (!numTriangles)
+		return;
+
+	//vertices of A and B are shared if they are closer than sqrt(m_equalVertexThreshold), weld with some margin
+	btScalar radius = 2 * (btSqrt(triangleInfoMap->m_equalVertexThreshold) + maxDistanceB);
+	btWeldVertices(mesh.m_verticesA, radius, mesh.m_weldedVertices);
+	btBuildInternalEdges(mesh);
+	btRankLeafNodes(bvh, mesh);
+
+	btAlignedObjectArray<btTriangleInfo> infos;
+	btAlignedObjectArray<int> sharedEdges;
+	infos.resize(btMin(numTriangles, BT_INTERNAL_EDGE_BATCH_SIZE));
+	sharedEdges.resize(infos.size());
+
+	btInternalEdgeInfoLoop loop;
+	loop.m_mesh = &mesh;
+	loop.m_bvh = bvh;
+	loop.m_triangleInfoMap = triangleInfoMap;
+	loop.m_infos = &infos[0];
+	loop.m_sharedEdges = &sharedEdges[0];
+	for (int batchBegin = 0; batchBegin < numTriangles; batchBegin += BT_INTERNAL_EDGE_BATCH_SIZE)
+	{
+		int batchEnd = btMin(batchBegin + BT_INTERNAL_EDGE_BATCH_SIZE, numTriangles);
+		loop.m_batchBegin = batchBegin;
+		btParallelFor(batchBegin, batchEnd, 64, loop);
+
+		//in the order of the serial version, so the map is identical
+		for (int triangle = batchBegin; triangle < batchEnd; triangle++)
+		{
+			btMergeSharedEdgeInfo(triangleInfoMap, mesh.m_triangleParts[triangle], mesh.getTriangleIndex(triangle), infos[triangle - batchBegin], sharedEdges[triangle - batchBegin]);
+		}
+	}
+}
+
+struct btInternalEdgeHeightfieldLoop : public btIParallelForBody
+{
+	const btHeightfieldTerrainShape* m_heightfieldShape;
+	btTriangleInfoMap* m_triangleInfoMap;
+	const btVector3* m_triangles;  //3 vertices per triangle
+	const int* m_partIds;
+	const int* m_triangleIndices;
+	btTriangleInfo* m_infos;
+	int* m_sharedEdges;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btInternalEdgeHeightfieldLoop");
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			m_infos[i] = btTriangleInfo();
+			btVector3 triangle[3] = {m_triangles[i * 3], m_triangles[i * 3 + 1], m_triangles[i * 3 + 2]};
+
+			btConnectivityProcessor connectivityProcessor;
+			connectivityProcessor.m_partIdA = m_partIds[i];
+			connectivityProcessor.m_triangleIndexA = m_triangleIndices[i];
+			connectivityProcessor.m_triangleVerticesA = triangle;
+			connectivityProcessor.m_triangleInfoMap = m_triangleInfoMap;
+			connectivityProcessor.m_sharedEdgeInfo = &m_infos[i];
+			btVector3 aabbMin, aabbMax;
+			aabbMin.setValue(btScalar(BT_LARGE_FLOAT), btScalar(BT_LARGE_FLOAT), btScalar(BT_LARGE_FLOAT));
+			aabbMax.setValue(btScalar(-BT_LARGE_FLOAT), btScalar(-BT_LARGE_FLOAT), btScalar(-BT_LARGE_FLOAT));
+			aabbMin.setMin(triangle[0]);
+			aabbMax.setMax(triangle[0]);
+			aabbMin.setMin(triangle[1]);
+			aabbMax.setMax(triangle[1]);
+			aabbMin.setMin(triangle[2]);
+			aabbMax.setMax(triangle[2]);
+
+			m_heightfieldShape->processAllTriangles(&connectivityProcessor, aabbMin, aabbMax);
+			m_sharedEdges[i] = connectivityProcessor.m_sharedEdges;
+		}
+	}
+};
+
+///collects the triangles A of the heightfield in batches, their neighbours are queried in parallel
+struct btInternalEdgeHeightfieldBatch : public btTriangleCallback
+{
+	btHeightfieldTerrainShape* m_heightfieldShape;
+	btTriangleInfoMap* m_triangleInfoMap;
+	btAlignedObjectArray<btVector3> m_triangles;
+	btAlignedObjectArray<int> m_partIds;
+	btAlignedObjectArray<int> m_triangleIndices;
+	btAlignedObjectArray<btTriangleInfo> m_infos;
+	btAlignedObjectArray<int> m_sharedEdges;
+
+	btInternalEdgeHeightfieldBatch(btHeightfieldTerrainShape* heightfieldShape, btTriangleInfoMap* triangleInfoMap)
+		: m_heightfieldShape(heightfieldShape),
+		  m_triangleInfoMap(triangleInfoMap)
+	{
+	}
+
+	virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+	{
+		m_triangles.push_back(triangle[0]);
+		m_triangles.push_back(triangle[1]);
+		m_triangles.push_back(triangle[2]);
+		m_partIds.push_back(partId);
+		m_triangleIndices.push_back(triangleIndex);
+		if (m_partIds.size() == BT_INTERNAL_EDGE_BATCH_SIZE)
+			flush();
+	}
+
+	void flush()
+	{
+		int numTriangles = m_partIds.size();
+		if (!numTriangles)
+			return;
+
+		m_infos.resizeNoInitialize(numTriangles);
+		m_sharedEdges.resizeNoInitialize(numTriangles);
+		btInternalEdgeHeightfieldLoop loop;
+		loop.m_heightfieldShape = m_heightfieldShape;
+		loop.m_triangleInfoMap = m_triangleInfoMap;
+		loop.m_triangles = &m_triangles[0];
+		loop.m_partIds = &m_partIds[0];
+		loop.m_triangleIndices = &m_triangleIndices[0];
+		loop.m_infos = &m_infos[0];
+		loop.m_sharedEdges = &m_sharedEdges[0];
+		btParallelFor(0, numTriangles, 16, loop);
+
+		for (int i = 0; i < numTriangles; i++)
+		{
+			btMergeSharedEdgeInfo(m_triangleInfoMap, m_partIds[i], m_triangleIndices[i], m_infos[i], m_sharedEdges[i]);
+		}
+		m_triangles.resize(0);
+		m_partIds.resize(0);
+		m_triangleIndices.resize(0);
+	}
+};
+
+void btGenerateInternalEdgeInfoMt(btHeightfieldTerrainShape* heightfieldShape, btTriangleInfoMap* triangleInfoMap)
+{
+	//the user pointer shouldn't already be used for other purposes, we intend to store connectivity info there!
+	if (heightfieldShape->getTriangleInfoMap())
+		return;
+
+	heightfieldShape->setTriangleInfoMap(triangleInfoMap);
+
+	BT_PROFILE("btGenerateInternalEdgeInfoMt");
+
+	btVector3 aabbMin, aabbMax;
+
+	aabbMax.setValue(btScalar(BT_LARGE_FLOAT), btScalar(BT_LARGE_FLOAT), btScalar(BT_LARGE_FLOAT));
+	aabbMin.setValue(btScalar(-BT_LARGE_FLOAT), btScalar(-BT_LARGE_FLOAT), btScalar(-BT_LARGE_FLOAT));
+
+	btInternalEdgeHeightfieldBatch batch(heightfieldShape, triangleInfoMap);
+	heightfieldShape->processAllTriangles(&batch, aabbMin, aabbMax);
+	batch.flush();
+}
+
 // Given a point and a line segment (defined by two points), compute the closest point
 // in the line.  Cap the point at the endpoints of the line segment.
 void btNearestPointInLineSegment(const btVector3& point, const btVector3& line0, const btVector3& line1, btVector3& nearestPoint)
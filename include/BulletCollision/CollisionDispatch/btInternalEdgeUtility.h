@@ -29,6 +29,15 @@ void btGenerateInternalEdgeInfo(btBvhTriangleMeshShape* trimeshShape, btTriangle
 
 void btGenerateInternalEdgeInfo(btHeightfieldTerrainShape* trimeshShape, btTriangleInfoMap* triangleInfoMap);
 
+///Multithreaded btGenerateInternalEdgeInfo with btParallelFor, the triangle info map is identical to the one of the serial version.
+///Instead of an aabb query per triangle the vertices are welded by m_equalVertexThreshold and the neighbours are looked up in
+///the sorted edge list of the welded vertices, they are then processed in the order of the bvh traversal.
+///Shapes without a quantized bvh use btGenerateInternalEdgeInfo.
+void btGenerateInternalEdgeInfoMt(btBvhTriangleMeshShape* trimeshShape, btTriangleInfoMap* triangleInfoMap);
+
+///The heightfield queries are cheap already, the triangles are processed in parallel batches
+void btGenerateInternalEdgeInfoMt(btHeightfieldTerrainShape* heightfieldShape, btTriangleInfoMap* triangleInfoMap);
+
 ///Call the btFixMeshNormal to adjust the collision normal, using the triangle info map (generated using btGenerateInternalEdgeInfo)
 ///If this info map is missing, or the triangle is not store in this map, nothing will be done
 void btAdjustInternalEdgeContacts(btManifoldPoint& cp, const btCollisionObjectWrapper* trimeshColObj0Wrap, const btCollisionObjectWrapper* otherColObj1Wrap, int partId0, int index0, int normalAdjustFlags = 0);
@@ -21,12 +21,13 @@ subject to the following restrictions:
 
 ///Bvh Concave triangle mesh is a static-triangle mesh shape with Bounding Volume Hierarchy optimization.
 ///Uses an interface to access the triangles to allow for sharing graphics/physics triangles.
-btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression, bool buildBvh)
+btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression, bool buildBvh, btQuantizedBvh::btBuildMode bvhBuildMode)
 	: btTriangleMeshShape(meshInterface),
 	  m_bvh(0),
 	  m_triangleInfoMap(0),
 	  m_useQuantizedAabbCompression(useQuantizedAabbCompression),
-	  m_ownsBvh(false)
+	  m_ownsBvh(false),
+	  m_bvhBuildMode(bvhBuildMode)
 {
 	m_shapeType = TRIANGLE_MESH_SHAPE_PROXYTYPE;
 	//construct bvh from meshInterface
@@ -40,12 +41,13 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 #endif  //DISABLE_BVH
 }
 
-btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, bool buildBvh)
+btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInterface, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, bool buildBvh, btQuantizedBvh::btBuildMode bvhBuildMode)
 	: btTriangleMeshShape(meshInterface),
 	  m_bvh(0),
 	  m_triangleInfoMap(0),
 	  m_useQuantizedAabbCompression(useQuantizedAabbCompression),
-	  m_ownsBvh(false)
+	  m_ownsBvh(false),
+	  m_bvhBuildMode(bvhBuildMode)
 {
 	m_shapeType = TRIANGLE_MESH_SHAPE_PROXYTYPE;
 	//construct bvh from meshInterface
@@ -56,7 +58,7 @@ btBvhTriangleMeshShape::btBvhTriangleMeshShape(btStridingMeshInterface* meshInte
 		void* mem = btAlignedAlloc(sizeof(btOptimizedBvh), 16);
 		m_bvh = new (mem) btOptimizedBvh();
 
-		m_bvh->build(meshInterface, m_useQuantizedAabbCompression, bvhAabbMin, bvhAabbMax);
+		m_bvh->build(meshInterface, m_useQuantizedAabbCompression, bvhAabbMin, bvhAabbMax, m_bvhBuildMode);
 		m_ownsBvh = true;
 	}
 
@@ -348,7 +350,7 @@ void btBvhTriangleMeshShape::buildOptimizedBvh()
 	void* mem = btAlignedAlloc(sizeof(btOptimizedBvh), 16);
 	m_bvh = new (mem) btOptimizedBvh();
 	//rebuild the bvh...
-	m_bvh->build(m_meshInterface, m_useQuantizedAabbCompression, m_localAabbMin, m_localAabbMax);
+	m_bvh->build(m_meshInterface, m_useQuantizedAabbCompression, m_localAabbMin, m_localAabbMax, m_bvhBuildMode);
 	m_ownsBvh = true;
 }
 
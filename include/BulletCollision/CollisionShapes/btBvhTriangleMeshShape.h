@@ -39,19 +39,21 @@ btBvhTriangleMeshShape : public btTriangleMeshShape
 
 	bool m_useQuantizedAabbCompression;
 	bool m_ownsBvh;
+	btQuantizedBvh::btBuildMode m_bvhBuildMode;
 #ifdef __clang__
-	bool m_pad[11] __attribute__((unused));  ////need padding due to alignment
+	bool m_pad[7] __attribute__((unused));  ////need padding due to alignment
 #else
-	bool m_pad[11];  ////need padding due to alignment
+	bool m_pad[7];  ////need padding due to alignment
 #endif
 
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
 
-	btBvhTriangleMeshShape(btStridingMeshInterface * meshInterface, bool useQuantizedAabbCompression, bool buildBvh = true);
+	///btQuantizedBvh::BUILD_BINNED_SAH builds a tree that is faster to query, in parallel, see btQuantizedBvh::btBuildMode
+	btBvhTriangleMeshShape(btStridingMeshInterface * meshInterface, bool useQuantizedAabbCompression, bool buildBvh = true, btQuantizedBvh::btBuildMode bvhBuildMode = btQuantizedBvh::BUILD_MEDIAN_SPLIT);
 
 	///optionally pass in a larger bvh aabb, used for quantization. This allows for deformations within this aabb
-	btBvhTriangleMeshShape(btStridingMeshInterface * meshInterface, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, bool buildBvh = true);
+	btBvhTriangleMeshShape(btStridingMeshInterface * meshInterface, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, bool buildBvh = true, btQuantizedBvh::btBuildMode bvhBuildMode = btQuantizedBvh::BUILD_MEDIAN_SPLIT);
 
 	virtual ~btBvhTriangleMeshShape();
 
@@ -84,6 +86,16 @@ public:
 
 	void buildOptimizedBvh();
 
+	///used by buildOptimizedBvh, also when the local scaling changes
+	void setBvhBuildMode(btQuantizedBvh::btBuildMode bvhBuildMode)
+	{
+		m_bvhBuildMode = bvhBuildMode;
+	}
+	btQuantizedBvh::btBuildMode getBvhBuildMode() const
+	{
+		return m_bvhBuildMode;
+	}
+
 	bool usesQuantizedAabbCompression() const
 	{
 		return m_useQuantizedAabbCompression;
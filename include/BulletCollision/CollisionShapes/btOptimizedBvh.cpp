@@ -18,6 +18,13 @@ subject to the following restrictions:
 #include "LinearMath/btAabbUtil2.h"
 #include "LinearMath/btIDebugDraw.h"
 
+#if OPTIMIZED_BVH_ENABLE_BENCHMARK
+#include "btTriangleIndexVertexArray.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+#include <stdio.h>
+#endif
+
 btOptimizedBvh::btOptimizedBvh()
 {
 }
@@ -26,7 +33,7 @@ btOptimizedBvh::~btOptimizedBvh()
 {
 }
 
-void btOptimizedBvh::build(btStridingMeshInterface* triangles, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax)
+void btOptimizedBvh::build(btStridingMeshInterface* triangles, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, btBuildMode buildMode)
 {
 	m_useQuantization = useQuantizedAabbCompression;
 
@@ -169,7 +176,14 @@ void btOptimizedBvh::build(btStridingMeshInterface* triangles, bool useQuantized
 
 	m_curNodeIndex = 0;
 
-	buildTree(0, numLeafNodes);
+	if (m_useQuantization && buildMode == BUILD_BINNED_SAH)
+	{
+		buildTreeBinnedSah(numLeafNodes);
+	}
+	else
+	{
+		buildTree(0, numLeafNodes);
+	}
 
 	///if the entire tree is small then subtree size, we need to create a header info for the tree
 	if (m_useQuantization && !m_SubtreeHeaders.size())
@@ -362,3 +376,164 @@ btOptimizedBvh* btOptimizedBvh::deSerializeInPlace(void* i_alignedDataBuffer, un
 	//we don't add additional data so just do a static upcast
 	return static_cast<btOptimizedBvh*>(bvh);
 }
+
+//
+#if OPTIMIZED_BVH_ENABLE_BENCHMARK
+
+struct btOptimizedBvhBenchmark
+{
+	struct CountingCallback : public btNodeOverlapCallback
+	{
+		int m_numNodes;
+		CountingCallback() : m_numNodes(0) {}
+		virtual void processNode(int /*subPart*/, int /*triangleIndex*/)
+		{
+			m_numNodes++;
+		}
+	};
+	static int UnsignedRand(int range = RAND_MAX - 1) { return (rand() % (range + 1)); }
+	static btScalar UnitRand() { return (UnsignedRand(16384) / (btScalar)16384); }
+
+	static void addBox(btAlignedObjectArray<btVector3>& vertices, btAlignedObjectArray<int>& indices, const btVector3& center, const btVector3& extents)
+	{
+		static const int boxIndices[36] = {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+		int base = vertices.size();
+		for (int i = 0; i < 8; i++)
+		{
+			vertices.push_back(center + btVector3(i & 4 ? extents[0] : -extents[0], i & 2 ? extents[1] : -extents[1], i & 1 ? extents[2] : -extents[2]));
+		}
+		for (int i = 0; i < 36; i++)
+		{
+			indices.push_back(base + boxIndices[i]);
+		}
+	}
+};
+
+void btOptimizedBvh::benchmark()
+{
+	static const char* meshNames[] = {"terrain", "city"};
+	btAlignedObjectArray<btVector3> vertices;
+	btAlignedObjectArray<int> indices;
+	btClock wallclock;
+
+	//the builds are timed on one thread and with the current scheduler, the queries are single threaded.
+	//Without a scheduler both builds run on the sequential one
+	btITaskScheduler* scheduler = btGetTaskScheduler();
+	btITaskScheduler* sequentialScheduler = btGetSequentialTaskScheduler();
+	btITaskScheduler* buildScheduler = scheduler ? scheduler : sequentialScheduler;
+	if (scheduler)
+	{
+		printf("Task scheduler '%s': %d threads\n", scheduler->getName(), scheduler->getNumThreads());
+	}
+	else
+	{
+		printf("Task scheduler none/serial\n");
+	}
+	for (int imesh = 0; imesh < 2; imesh++)
+	{
+		vertices.clear();
+		indices.clear();
+		srand(180673);
+		btVector3 aabbMin, aabbMax;
+		if (imesh == 0)
+		{
+			//a 512 x 512 height field, 512k triangles
+			const int size = 513;
+			for (int z = 0; z < size; z++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					btScalar height = btSin(x * btScalar(0.05)) * btCos(z * btScalar(0.07)) * 20 + btOptimizedBvhBenchmark::UnitRand();
+					vertices.push_back(btVector3(btScalar(x) - size / 2, height, btScalar(z) - size / 2));
+				}
+			}
+			for (int z = 0; z < size - 1; z++)
+			{
+				for (int x = 0; x < size - 1; x++)
+				{
+					int i = z * size + x;
+					indices.push_back(i);
+					indices.push_back(i + size);
+					indices.push_back(i + 1);
+					indices.push_back(i + 1);
+					indices.push_back(i + size);
+					indices.push_back(i + size + 1);
+				}
+			}
+		}
+		else
+		{
+			//large buildings with many small props in some of the streets, 480k triangles of very different sizes
+			for (int i = 0; i < 2000; i++)
+			{
+				btVector3 center((btOptimizedBvhBenchmark::UnitRand() - btScalar(0.5)) * 1000, 0, (btOptimizedBvhBenchmark::UnitRand() - btScalar(0.5)) * 1000);
+				btOptimizedBvhBenchmark::addBox(vertices, indices, center, btVector3(5 + btOptimizedBvhBenchmark::UnitRand() * 20, 10 + btOptimizedBvhBenchmark::UnitRand() * 60, 5 + btOptimizedBvhBenchmark::UnitRand() * 20));
+			}
+			for (int i = 0; i < 38000; i++)
+			{
+				int street = btOptimizedBvhBenchmark::UnsignedRand(15);
+				btVector3 center((street - 8) * 60 + btOptimizedBvhBenchmark::UnitRand() * 10, btOptimizedBvhBenchmark::UnitRand() * 3, (btOptimizedBvhBenchmark::UnitRand() - btScalar(0.5)) * 1000);
+				btOptimizedBvhBenchmark::addBox(vertices, indices, center, btVector3(0.2, 0.2, 0.2) + btVector3(btOptimizedBvhBenchmark::UnitRand(), btOptimizedBvhBenchmark::UnitRand(), btOptimizedBvhBenchmark::UnitRand()) * btScalar(0.5));
+			}
+		}
+		btTriangleIndexVertexArray mesh(indices.size() / 3, &indices[0], 3 * sizeof(int), vertices.size(), &vertices[0][0], sizeof(btVector3));
+		mesh.calculateAabbBruteForce(aabbMin, aabbMax);
+		printf("Mesh '%s': %d triangles\n", meshNames[imesh], indices.size() / 3);
+
+		//the same rays and boxes for both trees
+		const int numRays = 20000;
+		btAlignedObjectArray<btVector3> rayFrom, rayTo;
+		btVector3 extents = aabbMax - aabbMin;
+		for (int i = 0; i < numRays; i++)
+		{
+			btVector3 from = aabbMin + btVector3(btOptimizedBvhBenchmark::UnitRand(), btOptimizedBvhBenchmark::UnitRand(), btOptimizedBvhBenchmark::UnitRand()) * extents;
+			btVector3 dir(btOptimizedBvhBenchmark::UnitRand() - btScalar(0.5), btOptimizedBvhBenchmark::UnitRand() - btScalar(0.5), btOptimizedBvhBenchmark::UnitRand() - btScalar(0.5));
+			rayFrom.push_back(from);
+			rayTo.push_back(from + dir.safeNormalize() * extents.length() * btScalar(0.25));
+		}
+
+		for (int imode = 0; imode < 2; imode++)
+		{
+			const btBuildMode buildMode = imode ? BUILD_BINNED_SAH : BUILD_MEDIAN_SPLIT;
+			void* mem = btAlignedAlloc(sizeof(btOptimizedBvh), 16);
+			btOptimizedBvh* bvh = new (mem) btOptimizedBvh();
+			btSetTaskScheduler(sequentialScheduler);
+			wallclock.reset();
+			bvh->build(&mesh, true, aabbMin, aabbMax, buildMode);
+			const unsigned long sequentialBuildUs = wallclock.getTimeMicroseconds();
+
+			btSetTaskScheduler(buildScheduler);
+			wallclock.reset();
+			bvh->build(&mesh, true, aabbMin, aabbMax, buildMode);
+			const unsigned long buildUs = wallclock.getTimeMicroseconds();
+
+			btOptimizedBvhBenchmark::CountingCallback rayCallback;
+			wallclock.reset();
+			for (int i = 0; i < numRays; i++)
+			{
+				bvh->reportRayOverlappingNodex(&rayCallback, rayFrom[i], rayTo[i]);
+			}
+			const unsigned long rayUs = wallclock.getTimeMicroseconds();
+
+			btOptimizedBvhBenchmark::CountingCallback aabbCallback;
+			wallclock.reset();
+			for (int i = 0; i < numRays; i++)
+			{
+				btVector3 halfExtents(2, 2, 2);
+				bvh->reportAabbOverlappingNodex(&aabbCallback, rayFrom[i] - halfExtents, rayFrom[i] + halfExtents);
+			}
+			const unsigned long aabbUs = wallclock.getTimeMicroseconds();
+
+			printf("\t%-18s: build %8lu us on 1 thread, %8lu us on %d, %d rays %8lu us (%d leaves), %d aabbs %8lu us (%d leaves), %d subtrees\n", imode ? "BUILD_BINNED_SAH" : "BUILD_MEDIAN_SPLIT",
+				   sequentialBuildUs, buildUs, buildScheduler->getNumThreads(), numRays, rayUs, rayCallback.m_numNodes, numRays, aabbUs, aabbCallback.m_numNodes, bvh->getSubtreeInfoArray().size());
+			bvh->~btOptimizedBvh();
+			btAlignedFree(bvh);
+		}
+	}
+	btSetTaskScheduler(scheduler);
+}
+#else
+void btOptimizedBvh::benchmark()
+{
+}
+#endif
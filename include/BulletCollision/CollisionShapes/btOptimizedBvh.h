@@ -22,6 +22,12 @@ subject to the following restrictions:
 
 class btStridingMeshInterface;
 
+//
+// Compile time config
+//
+
+#define OPTIMIZED_BVH_ENABLE_BENCHMARK 0
+
 ///The btOptimizedBvh extends the btQuantizedBvh to create AABB tree for triangle meshes, through the btStridingMeshInterface.
 ATTRIBUTE_ALIGNED16(class)
 btOptimizedBvh : public btQuantizedBvh
@@ -35,7 +41,8 @@ public:
 
 	virtual ~btOptimizedBvh();
 
-	void build(btStridingMeshInterface * triangles, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax);
+	///BUILD_BINNED_SAH gives trees that are faster to query and builds in parallel, it uses the median split without useQuantizedAabbCompression
+	void build(btStridingMeshInterface * triangles, bool useQuantizedAabbCompression, const btVector3& bvhAabbMin, const btVector3& bvhAabbMax, btBuildMode buildMode = BUILD_MEDIAN_SPLIT);
 
 	void refit(btStridingMeshInterface * triangles, const btVector3& aabbMin, const btVector3& aabbMax);
 
@@ -51,6 +58,9 @@ public:
 
 	///deSerializeInPlace loads and initializes a BVH from a buffer in memory 'in place'
 	static btOptimizedBvh* deSerializeInPlace(void* i_alignedDataBuffer, unsigned int i_dataBufferSize, bool i_swapEndian);
+
+	///build and ray query times of the median split and binned SAH builds, see OPTIMIZED_BVH_ENABLE_BENCHMARK
+	static void benchmark();
 };
 
 #endif  //BT_OPTIMIZED_BVH_H
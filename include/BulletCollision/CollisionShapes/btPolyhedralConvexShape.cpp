@@ -24,7 +24,8 @@ subject to the following restrictions:
 #include "LinearMath/btGrahamScan2dConvexHull.h"
 
 btPolyhedralConvexShape::btPolyhedralConvexShape() : btConvexInternalShape(),
-													 m_polyhedron(0)
+													 m_polyhedron(0),
+													 m_polyhedronMargin(0)
 {
 }
 
@@ -48,6 +49,7 @@ void btPolyhedralConvexShape::setPolyhedralFeatures(btConvexPolyhedron& polyhedr
 		void* mem = btAlignedAlloc(sizeof(btConvexPolyhedron), 16);
 		m_polyhedron = new (mem) btConvexPolyhedron(polyhedron);
 	}
+	m_polyhedronMargin = btScalar(0);
 }
 
 bool btPolyhedralConvexShape::initializePolyhedralFeatures(int shiftVerticesByMargin)
@@ -60,6 +62,7 @@ bool btPolyhedralConvexShape::initializePolyhedralFeatures(int shiftVerticesByMa
 
 	void* mem = btAlignedAlloc(sizeof(btConvexPolyhedron), 16);
 	m_polyhedron = new (mem) btConvexPolyhedron;
+	m_polyhedronMargin = shiftVerticesByMargin ? getMargin() : btScalar(0);
 
 	btAlignedObjectArray<btVector3> orgVertices;
 
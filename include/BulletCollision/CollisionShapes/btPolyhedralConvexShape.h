@@ -26,6 +26,7 @@ btPolyhedralConvexShape : public btConvexInternalShape
 {
 protected:
 	btConvexPolyhedron* m_polyhedron;
+	btScalar m_polyhedronMargin;  //margin that the faces of m_polyhedron were shifted by
 
 public:
 	BT_DECLARE_ALIGNED_ALLOCATOR();
@@ -45,6 +46,12 @@ public:
 		return m_polyhedron;
 	}
 
+	///the margin that initializePolyhedralFeatures(1) included in the convex polyhedron, 0 otherwise
+	btScalar getConvexPolyhedronMargin() const
+	{
+		return m_polyhedronMargin;
+	}
+
 	//brute force implementations
 
 	virtual btVector3 localGetSupportingVertexWithoutMargin(const btVector3& vec) const;
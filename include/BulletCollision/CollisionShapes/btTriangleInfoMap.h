@@ -76,6 +76,30 @@ struct btTriangleInfoMap : public btInternalTriangleInfoMap
 	virtual const char* serialize(void* dataBuffer, btSerializer* serializer) const;
 
 	void deSerialize(struct btTriangleInfoMapData& data);
+
+	///size of the buffer for serializeInPlace
+	unsigned int calculateSerializeInPlaceBufferSize() const;
+
+	///writes the thresholds and the hash table arrays to a 16 byte aligned buffer, in the native btScalar and byte order
+	void serializeInPlace(void* o_alignedDataBuffer) const;
+
+	///uses the arrays of a buffer written by serializeInPlace without copying them, the buffer has to outlive the map.
+	///The map can still be changed, that writes to the buffer until an array has to grow and is copied
+	bool deSerializeInPlace(void* i_alignedDataBuffer, unsigned int i_dataBufferSize);
+};
+
+///header of the buffer of btTriangleInfoMap::serializeInPlace, followed by the value, hash table, next and key arrays.
+///The hash uses the capacity of the value array, the values are stored with m_hashTableSize entries
+struct btTriangleInfoMapInPlaceData
+{
+	btScalar m_convexEpsilon;
+	btScalar m_planarEpsilon;
+	btScalar m_equalVertexThreshold;
+	btScalar m_edgeDistanceThreshold;
+	btScalar m_maxEdgeAngleThreshold;
+	btScalar m_zeroAreaThreshold;
+	int m_hashTableSize;
+	int m_numValues;
 };
 
 // clang-format off
@@ -235,4 +259,100 @@ SIMD_FORCE_INLINE void btTriangleInfoMap::deSerialize(btTriangleInfoMapData& tma
 	}
 }
 
+SIMD_FORCE_INLINE static unsigned int btTriangleInfoMapAlign16(unsigned int size)
+{
+	return (size + 15) & ~15u;
+}
+
+SIMD_FORCE_INLINE unsigned int btTriangleInfoMap::calculateSerializeInPlaceBufferSize() const
+{
+	unsigned int size = btTriangleInfoMapAlign16(sizeof(btTriangleInfoMapInPlaceData));
+	size += btTriangleInfoMapAlign16(m_hashTable.size() * sizeof(btTriangleInfo));
+	size += (m_hashTable.size() * 2 + m_keyArray.size()) * sizeof(int);
+	return btTriangleInfoMapAlign16(size);
+}
+
+SIMD_FORCE_INLINE void btTriangleInfoMap::serializeInPlace(void* o_alignedDataBuffer) const
+{
+	btAssert(m_hashTable.size() == m_next.size() && m_hashTable.size() == m_valueArray.capacity() && m_keyArray.size() == m_valueArray.size());
+	unsigned char* data = (unsigned char*)o_alignedDataBuffer;
+	memset(data, 0, calculateSerializeInPlaceBufferSize());
+
+	btTriangleInfoMapInPlaceData* header = (btTriangleInfoMapInPlaceData*)data;
+	header->m_convexEpsilon = m_convexEpsilon;
+	header->m_planarEpsilon = m_planarEpsilon;
+	header->m_equalVertexThreshold = m_equalVertexThreshold;
+	header->m_edgeDistanceThreshold = m_edgeDistanceThreshold;
+	header->m_maxEdgeAngleThreshold = m_maxEdgeAngleThreshold;
+	header->m_zeroAreaThreshold = m_zeroAreaThreshold;
+	header->m_hashTableSize = m_hashTable.size();
+	header->m_numValues = m_valueArray.size();
+	data += btTriangleInfoMapAlign16(sizeof(btTriangleInfoMapInPlaceData));
+
+	btTriangleInfo* values = (btTriangleInfo*)data;
+	for (int i = 0; i < m_valueArray.size(); i++)
+	{
+		values[i].m_flags = m_valueArray[i].m_flags;
+		values[i].m_edgeV0V1Angle = m_valueArray[i].m_edgeV0V1Angle;
+		values[i].m_edgeV1V2Angle = m_valueArray[i].m_edgeV1V2Angle;
+		values[i].m_edgeV2V0Angle = m_valueArray[i].m_edgeV2V0Angle;
+	}
+	data += btTriangleInfoMapAlign16(m_hashTable.size() * sizeof(btTriangleInfo));
+
+	int* ints = (int*)data;
+	for (int i = 0; i < m_hashTable.size(); i++)
+	{
+		*ints++ = m_hashTable[i];
+	}
+	for (int i = 0; i < m_next.size(); i++)
+	{
+		*ints++ = m_next[i];
+	}
+	for (int i = 0; i < m_keyArray.size(); i++)
+	{
+		*ints++ = m_keyArray[i].getUid1();
+	}
+}
+
+SIMD_FORCE_INLINE bool btTriangleInfoMap::deSerializeInPlace(void* i_alignedDataBuffer, unsigned int i_dataBufferSize)
+{
+	const unsigned int headerSize = btTriangleInfoMapAlign16(sizeof(btTriangleInfoMapInPlaceData));
+	if (!i_alignedDataBuffer || i_dataBufferSize < headerSize)
+	{
+		return false;
+	}
+	unsigned char* data = (unsigned char*)i_alignedDataBuffer;
+	const btTriangleInfoMapInPlaceData* header = (const btTriangleInfoMapInPlaceData*)data;
+	const int hashTableSize = header->m_hashTableSize;
+	const int numValues = header->m_numValues;
+	if (hashTableSize < 0 || (hashTableSize & (hashTableSize - 1)) != 0 || numValues < 0 || numValues > hashTableSize ||
+		unsigned(hashTableSize) > (i_dataBufferSize - headerSize) / (sizeof(btTriangleInfo) + 2 * sizeof(int)))
+	{
+		return false;
+	}
+	const unsigned int valuesSize = btTriangleInfoMapAlign16(hashTableSize * sizeof(btTriangleInfo));
+	if (headerSize + valuesSize + (hashTableSize * 2 + numValues) * sizeof(int) > i_dataBufferSize)
+	{
+		return false;
+	}
+
+	m_convexEpsilon = header->m_convexEpsilon;
+	m_planarEpsilon = header->m_planarEpsilon;
+	m_equalVertexThreshold = header->m_equalVertexThreshold;
+	m_edgeDistanceThreshold = header->m_edgeDistanceThreshold;
+	m_maxEdgeAngleThreshold = header->m_maxEdgeAngleThreshold;
+	m_zeroAreaThreshold = header->m_zeroAreaThreshold;
+	data += headerSize;
+
+	//btHashInt only holds the int key, the keys are used as they are
+	m_valueArray.initializeFromBuffer(hashTableSize ? data : 0, numValues, hashTableSize);
+	data += valuesSize;
+	m_hashTable.initializeFromBuffer(hashTableSize ? data : 0, hashTableSize, hashTableSize);
+	data += hashTableSize * sizeof(int);
+	m_next.initializeFromBuffer(hashTableSize ? data : 0, hashTableSize, hashTableSize);
+	data += hashTableSize * sizeof(int);
+	m_keyArray.initializeFromBuffer(numValues ? data : 0, numValues, numValues);
+	return true;
+}
+
 #endif  //_BT_TRIANGLE_INFO_MAP_H
@@ -38,6 +38,7 @@ public:
 		kF_UseSubSimplexConvexCastRaytest = 1 << 2,  // Uses an approximate but faster ray versus convex intersection algorithm
 		kF_UseGjkConvexCastRaytest = 1 << 3,
 		kF_DisableHeightfieldAccelerator  = 1 << 4, //don't use the heightfield raycast accelerator. See https://github.com/bulletphysics/bullet3/pull/2062
+		kF_DisableAnalyticRaytest = 1 << 5,          // Uses the convex cast for spheres, boxes, capsules, cylinders, planes and convex hulls instead of their closed form intersection
 		kF_Terminator = 0xFFFFFFFF
 	};
 	unsigned int m_flags;
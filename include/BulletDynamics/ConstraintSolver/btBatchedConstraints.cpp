@@ -21,6 +21,7 @@ subject to the following restrictions:
 #include "LinearMath/btQuickprof.h"
 
 #include <string.h>  //for memset
+#include <limits.h>  //for INT_MAX
 
 #include <cmath>
 
@@ -98,6 +99,37 @@ bool btBatchedConstraints::validate(btConstraintArray* constraints, const btAlig
 	return errors == 0;
 }
 
+void btBatchedConstraints::getStats(Stats* stats) const
+{
+	stats->m_numConstraints = m_constraintIndices.size();
+	stats->m_numPhases = m_phases.size();
+	stats->m_numBatches = m_batches.size();
+	stats->m_minBatchSize = 0;
+	stats->m_maxBatchSize = 0;
+	stats->m_meanBatchSize = btScalar(0);
+	stats->m_minBatchesPerPhase = 0;
+	stats->m_maxBatchesPerPhase = 0;
+	if (m_batches.size() == 0)
+	{
+		return;
+	}
+	stats->m_minBatchSize = INT_MAX;
+	for (int iBatch = 0; iBatch < m_batches.size(); ++iBatch)
+	{
+		int batchSize = m_batches[iBatch].end - m_batches[iBatch].begin;
+		stats->m_minBatchSize = btMin(stats->m_minBatchSize, batchSize);
+		stats->m_maxBatchSize = btMax(stats->m_maxBatchSize, batchSize);
+	}
+	stats->m_meanBatchSize = btScalar(m_constraintIndices.size()) / btScalar(m_batches.size());
+	stats->m_minBatchesPerPhase = INT_MAX;
+	for (int iPhase = 0; iPhase < m_phases.size(); ++iPhase)
+	{
+		int numBatches = m_phases[iPhase].end - m_phases[iPhase].begin;
+		stats->m_minBatchesPerPhase = btMin(stats->m_minBatchesPerPhase, numBatches);
+		stats->m_maxBatchesPerPhase = btMax(stats->m_maxBatchesPerPhase, numBatches);
+	}
+}
+
 static void debugDrawSingleBatch(const btBatchedConstraints* bc,
 								 btConstraintArray* constraints,
 								 const btAlignedObjectArray<btSolverBody>& bodies,
@@ -785,6 +817,61 @@ struct AssignConstraintsToGridBatchesLoop : public btIParallelForBody
 	}
 };
 
+//
+// mapBodyPositionsToSphere -- replace cartesian body positions with (longitude, latitude, radius) around a center
+//
+// The frame is oriented so the average direction of the dynamic bodies sits at longitude = latitude = 0. Bodies
+// clustered on one side of a planet are then far from the poles (where cells get thin) and from the longitude seam
+// (where neighbouring bodies would end up on opposite sides of the grid). Angles are scaled by the average radius
+// so that cells are roughly square near the cluster.
+//
+static void mapBodyPositionsToSphere(btVector3* bodyPositions, const bool* bodyDynamicFlags, int numBodies, const btVector3& center)
+{
+	BT_PROFILE("mapBodyPositionsToSphere");
+	btVector3 meanDir(0, 0, 0);
+	btScalar meanRadius = btScalar(0);
+	int numDynamic = 0;
+	for (int i = 0; i < numBodies; ++i)
+	{
+		if (bodyDynamicFlags[i])
+		{
+			btVector3 rel = bodyPositions[i] - center;
+			btScalar r = rel.length();
+			if (r > SIMD_EPSILON)
+			{
+				meanDir += rel / r;
+			}
+			meanRadius += r;
+			numDynamic++;
+		}
+	}
+	if (numDynamic == 0)
+	{
+		return;
+	}
+	meanRadius /= btScalar(numDynamic);
+	meanRadius = btMax(meanRadius, btScalar(1));
+	if (meanDir.length2() < SIMD_EPSILON)
+	{
+		meanDir = btVector3(1, 0, 0);
+	}
+	btVector3 axisX = meanDir.normalized();
+	btVector3 axisY;
+	btVector3 axisZ;
+	btPlaneSpace1(axisX, axisY, axisZ);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		if (bodyDynamicFlags[i])
+		{
+			btVector3 rel = bodyPositions[i] - center;
+			btScalar r = rel.length();
+			btScalar lon = btAtan2(rel.dot(axisY), rel.dot(axisX));
+			btScalar lat = r > SIMD_EPSILON ? btAsin(btClamped(rel.dot(axisZ) / r, btScalar(-1), btScalar(1))) : btScalar(0);
+			bodyPositions[i] = btVector3(lon * meanRadius, lat * meanRadius, r);
+		}
+	}
+}
+
 //
 // setupSpatialGridBatchesMt -- generate batches using a uniform 3D grid
 //
@@ -811,6 +898,10 @@ Key idea: Given that each constraint spans 1 or 2 grid cells in each dimension,
 
 Optionally, we can "collapse" one dimension of our 3D grid to turn it into a 2D grid, which reduces the number of phases
 to 4. With fewer phases, there are more constraints per phase and this makes it easier to create batches of a useful size.
+
+For the spherical grid, body positions are first mapped to (longitude, latitude, radius) around sphericalGridCenter
+and the radius axis is always the one collapsed, so bodies resting on a planet spread over a 2D lat/long grid
+instead of piling into the few cells of a cartesian grid that the curved surface passes through.
 */
 //
 static void setupSpatialGridBatchesMt(
@@ -820,7 +911,8 @@ static void setupSpatialGridBatchesMt(
 	const btAlignedObjectArray<btSolverBody>& bodies,
 	int minBatchSize,
 	int maxBatchSize,
-	bool use2DGrid)
+	bool use2DGrid,
+	const btVector3* sphericalGridCenter)
 {
 	BT_PROFILE("setupSpatialGridBatchesMt");
 	const int numPhases = 8;
@@ -864,6 +956,17 @@ static void setupSpatialGridBatchesMt(
 
 	numConstraints = initBatchedConstraintInfo(conInfos, constraints);
 
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		const btSolverBody& body = bodies[i];
+		bodyPositions[i] = body.getWorldTransform().getOrigin();
+		bodyDynamicFlags[i] = (body.internalGetInvMass().x() > btScalar(0));
+	}
+	if (sphericalGridCenter)
+	{
+		mapBodyPositionsToSphere(bodyPositions, bodyDynamicFlags, bodies.size(), *sphericalGridCenter);
+	}
+
 	// compute bounding box around all dynamic bodies
 	// (could be done in parallel)
 	btVector3 bboxMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
@@ -871,16 +974,11 @@ static void setupSpatialGridBatchesMt(
 	//int dynamicBodyCount = 0;
 	for (int i = 0; i < bodies.size(); ++i)
 	{
-		const btSolverBody& body = bodies[i];
-		btVector3 bodyPos = body.getWorldTransform().getOrigin();
-		bool isDynamic = (body.internalGetInvMass().x() > btScalar(0));
-		bodyPositions[i] = bodyPos;
-		bodyDynamicFlags[i] = isDynamic;
-		if (isDynamic)
+		if (bodyDynamicFlags[i])
 		{
 			//dynamicBodyCount++;
-			bboxMin.setMin(bodyPos);
-			bboxMax.setMax(bodyPos);
+			bboxMin.setMin(bodyPositions[i]);
+			bboxMax.setMax(bodyPositions[i]);
 		}
 	}
 
@@ -915,6 +1013,11 @@ static void setupSpatialGridBatchesMt(
 				axisDim = gridDim[i];
 			}
 		}
+		if (sphericalGridCenter)
+		{
+			// always collapse the radius
+			iAxisToCollapse = 2;
+		}
 		// collapse it
 		gridCellSize[iAxisToCollapse] = gridExtent[iAxisToCollapse] * 2.0f;
 		phaseMask &= ~(1 << iAxisToCollapse);
@@ -1033,6 +1136,181 @@ static void setupSpatialGridBatchesMt(
 	btAssert(batchedConstraints->validate(constraints, bodies));
 }
 
+//
+// setupGraphColoringBatches -- generate batches by greedy coloring of the constraint graph
+//
+/*
+
+Unlike the spatial grid, this does not depend on where the bodies are, which makes it work for piles that are not
+spread out along the grid axes (e.g. bodies resting on the surface of a large sphere, or a single tall stack).
+
+1. Each (run-length encoded) constraint is a node, two constraints are adjacent if they share a dynamic body.
+   Static and kinematic bodies are never written by the solver, so constraints that only share a static body
+   (the ground, a planet) do not conflict and can go in the same color.
+
+2. Greedily assign each constraint the lowest color not yet used by either of its dynamic bodies. Colors used by a
+   body are tracked in a 64 bit mask, so this is a couple of bit operations per constraint.
+   If a constraint can't be colored (a body touches more than kMaxColors constraints of different colors)
+   it goes into an overflow phase that is solved as a single batch.
+
+3. Each color becomes a phase. Since no dynamic body appears twice within a color, the constraints of a phase can be
+   dealt out round-robin into as many batches as the phase size allows.
+*/
+//
+static void setupGraphColoringBatches(
+	btBatchedConstraints* batchedConstraints,
+	btAlignedObjectArray<char>* scratchMemory,
+	btConstraintArray* constraints,
+	const btAlignedObjectArray<btSolverBody>& bodies,
+	int minBatchSize,
+	int maxBatchSize)
+{
+	BT_PROFILE("setupGraphColoringBatches");
+	const int kMaxColors = 64;
+	const int numPhases = kMaxColors + 1;  // last phase is the overflow phase
+	const int kOverflowColor = kMaxColors;
+	const int maxNumBatchesPerPhase = 128;
+	int numConstraints = constraints->size();
+	int numConstraintRows = constraints->size();
+	int allocNumBatches = maxNumBatchesPerPhase * numPhases;
+
+	bool* bodyDynamicFlags = NULL;
+	unsigned long long* bodyColorMasks = NULL;
+	btBatchInfo* batches = NULL;
+	int* batchWork = NULL;
+	btBatchedConstraintInfo* conInfos = NULL;
+	int* constraintBatchIds = NULL;
+	int* constraintRowBatchIds = NULL;
+	{
+		PreallocatedMemoryHelper<10> memHelper;
+		memHelper.addChunk((void**)&bodyColorMasks, sizeof(unsigned long long) * bodies.size());
+		memHelper.addChunk((void**)&bodyDynamicFlags, sizeof(bool) * bodies.size());
+		memHelper.addChunk((void**)&batches, sizeof(btBatchInfo) * allocNumBatches);
+		memHelper.addChunk((void**)&batchWork, sizeof(int) * allocNumBatches);
+		memHelper.addChunk((void**)&conInfos, sizeof(btBatchedConstraintInfo) * numConstraints);
+		memHelper.addChunk((void**)&constraintBatchIds, sizeof(int) * numConstraints);
+		memHelper.addChunk((void**)&constraintRowBatchIds, sizeof(int) * numConstraintRows);
+		size_t scratchSize = memHelper.getSizeToAllocate();
+		// if we need to reallocate
+		if (static_cast<size_t>(scratchMemory->capacity()) < scratchSize)
+		{
+			// allocate 6.25% extra to avoid repeated reallocs
+			scratchMemory->reserve(scratchSize + scratchSize / 16);
+		}
+		scratchMemory->resizeNoInitialize(scratchSize);
+		char* memPtr = &scratchMemory->at(0);
+		memHelper.setChunkPointers(memPtr);
+	}
+
+	numConstraints = initBatchedConstraintInfo(conInfos, constraints);
+
+	for (int i = 0; i < bodies.size(); ++i)
+	{
+		bodyDynamicFlags[i] = (bodies[i].internalGetInvMass().x() > btScalar(0));
+		bodyColorMasks[i] = 0;
+	}
+
+	// greedy coloring, constraintBatchIds temporarily holds the color of each constraint
+	int colorRowCounts[numPhases];
+	int colorConstraintCounts[numPhases];
+	for (int i = 0; i < numPhases; ++i)
+	{
+		colorRowCounts[i] = 0;
+		colorConstraintCounts[i] = 0;
+	}
+	int numColorsUsed = 0;
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		const btBatchedConstraintInfo& con = conInfos[iCon];
+		int iBody0 = con.bodyIds[0];
+		int iBody1 = con.bodyIds[1];
+		unsigned long long usedColors = 0;
+		if (bodyDynamicFlags[iBody0])
+		{
+			usedColors |= bodyColorMasks[iBody0];
+		}
+		if (bodyDynamicFlags[iBody1])
+		{
+			usedColors |= bodyColorMasks[iBody1];
+		}
+		int color = kOverflowColor;
+		if (usedColors != ~0ULL)
+		{
+			// lowest clear bit
+			unsigned long long freeColors = ~usedColors;
+			unsigned long long lowestBit = freeColors & (~freeColors + 1);
+			color = 0;
+			while ((lowestBit >> color) != 1)
+			{
+				++color;
+			}
+			if (bodyDynamicFlags[iBody0])
+			{
+				bodyColorMasks[iBody0] |= lowestBit;
+			}
+			if (bodyDynamicFlags[iBody1])
+			{
+				bodyColorMasks[iBody1] |= lowestBit;
+			}
+			numColorsUsed = btMax(numColorsUsed, color + 1);
+		}
+		constraintBatchIds[iCon] = color;
+		colorRowCounts[color] += con.numConstraintRows;
+		colorConstraintCounts[color]++;
+	}
+
+	// decide how many batches each color is split into
+	int numThreads = btGetTaskScheduler()->getNumThreads();
+	int colorNumBatches[numPhases];
+	int colorNextConstraint[numPhases];
+	for (int iColor = 0; iColor < numPhases; ++iColor)
+	{
+		int numBatches = 1;
+		if (iColor != kOverflowColor)
+		{
+			int rows = colorRowCounts[iColor];
+			int targetBatchSize = btMax(minBatchSize, btMin(maxBatchSize, rows / btMax(1, numThreads)));
+			numBatches = btMax(1, rows / btMax(1, targetBatchSize));
+			numBatches = btMin(numBatches, btMin(maxNumBatchesPerPhase, btMax(1, colorConstraintCounts[iColor])));
+		}
+		colorNumBatches[iColor] = numBatches;
+		colorNextConstraint[iColor] = 0;
+	}
+
+	// move the overflow phase right after the last used color, so empty colors are not scanned when writing out
+	int colorPhase[numPhases];
+	for (int iColor = 0; iColor < kMaxColors; ++iColor)
+	{
+		colorPhase[iColor] = iColor;
+	}
+	colorPhase[kOverflowColor] = numColorsUsed;
+	int numPhasesUsed = numColorsUsed + (colorConstraintCounts[kOverflowColor] > 0 ? 1 : 0);
+
+	for (int iBatch = 0; iBatch < numPhasesUsed * maxNumBatchesPerPhase; ++iBatch)
+	{
+		batches[iBatch] = btBatchInfo();
+	}
+	for (int iCon = 0; iCon < numConstraints; ++iCon)
+	{
+		int color = constraintBatchIds[iCon];
+		int iBatch = colorPhase[color] * maxNumBatchesPerPhase + (colorNextConstraint[color]++ % colorNumBatches[color]);
+		constraintBatchIds[iCon] = iBatch;
+		batches[iBatch].numConstraints += conInfos[iCon].numConstraintRows;
+	}
+
+	if (numConstraintRows > numConstraints)
+	{
+		expandConstraintRowsMt(&constraintRowBatchIds[0], &constraintBatchIds[0], &conInfos[0], numConstraints, numConstraintRows);
+	}
+	else
+	{
+		constraintRowBatchIds = constraintBatchIds;
+	}
+
+	writeOutBatches(batchedConstraints, constraintRowBatchIds, numConstraintRows, batches, batchWork, maxNumBatchesPerPhase, numPhasesUsed);
+	btAssert(batchedConstraints->validate(constraints, bodies));
+}
+
 static void setupSingleBatch(
 	btBatchedConstraints* bc,
 	int numConstraints)
@@ -1070,8 +1348,19 @@ void btBatchedConstraints::setup(
 {
 	if (constraints->size() >= minBatchSize * 4)
 	{
-		bool use2DGrid = batchingMethod == BATCHING_METHOD_SPATIAL_GRID_2D;
-		setupSpatialGridBatchesMt(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, use2DGrid);
+		if (batchingMethod == BATCHING_METHOD_GRAPH_COLORING)
+		{
+			setupGraphColoringBatches(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize);
+		}
+		else if (batchingMethod == BATCHING_METHOD_SPHERICAL_GRID)
+		{
+			setupSpatialGridBatchesMt(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, true, &m_sphericalGridCenter);
+		}
+		else
+		{
+			bool use2DGrid = batchingMethod == BATCHING_METHOD_SPATIAL_GRID_2D;
+			setupSpatialGridBatchesMt(this, scratchMemory, constraints, bodies, minBatchSize, maxBatchSize, use2DGrid, NULL);
+		}
 		if (s_debugDrawBatches)
 		{
 			debugDrawAllBatches(this, constraints, bodies);
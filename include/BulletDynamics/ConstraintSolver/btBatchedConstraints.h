@@ -29,6 +29,8 @@ struct btBatchedConstraints
 	{
 		BATCHING_METHOD_SPATIAL_GRID_2D,
 		BATCHING_METHOD_SPATIAL_GRID_3D,
+		BATCHING_METHOD_GRAPH_COLORING,
+		BATCHING_METHOD_SPHERICAL_GRID,
 		BATCHING_METHOD_COUNT
 	};
 	struct Range
@@ -46,10 +48,28 @@ struct btBatchedConstraints
 	btAlignedObjectArray<char> m_phaseGrainSize;  // max grain size for each phase
 	btAlignedObjectArray<int> m_phaseOrder;       // phases can be done in any order, so we can randomize the order here
 	btIDebugDraw* m_debugDrawer;
+	btVector3 m_sphericalGridCenter;  // center of the sphere used by BATCHING_METHOD_SPHERICAL_GRID
+
+	// batch size statistics of the last setup, for tuning batch sizes and phases
+	struct Stats
+	{
+		int m_numConstraints;
+		int m_numPhases;
+		int m_numBatches;
+		int m_minBatchSize;
+		int m_maxBatchSize;
+		btScalar m_meanBatchSize;
+		int m_minBatchesPerPhase;
+		int m_maxBatchesPerPhase;
+	};
 
 	static bool s_debugDrawBatches;
 
-	btBatchedConstraints() { m_debugDrawer = NULL; }
+	btBatchedConstraints()
+	{
+		m_debugDrawer = NULL;
+		m_sphericalGridCenter.setZero();
+	}
 	void setup(btConstraintArray* constraints,
 			   const btAlignedObjectArray<btSolverBody>& bodies,
 			   BatchingMethod batchingMethod,
@@ -57,6 +77,7 @@ struct btBatchedConstraints
 			   int maxBatchSize,
 			   btAlignedObjectArray<char>* scratchMemory);
 	bool validate(btConstraintArray* constraints, const btAlignedObjectArray<btSolverBody>& bodies) const;
+	void getStats(Stats* stats) const;
 };
 
 #endif  // BT_BATCHED_CONSTRAINTS_H
@@ -36,6 +36,7 @@ enum btConstraintSolverType
 	BT_NNCG_SOLVER = 4,
 	BT_MULTIBODY_SOLVER = 8,
 	BT_BLOCK_SOLVER = 16,
+	BT_JACOBI_SOLVER = 32,
 };
 
 class btConstraintSolver
@@ -54,6 +55,9 @@ public:
 	virtual void reset() = 0;
 
 	virtual btConstraintSolverType getSolverType() const = 0;
+
+	///true if solveGroup honours btContactSolverInfo::m_numSolverSubsteps, see btDiscreteDynamicsWorld::setSoftStepping
+	virtual bool supportsSolverSubsteps() const { return false; }
 };
 
 #endif  //BT_CONSTRAINT_SOLVER_H
@@ -32,6 +32,7 @@ enum btSolverMode
 	SOLVER_ALLOW_ZERO_LENGTH_FRICTION_DIRECTIONS = 1024,
 	SOLVER_DISABLE_IMPLICIT_CONE_FRICTION = 2048,
 	SOLVER_USE_ARTICULATED_WARMSTARTING = 4096,
+	SOLVER_BLOCK_CONTACTS = 8192,  //solve the contact points of each manifold as one small LCP instead of row by row
 };
 
 struct btContactSolverInfoData
@@ -70,6 +71,7 @@ struct btContactSolverInfoData
 	bool m_jointFeedbackInJointFrame;
 	int m_reportSolverAnalytics;
 	int m_numNonContactInnerIterations;
+	int m_numSolverSubsteps;  //if above 1, contacts are solved with that many substeps of a single iteration each (TGS soft step)
 };
 
 struct btContactSolverInfo : public btContactSolverInfoData
@@ -110,6 +112,7 @@ struct btContactSolverInfo : public btContactSolverInfoData
 		m_jointFeedbackInJointFrame = false;
 		m_reportSolverAnalytics = 0;
 		m_numNonContactInnerIterations = 1;   // the number of inner iterations for solving motor constraint in a single iteration of the constraint solve
+		m_numSolverSubsteps = 1;
 	}
 };
 
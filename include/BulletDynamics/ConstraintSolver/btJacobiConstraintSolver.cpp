@@ -0,0 +1,469 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btJacobiConstraintSolver.h"
+#include "LinearMath/btQuickprof.h"
+#include "LinearMath/btThreads.h"
+
+//#define VERBOSE_RESIDUAL_PRINTF 1
+
+btJacobiConstraintSolver::btJacobiConstraintSolver()
+	: m_numJointRows(0),
+	  m_numContactRows(0),
+	  m_numFrictionRows(0),
+	  m_numRollingFrictionRows(0)
+{
+}
+
+void btJacobiConstraintSolver::gatherRow(const btSolverConstraint& c, int row, int frictionIndex)
+{
+	m_rowBodyA[row] = c.m_solverBodyIdA;
+	m_rowBodyB[row] = c.m_solverBodyIdB;
+	m_rowNormal1[row] = c.m_contactNormal1;
+	m_rowRelpos1CrossNormal[row] = c.m_relpos1CrossNormal;
+	m_rowNormal2[row] = c.m_contactNormal2;
+	m_rowRelpos2CrossNormal[row] = c.m_relpos2CrossNormal;
+	m_rowAngularComponentA[row] = c.m_angularComponentA;
+	m_rowAngularComponentB[row] = c.m_angularComponentB;
+	m_rowRhs[row] = c.m_rhs;
+	m_rowRhsPenetration[row] = c.m_rhsPenetration;
+	m_rowCfm[row] = c.m_cfm;
+	m_rowJacDiagABInv[row] = c.m_jacDiagABInv;
+	m_rowLowerLimit[row] = c.m_lowerLimit;
+	m_rowUpperLimit[row] = c.m_upperLimit;
+	m_rowFriction[row] = c.m_friction;
+	m_rowAppliedImpulse[row] = c.m_appliedImpulse;
+	m_rowAppliedPushImpulse[row] = c.m_appliedPushImpulse;
+	m_rowFrictionIndex[row] = frictionIndex;
+	m_rowNumIterations[row] = c.m_overrideNumSolverIterations;
+}
+
+void btJacobiConstraintSolver::gatherRows()
+{
+	BT_PROFILE("gatherRows");
+	m_numJointRows = m_tmpSolverNonContactConstraintPool.size();
+	m_numContactRows = m_tmpSolverContactConstraintPool.size();
+	m_numFrictionRows = m_tmpSolverContactFrictionConstraintPool.size();
+	m_numRollingFrictionRows = m_tmpSolverContactRollingFrictionConstraintPool.size();
+	int numRows = m_numJointRows + m_numContactRows + m_numFrictionRows + m_numRollingFrictionRows;
+
+	m_rowBodyA.resizeNoInitialize(numRows);
+	m_rowBodyB.resizeNoInitialize(numRows);
+	m_rowNormal1.resizeNoInitialize(numRows);
+	m_rowRelpos1CrossNormal.resizeNoInitialize(numRows);
+	m_rowNormal2.resizeNoInitialize(numRows);
+	m_rowRelpos2CrossNormal.resizeNoInitialize(numRows);
+	m_rowAngularComponentA.resizeNoInitialize(numRows);
+	m_rowAngularComponentB.resizeNoInitialize(numRows);
+	m_rowRhs.resizeNoInitialize(numRows);
+	m_rowRhsPenetration.resizeNoInitialize(numRows);
+	m_rowCfm.resizeNoInitialize(numRows);
+	m_rowJacDiagABInv.resizeNoInitialize(numRows);
+	m_rowLowerLimit.resizeNoInitialize(numRows);
+	m_rowUpperLimit.resizeNoInitialize(numRows);
+	m_rowFriction.resizeNoInitialize(numRows);
+	m_rowAppliedImpulse.resizeNoInitialize(numRows);
+	m_rowAppliedPushImpulse.resizeNoInitialize(numRows);
+	m_rowDeltaImpulse.resizeNoInitialize(numRows);
+	m_rowResidual.resizeNoInitialize(numRows);
+	m_rowFrictionIndex.resizeNoInitialize(numRows);
+	m_rowNumIterations.resizeNoInitialize(numRows);
+
+	int row = 0;
+	for (int i = 0; i < m_numJointRows; i++, row++)
+		gatherRow(m_tmpSolverNonContactConstraintPool[i], row, -1);
+	for (int i = 0; i < m_numContactRows; i++, row++)
+		gatherRow(m_tmpSolverContactConstraintPool[i], row, -1);
+	for (int i = 0; i < m_numFrictionRows; i++, row++)
+		gatherRow(m_tmpSolverContactFrictionConstraintPool[i], row, m_numJointRows + m_tmpSolverContactFrictionConstraintPool[i].m_frictionIndex);
+	for (int i = 0; i < m_numRollingFrictionRows; i++, row++)
+		gatherRow(m_tmpSolverContactRollingFrictionConstraintPool[i], row, m_numJointRows + m_tmpSolverContactRollingFrictionConstraintPool[i].m_frictionIndex);
+	btAssert(row == numRows);
+}
+
+static btScalar btRowResponse(const btSolverBody& body, const btVector3& normal, const btVector3& relposCrossNormal, const btVector3& angularComponent)
+{
+	//change of the velocity along the row for a unit impulse on this body
+	if (!body.m_originalBody)
+		return btScalar(0);
+	return normal.dot(normal * body.internalGetInvMass() * body.m_linearFactor) + relposCrossNormal.dot(angularComponent * body.m_angularFactor);
+}
+
+void btJacobiConstraintSolver::buildBodyRows(int pass, int rowBegin, int rowEnd)
+{
+	BT_PROFILE("buildBodyRows");
+	int numBodies = m_tmpSolverBodyPool.size();
+	btAlignedObjectArray<int>& starts = m_bodyRowStarts[pass];
+	btAlignedObjectArray<int>& rows = m_bodyRows[pass];
+	starts.resizeNoInitialize(numBodies + 1);
+	for (int i = 0; i <= numBodies; i++)
+		starts[i] = 0;
+
+	//count the rows of every body, bodies that don't move are left out
+	for (int row = rowBegin; row < rowEnd; row++)
+	{
+		if (m_tmpSolverBodyPool[m_rowBodyA[row]].m_originalBody)
+			starts[m_rowBodyA[row] + 1]++;
+		if (m_tmpSolverBodyPool[m_rowBodyB[row]].m_originalBody)
+			starts[m_rowBodyB[row] + 1]++;
+	}
+	for (int i = 0; i < numBodies; i++)
+		starts[i + 1] += starts[i];
+
+	//split the mass of every body evenly over its rows, scaling the effective mass of a row by
+	//(responseA + responseB) / (countA * responseA + countB * responseB), as in b3GpuJacobiContactSolver
+	for (int row = rowBegin; row < rowEnd; row++)
+	{
+		const btSolverBody& bodyA = m_tmpSolverBodyPool[m_rowBodyA[row]];
+		const btSolverBody& bodyB = m_tmpSolverBodyPool[m_rowBodyB[row]];
+		btScalar responseA = btRowResponse(bodyA, m_rowNormal1[row], m_rowRelpos1CrossNormal[row], m_rowAngularComponentA[row]);
+		btScalar responseB = btRowResponse(bodyB, m_rowNormal2[row], m_rowRelpos2CrossNormal[row], m_rowAngularComponentB[row]);
+		btScalar countA = btScalar(starts[m_rowBodyA[row] + 1] - starts[m_rowBodyA[row]]);
+		btScalar countB = btScalar(starts[m_rowBodyB[row] + 1] - starts[m_rowBodyB[row]]);
+		btScalar splitResponse = countA * responseA + countB * responseB;
+		if (splitResponse > SIMD_EPSILON)
+		{
+			btScalar scale = (responseA + responseB) / splitResponse;
+			m_rowRhs[row] *= scale;
+			m_rowRhsPenetration[row] *= scale;
+			m_rowCfm[row] *= scale;
+			m_rowJacDiagABInv[row] *= scale;
+		}
+	}
+
+	//fill in row order, so every body sums its impulses in the same order on any number of threads
+	rows.resizeNoInitialize(starts[numBodies]);
+	btAlignedObjectArray<int> offsets;
+	offsets.resizeNoInitialize(numBodies);
+	for (int i = 0; i < numBodies; i++)
+		offsets[i] = starts[i];
+	for (int row = rowBegin; row < rowEnd; row++)
+	{
+		if (m_tmpSolverBodyPool[m_rowBodyA[row]].m_originalBody)
+			rows[offsets[m_rowBodyA[row]]++] = 2 * row;
+		if (m_tmpSolverBodyPool[m_rowBodyB[row]].m_originalBody)
+			rows[offsets[m_rowBodyB[row]]++] = 2 * row + 1;
+	}
+}
+
+void btJacobiConstraintSolver::scatterRows()
+{
+	BT_PROFILE("scatterRows");
+	int row = 0;
+	for (int i = 0; i < m_numJointRows; i++, row++)
+	{
+		m_tmpSolverNonContactConstraintPool[i].m_appliedImpulse = m_rowAppliedImpulse[row];
+	}
+	for (int i = 0; i < m_numContactRows; i++, row++)
+	{
+		m_tmpSolverContactConstraintPool[i].m_appliedImpulse = m_rowAppliedImpulse[row];
+		m_tmpSolverContactConstraintPool[i].m_appliedPushImpulse = m_rowAppliedPushImpulse[row];
+	}
+	for (int i = 0; i < m_numFrictionRows; i++, row++)
+	{
+		btSolverConstraint& c = m_tmpSolverContactFrictionConstraintPool[i];
+		c.m_appliedImpulse = m_rowAppliedImpulse[row];
+		c.m_lowerLimit = m_rowLowerLimit[row];
+		c.m_upperLimit = m_rowUpperLimit[row];
+	}
+	for (int i = 0; i < m_numRollingFrictionRows; i++, row++)
+	{
+		btSolverConstraint& c = m_tmpSolverContactRollingFrictionConstraintPool[i];
+		c.m_appliedImpulse = m_rowAppliedImpulse[row];
+		c.m_lowerLimit = m_rowLowerLimit[row];
+		c.m_upperLimit = m_rowUpperLimit[row];
+	}
+}
+
+///solves the rows of a pass against the velocities of the last pass, only the row itself is written
+struct btJacobiSolveRowsLoop : public btIParallelForBody
+{
+	const btAlignedObjectArray<btSolverBody>* m_bodies;
+	int m_iteration;
+	int m_numIterations;
+	int m_firstContactRow;
+	int m_firstFrictionRow;
+	int m_firstRollingFrictionRow;
+	bool m_push;
+
+	const int* m_bodyA;
+	const int* m_bodyB;
+	const btVector3* m_normal1;
+	const btVector3* m_relpos1CrossNormal;
+	const btVector3* m_normal2;
+	const btVector3* m_relpos2CrossNormal;
+	const btScalar* m_rhs;
+	const btScalar* m_cfm;
+	const btScalar* m_jacDiagABInv;
+	btScalar* m_lowerLimit;
+	btScalar* m_upperLimit;
+	const btScalar* m_friction;
+	btScalar* m_appliedImpulse;
+	const btScalar* m_normalImpulse;
+	btScalar* m_deltaImpulse;
+	btScalar* m_residual;
+	const int* m_frictionIndex;
+	const int* m_numRowIterations;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btJacobiSolveRowsLoop");
+		const btAlignedObjectArray<btSolverBody>& bodies = *m_bodies;
+		for (int row = iBegin; row < iEnd; row++)
+		{
+			m_deltaImpulse[row] = btScalar(0);
+			m_residual[row] = btScalar(0);
+			if (row < m_firstContactRow)
+			{
+				//joints
+				if (m_push || m_iteration >= m_numRowIterations[row])
+					continue;
+			}
+			else if (row < m_firstFrictionRow)
+			{
+				//contacts
+				if (m_iteration >= m_numIterations || (m_push && !m_rhs[row]))
+					continue;
+			}
+			else
+			{
+				//friction, with limits from the normal impulse of this iteration
+				if (m_iteration >= m_numIterations)
+					continue;
+				btScalar totalImpulse = m_normalImpulse[m_frictionIndex[row]];
+				if (totalImpulse <= btScalar(0))
+					continue;
+				btScalar magnitude = m_friction[row] * totalImpulse;
+				if (row >= m_firstRollingFrictionRow && magnitude > m_friction[row])
+					magnitude = m_friction[row];
+				m_lowerLimit[row] = -magnitude;
+				m_upperLimit[row] = magnitude;
+			}
+
+			const btSolverBody& bodyA = bodies[m_bodyA[row]];
+			const btSolverBody& bodyB = bodies[m_bodyB[row]];
+			btScalar deltaVel1Dotn, deltaVel2Dotn;
+			if (m_push)
+			{
+				deltaVel1Dotn = m_normal1[row].dot(bodyA.m_pushVelocity) + m_relpos1CrossNormal[row].dot(bodyA.m_turnVelocity);
+				deltaVel2Dotn = m_normal2[row].dot(bodyB.m_pushVelocity) + m_relpos2CrossNormal[row].dot(bodyB.m_turnVelocity);
+			}
+			else
+			{
+				deltaVel1Dotn = m_normal1[row].dot(bodyA.m_deltaLinearVelocity) + m_relpos1CrossNormal[row].dot(bodyA.m_deltaAngularVelocity);
+				deltaVel2Dotn = m_normal2[row].dot(bodyB.m_deltaLinearVelocity) + m_relpos2CrossNormal[row].dot(bodyB.m_deltaAngularVelocity);
+			}
+			btScalar deltaImpulse = m_rhs[row] - m_appliedImpulse[row] * m_cfm[row];
+			deltaImpulse -= deltaVel1Dotn * m_jacDiagABInv[row];
+			deltaImpulse -= deltaVel2Dotn * m_jacDiagABInv[row];
+
+			const btScalar sum = m_appliedImpulse[row] + deltaImpulse;
+			if (sum < m_lowerLimit[row])
+			{
+				deltaImpulse = m_lowerLimit[row] - m_appliedImpulse[row];
+				m_appliedImpulse[row] = m_lowerLimit[row];
+			}
+			else if (!m_push && sum > m_upperLimit[row])
+			{
+				deltaImpulse = m_upperLimit[row] - m_appliedImpulse[row];
+				m_appliedImpulse[row] = m_upperLimit[row];
+			}
+			else
+			{
+				m_appliedImpulse[row] = sum;
+			}
+			m_deltaImpulse[row] = deltaImpulse;
+			btScalar residual = deltaImpulse * (btScalar(1) / m_jacDiagABInv[row]);
+			m_residual[row] = residual * residual;
+		}
+	}
+};
+
+///applies the impulse changes of a pass to every body, summed in row order
+struct btJacobiApplyImpulsesLoop : public btIParallelForBody
+{
+	btAlignedObjectArray<btSolverBody>* m_bodies;
+	const int* m_bodyRowStarts;
+	const int* m_bodyRows;
+	const btVector3* m_normal1;
+	const btVector3* m_normal2;
+	const btVector3* m_angularComponentA;
+	const btVector3* m_angularComponentB;
+	const btScalar* m_deltaImpulse;
+	bool m_push;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		BT_PROFILE("btJacobiApplyImpulsesLoop");
+		btAlignedObjectArray<btSolverBody>& bodies = *m_bodies;
+		for (int i = iBegin; i < iEnd; i++)
+		{
+			int begin = m_bodyRowStarts[i];
+			int end = m_bodyRowStarts[i + 1];
+			if (begin == end)
+				continue;
+			btVector3 linear(0, 0, 0);
+			btVector3 angular(0, 0, 0);
+			for (int j = begin; j < end; j++)
+			{
+				int row = m_bodyRows[j] >> 1;
+				btScalar deltaImpulse = m_deltaImpulse[row];
+				if (m_bodyRows[j] & 1)
+				{
+					linear += m_normal2[row] * deltaImpulse;
+					angular += m_angularComponentB[row] * deltaImpulse;
+				}
+				else
+				{
+					linear += m_normal1[row] * deltaImpulse;
+					angular += m_angularComponentA[row] * deltaImpulse;
+				}
+			}
+			btSolverBody& body = bodies[i];
+			if (m_push)
+			{
+				body.m_pushVelocity += linear * body.internalGetInvMass() * body.m_linearFactor;
+				body.m_turnVelocity += angular * body.m_angularFactor;
+			}
+			else
+			{
+				body.m_deltaLinearVelocity += linear * body.internalGetInvMass() * body.m_linearFactor;
+				body.m_deltaAngularVelocity += angular * body.m_angularFactor;
+			}
+		}
+	}
+};
+
+btScalar btJacobiConstraintSolver::solvePass(int pass, int iteration, int numIterations, bool push)
+{
+	btAssert(!push || pass == 0);
+	int firstFrictionRow = m_numJointRows + m_numContactRows;
+	int rowBegin = pass == 0 ? 0 : firstFrictionRow;
+	int rowEnd = pass == 0 ? firstFrictionRow : m_rowBodyA.size();
+	if (rowBegin == rowEnd)
+		return btScalar(0);
+
+	btJacobiSolveRowsLoop solveLoop;
+	solveLoop.m_bodies = &m_tmpSolverBodyPool;
+	solveLoop.m_iteration = iteration;
+	solveLoop.m_numIterations = numIterations;
+	solveLoop.m_firstContactRow = m_numJointRows;
+	solveLoop.m_firstFrictionRow = firstFrictionRow;
+	solveLoop.m_firstRollingFrictionRow = firstFrictionRow + m_numFrictionRows;
+	solveLoop.m_push = push;
+	solveLoop.m_bodyA = &m_rowBodyA[0];
+	solveLoop.m_bodyB = &m_rowBodyB[0];
+	solveLoop.m_normal1 = &m_rowNormal1[0];
+	solveLoop.m_relpos1CrossNormal = &m_rowRelpos1CrossNormal[0];
+	solveLoop.m_normal2 = &m_rowNormal2[0];
+	solveLoop.m_relpos2CrossNormal = &m_rowRelpos2CrossNormal[0];
+	solveLoop.m_rhs = push ? &m_rowRhsPenetration[0] : &m_rowRhs[0];
+	solveLoop.m_cfm = &m_rowCfm[0];
+	solveLoop.m_jacDiagABInv = &m_rowJacDiagABInv[0];
+	solveLoop.m_lowerLimit = &m_rowLowerLimit[0];
+	solveLoop.m_upperLimit = &m_rowUpperLimit[0];
+	solveLoop.m_friction = &m_rowFriction[0];
+	solveLoop.m_appliedImpulse = push ? &m_rowAppliedPushImpulse[0] : &m_rowAppliedImpulse[0];
+	solveLoop.m_normalImpulse = &m_rowAppliedImpulse[0];
+	solveLoop.m_deltaImpulse = &m_rowDeltaImpulse[0];
+	solveLoop.m_residual = &m_rowResidual[0];
+	solveLoop.m_frictionIndex = &m_rowFrictionIndex[0];
+	solveLoop.m_numRowIterations = &m_rowNumIterations[0];
+	{
+		BT_PROFILE("solveRows");
+		btParallelFor(rowBegin, rowEnd, 64, solveLoop);
+	}
+
+	btJacobiApplyImpulsesLoop applyLoop;
+	applyLoop.m_bodies = &m_tmpSolverBodyPool;
+	applyLoop.m_bodyRowStarts = &m_bodyRowStarts[pass][0];
+	applyLoop.m_bodyRows = m_bodyRows[pass].size() ? &m_bodyRows[pass][0] : 0;
+	applyLoop.m_normal1 = &m_rowNormal1[0];
+	applyLoop.m_normal2 = &m_rowNormal2[0];
+	applyLoop.m_angularComponentA = &m_rowAngularComponentA[0];
+	applyLoop.m_angularComponentB = &m_rowAngularComponentB[0];
+	applyLoop.m_deltaImpulse = &m_rowDeltaImpulse[0];
+	applyLoop.m_push = push;
+	{
+		BT_PROFILE("applyImpulses");
+		btParallelFor(0, m_tmpSolverBodyPool.size(), 64, applyLoop);
+	}
+
+	//the maximum doesn't depend on the order, but is taken here to keep the row loop free of shared state
+	btScalar leastSquaresResidual = btScalar(0);
+	for (int row = rowBegin; row < rowEnd; row++)
+		leastSquaresResidual = btMax(leastSquaresResidual, m_rowResidual[row]);
+	return leastSquaresResidual;
+}
+
+void btJacobiConstraintSolver::solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject** /*bodies*/, int /*numBodies*/, btPersistentManifold** /*manifoldPtr*/, int /*numManifolds*/, btTypedConstraint** /*constraints*/, int /*numConstraints*/, const btContactSolverInfo& infoGlobal, btIDebugDraw* /*debugDrawer*/)
+{
+	BT_PROFILE("solveGroupCacheFriendlySplitImpulseIterations");
+	if (!infoGlobal.m_splitImpulse || !m_numContactRows)
+		return;
+	for (int iteration = 0; iteration < infoGlobal.m_numIterations; iteration++)
+	{
+		btScalar leastSquaresResidual = solvePass(0, iteration, infoGlobal.m_numIterations, true);
+		if (leastSquaresResidual <= infoGlobal.m_leastSquaresResidualThreshold || iteration >= (infoGlobal.m_numIterations - 1))
+		{
+#ifdef VERBOSE_RESIDUAL_PRINTF
+			printf("residual = %f at iteration #%d\n", leastSquaresResidual, iteration);
+#endif
+			break;
+		}
+	}
+}
+
+btScalar btJacobiConstraintSolver::solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer)
+{
+	BT_PROFILE("solveGroupCacheFriendlyIterations");
+
+	if (infoGlobal.m_numSolverSubsteps > 1)
+		return solveGroupCacheFriendlySubsteps(bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+
+	gatherRows();
+	buildBodyRows(0, 0, m_numJointRows + m_numContactRows);
+	buildBodyRows(1, m_numJointRows + m_numContactRows, m_rowBodyA.size());
+
+	///this is a special step to resolve penetrations (just for contacts)
+	solveGroupCacheFriendlySplitImpulseIterations(bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+
+	int maxIterations = m_maxOverrideNumSolverIterations > infoGlobal.m_numIterations ? m_maxOverrideNumSolverIterations : infoGlobal.m_numIterations;
+
+	for (int iteration = 0; iteration < maxIterations; iteration++)
+	{
+		m_leastSquaresResidual = solvePass(0, iteration, infoGlobal.m_numIterations, false);
+		m_leastSquaresResidual = btMax(m_leastSquaresResidual, solvePass(1, iteration, infoGlobal.m_numIterations, false));
+
+		if (m_leastSquaresResidual <= infoGlobal.m_leastSquaresResidualThreshold || (iteration >= (maxIterations - 1)))
+		{
+#ifdef VERBOSE_RESIDUAL_PRINTF
+			printf("residual = %f at iteration #%d\n", m_leastSquaresResidual, iteration);
+#endif
+			m_analyticsData.m_numSolverCalls++;
+			m_analyticsData.m_numIterationsUsed = iteration + 1;
+			m_analyticsData.m_islandId = -2;
+			if (numBodies > 0)
+				m_analyticsData.m_islandId = bodies[0]->getCompanionId();
+			m_analyticsData.m_numBodies = numBodies;
+			m_analyticsData.m_numContactManifolds = numManifolds;
+			m_analyticsData.m_remainingLeastSquaresResidual = m_leastSquaresResidual;
+			break;
+		}
+	}
+
+	scatterRows();
+	return 0.f;
+}
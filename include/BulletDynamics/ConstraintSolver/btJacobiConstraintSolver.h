@@ -0,0 +1,87 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_JACOBI_CONSTRAINT_SOLVER_H
+#define BT_JACOBI_CONSTRAINT_SOLVER_H
+
+#include "btSequentialImpulseConstraintSolver.h"
+
+///The btJacobiConstraintSolver solves the rows of btSequentialImpulseConstraintSolver in Jacobi style, the CPU version of b3GpuJacobiContactSolver.
+///Every iteration solves all rows at once against the velocities of the previous iteration, with the mass of each body split
+///evenly over the rows that touch it, and then applies the sum of the impulse changes to every body in a fixed row order.
+///The rows and the bodies are processed with btParallelFor, so the result is bitwise identical for any number of threads
+///and any task scheduler, which makes it suitable as the deterministic mode for lockstep networking.
+///An iteration has two passes: the joint and contact rows, then the friction rows with limits from the new normal impulses.
+///Jacobi converges more slowly than Gauss Seidel, stacks need more iterations than with btSequentialImpulseConstraintSolver.
+///The setup and the write back are the ones of btSequentialImpulseConstraintSolver, SOLVER_RANDMIZE_ORDER and SOLVER_BLOCK_CONTACTS
+///have no effect and substepping (m_numSolverSubsteps > 1) falls back to the sequential iterations.
+ATTRIBUTE_ALIGNED16(class)
+btJacobiConstraintSolver : public btSequentialImpulseConstraintSolver
+{
+protected:
+	//rows of all pools in SoA layout: joints, contacts, friction, rolling friction
+	btAlignedObjectArray<int> m_rowBodyA;
+	btAlignedObjectArray<int> m_rowBodyB;
+	btAlignedObjectArray<btVector3> m_rowNormal1;
+	btAlignedObjectArray<btVector3> m_rowRelpos1CrossNormal;
+	btAlignedObjectArray<btVector3> m_rowNormal2;
+	btAlignedObjectArray<btVector3> m_rowRelpos2CrossNormal;
+	btAlignedObjectArray<btVector3> m_rowAngularComponentA;
+	btAlignedObjectArray<btVector3> m_rowAngularComponentB;
+	btAlignedObjectArray<btScalar> m_rowRhs;  //m_rhs, m_rhsPenetration, m_cfm and m_jacDiagABInv are scaled by the mass split
+	btAlignedObjectArray<btScalar> m_rowRhsPenetration;
+	btAlignedObjectArray<btScalar> m_rowCfm;
+	btAlignedObjectArray<btScalar> m_rowJacDiagABInv;
+	btAlignedObjectArray<btScalar> m_rowLowerLimit;
+	btAlignedObjectArray<btScalar> m_rowUpperLimit;
+	btAlignedObjectArray<btScalar> m_rowFriction;
+	btAlignedObjectArray<btScalar> m_rowAppliedImpulse;
+	btAlignedObjectArray<btScalar> m_rowAppliedPushImpulse;
+	btAlignedObjectArray<btScalar> m_rowDeltaImpulse;    //change of the current pass
+	btAlignedObjectArray<btScalar> m_rowResidual;
+	btAlignedObjectArray<int> m_rowFrictionIndex;        //row of the contact, for friction rows
+	btAlignedObjectArray<int> m_rowNumIterations;
+
+	//rows of every solver body, sorted, 2 * row + 1 when the body is body B of the row. One table per pass
+	btAlignedObjectArray<int> m_bodyRowStarts[2];
+	btAlignedObjectArray<int> m_bodyRows[2];
+
+	int m_numJointRows;
+	int m_numContactRows;
+	int m_numFrictionRows;
+	int m_numRollingFrictionRows;
+
+	void gatherRow(const btSolverConstraint& c, int row, int frictionIndex);
+	void gatherRows();
+	void buildBodyRows(int pass, int rowBegin, int rowEnd);
+	void scatterRows();
+	///pass 0 solves the joint and contact rows, pass 1 the friction rows, push solves the split impulse of the contacts
+	btScalar solvePass(int pass, int iteration, int numIterations, bool push);
+
+	virtual void solveGroupCacheFriendlySplitImpulseIterations(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
+	virtual btScalar solveGroupCacheFriendlyIterations(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btJacobiConstraintSolver();
+
+	virtual btConstraintSolverType getSolverType() const
+	{
+		return BT_JACOBI_SOLVER;
+	}
+};
+
+#endif  //BT_JACOBI_CONSTRAINT_SOLVER_H
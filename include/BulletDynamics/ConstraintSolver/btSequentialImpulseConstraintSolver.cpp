@@ -1520,9 +1520,306 @@ btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(btCol
 		}
 	}
 
+	if (infoGlobal.m_solverMode & SOLVER_BLOCK_CONTACTS)
+		setupContactBlocks();
+	else
+		m_tmpSolverContactBlockPool.resize(0);
+
 	return 0.f;
 }
 
+static btScalar btContactRowCoupling(const btSolverConstraint& ci, const btSolverConstraint& cj, const btSolverBody& bodyA, const btSolverBody& bodyB)
+{
+	btScalar coupling = btScalar(0);
+	if (bodyA.m_originalBody)
+	{
+		coupling += ci.m_contactNormal1.dot(cj.m_contactNormal1 * bodyA.internalGetInvMass() * bodyA.m_linearFactor);
+		coupling += ci.m_relpos1CrossNormal.dot(cj.m_angularComponentA * bodyA.m_angularFactor);
+	}
+	if (bodyB.m_originalBody)
+	{
+		coupling += ci.m_contactNormal2.dot(cj.m_contactNormal2 * bodyB.internalGetInvMass() * bodyB.m_linearFactor);
+		coupling += ci.m_relpos2CrossNormal.dot(cj.m_angularComponentB * bodyB.m_angularFactor);
+	}
+	return coupling;
+}
+
+static btScalar btContactRowVelocity(const btSolverConstraint& c, btSolverBody& bodyA, btSolverBody& bodyB)
+{
+	return c.m_contactNormal1.dot(bodyA.internalGetDeltaLinearVelocity()) + c.m_relpos1CrossNormal.dot(bodyA.internalGetDeltaAngularVelocity()) +
+		   c.m_contactNormal2.dot(bodyB.internalGetDeltaLinearVelocity()) + c.m_relpos2CrossNormal.dot(bodyB.internalGetDeltaAngularVelocity());
+}
+
+///solves the n x n system a*x = rhs by gaussian elimination with partial pivoting, a and rhs are destroyed
+static bool btSolveSmallDense(int n, btScalar a[4][4], btScalar rhs[4], btScalar x[4], btScalar pivotTolerance)
+{
+	for (int k = 0; k < n; k++)
+	{
+		int pivot = k;
+		for (int i = k + 1; i < n; i++)
+		{
+			if (btFabs(a[i][k]) > btFabs(a[pivot][k]))
+				pivot = i;
+		}
+		if (btFabs(a[pivot][k]) <= pivotTolerance)
+			return false;
+		if (pivot != k)
+		{
+			for (int j = k; j < n; j++)
+				btSwap(a[k][j], a[pivot][j]);
+			btSwap(rhs[k], rhs[pivot]);
+		}
+		for (int i = k + 1; i < n; i++)
+		{
+			btScalar f = a[i][k] / a[k][k];
+			for (int j = k; j < n; j++)
+				a[i][j] -= f * a[k][j];
+			rhs[i] -= f * rhs[k];
+		}
+	}
+	for (int k = n - 1; k >= 0; k--)
+	{
+		btScalar sum = rhs[k];
+		for (int j = k + 1; j < n; j++)
+			sum -= a[k][j] * x[j];
+		x[k] = sum / a[k][k];
+	}
+	return true;
+}
+
+///exact solution of the boxed LCP  w = K*x + b,  lo <= x <= hi  for n <= 4 variables.
+///Every assignment of free / at lower / at upper is tried, starting with all variables free,
+///which is the common case for resting contact. Returns false if no assignment is consistent.
+static bool btSolveSmallBoxLcp(int n, const btScalar K[4][4], const btScalar b[4], const btScalar lo[4], const btScalar hi[4], bool boxed, btScalar x[4])
+{
+	const int radix = boxed ? 3 : 2;
+	int numCombinations = 1;
+	btScalar maxDiag = btScalar(0);
+	for (int i = 0; i < n; i++)
+	{
+		numCombinations *= radix;
+		maxDiag = btMax(maxDiag, K[i][i]);
+	}
+	const btScalar pivotTolerance = maxDiag * btScalar(1e-9);
+	for (int combination = 0; combination < numCombinations; combination++)
+	{
+		//0: free, 1: at lower limit, 2: at upper limit
+		int state[4];
+		int freeIndex[4];
+		int numFree = 0;
+		int code = combination;
+		for (int i = 0; i < n; i++)
+		{
+			state[i] = code % radix;
+			code /= radix;
+			if (state[i] == 0)
+				freeIndex[numFree++] = i;
+			else
+				x[i] = (state[i] == 1) ? lo[i] : hi[i];
+		}
+		if (numFree)
+		{
+			btScalar a[4][4];
+			btScalar rhs[4];
+			btScalar xFree[4];
+			for (int r = 0; r < numFree; r++)
+			{
+				int i = freeIndex[r];
+				rhs[r] = -b[i];
+				for (int j = 0; j < n; j++)
+				{
+					if (state[j] != 0)
+						rhs[r] -= K[i][j] * x[j];
+				}
+				for (int c = 0; c < numFree; c++)
+					a[r][c] = K[i][freeIndex[c]];
+			}
+			if (!btSolveSmallDense(numFree, a, rhs, xFree, pivotTolerance))
+				continue;
+			for (int r = 0; r < numFree; r++)
+				x[freeIndex[r]] = xFree[r];
+		}
+		bool consistent = true;
+		for (int i = 0; i < n && consistent; i++)
+		{
+			btScalar tolerance = btScalar(1e-6) * (btScalar(1) + btFabs(x[i]));
+			if (state[i] == 0)
+			{
+				consistent = (x[i] >= lo[i] - tolerance) && (x[i] <= hi[i] + tolerance);
+			}
+			else
+			{
+				btScalar w = b[i];
+				for (int j = 0; j < n; j++)
+					w += K[i][j] * x[j];
+				btScalar velocityTolerance = btScalar(1e-6) * (btScalar(1) + btFabs(b[i]));
+				consistent = (state[i] == 1) ? (w >= -velocityTolerance) : (w <= velocityTolerance);
+			}
+		}
+		if (consistent)
+		{
+			for (int i = 0; i < n; i++)
+				x[i] = btMax(lo[i], btMin(hi[i], x[i]));
+			return true;
+		}
+	}
+	return false;
+}
+
+void btSequentialImpulseConstraintSolver::setupContactBlocks()
+{
+	BT_PROFILE("setupContactBlocks");
+	m_tmpSolverContactBlockPool.resize(0);
+	int numContacts = m_tmpSolverContactConstraintPool.size();
+	int i = 0;
+	while (i < numContacts)
+	{
+		//convertContact emits the points of one manifold consecutively, so a run with the same body pair is (part of) one manifold
+		const btSolverConstraint& first = m_tmpSolverContactConstraintPool[i];
+		int count = 1;
+		while (count < 4 && i + count < numContacts &&
+			   m_tmpSolverContactConstraintPool[i + count].m_solverBodyIdA == first.m_solverBodyIdA &&
+			   m_tmpSolverContactConstraintPool[i + count].m_solverBodyIdB == first.m_solverBodyIdB)
+		{
+			count++;
+		}
+		btSolverContactBlock& block = m_tmpSolverContactBlockPool.expandNonInitializing();
+		block.m_firstContact = i;
+		block.m_numContacts = count;
+		const btSolverBody& bodyA = m_tmpSolverBodyPool[first.m_solverBodyIdA];
+		const btSolverBody& bodyB = m_tmpSolverBodyPool[first.m_solverBodyIdB];
+		for (int r = 0; r < count; r++)
+		{
+			for (int c = 0; c < count; c++)
+			{
+				block.m_A[r][c] = btContactRowCoupling(m_tmpSolverContactConstraintPool[i + r], m_tmpSolverContactConstraintPool[i + c], bodyA, bodyB);
+			}
+		}
+		i += count;
+	}
+}
+
+btScalar btSequentialImpulseConstraintSolver::resolveContactBlock(const btSolverContactBlock& block)
+{
+	const int n = block.m_numContacts;
+	const btSolverConstraint& first = m_tmpSolverContactConstraintPool[block.m_firstContact];
+	btSolverBody& bodyA = m_tmpSolverBodyPool[first.m_solverBodyIdA];
+	btSolverBody& bodyB = m_tmpSolverBodyPool[first.m_solverBodyIdB];
+
+	btScalar K[4][4];
+	btScalar b[4];
+	btScalar x[4];
+	btScalar lo[4];
+	btScalar hi[4];
+	for (int i = 0; i < n; i++)
+	{
+		const btSolverConstraint& c = m_tmpSolverContactConstraintPool[block.m_firstContact + i];
+		//the row solver works in impulse units scaled by m_jacDiagABInv, the block works in velocity units
+		b[i] = btContactRowVelocity(c, bodyA, bodyB) - c.m_rhs / c.m_jacDiagABInv;
+		for (int j = 0; j < n; j++)
+		{
+			K[i][j] = block.m_A[i][j];
+			b[i] -= block.m_A[i][j] * m_tmpSolverContactConstraintPool[block.m_firstContact + j].m_appliedImpulse;
+		}
+		//coplanar contact points make the coupling matrix singular, a tiny relative regularization keeps the elimination stable
+		K[i][i] += block.m_A[i][i] * btScalar(1e-5) + c.m_cfm / c.m_jacDiagABInv;
+		lo[i] = c.m_lowerLimit;
+		hi[i] = c.m_upperLimit;
+	}
+
+	btScalar residual = btScalar(0);
+	if (!btSolveSmallBoxLcp(n, K, b, lo, hi, false, x))
+	{
+		for (int i = 0; i < n; i++)
+		{
+			btScalar rowResidual = resolveSingleConstraintRowLowerLimit(bodyA, bodyB, m_tmpSolverContactConstraintPool[block.m_firstContact + i]);
+			residual = btMax(residual, rowResidual * rowResidual);
+		}
+		return residual;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		btSolverConstraint& c = m_tmpSolverContactConstraintPool[block.m_firstContact + i];
+		btScalar deltaImpulse = x[i] - c.m_appliedImpulse;
+		c.m_appliedImpulse = x[i];
+		bodyA.internalApplyImpulse(c.m_contactNormal1 * bodyA.internalGetInvMass(), c.m_angularComponentA, deltaImpulse);
+		bodyB.internalApplyImpulse(c.m_contactNormal2 * bodyB.internalGetInvMass(), c.m_angularComponentB, deltaImpulse);
+		btScalar rowResidual = deltaImpulse * (btScalar(1) / c.m_jacDiagABInv);
+		residual = btMax(residual, rowResidual * rowResidual);
+	}
+	return residual;
+}
+
+btScalar btSequentialImpulseConstraintSolver::resolveContactBlockFriction(const btSolverContactBlock& block, const btContactSolverInfo& infoGlobal)
+{
+	btScalar residual = btScalar(0);
+	for (int i = 0; i < block.m_numContacts; i++)
+	{
+		const btSolverConstraint& contact = m_tmpSolverContactConstraintPool[block.m_firstContact + i];
+		btScalar totalImpulse = contact.m_appliedImpulse;
+		if (totalImpulse <= btScalar(0))
+			continue;
+		btSolverConstraint& friction0 = m_tmpSolverContactFrictionConstraintPool[contact.m_frictionIndex];
+		btSolverBody& bodyA = m_tmpSolverBodyPool[friction0.m_solverBodyIdA];
+		btSolverBody& bodyB = m_tmpSolverBodyPool[friction0.m_solverBodyIdB];
+		friction0.m_lowerLimit = -(friction0.m_friction * totalImpulse);
+		friction0.m_upperLimit = friction0.m_friction * totalImpulse;
+		if (!(infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS))
+		{
+			btScalar rowResidual = resolveSingleConstraintRowGeneric(bodyA, bodyB, friction0);
+			residual = btMax(residual, rowResidual * rowResidual);
+			continue;
+		}
+		btSolverConstraint& friction1 = m_tmpSolverContactFrictionConstraintPool[contact.m_frictionIndex + 1];
+		friction1.m_lowerLimit = -(friction1.m_friction * totalImpulse);
+		friction1.m_upperLimit = friction1.m_friction * totalImpulse;
+
+		//both tangent directions are solved together, so friction doesn't drift along the direction solved last
+		btSolverConstraint* rows[2] = {&friction0, &friction1};
+		btScalar K[4][4];
+		btScalar b[4];
+		btScalar x[4];
+		btScalar lo[4];
+		btScalar hi[4];
+		for (int r = 0; r < 2; r++)
+		{
+			const btSolverConstraint& c = *rows[r];
+			b[r] = btContactRowVelocity(c, bodyA, bodyB) - c.m_rhs / c.m_jacDiagABInv;
+			for (int j = 0; j < 2; j++)
+			{
+				K[r][j] = btContactRowCoupling(c, *rows[j], bodyA, bodyB);
+				b[r] -= K[r][j] * rows[j]->m_appliedImpulse;
+			}
+			lo[r] = c.m_lowerLimit;
+			hi[r] = c.m_upperLimit;
+		}
+		for (int r = 0; r < 2; r++)
+		{
+			K[r][r] += K[r][r] * btScalar(1e-5) + rows[r]->m_cfm / rows[r]->m_jacDiagABInv;
+		}
+		if (!btSolveSmallBoxLcp(2, K, b, lo, hi, true, x))
+		{
+			for (int r = 0; r < 2; r++)
+			{
+				btScalar rowResidual = resolveSingleConstraintRowGeneric(bodyA, bodyB, *rows[r]);
+				residual = btMax(residual, rowResidual * rowResidual);
+			}
+			continue;
+		}
+		for (int r = 0; r < 2; r++)
+		{
+			btSolverConstraint& c = *rows[r];
+			btScalar deltaImpulse = x[r] - c.m_appliedImpulse;
+			c.m_appliedImpulse = x[r];
+			bodyA.internalApplyImpulse(c.m_contactNormal1 * bodyA.internalGetInvMass(), c.m_angularComponentA, deltaImpulse);
+			bodyB.internalApplyImpulse(c.m_contactNormal2 * bodyB.internalGetInvMass(), c.m_angularComponentB, deltaImpulse);
+			btScalar rowResidual = deltaImpulse * (btScalar(1) / c.m_jacDiagABInv);
+			residual = btMax(residual, rowResidual * rowResidual);
+		}
+	}
+	return residual;
+}
+
 btScalar btSequentialImpulseConstraintSolver::solveSingleIteration(int iteration, btCollisionObject** /*bodies */, int /*numBodies*/, btPersistentManifold** /*manifoldPtr*/, int /*numManifolds*/, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* /*debugDrawer*/)
 {
 	BT_PROFILE("solveSingleIteration");
@@ -1592,7 +1889,17 @@ btScalar btSequentialImpulseConstraintSolver::solveSingleIteration(int iteration
 		}
 
 		///solve all contact constraints
-		if (infoGlobal.m_solverMode & SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS)
+		if (infoGlobal.m_solverMode & SOLVER_BLOCK_CONTACTS)
+		{
+			//each block's normal rows are solved exactly, then the friction rows of its points
+			for (int b = 0; b < m_tmpSolverContactBlockPool.size(); b++)
+			{
+				const btSolverContactBlock& block = m_tmpSolverContactBlockPool[b];
+				leastSquaresResidual = btMax(leastSquaresResidual, resolveContactBlock(block));
+				leastSquaresResidual = btMax(leastSquaresResidual, resolveContactBlockFriction(block, infoGlobal));
+			}
+		}
+		else if (infoGlobal.m_solverMode & SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS)
 		{
 			int numPoolConstraints = m_tmpSolverContactConstraintPool.size();
 			int multiplier = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) ? 2 : 1;
@@ -1727,10 +2034,201 @@ void btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySplitImpulseIte
 	}
 }
 
+static btScalar btRowVelocity(const btSolverConstraint& c, const btVector3& linA, const btVector3& angA, const btVector3& linB, const btVector3& angB)
+{
+	return c.m_contactNormal1.dot(linA) + c.m_relpos1CrossNormal.dot(angA) + c.m_contactNormal2.dot(linB) + c.m_relpos2CrossNormal.dot(angB);
+}
+
+static void btRemoveExternalImpulseFromRows(btConstraintArray& rows, btAlignedObjectArray<btSolverBody>& bodies, bool includeTorque)
+{
+	const btVector3 zero(0, 0, 0);
+	for (int j = 0; j < rows.size(); j++)
+	{
+		btSolverConstraint& c = rows[j];
+		const btSolverBody& bodyA = bodies[c.m_solverBodyIdA];
+		const btSolverBody& bodyB = bodies[c.m_solverBodyIdB];
+		btScalar externalVelocity = btRowVelocity(c, bodyA.m_externalForceImpulse, includeTorque ? bodyA.m_externalTorqueImpulse : zero, bodyB.m_externalForceImpulse, includeTorque ? bodyB.m_externalTorqueImpulse : zero);
+		c.m_rhs += externalVelocity * c.m_jacDiagABInv;
+	}
+}
+
+static void btSetupSubstepContactRows(btConstraintArray& contacts, btAlignedObjectArray<btSolverBody>& bodies, const btAlignedObjectArray<btScalar>& separations, const btAlignedObjectArray<btScalar>& restitutions, btScalar invSubstep, btScalar positionalBiasRate, btScalar maxBiasVelocity)
+{
+	for (int j = 0; j < contacts.size(); j++)
+	{
+		btSolverConstraint& c = contacts[j];
+		const btSolverBody& bodyA = bodies[c.m_solverBodyIdA];
+		const btSolverBody& bodyB = bodies[c.m_solverBodyIdB];
+		//m_pushVelocity and m_turnVelocity hold the displacement since the start of the step
+		btScalar separation = separations[j] + btRowVelocity(c, bodyA.m_pushVelocity, bodyA.m_turnVelocity, bodyB.m_pushVelocity, bodyB.m_turnVelocity);
+		btScalar targetVelocity = restitutions[j];
+		if (separation > 0)
+		{
+			//speculative contact, allow closing the gap within this substep
+			targetVelocity -= separation * invSubstep;
+		}
+		else
+		{
+			targetVelocity += btMin(-separation * positionalBiasRate, maxBiasVelocity);
+		}
+		btScalar relVel = btRowVelocity(c, bodyA.m_linearVelocity, bodyA.m_angularVelocity, bodyB.m_linearVelocity, bodyB.m_angularVelocity);
+		c.m_rhs = (targetVelocity - relVel) * c.m_jacDiagABInv;
+		c.m_rhsPenetration = 0;
+	}
+}
+
+static void btScaleAppliedImpulses(btConstraintArray& rows, btScalar scale)
+{
+	for (int j = 0; j < rows.size(); j++)
+		rows[j].m_appliedImpulse *= scale;
+}
+
+static void btApplyRowImpulses(const btConstraintArray& rows, btAlignedObjectArray<btSolverBody>& bodies)
+{
+	for (int j = 0; j < rows.size(); j++)
+	{
+		const btSolverConstraint& c = rows[j];
+		if (c.m_appliedImpulse != btScalar(0))
+		{
+			btSolverBody& bodyA = bodies[c.m_solverBodyIdA];
+			btSolverBody& bodyB = bodies[c.m_solverBodyIdB];
+			bodyA.internalApplyImpulse(c.m_contactNormal1 * bodyA.internalGetInvMass(), c.m_angularComponentA, c.m_appliedImpulse);
+			bodyB.internalApplyImpulse(c.m_contactNormal2 * bodyB.internalGetInvMass(), c.m_angularComponentB, c.m_appliedImpulse);
+		}
+	}
+}
+
+///Temporal Gauss-Seidel: the step is split into m_numSolverSubsteps substeps of one iteration each.
+///External forces are applied a substep at a time and body displacements are accumulated, so the separation
+///of each contact is updated analytically from the manifold distance instead of running collision detection again.
+///During the substeps m_appliedImpulse holds the impulse of a single substep, which is applied again as warm start
+///at the beginning of every substep.
+btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySubsteps(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer)
+{
+	BT_PROFILE("solveGroupCacheFriendlySubsteps");
+	const int numSubsteps = infoGlobal.m_numSolverSubsteps;
+	const btScalar substep = infoGlobal.m_timeStep / btScalar(numSubsteps);
+	const btScalar invSubstep = btScalar(1) / substep;
+	const btScalar substepFraction = btScalar(1) / btScalar(numSubsteps);
+	const btScalar erp = (infoGlobal.m_erp2 > btScalar(0)) ? infoGlobal.m_erp2 : infoGlobal.m_erp;
+	const btScalar positionalBiasRate = erp * invSubstep;
+
+	//the rows were set up against the velocity after the full external impulse,
+	//rebase them on the velocity at the start of the step since the impulse is now applied gradually
+	//(friction rows only include the external force, see setupFrictionConstraint)
+	btRemoveExternalImpulseFromRows(m_tmpSolverNonContactConstraintPool, m_tmpSolverBodyPool, true);
+	btRemoveExternalImpulseFromRows(m_tmpSolverContactFrictionConstraintPool, m_tmpSolverBodyPool, false);
+	btRemoveExternalImpulseFromRows(m_tmpSolverContactRollingFrictionConstraintPool, m_tmpSolverBodyPool, false);
+
+	int numContacts = m_tmpSolverContactConstraintPool.size();
+	m_tmpContactSeparationPool.resizeNoInitialize(numContacts);
+	m_tmpContactRestitutionPool.resizeNoInitialize(numContacts);
+	for (int j = 0; j < numContacts; j++)
+	{
+		const btSolverConstraint& c = m_tmpSolverContactConstraintPool[j];
+		const btSolverBody& bodyA = m_tmpSolverBodyPool[c.m_solverBodyIdA];
+		const btSolverBody& bodyB = m_tmpSolverBodyPool[c.m_solverBodyIdB];
+		const btManifoldPoint* cp = (const btManifoldPoint*)c.m_originalContactPoint;
+		btScalar separation = cp->getDistance() + infoGlobal.m_linearSlop;
+		btScalar restitution = btScalar(0);
+		if (separation <= btScalar(0))
+		{
+			btScalar relVel = btRowVelocity(c, bodyA.m_linearVelocity, bodyA.m_angularVelocity, bodyB.m_linearVelocity, bodyB.m_angularVelocity);
+			restitution = btMax(btScalar(0), restitutionCurve(relVel, cp->m_combinedRestitution, infoGlobal.m_restitutionVelocityThreshold));
+		}
+		m_tmpContactSeparationPool[j] = separation;
+		m_tmpContactRestitutionPool[j] = restitution;
+	}
+
+	//m_pushVelocity and m_turnVelocity accumulate the displacement over the substeps, split impulse is not used.
+	//The delta velocity only holds the warm start of the whole step, which is redistributed over the substeps.
+	for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
+	{
+		btSolverBody& body = m_tmpSolverBodyPool[i];
+		body.m_pushVelocity.setZero();
+		body.m_turnVelocity.setZero();
+		body.m_deltaLinearVelocity.setZero();
+		body.m_deltaAngularVelocity.setZero();
+	}
+	btScaleAppliedImpulses(m_tmpSolverNonContactConstraintPool, substepFraction);
+	btScaleAppliedImpulses(m_tmpSolverContactConstraintPool, substepFraction);
+	btScaleAppliedImpulses(m_tmpSolverContactFrictionConstraintPool, substepFraction);
+	btScaleAppliedImpulses(m_tmpSolverContactRollingFrictionConstraintPool, substepFraction);
+
+	for (int step = 0; step < numSubsteps; step++)
+	{
+		for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
+		{
+			btSolverBody& body = m_tmpSolverBodyPool[i];
+			if (body.m_originalBody)
+			{
+				body.m_deltaLinearVelocity += body.m_externalForceImpulse * substepFraction;
+				body.m_deltaAngularVelocity += body.m_externalTorqueImpulse * substepFraction;
+			}
+		}
+		btApplyRowImpulses(m_tmpSolverNonContactConstraintPool, m_tmpSolverBodyPool);
+		btApplyRowImpulses(m_tmpSolverContactConstraintPool, m_tmpSolverBodyPool);
+		btApplyRowImpulses(m_tmpSolverContactFrictionConstraintPool, m_tmpSolverBodyPool);
+		btApplyRowImpulses(m_tmpSolverContactRollingFrictionConstraintPool, m_tmpSolverBodyPool);
+
+		btSetupSubstepContactRows(m_tmpSolverContactConstraintPool, m_tmpSolverBodyPool, m_tmpContactSeparationPool, m_tmpContactRestitutionPool, invSubstep, positionalBiasRate, infoGlobal.m_maxErrorReduction);
+		m_leastSquaresResidual = solveSingleIteration(0, bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+
+		for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
+		{
+			btSolverBody& body = m_tmpSolverBodyPool[i];
+			if (body.m_originalBody)
+			{
+				body.m_pushVelocity += (body.m_linearVelocity + body.m_deltaLinearVelocity) * substep;
+				body.m_turnVelocity += (body.m_angularVelocity + body.m_deltaAngularVelocity) * substep;
+			}
+		}
+
+		//relax: solve again without positional bias so the stored impulses, and the warm start of the next substep, carry no push-out velocity
+		btSetupSubstepContactRows(m_tmpSolverContactConstraintPool, m_tmpSolverBodyPool, m_tmpContactSeparationPool, m_tmpContactRestitutionPool, invSubstep, btScalar(0), infoGlobal.m_maxErrorReduction);
+		m_leastSquaresResidual = solveSingleIteration(0, bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+	}
+
+	//the world integrates the final velocity over the whole step, the push and turn velocities
+	//correct that to the displacement accumulated over the substeps
+	const btScalar invTimeStep = btScalar(1) / infoGlobal.m_timeStep;
+	for (int i = 0; i < m_tmpSolverBodyPool.size(); i++)
+	{
+		btSolverBody& body = m_tmpSolverBodyPool[i];
+		if (body.m_originalBody)
+		{
+			body.m_pushVelocity = body.m_pushVelocity * invTimeStep - (body.m_linearVelocity + body.m_deltaLinearVelocity);
+			body.m_turnVelocity = body.m_turnVelocity * invTimeStep - (body.m_angularVelocity + body.m_deltaAngularVelocity);
+			//writeBackBodies adds the external impulse again
+			body.m_deltaLinearVelocity -= body.m_externalForceImpulse;
+			body.m_deltaAngularVelocity -= body.m_externalTorqueImpulse;
+		}
+	}
+	//report the impulse of the whole step, as the iterative path does
+	btScalar numSubstepsScale = btScalar(numSubsteps);
+	btScaleAppliedImpulses(m_tmpSolverNonContactConstraintPool, numSubstepsScale);
+	btScaleAppliedImpulses(m_tmpSolverContactConstraintPool, numSubstepsScale);
+	btScaleAppliedImpulses(m_tmpSolverContactFrictionConstraintPool, numSubstepsScale);
+	btScaleAppliedImpulses(m_tmpSolverContactRollingFrictionConstraintPool, numSubstepsScale);
+
+	m_analyticsData.m_numSolverCalls++;
+	m_analyticsData.m_numIterationsUsed = numSubsteps;
+	m_analyticsData.m_islandId = -2;
+	if (numBodies > 0)
+		m_analyticsData.m_islandId = bodies[0]->getCompanionId();
+	m_analyticsData.m_numBodies = numBodies;
+	m_analyticsData.m_numContactManifolds = numManifolds;
+	m_analyticsData.m_remainingLeastSquaresResidual = m_leastSquaresResidual;
+	return 0.f;
+}
+
 btScalar btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer)
 {
 	BT_PROFILE("solveGroupCacheFriendlyIterations");
 
+	if (infoGlobal.m_numSolverSubsteps > 1 && supportsSolverSubsteps())
+		return solveGroupCacheFriendlySubsteps(bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+
 	{
 		///this is a special step to resolve penetrations (just for contacts)
 		solveGroupCacheFriendlySplitImpulseIterations(bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
@@ -1807,12 +2305,15 @@ void btSequentialImpulseConstraintSolver::writeBackJoints(int iBegin, int iEnd,
 
 void btSequentialImpulseConstraintSolver::writeBackBodies(int iBegin, int iEnd, const btContactSolverInfo& infoGlobal)
 {
+	const bool substeps = infoGlobal.m_numSolverSubsteps > 1 && supportsSolverSubsteps();
 	for (int i = iBegin; i < iEnd; i++)
 	{
 		btRigidBody* body = m_tmpSolverBodyPool[i].m_originalBody;
 		if (body)
 		{
-			if (infoGlobal.m_splitImpulse)
+			if (substeps)
+				m_tmpSolverBodyPool[i].writebackVelocityAndTransform(infoGlobal.m_timeStep, btScalar(1));
+			else if (infoGlobal.m_splitImpulse)
 				m_tmpSolverBodyPool[i].writebackVelocityAndTransform(infoGlobal.m_timeStep, infoGlobal.m_splitImpulseTurnErp);
 			else
 				m_tmpSolverBodyPool[i].writebackVelocity();
@@ -1825,7 +2326,7 @@ void btSequentialImpulseConstraintSolver::writeBackBodies(int iBegin, int iEnd,
 				m_tmpSolverBodyPool[i].m_angularVelocity +
 				m_tmpSolverBodyPool[i].m_externalTorqueImpulse);
 
-			if (infoGlobal.m_splitImpulse)
+			if (infoGlobal.m_splitImpulse || substeps)
 				m_tmpSolverBodyPool[i].m_originalBody->setWorldTransform(m_tmpSolverBodyPool[i].m_worldTransform);
 
 			m_tmpSolverBodyPool[i].m_originalBody->setCompanionId(-1);
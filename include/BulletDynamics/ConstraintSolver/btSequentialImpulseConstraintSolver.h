@@ -63,6 +63,19 @@ protected:
 	btAlignedObjectArray<int> m_orderNonContactConstraintPool;
 	btAlignedObjectArray<int> m_orderFrictionConstraintPool;
 	btAlignedObjectArray<btTypedConstraint::btConstraintInfo1> m_tmpConstraintSizesPool;
+
+	///a run of up to 4 consecutive contact rows between the same pair of solver bodies,
+	///solved as one coupled LCP when SOLVER_BLOCK_CONTACTS is set
+	struct btSolverContactBlock
+	{
+		int m_firstContact;
+		int m_numContacts;
+		btScalar m_A[4][4];  //effective mass coupling J*M^-1*J^T of the rows, without cfm
+	};
+	btAlignedObjectArray<btSolverContactBlock> m_tmpSolverContactBlockPool;
+	///separation and restitution velocity of each contact row at the start of the step, used by the substepping path
+	btAlignedObjectArray<btScalar> m_tmpContactSeparationPool;
+	btAlignedObjectArray<btScalar> m_tmpContactRestitutionPool;
 	int m_maxOverrideNumSolverIterations;
 	int m_fixedBodyId;
 	// When running solvers on multiple threads, a race condition exists for Kinematic objects that
@@ -141,6 +154,10 @@ protected:
 		return m_resolveSplitPenetrationImpulse(bodyA, bodyB, contactConstraint);
 	}
 
+	void setupContactBlocks();
+	btScalar resolveContactBlock(const btSolverContactBlock& block);
+	btScalar resolveContactBlockFriction(const btSolverContactBlock& block, const btContactSolverInfo& infoGlobal);
+
 protected:
 	void writeBackContacts(int iBegin, int iEnd, const btContactSolverInfo& infoGlobal);
 	void writeBackJoints(int iBegin, int iEnd, const btContactSolverInfo& infoGlobal);
@@ -150,6 +167,7 @@ protected:
 	virtual btScalar solveSingleIteration(int iteration, btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
 
 	virtual btScalar solveGroupCacheFriendlySetup(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
+	btScalar solveGroupCacheFriendlySubsteps(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
 	virtual btScalar solveGroupCacheFriendlyIterations(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
 
 public:
@@ -181,6 +199,11 @@ public:
 		return BT_SEQUENTIAL_IMPULSE_SOLVER;
 	}
 
+	virtual bool supportsSolverSubsteps() const
+	{
+		return true;
+	}
+
 	btSingleConstraintRowSolver getActiveConstraintRowSolverGeneric()
 	{
 		return m_resolveSingleConstraintRowGeneric;
@@ -28,6 +28,7 @@ int btSequentialImpulseConstraintSolverMt::s_minBatchSize = 50;
 int btSequentialImpulseConstraintSolverMt::s_maxBatchSize = 100;
 btBatchedConstraints::BatchingMethod btSequentialImpulseConstraintSolverMt::s_contactBatchingMethod = btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_2D;
 btBatchedConstraints::BatchingMethod btSequentialImpulseConstraintSolverMt::s_jointBatchingMethod = btBatchedConstraints::BATCHING_METHOD_SPATIAL_GRID_2D;
+btVector3 btSequentialImpulseConstraintSolverMt::s_sphericalGridCenter = btVector3(0, 0, 0);
 
 btSequentialImpulseConstraintSolverMt::btSequentialImpulseConstraintSolverMt()
 {
@@ -43,6 +44,7 @@ btSequentialImpulseConstraintSolverMt::~btSequentialImpulseConstraintSolverMt()
 void btSequentialImpulseConstraintSolverMt::setupBatchedContactConstraints()
 {
 	BT_PROFILE("setupBatchedContactConstraints");
+	m_batchedContactConstraints.m_sphericalGridCenter = s_sphericalGridCenter;
 	m_batchedContactConstraints.setup(&m_tmpSolverContactConstraintPool,
 									  m_tmpSolverBodyPool,
 									  s_contactBatchingMethod,
@@ -54,6 +56,7 @@ void btSequentialImpulseConstraintSolverMt::setupBatchedContactConstraints()
 void btSequentialImpulseConstraintSolverMt::setupBatchedJointConstraints()
 {
 	BT_PROFILE("setupBatchedJointConstraints");
+	m_batchedJointConstraints.m_sphericalGridCenter = s_sphericalGridCenter;
 	m_batchedJointConstraints.setup(&m_tmpSolverNonContactConstraintPool,
 									m_tmpSolverBodyPool,
 									s_jointBatchingMethod,
@@ -89,6 +89,7 @@ public:
 	static int s_minimumContactManifoldsForBatching;  // don't even try to batch if fewer manifolds than this
 	static btBatchedConstraints::BatchingMethod s_contactBatchingMethod;
 	static btBatchedConstraints::BatchingMethod s_jointBatchingMethod;
+	static btVector3 s_sphericalGridCenter;  // used by BATCHING_METHOD_SPHERICAL_GRID, e.g. the center of a planet
 	static int s_minBatchSize;  // desired number of constraints per batch
 	static int s_maxBatchSize;
 
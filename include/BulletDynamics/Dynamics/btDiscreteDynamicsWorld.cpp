@@ -199,7 +199,8 @@ btDiscreteDynamicsWorld::btDiscreteDynamicsWorld(btDispatcher* dispatcher, btBro
 	  m_synchronizeAllMotionStates(false),
 	  m_applySpeculativeContactRestitution(false),
 	  m_profileTimings(0),
-	  m_latencyMotionStateInterpolation(true)
+	  m_latencyMotionStateInterpolation(true),
+	  m_softStepping(false)
 
 {
 	if (!m_constraintSolver)
@@ -429,11 +430,23 @@ int btDiscreteDynamicsWorld::stepSimulation(btScalar timeStep, int maxSubSteps,
 
 		applyGravity();
 
-		for (int i = 0; i < clampedSimulationSteps; i++)
+		if (m_softStepping && clampedSimulationSteps > 1 && m_constraintSolver->supportsSolverSubsteps())
 		{
-			internalSingleStepSimulation(fixedTimeStep);
+			//one collision pass for the whole frame, the solver substeps at the fixed time step
+			int numSolverSubsteps = m_solverInfo.m_numSolverSubsteps;
+			m_solverInfo.m_numSolverSubsteps = btMax(numSolverSubsteps, 1) * clampedSimulationSteps;
+			internalSingleStepSimulation(fixedTimeStep * clampedSimulationSteps);
+			m_solverInfo.m_numSolverSubsteps = numSolverSubsteps;
 			synchronizeMotionStates();
 		}
+		else
+		{
+			for (int i = 0; i < clampedSimulationSteps; i++)
+			{
+				internalSingleStepSimulation(fixedTimeStep);
+				synchronizeMotionStates();
+			}
+		}
 	}
 	else
 	{
@@ -66,6 +66,8 @@ protected:
 
 	bool m_latencyMotionStateInterpolation;
 
+	bool m_softStepping;
+
 	btAlignedObjectArray<btPersistentManifold*> m_predictiveManifolds;
 	btSpinMutex m_predictiveManifoldsMutex;  // used to synchronize threads creating predictive contacts
 
@@ -229,6 +231,45 @@ public:
 	{
 		return m_latencyMotionStateInterpolation;
 	}
+
+	///When several fixed steps are due in one stepSimulation call, run collision detection once for all of them
+	///and let the constraint solver take the fixed steps as substeps (see btContactSolverInfo::m_numSolverSubsteps).
+	///Much cheaper than full substeps on slow frames, at the cost of contacts that appear during the frame being found late.
+	///Solvers without btConstraintSolver::supportsSolverSubsteps, like the multibody solvers, keep taking the fixed steps one by one.
+	void setSoftStepping(bool softStepping)
+	{
+		m_softStepping = softStepping;
+	}
+	bool getSoftStepping() const
+	{
+		return m_softStepping;
+	}
+
+	///the time accumulated by stepSimulation that was not simulated yet, saved by btDynamicsWorldCheckpoint
+	btScalar getLocalTime() const
+	{
+		return m_localTime;
+	}
+
+	void setLocalTime(btScalar localTime)
+	{
+		m_localTime = localTime;
+	}
+
+	///speculative contact manifolds of the last step, they stay in the dispatcher until the next step releases them
+	const btAlignedObjectArray<btPersistentManifold*>& getPredictiveManifolds() const
+	{
+		return m_predictiveManifolds;
+	}
+
+	void setPredictiveManifolds(btPersistentManifold* const* manifolds, int numManifolds)
+	{
+		m_predictiveManifolds.resize(numManifolds);
+		for (int i = 0; i < numManifolds; i++)
+		{
+			m_predictiveManifolds[i] = manifolds[i];
+		}
+	}
     
     btAlignedObjectArray<btRigidBody*>& getNonStaticRigidBodies()
     {
@@ -53,6 +53,7 @@ public:
 
 	virtual void reset() BT_OVERRIDE;
 	virtual btConstraintSolverType getSolverType() const BT_OVERRIDE { return m_solverType; }
+	virtual bool supportsSolverSubsteps() const BT_OVERRIDE { return m_solvers.size() && m_solvers[0].solver->supportsSolverSubsteps(); }
 
 private:
 	const static size_t kCacheLineSize = 128;
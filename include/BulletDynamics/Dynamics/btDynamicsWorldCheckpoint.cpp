@@ -0,0 +1,592 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDynamicsWorldCheckpoint.h"
+#include "btDiscreteDynamicsWorld.h"
+#include "btRigidBody.h"
+#include "BulletDynamics/ConstraintSolver/btTypedConstraint.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
+#include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include "LinearMath/btPoolAllocator.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <string.h>  //for memcpy
+
+btDynamicsWorldCheckpoint::btDynamicsWorldCheckpoint()
+	: m_valid(false),
+	  m_world(0),
+	  m_manifoldPool(0),
+	  m_algorithmPool(0),
+	  m_localTime(0),
+	  m_hasSolverSeed(false),
+	  m_solverSeed(0)
+{
+}
+
+btDynamicsWorldCheckpoint::~btDynamicsWorldCheckpoint()
+{
+}
+
+void btDynamicsWorldCheckpoint::saveTree(const btDbvt& tree, TreeState& state)
+{
+	state.m_nodes.resize(0);
+	state.m_lkhd = tree.m_lkhd;
+	state.m_leaves = tree.m_leaves;
+	state.m_opath = tree.m_opath;
+	if (!tree.m_root)
+	{
+		return;
+	}
+
+	//preorder with childs[0] first, so restoreTree can link the first child it sees as childs[0]
+	btAlignedObjectArray<const btDbvtNode*> stack;
+	btAlignedObjectArray<int> parents;
+	stack.push_back(tree.m_root);
+	parents.push_back(-1);
+	while (stack.size())
+	{
+		const btDbvtNode* node = stack[stack.size() - 1];
+		const int parent = parents[parents.size() - 1];
+		stack.pop_back();
+		parents.pop_back();
+
+		TreeNode& state_node = state.m_nodes.expandNonInitializing();
+		state_node.m_volume = node->volume;
+		state_node.m_parent = parent;
+		if (node->isleaf())
+		{
+			state_node.m_proxy = static_cast<btDbvtProxy*>(node->data);
+		}
+		else
+		{
+			state_node.m_proxy = 0;
+			const int index = state.m_nodes.size() - 1;
+			stack.push_back(node->childs[1]);
+			parents.push_back(index);
+			stack.push_back(node->childs[0]);
+			parents.push_back(index);
+		}
+	}
+}
+
+void btDynamicsWorldCheckpoint::collectNodes(btDbvtNode* node, btAlignedObjectArray<btDbvtNode*>& nodes)
+{
+	if (!node)
+	{
+		return;
+	}
+	const int first = nodes.size();
+	nodes.push_back(node);
+	for (int i = first; i < nodes.size(); ++i)
+	{
+		btDbvtNode* n = nodes[i];
+		if (n->isinternal())
+		{
+			nodes.push_back(n->childs[0]);
+			nodes.push_back(n->childs[1]);
+		}
+	}
+}
+
+void btDynamicsWorldCheckpoint::restoreTree(btDbvt& tree, const TreeState& state, btDbvtNode* const* nodes)
+{
+	const int numNodes = state.m_nodes.size();
+	for (int i = 0; i < numNodes; ++i)
+	{
+		const TreeNode& state_node = state.m_nodes[i];
+		btDbvtNode* node = nodes[i];
+		node->volume = state_node.m_volume;
+		if (state_node.m_proxy)
+		{
+			node->data = state_node.m_proxy;
+			node->childs[1] = 0;
+			state_node.m_proxy->leaf = node;
+		}
+		else
+		{
+			node->childs[0] = node->childs[1] = 0;
+		}
+		if (state_node.m_parent >= 0)
+		{
+			btDbvtNode* parent = nodes[state_node.m_parent];
+			node->parent = parent;
+			parent->childs[parent->childs[0] ? 1 : 0] = node;
+		}
+		else
+		{
+			node->parent = 0;
+		}
+	}
+	tree.m_root = numNodes ? nodes[0] : 0;
+	tree.m_lkhd = state.m_lkhd;
+	tree.m_leaves = state.m_leaves;
+	tree.m_opath = state.m_opath;
+}
+
+void btDynamicsWorldCheckpoint::restorePoolElements(btPoolAllocator* pool, void* const* elements, const unsigned char* data, int numElements, int elemSize, btAlignedObjectArray<unsigned char>& used)
+{
+	//the free list gets a different order than in the original run, allocation addresses don't affect the simulation
+	used.resize(pool->getMaxCount());
+	if (used.size())
+	{
+		memset(&used[0], 0, used.size());
+	}
+	const unsigned char* poolAddress = pool->getPoolAddress();
+	const int poolElemSize = pool->getElementSize();
+	for (int i = 0; i < numElements; ++i)
+	{
+		used[int((static_cast<const unsigned char*>(elements[i]) - poolAddress) / poolElemSize)] = 1;
+	}
+	if (used.size())
+	{
+		pool->resetFreeList(&used[0]);
+	}
+	for (int i = 0; i < numElements; ++i)
+	{
+		memcpy(elements[i], data + size_t(i) * elemSize, elemSize);
+	}
+}
+
+bool btDynamicsWorldCheckpoint::save(btDiscreteDynamicsWorld* world, btCollisionDispatcher* dispatcher, btDbvtBroadphase* broadphase)
+{
+	BT_PROFILE("btDynamicsWorldCheckpoint::save");
+	m_valid = false;
+	btAssert(world->getDispatcher() == dispatcher && world->getBroadphase() == broadphase);
+	if (world->getDispatcher() != dispatcher || world->getBroadphase() != broadphase)
+	{
+		return false;
+	}
+	//btSortedOverlappingPairCache removes pairs deferred and needs its own state
+	if (broadphase->m_paircache->hasDeferredRemoval())
+	{
+		return false;
+	}
+	m_world = world;
+
+	const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+	const int numObjects = objects.size();
+	m_objects.resize(numObjects);
+	m_proxies.resize(numObjects);
+	m_objectStates.resizeNoInitialize(numObjects);
+	for (int i = 0; i < numObjects; ++i)
+	{
+		btCollisionObject* obj = objects[i];
+		if (obj->getInternalType() != btCollisionObject::CO_RIGID_BODY && obj->getInternalType() != btCollisionObject::CO_COLLISION_OBJECT)
+		{
+			return false;
+		}
+		const btCollisionShape* shape = obj->getCollisionShape();
+		if (!shape->isConvex() && shape->getShapeType() != STATIC_PLANE_PROXYTYPE)
+		{
+			return false;
+		}
+		m_objects[i] = obj;
+		m_proxies[i] = obj->getBroadphaseHandle();
+
+		ObjectState& state = m_objectStates[i];
+		state.m_worldTransform = obj->getWorldTransform();
+		state.m_interpolationWorldTransform = obj->getInterpolationWorldTransform();
+		state.m_interpolationLinearVelocity = obj->getInterpolationLinearVelocity();
+		state.m_interpolationAngularVelocity = obj->getInterpolationAngularVelocity();
+		state.m_deactivationTime = obj->getDeactivationTime();
+		state.m_hitFraction = obj->getHitFraction();
+		state.m_activationState = obj->getActivationState();
+		state.m_islandTag = obj->getIslandTag();
+		state.m_companionId = obj->getCompanionId();
+		if (const btRigidBody* body = btRigidBody::upcast(obj))
+		{
+			state.m_invInertiaTensorWorld = body->getInvInertiaTensorWorld();
+			state.m_linearVelocity = body->getLinearVelocity();
+			state.m_angularVelocity = body->getAngularVelocity();
+			state.m_gravity = body->getGravity();
+		}
+	}
+
+	const btAlignedObjectArray<btRigidBody*>& nonStaticRigidBodies = world->getNonStaticRigidBodies();
+	m_nonStaticRigidBodies.resize(nonStaticRigidBodies.size());
+	for (int i = 0; i < nonStaticRigidBodies.size(); ++i)
+	{
+		m_nonStaticRigidBodies[i] = nonStaticRigidBodies[i];
+	}
+
+	const int numConstraints = world->getNumConstraints();
+	m_constraints.resize(numConstraints);
+	m_constraintStates.resize(numConstraints);
+	for (int i = 0; i < numConstraints; ++i)
+	{
+		btTypedConstraint* constraint = world->getConstraint(i);
+		m_constraints[i] = constraint;
+		m_constraintStates[i].m_appliedImpulse = constraint->internalGetAppliedImpulse();
+		m_constraintStates[i].m_enabled = constraint->isEnabled();
+	}
+
+	//manifolds, the ones that overflowed the pool into the heap can't be restored at their address
+	m_manifoldPool = dispatcher->getCollisionConfiguration()->getPersistentManifoldPool();
+	const int numManifolds = dispatcher->getNumManifolds();
+	m_manifolds.resize(numManifolds);
+	m_manifoldData.resize(numManifolds * int(sizeof(btPersistentManifold)));
+	for (int i = 0; i < numManifolds; ++i)
+	{
+		btPersistentManifold* manifold = dispatcher->getInternalManifoldPointer()[i];
+		if (!m_manifoldPool->validPtr(manifold))
+		{
+			return false;
+		}
+		m_manifolds[i] = manifold;
+		memcpy(&m_manifoldData[i * int(sizeof(btPersistentManifold))], manifold, sizeof(btPersistentManifold));
+	}
+	const btAlignedObjectArray<btPersistentManifold*>& predictiveManifolds = world->getPredictiveManifolds();
+	m_predictiveManifolds.resize(predictiveManifolds.size());
+	for (int i = 0; i < predictiveManifolds.size(); ++i)
+	{
+		m_predictiveManifolds[i] = predictiveManifolds[i];
+	}
+
+	//overlapping pairs and their collision algorithms
+	const btBroadphasePairArray& pairs = broadphase->m_paircache->getOverlappingPairArray();
+	m_pairs.resize(0);
+	m_pairs.reserve(pairs.size());
+	m_algorithmPool = dispatcher->getCollisionConfiguration()->getCollisionAlgorithmPool();
+	const int algorithmSize = m_algorithmPool->getElementSize();
+	m_algorithms.resize(0);
+	m_algorithmData.resize(0);
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		const btBroadphasePair& pair = pairs[i];
+		m_pairs.push_back(pair);
+		if (pair.m_algorithm)
+		{
+			if (!m_algorithmPool->validPtr(pair.m_algorithm))
+			{
+				return false;
+			}
+			m_algorithms.push_back(pair.m_algorithm);
+			const int offset = m_algorithmData.size();
+			m_algorithmData.resize(offset + algorithmSize);
+			memcpy(&m_algorithmData[offset], pair.m_algorithm, algorithmSize);
+		}
+	}
+
+	//restore resets the free lists of the pools, which would also free slots that are held outside of the world
+	if (m_manifolds.size() != m_manifoldPool->getUsedCount() || m_algorithms.size() != m_algorithmPool->getUsedCount())
+	{
+		return false;
+	}
+
+	//broadphase
+	saveTree(broadphase->m_sets[0], m_trees[0]);
+	saveTree(broadphase->m_sets[1], m_trees[1]);
+	m_proxyStates.resize(0);
+	m_proxyStates.reserve(numObjects);
+	for (int i = 0; i < NUM_STAGE_LISTS; ++i)
+	{
+		m_stageListSizes[i] = 0;
+		for (btDbvtProxy* proxy = broadphase->m_stageRoots[i]; proxy; proxy = proxy->links[1])
+		{
+			ProxyState& state = m_proxyStates.expandNonInitializing();
+			state.m_proxy = proxy;
+			state.m_aabbMin = proxy->m_aabbMin;
+			state.m_aabbMax = proxy->m_aabbMax;
+			state.m_stage = proxy->stage;
+			++m_stageListSizes[i];
+		}
+	}
+	//every proxy has to belong to one of the collision objects, or restore could not validate them
+	if (m_proxyStates.size() != numObjects)
+	{
+		return false;
+	}
+	m_stageCurrent = broadphase->m_stageCurrent;
+	m_fupdates = broadphase->m_fupdates;
+	m_dupdates = broadphase->m_dupdates;
+	m_cupdates = broadphase->m_cupdates;
+	m_newpairs = broadphase->m_newpairs;
+	m_fixedleft = broadphase->m_fixedleft;
+	m_updates_call = broadphase->m_updates_call;
+	m_updates_done = broadphase->m_updates_done;
+	m_updates_ratio = broadphase->m_updates_ratio;
+	m_pid = broadphase->m_pid;
+	m_cid = broadphase->m_cid;
+	m_gid = broadphase->m_gid;
+	m_needcleanup = broadphase->m_needcleanup;
+
+	m_localTime = world->getLocalTime();
+	m_hasSolverSeed = world->getConstraintSolver()->getSolverType() == BT_SEQUENTIAL_IMPULSE_SOLVER;
+	if (m_hasSolverSeed)
+	{
+		m_solverSeed = static_cast<btSequentialImpulseConstraintSolver*>(world->getConstraintSolver())->getRandSeed();
+	}
+
+	m_valid = true;
+	return true;
+}
+
+bool btDynamicsWorldCheckpoint::matchesWorld(btDiscreteDynamicsWorld* world, btCollisionDispatcher* dispatcher, btDbvtBroadphase* broadphase) const
+{
+	if (!m_valid || world != m_world || world->getDispatcher() != dispatcher || world->getBroadphase() != broadphase)
+	{
+		return false;
+	}
+	if (dispatcher->getCollisionConfiguration()->getPersistentManifoldPool() != m_manifoldPool ||
+		dispatcher->getCollisionConfiguration()->getCollisionAlgorithmPool() != m_algorithmPool)
+	{
+		return false;
+	}
+
+	const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+	if (objects.size() != m_objects.size())
+	{
+		return false;
+	}
+	for (int i = 0; i < objects.size(); ++i)
+	{
+		if (objects[i] != m_objects[i] || objects[i]->getBroadphaseHandle() != m_proxies[i])
+		{
+			return false;
+		}
+	}
+
+	const btAlignedObjectArray<btRigidBody*>& nonStaticRigidBodies = world->getNonStaticRigidBodies();
+	if (nonStaticRigidBodies.size() != m_nonStaticRigidBodies.size())
+	{
+		return false;
+	}
+	for (int i = 0; i < nonStaticRigidBodies.size(); ++i)
+	{
+		if (nonStaticRigidBodies[i] != m_nonStaticRigidBodies[i])
+		{
+			return false;
+		}
+	}
+
+	if (world->getNumConstraints() != m_constraints.size())
+	{
+		return false;
+	}
+	for (int i = 0; i < m_constraints.size(); ++i)
+	{
+		if (world->getConstraint(i) != m_constraints[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool btDynamicsWorldCheckpoint::poolsHoldOnlyWorldElements(btCollisionDispatcher* dispatcher, btDbvtBroadphase* broadphase) const
+{
+	int numManifolds = 0;
+	for (int i = 0; i < dispatcher->getNumManifolds(); ++i)
+	{
+		if (m_manifoldPool->validPtr(dispatcher->getInternalManifoldPointer()[i]))
+		{
+			++numManifolds;
+		}
+	}
+	int numAlgorithms = 0;
+	const btBroadphasePairArray& pairs = broadphase->m_paircache->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		if (m_algorithmPool->validPtr(pairs[i].m_algorithm))
+		{
+			++numAlgorithms;
+		}
+	}
+	return numManifolds == m_manifoldPool->getUsedCount() && numAlgorithms == m_algorithmPool->getUsedCount();
+}
+
+bool btDynamicsWorldCheckpoint::restore(btDiscreteDynamicsWorld* world, btCollisionDispatcher* dispatcher, btDbvtBroadphase* broadphase) const
+{
+	BT_PROFILE("btDynamicsWorldCheckpoint::restore");
+	if (!matchesWorld(world, dispatcher, broadphase))
+	{
+		return false;
+	}
+	//the free lists of the pools are rebuilt from the saved elements, a slot held outside of the world would be handed out twice
+	if (!poolsHoldOnlyWorldElements(dispatcher, broadphase))
+	{
+		return false;
+	}
+
+	//release what was allocated on the heap since the save, the pool contents are replaced wholesale below
+	btBroadphasePairArray& pairs = broadphase->m_paircache->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); ++i)
+	{
+		btCollisionAlgorithm* algorithm = pairs[i].m_algorithm;
+		if (algorithm && !m_algorithmPool->validPtr(algorithm))
+		{
+			algorithm->~btCollisionAlgorithm();
+			dispatcher->freeCollisionAlgorithm(algorithm);
+			pairs[i].m_algorithm = 0;
+		}
+	}
+	for (int i = dispatcher->getNumManifolds() - 1; i >= 0; --i)
+	{
+		btPersistentManifold* manifold = dispatcher->getInternalManifoldPointer()[i];
+		if (!m_manifoldPool->validPtr(manifold))
+		{
+			dispatcher->releaseManifold(manifold);
+		}
+	}
+
+	//manifolds and algorithms at their original addresses
+	if (m_manifolds.size())
+	{
+		restorePoolElements(m_manifoldPool, (void* const*)&m_manifolds[0], &m_manifoldData[0], m_manifolds.size(), int(sizeof(btPersistentManifold)), m_poolUsed);
+	}
+	else
+	{
+		restorePoolElements(m_manifoldPool, 0, 0, 0, 0, m_poolUsed);
+	}
+	if (m_algorithms.size())
+	{
+		restorePoolElements(m_algorithmPool, (void* const*)&m_algorithms[0], &m_algorithmData[0], m_algorithms.size(), m_algorithmPool->getElementSize(), m_poolUsed);
+	}
+	else
+	{
+		restorePoolElements(m_algorithmPool, 0, 0, 0, 0, m_poolUsed);
+	}
+	dispatcher->setInternalManifolds(m_manifolds.size() ? &m_manifolds[0] : 0, m_manifolds.size());
+	world->setPredictiveManifolds(m_predictiveManifolds.size() ? &m_predictiveManifolds[0] : 0, m_predictiveManifolds.size());
+
+	//overlapping pairs, the hash table only depends on the proxy ids
+	pairs.resize(m_pairs.size());
+	for (int i = 0; i < m_pairs.size(); ++i)
+	{
+		pairs[i] = m_pairs[i];
+	}
+	static_cast<btHashedOverlappingPairCache*>(broadphase->m_paircache)->rebuildHashTable();
+
+	//broadphase trees, reusing the nodes the trees currently own
+	m_nodes.resize(0);
+	for (int i = 0; i < 2; ++i)
+	{
+		btDbvt& tree = broadphase->m_sets[i];
+		collectNodes(tree.m_root, m_nodes);
+		if (tree.m_free)
+		{
+			m_nodes.push_back(tree.m_free);
+			tree.m_free = 0;
+		}
+	}
+	const int numNodes = m_trees[0].m_nodes.size() + m_trees[1].m_nodes.size();
+	while (m_nodes.size() < numNodes)
+	{
+		m_nodes.push_back(new (btAlignedAlloc(sizeof(btDbvtNode), 16)) btDbvtNode());
+	}
+	while (m_nodes.size() > numNodes)
+	{
+		btAlignedFree(m_nodes[m_nodes.size() - 1]);
+		m_nodes.pop_back();
+	}
+	if (numNodes)
+	{
+		restoreTree(broadphase->m_sets[0], m_trees[0], &m_nodes[0]);
+		restoreTree(broadphase->m_sets[1], m_trees[1], &m_nodes[m_trees[0].m_nodes.size()]);
+	}
+	else
+	{
+		restoreTree(broadphase->m_sets[0], m_trees[0], 0);
+		restoreTree(broadphase->m_sets[1], m_trees[1], 0);
+	}
+
+	//stage lists, head first
+	int proxyIndex = 0;
+	for (int i = 0; i < NUM_STAGE_LISTS; ++i)
+	{
+		btDbvtProxy* previous = 0;
+		broadphase->m_stageRoots[i] = 0;
+		for (int j = 0; j < m_stageListSizes[i]; ++j)
+		{
+			const ProxyState& state = m_proxyStates[proxyIndex++];
+			btDbvtProxy* proxy = state.m_proxy;
+			proxy->m_aabbMin = state.m_aabbMin;
+			proxy->m_aabbMax = state.m_aabbMax;
+			proxy->stage = state.m_stage;
+			proxy->links[0] = previous;
+			proxy->links[1] = 0;
+			if (previous)
+			{
+				previous->links[1] = proxy;
+			}
+			else
+			{
+				broadphase->m_stageRoots[i] = proxy;
+			}
+			previous = proxy;
+		}
+	}
+	broadphase->m_stageCurrent = m_stageCurrent;
+	broadphase->m_fupdates = m_fupdates;
+	broadphase->m_dupdates = m_dupdates;
+	broadphase->m_cupdates = m_cupdates;
+	broadphase->m_newpairs = m_newpairs;
+	broadphase->m_fixedleft = m_fixedleft;
+	broadphase->m_updates_call = m_updates_call;
+	broadphase->m_updates_done = m_updates_done;
+	broadphase->m_updates_ratio = m_updates_ratio;
+	broadphase->m_pid = m_pid;
+	broadphase->m_cid = m_cid;
+	broadphase->m_gid = m_gid;
+	broadphase->m_needcleanup = m_needcleanup;
+
+	//collision objects and bodies
+	for (int i = 0; i < m_objects.size(); ++i)
+	{
+		btCollisionObject* obj = m_objects[i];
+		const ObjectState& state = m_objectStates[i];
+		obj->setWorldTransform(state.m_worldTransform);
+		obj->setInterpolationWorldTransform(state.m_interpolationWorldTransform);
+		obj->setInterpolationLinearVelocity(state.m_interpolationLinearVelocity);
+		obj->setInterpolationAngularVelocity(state.m_interpolationAngularVelocity);
+		obj->forceActivationState(state.m_activationState);
+		obj->setDeactivationTime(state.m_deactivationTime);
+		obj->setHitFraction(state.m_hitFraction);
+		obj->setIslandTag(state.m_islandTag);
+		obj->setCompanionId(state.m_companionId);
+		if (btRigidBody* body = btRigidBody::upcast(obj))
+		{
+			body->setInvInertiaTensorWorld(state.m_invInertiaTensorWorld);
+			body->setLinearVelocity(state.m_linearVelocity);
+			body->setAngularVelocity(state.m_angularVelocity);
+			//setGravity derives the force from the mass, only call it when the acceleration changed
+			if (body->getGravity() != state.m_gravity)
+			{
+				body->setGravity(state.m_gravity);
+			}
+			body->clearForces();
+		}
+	}
+
+	for (int i = 0; i < m_constraints.size(); ++i)
+	{
+		m_constraints[i]->internalSetAppliedImpulse(m_constraintStates[i].m_appliedImpulse);
+		m_constraints[i]->setEnabled(m_constraintStates[i].m_enabled);
+	}
+
+	world->setLocalTime(m_localTime);
+	if (m_hasSolverSeed && world->getConstraintSolver()->getSolverType() == BT_SEQUENTIAL_IMPULSE_SOLVER)
+	{
+		static_cast<btSequentialImpulseConstraintSolver*>(world->getConstraintSolver())->setRandSeed(m_solverSeed);
+	}
+
+	world->synchronizeMotionStates();
+	return true;
+}
@@ -0,0 +1,215 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_DYNAMICS_WORLD_CHECKPOINT_H
+#define BT_DYNAMICS_WORLD_CHECKPOINT_H
+
+#include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btTransform.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+
+class btDiscreteDynamicsWorld;
+class btCollisionDispatcher;
+class btCollisionObject;
+class btRigidBody;
+class btTypedConstraint;
+class btPersistentManifold;
+class btCollisionAlgorithm;
+class btPoolAllocator;
+struct btDbvtBroadphase;
+struct btDbvtProxy;
+
+///
+/// btDynamicsWorldCheckpoint - saves the simulation state of a btDiscreteDynamicsWorld in memory and rolls the world back to it.
+///
+///  Stepping from a restored checkpoint reproduces the original steps bit for bit, so it can be used for rollback networking,
+///  replays and "what if" steps. Only the state that changes while stepping is captured, not the structure of the world:
+///  restore fails, without changing the world, unless the world holds the same collision objects (in the same order,
+///  with the same broadphase proxies), the same rigid bodies and the same constraints as at save time.
+///
+///  Captured state:
+///     - per collision object: transforms, interpolation state, velocities, gravity, world inverse inertia, activation,
+///       deactivation time, hit fraction, island tag and companion id
+///     - per constraint: the enabled flag and the applied impulse
+///     - the contact manifolds (including warm starting impulses and predictive contacts) and the collision algorithms,
+///       restored at their original addresses in the pools of the collision configuration
+///     - the overlapping pairs in their original order
+///     - both btDbvt trees of the broadphase, the proxy stages and the incremental update counters
+///     - the time accumulated by stepSimulation and the random seed of btSequentialImpulseConstraintSolver
+///
+///  Limitations:
+///     - take and restore checkpoints between steps: forces are not captured, restore clears them
+///     - only rigid bodies and plain collision objects with convex shapes or btStaticPlaneShape, so the collision algorithms
+///       hold no memory outside of their pool slot
+///     - btDbvtBroadphase with the default btHashedOverlappingPairCache, and a collision configuration that is not shared
+///       with another world: every used slot of its pools has to belong to the world. btCollisionDispatcherMt keeps slots in
+///       per-thread caches, call its flushThreadLocalPools() before save and restore, or both fail
+///     - kinematic bodies are driven by their motion state, which the user has to roll back
+///     - constraint solver state beyond the applied impulse (for example motor or limit warm starting inside a constraint) is not captured
+///
+///  The checkpoint keeps its buffers, saving again into the same checkpoint does not allocate once they are large enough.
+///
+ATTRIBUTE_ALIGNED16(class)
+btDynamicsWorldCheckpoint
+{
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btDynamicsWorldCheckpoint();
+
+	~btDynamicsWorldCheckpoint();
+
+	///dispatcher and broadphase have to be the ones of world. Returns false, and leaves the checkpoint invalid,
+	///if the world contains anything the checkpoint does not support.
+	bool save(btDiscreteDynamicsWorld * world, btCollisionDispatcher * dispatcher, btDbvtBroadphase * broadphase);
+
+	///restore a checkpoint saved from the same world. The checkpoint stays valid and can be restored again.
+	bool restore(btDiscreteDynamicsWorld * world, btCollisionDispatcher * dispatcher, btDbvtBroadphase * broadphase) const;
+
+	bool isValid() const
+	{
+		return m_valid;
+	}
+
+	void invalidate()
+	{
+		m_valid = false;
+	}
+
+	int getNumCollisionObjects() const
+	{
+		return m_objects.size();
+	}
+
+	int getNumManifolds() const
+	{
+		return m_manifolds.size();
+	}
+
+	int getNumOverlappingPairs() const
+	{
+		return m_pairs.size();
+	}
+
+private:
+	struct ObjectState
+	{
+		btTransform m_worldTransform;
+		btTransform m_interpolationWorldTransform;
+		btVector3 m_interpolationLinearVelocity;
+		btVector3 m_interpolationAngularVelocity;
+		btMatrix3x3 m_invInertiaTensorWorld;
+		btVector3 m_linearVelocity;
+		btVector3 m_angularVelocity;
+		btVector3 m_gravity;
+		btScalar m_deactivationTime;
+		btScalar m_hitFraction;
+		int m_activationState;
+		int m_islandTag;
+		int m_companionId;
+	};
+
+	struct ConstraintState
+	{
+		btScalar m_appliedImpulse;
+		bool m_enabled;
+	};
+
+	struct TreeNode
+	{
+		btDbvtVolume m_volume;
+		int m_parent;
+		btDbvtProxy* m_proxy;  // 0 for internal nodes
+	};
+
+	struct TreeState
+	{
+		btAlignedObjectArray<TreeNode> m_nodes;  // preorder, childs[0] first
+		int m_lkhd;
+		int m_leaves;
+		unsigned m_opath;
+	};
+
+	struct ProxyState
+	{
+		btDbvtProxy* m_proxy;
+		btVector3 m_aabbMin;
+		btVector3 m_aabbMax;
+		int m_stage;
+	};
+
+	enum
+	{
+		NUM_STAGE_LISTS = 3  // btDbvtBroadphase::STAGECOUNT + 1, the last one holds the fixed proxies
+	};
+
+	static void saveTree(const btDbvt& tree, TreeState& state);
+	static void collectNodes(btDbvtNode * node, btAlignedObjectArray<btDbvtNode*> & nodes);
+	static void restoreTree(btDbvt & tree, const TreeState& state, btDbvtNode* const* nodes);
+	static void restorePoolElements(btPoolAllocator * pool, void* const* elements, const unsigned char* data, int numElements, int elemSize, btAlignedObjectArray<unsigned char>& used);
+
+	bool matchesWorld(btDiscreteDynamicsWorld * world, btCollisionDispatcher * dispatcher, btDbvtBroadphase * broadphase) const;
+	bool poolsHoldOnlyWorldElements(btCollisionDispatcher * dispatcher, btDbvtBroadphase * broadphase) const;
+
+	bool m_valid;
+	const btDiscreteDynamicsWorld* m_world;
+
+	btAlignedObjectArray<btCollisionObject*> m_objects;
+	btAlignedObjectArray<btBroadphaseProxy*> m_proxies;
+	btAlignedObjectArray<ObjectState> m_objectStates;
+	btAlignedObjectArray<btRigidBody*> m_nonStaticRigidBodies;
+
+	btAlignedObjectArray<btTypedConstraint*> m_constraints;
+	btAlignedObjectArray<ConstraintState> m_constraintStates;
+
+	btPoolAllocator* m_manifoldPool;
+	btAlignedObjectArray<btPersistentManifold*> m_manifolds;  // in dispatcher order
+	btAlignedObjectArray<unsigned char> m_manifoldData;
+	btAlignedObjectArray<btPersistentManifold*> m_predictiveManifolds;
+
+	btPoolAllocator* m_algorithmPool;
+	btAlignedObjectArray<btCollisionAlgorithm*> m_algorithms;
+	btAlignedObjectArray<unsigned char> m_algorithmData;
+
+	btBroadphasePairArray m_pairs;
+
+	TreeState m_trees[2];
+	btAlignedObjectArray<ProxyState> m_proxyStates;  // the stage lists, head first
+	int m_stageListSizes[NUM_STAGE_LISTS];
+	int m_stageCurrent;
+	int m_fupdates;
+	int m_dupdates;
+	int m_cupdates;
+	int m_newpairs;
+	int m_fixedleft;
+	unsigned m_updates_call;
+	unsigned m_updates_done;
+	btScalar m_updates_ratio;
+	int m_pid;
+	int m_cid;
+	int m_gid;
+	bool m_needcleanup;
+
+	btScalar m_localTime;
+	bool m_hasSolverSeed;
+	unsigned long m_solverSeed;
+
+	//scratch memory of restore
+	mutable btAlignedObjectArray<unsigned char> m_poolUsed;
+	mutable btAlignedObjectArray<btDbvtNode*> m_nodes;
+};
+
+#endif  //BT_DYNAMICS_WORLD_CHECKPOINT_H
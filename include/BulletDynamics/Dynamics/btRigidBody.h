@@ -267,6 +267,13 @@ public:
 		return m_invInertiaTensorWorld;
 	}
 
+	///overwrite the cached world space inverse inertia, that updateInertiaTensor derives from the transform.
+	///Used to restore it exactly, it can be stale after setMassProps until the next integration.
+	void setInvInertiaTensorWorld(const btMatrix3x3& invInertiaTensorWorld)
+	{
+		m_invInertiaTensorWorld = invInertiaTensorWorld;
+	}
+
 	void integrateVelocities(btScalar step);
 
 	void setCenterOfMassTransform(const btTransform& xform);
@@ -96,6 +96,12 @@ public:
 	virtual btScalar solveGroupCacheFriendlyFinish(btCollisionObject * *bodies, int numBodies, const btContactSolverInfo& infoGlobal);
 
 	virtual void solveMultiBodyGroup(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifold, int numManifolds, btTypedConstraint** constraints, int numConstraints, btMultiBodyConstraint** multiBodyConstraints, int numMultiBodyConstraints, const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher);
+
+	///the substeps of btSequentialImpulseConstraintSolver don't include the multibody rows
+	virtual bool supportsSolverSubsteps() const
+	{
+		return false;
+	}
 };
 
 #endif  //BT_MULTIBODY_CONSTRAINT_SOLVER_H
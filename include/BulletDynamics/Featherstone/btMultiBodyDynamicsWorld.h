@@ -52,6 +52,18 @@ protected:
 
 	virtual void serializeMultiBodies(btSerializer* serializer);
 
+	///per-multibody passes over a range of bodies, using the given scratch memory so that ranges can run concurrently
+	void forwardKinematicsInternal(btMultiBody** bodies, int numBodies, btAlignedObjectArray<btQuaternion>& scratch_world_to_local, btAlignedObjectArray<btVector3>& scratch_local_origin);
+	void computeMultiBodyAccelerationsInternal(btMultiBody** bodies, int numBodies, const btContactSolverInfo& solverInfo, bool isConstraintPass,
+											   btAlignedObjectArray<btScalar>& scratch_r, btAlignedObjectArray<btVector3>& scratch_v, btAlignedObjectArray<btMatrix3x3>& scratch_m);
+	void integrateMultiBodyTransformsInternal(btMultiBody** bodies, int numBodies, btScalar timeStep,
+											  btAlignedObjectArray<btQuaternion>& scratch_world_to_local, btAlignedObjectArray<btVector3>& scratch_local_origin);
+	void predictMultiBodyTransformsInternal(btMultiBody** bodies, int numBodies, btScalar timeStep,
+											btAlignedObjectArray<btQuaternion>& scratch_world_to_local, btAlignedObjectArray<btVector3>& scratch_local_origin);
+
+	///forward dynamics of all awake multibodies: adds gravity and steps the velocities, or only recomputes the joint feedback for the constraint pass
+	virtual void computeMultiBodyAccelerations(const btContactSolverInfo& solverInfo, bool isConstraintPass);
+
 public:
 	btMultiBodyDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btMultiBodyConstraintSolver* constraintSolver, btCollisionConfiguration* collisionConfiguration);
 
@@ -98,15 +110,15 @@ public:
 	virtual void removeMultiBodyConstraint(btMultiBodyConstraint* constraint);
 
 	virtual void integrateTransforms(btScalar timeStep);
-    void integrateMultiBodyTransforms(btScalar timeStep);
-    void predictMultiBodyTransforms(btScalar timeStep);
+    virtual void integrateMultiBodyTransforms(btScalar timeStep);
+    virtual void predictMultiBodyTransforms(btScalar timeStep);
     
     virtual void predictUnconstraintMotion(btScalar timeStep);
 	virtual void debugDrawWorld();
 
 	virtual void debugDrawMultiBodyConstraint(btMultiBodyConstraint* constraint);
 
-	void forwardKinematics();
+	virtual void forwardKinematics();
 	virtual void clearForces();
 	virtual void clearMultiBodyConstraintForces();
 	virtual void clearMultiBodyForces();
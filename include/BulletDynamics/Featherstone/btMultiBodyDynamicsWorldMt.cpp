@@ -0,0 +1,435 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btMultiBodyDynamicsWorldMt.h"
+#include "btMultiBody.h"
+#include "btMultiBodyLinkCollider.h"
+#include "btMultiBodyConstraint.h"
+#include "LinearMath/btQuickprof.h"
+
+static void btMultiBodyParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, grainSize, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+btMultiBodyConstraintSolverPoolMt::ThreadSolver* btMultiBodyConstraintSolverPoolMt::getAndLockThreadSolver()
+{
+	int i = 0;
+#if BT_THREADSAFE
+	i = btGetCurrentThreadIndex() % m_solvers.size();
+#endif  // #if BT_THREADSAFE
+	while (true)
+	{
+		ThreadSolver& solver = m_solvers[i];
+		if (solver.mutex.tryLock())
+		{
+			return &solver;
+		}
+		// failed, try the next one
+		i = (i + 1) % m_solvers.size();
+	}
+	return NULL;
+}
+
+void btMultiBodyConstraintSolverPoolMt::init(btMultiBodyConstraintSolver** solvers, int numSolvers)
+{
+	m_solverType = BT_MULTIBODY_SOLVER;
+	m_solvers.resize(numSolvers);
+	for (int i = 0; i < numSolvers; ++i)
+	{
+		m_solvers[i].solver = solvers[i];
+	}
+	if (numSolvers > 0)
+	{
+		m_solverType = solvers[0]->getSolverType();
+	}
+}
+
+btMultiBodyConstraintSolverPoolMt::btMultiBodyConstraintSolverPoolMt(int numSolvers)
+{
+	btAlignedObjectArray<btMultiBodyConstraintSolver*> solvers;
+	solvers.reserve(numSolvers);
+	for (int i = 0; i < numSolvers; ++i)
+	{
+		btMultiBodyConstraintSolver* solver = new btMultiBodyConstraintSolver();
+		solvers.push_back(solver);
+	}
+	init(&solvers[0], numSolvers);
+}
+
+btMultiBodyConstraintSolverPoolMt::btMultiBodyConstraintSolverPoolMt(btMultiBodyConstraintSolver** solvers, int numSolvers)
+{
+	init(solvers, numSolvers);
+}
+
+btMultiBodyConstraintSolverPoolMt::~btMultiBodyConstraintSolverPoolMt()
+{
+	// delete all solvers
+	for (int i = 0; i < m_solvers.size(); ++i)
+	{
+		ThreadSolver& solver = m_solvers[i];
+		delete solver.solver;
+		solver.solver = NULL;
+	}
+}
+
+btScalar btMultiBodyConstraintSolverPoolMt::solveGroup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifold, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher)
+{
+	ThreadSolver* ts = getAndLockThreadSolver();
+	ts->solver->solveGroup(bodies, numBodies, manifold, numManifolds, constraints, numConstraints, info, debugDrawer, dispatcher);
+	ts->mutex.unlock();
+	return 0.0f;
+}
+
+void btMultiBodyConstraintSolverPoolMt::solveMultiBodyGroup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifold, int numManifolds, btTypedConstraint** constraints, int numConstraints, btMultiBodyConstraint** multiBodyConstraints, int numMultiBodyConstraints, const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher)
+{
+	ThreadSolver* ts = getAndLockThreadSolver();
+	ts->solver->solveMultiBodyGroup(bodies, numBodies, manifold, numManifolds, constraints, numConstraints, multiBodyConstraints, numMultiBodyConstraints, info, debugDrawer, dispatcher);
+	if (info.m_reportSolverAnalytics & 1)
+	{
+		// only meaningful when called from a single thread, see MultiBodyParallelSolverIslandCallback
+		m_analyticsData = ts->solver->m_analyticsData;
+	}
+	ts->mutex.unlock();
+}
+
+void btMultiBodyConstraintSolverPoolMt::prepareSolve(int numBodies, int numManifolds)
+{
+	for (int i = 0; i < m_solvers.size(); ++i)
+	{
+		m_solvers[i].solver->prepareSolve(numBodies, numManifolds);
+	}
+}
+
+void btMultiBodyConstraintSolverPoolMt::allSolved(const btContactSolverInfo& info, class btIDebugDraw* debugDrawer)
+{
+	for (int i = 0; i < m_solvers.size(); ++i)
+	{
+		m_solvers[i].solver->allSolved(info, debugDrawer);
+	}
+}
+
+void btMultiBodyConstraintSolverPoolMt::reset()
+{
+	for (int i = 0; i < m_solvers.size(); ++i)
+	{
+		ThreadSolver& solver = m_solvers[i];
+		solver.mutex.lock();
+		solver.solver->reset();
+		solver.mutex.unlock();
+	}
+}
+
+MultiBodyParallelSolverIslandCallback::MultiBodyParallelSolverIslandCallback(btMultiBodyConstraintSolverPoolMt* solverPool, btDispatcher* dispatcher)
+	: MultiBodyInplaceSolverIslandCallback(solverPool, dispatcher),
+	  m_solverPool(solverPool)
+{
+}
+
+void MultiBodyParallelSolverIslandCallback::setup(btContactSolverInfo* solverInfo, btTypedConstraint** sortedConstraints, int numConstraints, btMultiBodyConstraint** sortedMultiBodyConstraints, int numMultiBodyConstraints, btIDebugDraw* debugDrawer)
+{
+	MultiBodyInplaceSolverIslandCallback::setup(solverInfo, sortedConstraints, numConstraints, sortedMultiBodyConstraints, numMultiBodyConstraints, debugDrawer);
+	m_batches.resize(0);
+	m_batchBodies.resize(0);
+	m_batchManifolds.resize(0);
+	m_batchConstraints.resize(0);
+	m_batchMultiBodyConstraints.resize(0);
+}
+
+void MultiBodyParallelSolverIslandCallback::processConstraints(int islandId)
+{
+	if (m_bodies.size() || m_manifolds.size() || m_constraints.size() || m_multiBodyConstraints.size())
+	{
+		Batch& batch = m_batches.expand();
+		batch.m_bodyIndex = m_batchBodies.size();
+		batch.m_numBodies = m_bodies.size();
+		batch.m_manifoldIndex = m_batchManifolds.size();
+		batch.m_numManifolds = m_manifolds.size();
+		batch.m_constraintIndex = m_batchConstraints.size();
+		batch.m_numConstraints = m_constraints.size();
+		batch.m_multiBodyConstraintIndex = m_batchMultiBodyConstraints.size();
+		batch.m_numMultiBodyConstraints = m_multiBodyConstraints.size();
+		batch.m_islandId = islandId;
+		int i;
+		for (i = 0; i < m_bodies.size(); i++)
+			m_batchBodies.push_back(m_bodies[i]);
+		for (i = 0; i < m_manifolds.size(); i++)
+			m_batchManifolds.push_back(m_manifolds[i]);
+		for (i = 0; i < m_constraints.size(); i++)
+			m_batchConstraints.push_back(m_constraints[i]);
+		for (i = 0; i < m_multiBodyConstraints.size(); i++)
+			m_batchMultiBodyConstraints.push_back(m_multiBodyConstraints[i]);
+	}
+	m_bodies.resize(0);
+	m_softBodies.resize(0);
+	m_manifolds.resize(0);
+	m_constraints.resize(0);
+	m_multiBodyConstraints.resize(0);
+
+	if (islandId >= 0 || m_batches.size() == 0)
+	{
+		// more islands to come
+		return;
+	}
+
+	buildGroups();
+
+	bool parallel = (m_solver == m_solverPool) && m_groups.size() > 1 && !(m_solverInfo->m_reportSolverAnalytics & 1);
+#if BT_THREADSAFE
+	parallel = parallel && btGetTaskScheduler() && btGetTaskScheduler()->getNumThreads() > 1;
+#else
+	parallel = false;
+#endif
+	if (parallel)
+	{
+		BT_PROFILE("solveIslandGroupsMt");
+		struct SolveGroupLoop : public btIParallelForBody
+		{
+			MultiBodyParallelSolverIslandCallback* m_callback;
+
+			void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+			{
+				for (int i = iBegin; i < iEnd; ++i)
+				{
+					m_callback->solveGroup(i);
+				}
+			}
+		} loop;
+		loop.m_callback = this;
+		btMultiBodyParallelFor(0, m_groups.size(), 1, loop);
+	}
+	else
+	{
+		for (int i = 0; i < m_groups.size(); ++i)
+		{
+			solveGroup(i);
+			if (m_groups[i].m_numBodies && (m_solverInfo->m_reportSolverAnalytics & 1))
+			{
+				m_solver->m_analyticsData.m_islandId = m_groups[i].m_islandId;
+				m_islandAnalyticsData.push_back(m_solver->m_analyticsData);
+			}
+		}
+	}
+	m_batches.resize(0);
+}
+
+void MultiBodyParallelSolverIslandCallback::solveGroup(int groupIndex)
+{
+	const Batch& group = m_groups[groupIndex];
+	btCollisionObject** bodies = group.m_numBodies ? &m_groupBodies[group.m_bodyIndex] : 0;
+	btPersistentManifold** manifolds = group.m_numManifolds ? &m_groupManifolds[group.m_manifoldIndex] : 0;
+	btTypedConstraint** constraints = group.m_numConstraints ? &m_groupConstraints[group.m_constraintIndex] : 0;
+	btMultiBodyConstraint** multiBodyConstraints = group.m_numMultiBodyConstraints ? &m_groupMultiBodyConstraints[group.m_multiBodyConstraintIndex] : 0;
+	m_solver->solveMultiBodyGroup(bodies, group.m_numBodies, manifolds, group.m_numManifolds, constraints, group.m_numConstraints,
+								  multiBodyConstraints, group.m_numMultiBodyConstraints, *m_solverInfo, m_debugDrawer, m_dispatcher);
+}
+
+static btMultiBody* btGetMultiBody(const btCollisionObject* colObj)
+{
+	const btMultiBodyLinkCollider* col = btMultiBodyLinkCollider::upcast(colObj);
+	return col ? col->m_multiBody : 0;
+}
+
+void MultiBodyParallelSolverIslandCallback::linkMultiBody(btMultiBody* multiBody, int batchIndex)
+{
+	if (!multiBody)
+		return;
+	if (batchIndex < 0)
+	{
+		multiBody->setCompanionId(-1);
+	}
+	else if (multiBody->getCompanionId() < 0)
+	{
+		multiBody->setCompanionId(batchIndex);
+	}
+	else
+	{
+		m_batchUnionFind.unite(multiBody->getCompanionId(), batchIndex);
+	}
+}
+
+void MultiBodyParallelSolverIslandCallback::linkBatchMultiBodies(const Batch& batch, int batchIndex)
+{
+	int i;
+	for (i = 0; i < batch.m_numBodies; i++)
+	{
+		linkMultiBody(btGetMultiBody(m_batchBodies[batch.m_bodyIndex + i]), batchIndex);
+	}
+	for (i = 0; i < batch.m_numManifolds; i++)
+	{
+		const btPersistentManifold* manifold = m_batchManifolds[batch.m_manifoldIndex + i];
+		linkMultiBody(btGetMultiBody(manifold->getBody0()), batchIndex);
+		linkMultiBody(btGetMultiBody(manifold->getBody1()), batchIndex);
+	}
+	for (i = 0; i < batch.m_numMultiBodyConstraints; i++)
+	{
+		btMultiBodyConstraint* c = m_batchMultiBodyConstraints[batch.m_multiBodyConstraintIndex + i];
+		linkMultiBody(c->getMultiBodyA(), batchIndex);
+		linkMultiBody(c->getMultiBodyB(), batchIndex);
+	}
+}
+
+void MultiBodyParallelSolverIslandCallback::clearMultiBodyCompanionIds(const Batch& batch)
+{
+	linkBatchMultiBodies(batch, -1);
+}
+
+void MultiBodyParallelSolverIslandCallback::buildGroups()
+{
+	BT_PROFILE("buildGroups");
+	const int numBatches = m_batches.size();
+	m_batchUnionFind.reset(numBatches);
+
+	// the companion id of a multibody temporarily stores the first batch that references it
+	int i;
+	for (i = 0; i < numBatches; i++)
+		clearMultiBodyCompanionIds(m_batches[i]);
+	for (i = 0; i < numBatches; i++)
+		linkBatchMultiBodies(m_batches[i], i);
+	for (i = 0; i < numBatches; i++)
+		clearMultiBodyCompanionIds(m_batches[i]);
+
+	// gather the batches of each group, in batch order
+	btAlignedObjectArray<int> groupOfBatch;
+	groupOfBatch.resize(numBatches);
+	m_groups.resize(0);
+	for (i = 0; i < numBatches; i++)
+	{
+		const int root = m_batchUnionFind.find(i);
+		if (root == i)
+		{
+			groupOfBatch[i] = m_groups.size();
+			Batch& group = m_groups.expand();
+			group.m_numBodies = group.m_numManifolds = group.m_numConstraints = group.m_numMultiBodyConstraints = 0;
+			group.m_islandId = m_batches[i].m_islandId;
+		}
+	}
+	for (i = 0; i < numBatches; i++)
+	{
+		const Batch& batch = m_batches[i];
+		const int g = groupOfBatch[m_batchUnionFind.find(i)];
+		groupOfBatch[i] = g;
+		m_groups[g].m_numBodies += batch.m_numBodies;
+		m_groups[g].m_numManifolds += batch.m_numManifolds;
+		m_groups[g].m_numConstraints += batch.m_numConstraints;
+		m_groups[g].m_numMultiBodyConstraints += batch.m_numMultiBodyConstraints;
+	}
+	int numBodies = 0, numManifolds = 0, numConstraints = 0, numMultiBodyConstraints = 0;
+	for (i = 0; i < m_groups.size(); i++)
+	{
+		Batch& group = m_groups[i];
+		group.m_bodyIndex = numBodies;
+		group.m_manifoldIndex = numManifolds;
+		group.m_constraintIndex = numConstraints;
+		group.m_multiBodyConstraintIndex = numMultiBodyConstraints;
+		numBodies += group.m_numBodies;
+		numManifolds += group.m_numManifolds;
+		numConstraints += group.m_numConstraints;
+		numMultiBodyConstraints += group.m_numMultiBodyConstraints;
+		// reused as fill cursors below
+		group.m_numBodies = group.m_numManifolds = group.m_numConstraints = group.m_numMultiBodyConstraints = 0;
+	}
+	m_groupBodies.resize(numBodies);
+	m_groupManifolds.resize(numManifolds);
+	m_groupConstraints.resize(numConstraints);
+	m_groupMultiBodyConstraints.resize(numMultiBodyConstraints);
+	for (i = 0; i < numBatches; i++)
+	{
+		const Batch& batch = m_batches[i];
+		Batch& group = m_groups[groupOfBatch[i]];
+		int j;
+		for (j = 0; j < batch.m_numBodies; j++)
+			m_groupBodies[group.m_bodyIndex + group.m_numBodies++] = m_batchBodies[batch.m_bodyIndex + j];
+		for (j = 0; j < batch.m_numManifolds; j++)
+			m_groupManifolds[group.m_manifoldIndex + group.m_numManifolds++] = m_batchManifolds[batch.m_manifoldIndex + j];
+		for (j = 0; j < batch.m_numConstraints; j++)
+			m_groupConstraints[group.m_constraintIndex + group.m_numConstraints++] = m_batchConstraints[batch.m_constraintIndex + j];
+		for (j = 0; j < batch.m_numMultiBodyConstraints; j++)
+			m_groupMultiBodyConstraints[group.m_multiBodyConstraintIndex + group.m_numMultiBodyConstraints++] = m_batchMultiBodyConstraints[batch.m_multiBodyConstraintIndex + j];
+	}
+}
+
+btMultiBodyDynamicsWorldMt::btMultiBodyDynamicsWorldMt(btDispatcher* dispatcher,
+													   btBroadphaseInterface* pairCache,
+													   btMultiBodyConstraintSolverPoolMt* solverPool,
+													   btCollisionConfiguration* collisionConfiguration)
+	: btMultiBodyDynamicsWorld(dispatcher, pairCache, solverPool, collisionConfiguration)
+{
+	delete m_solverMultiBodyIslandCallback;
+	m_solverMultiBodyIslandCallback = new MultiBodyParallelSolverIslandCallback(solverPool, dispatcher);
+
+	int numThreads = 1;
+#if BT_THREADSAFE
+	numThreads = BT_MAX_THREAD_COUNT;
+#endif
+	m_threadScratch.resize(numThreads);
+}
+
+btMultiBodyDynamicsWorldMt::~btMultiBodyDynamicsWorldMt()
+{
+}
+
+void btMultiBodyDynamicsWorldMt::forwardKinematics()
+{
+	if (m_multiBodies.size() == 0)
+		return;
+	UpdaterForwardKinematics update;
+	update.multiBodies = &m_multiBodies[0];
+	update.world = this;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), 4, update);
+}
+
+void btMultiBodyDynamicsWorldMt::computeMultiBodyAccelerations(const btContactSolverInfo& solverInfo, bool isConstraintPass)
+{
+	if (m_multiBodies.size() == 0)
+		return;
+	UpdaterComputeAccelerations update;
+	update.solverInfo = &solverInfo;
+	update.isConstraintPass = isConstraintPass;
+	update.multiBodies = &m_multiBodies[0];
+	update.world = this;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), 1, update);
+}
+
+void btMultiBodyDynamicsWorldMt::integrateMultiBodyTransforms(btScalar timeStep)
+{
+	BT_PROFILE("btMultiBody stepPositions");
+	if (m_multiBodies.size() == 0)
+		return;
+	UpdaterIntegrateTransforms update;
+	update.timeStep = timeStep;
+	update.multiBodies = &m_multiBodies[0];
+	update.world = this;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), 4, update);
+}
+
+void btMultiBodyDynamicsWorldMt::predictMultiBodyTransforms(btScalar timeStep)
+{
+	BT_PROFILE("btMultiBody predictPositions");
+	if (m_multiBodies.size() == 0)
+		return;
+	UpdaterPredictTransforms update;
+	update.timeStep = timeStep;
+	update.multiBodies = &m_multiBodies[0];
+	update.world = this;
+	btMultiBodyParallelFor(0, m_multiBodies.size(), 4, update);
+}
@@ -0,0 +1,230 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2013 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_MULTIBODY_DYNAMICS_WORLD_MT_H
+#define BT_MULTIBODY_DYNAMICS_WORLD_MT_H
+
+#include "btMultiBodyDynamicsWorld.h"
+#include "btMultiBodyConstraintSolver.h"
+#include "btMultiBodyInplaceSolverIslandCallback.h"
+#include "BulletCollision/CollisionDispatch/btUnionFind.h"
+#include "LinearMath/btThreads.h"
+
+///
+/// btMultiBodyConstraintSolverPoolMt - a threadsafe pool of multibody constraint solvers.
+///
+///  Works like btConstraintSolverPoolMt: each call to solveMultiBodyGroup locks a solver that isn't used
+///  by another thread. Every solver owns its own btMultiBodyJacobianData, so the Jacobians, unit impulse
+///  responses and delta velocities of concurrently solved groups never share memory.
+///
+ATTRIBUTE_ALIGNED16(class)
+btMultiBodyConstraintSolverPoolMt : public btMultiBodyConstraintSolver
+{
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	// create the solvers for me
+	explicit btMultiBodyConstraintSolverPoolMt(int numSolvers);
+
+	// pass in fully constructed solvers (destructor will delete them)
+	btMultiBodyConstraintSolverPoolMt(btMultiBodyConstraintSolver * *solvers, int numSolvers);
+
+	virtual ~btMultiBodyConstraintSolverPoolMt();
+
+	virtual btScalar solveGroup(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifold, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher) BT_OVERRIDE;
+
+	virtual void solveMultiBodyGroup(btCollisionObject * *bodies, int numBodies, btPersistentManifold** manifold, int numManifolds, btTypedConstraint** constraints, int numConstraints, btMultiBodyConstraint** multiBodyConstraints, int numMultiBodyConstraints, const btContactSolverInfo& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher) BT_OVERRIDE;
+
+	virtual void prepareSolve(int numBodies, int numManifolds) BT_OVERRIDE;
+
+	virtual void allSolved(const btContactSolverInfo& info, class btIDebugDraw* debugDrawer) BT_OVERRIDE;
+
+	virtual void reset() BT_OVERRIDE;
+
+	virtual btConstraintSolverType getSolverType() const BT_OVERRIDE { return m_solverType; }
+
+	int getNumSolvers() const { return m_solvers.size(); }
+
+private:
+	const static size_t kCacheLineSize = 128;
+	struct ThreadSolver
+	{
+		btMultiBodyConstraintSolver* solver;
+		btSpinMutex mutex;
+		char _cachelinePadding[kCacheLineSize - sizeof(btSpinMutex) - sizeof(void*)];  // keep mutexes from sharing a cache line
+	};
+	btAlignedObjectArray<ThreadSolver> m_solvers;
+	btConstraintSolverType m_solverType;
+
+	ThreadSolver* getAndLockThreadSolver();
+	void init(btMultiBodyConstraintSolver * *solvers, int numSolvers);
+};
+
+///
+/// MultiBodyParallelSolverIslandCallback - records the island batches of MultiBodyInplaceSolverIslandCallback
+///                                         and solves them concurrently once all islands are known.
+///
+///  Batches that touch the same btMultiBody (a fixed base collider is static, so its contacts can end up in
+///  another island than its links) are merged, since the solver stores per-group state in the multibody.
+///  Falls back to solving serially without a task scheduler, when the solver is not the pool or when
+///  solver analytics are requested.
+///
+struct MultiBodyParallelSolverIslandCallback : public MultiBodyInplaceSolverIslandCallback
+{
+	struct Batch
+	{
+		int m_bodyIndex;
+		int m_numBodies;
+		int m_manifoldIndex;
+		int m_numManifolds;
+		int m_constraintIndex;
+		int m_numConstraints;
+		int m_multiBodyConstraintIndex;
+		int m_numMultiBodyConstraints;
+		int m_islandId;
+	};
+
+	btMultiBodyConstraintSolverPoolMt* m_solverPool;
+
+	btAlignedObjectArray<Batch> m_batches;
+	btAlignedObjectArray<btCollisionObject*> m_batchBodies;
+	btAlignedObjectArray<btPersistentManifold*> m_batchManifolds;
+	btAlignedObjectArray<btTypedConstraint*> m_batchConstraints;
+	btAlignedObjectArray<btMultiBodyConstraint*> m_batchMultiBodyConstraints;
+
+	btAlignedObjectArray<Batch> m_groups;
+	btAlignedObjectArray<btCollisionObject*> m_groupBodies;
+	btAlignedObjectArray<btPersistentManifold*> m_groupManifolds;
+	btAlignedObjectArray<btTypedConstraint*> m_groupConstraints;
+	btAlignedObjectArray<btMultiBodyConstraint*> m_groupMultiBodyConstraints;
+	btUnionFind m_batchUnionFind;
+
+	MultiBodyParallelSolverIslandCallback(btMultiBodyConstraintSolverPoolMt* solverPool, btDispatcher* dispatcher);
+
+	virtual void setup(btContactSolverInfo* solverInfo, btTypedConstraint** sortedConstraints, int numConstraints, btMultiBodyConstraint** sortedMultiBodyConstraints, int numMultiBodyConstraints, btIDebugDraw* debugDrawer) BT_OVERRIDE;
+
+	///records the pending batch, the final flush (islandId < 0) solves all recorded batches
+	virtual void processConstraints(int islandId = -1) BT_OVERRIDE;
+
+	void solveGroup(int groupIndex);
+
+private:
+	void buildGroups();
+	void linkMultiBody(btMultiBody* multiBody, int batchIndex);
+	void clearMultiBodyCompanionIds(const Batch& batch);
+	void linkBatchMultiBodies(const Batch& batch, int batchIndex);
+};
+
+///
+/// btMultiBodyDynamicsWorldMt -- a version of btMultiBodyDynamicsWorld that runs the per-multibody passes
+///                               and the island solve on multiple threads.
+///
+///  Should function exactly like btMultiBodyDynamicsWorld.
+///  The following passes iterate over all multibodies and run in parallel, each thread with its own scratch memory:
+///     - forwardKinematics
+///     - computeMultiBodyAccelerations (articulated body algorithm, including the RK4 path and the joint feedback pass)
+///     - integrateMultiBodyTransforms (stepPositionsMultiDof)
+///     - predictMultiBodyTransforms
+///  Islands are solved concurrently by the solvers of a btMultiBodyConstraintSolverPoolMt, so the contact and
+///  constraint Jacobians (fillContactJacobianMultiDof) of different islands are also filled in parallel.
+///
+ATTRIBUTE_ALIGNED16(class)
+btMultiBodyDynamicsWorldMt : public btMultiBodyDynamicsWorld
+{
+protected:
+	struct ThreadScratch
+	{
+		btAlignedObjectArray<btQuaternion> m_world_to_local;
+		btAlignedObjectArray<btVector3> m_local_origin;
+		btAlignedObjectArray<btScalar> m_r;
+		btAlignedObjectArray<btVector3> m_v;
+		btAlignedObjectArray<btMatrix3x3> m_m;
+	};
+	btAlignedObjectArray<ThreadScratch> m_threadScratch;
+
+	ThreadScratch& getThreadScratch()
+	{
+		return m_threadScratch[btGetCurrentThreadIndex() % m_threadScratch.size()];
+	}
+
+	struct UpdaterForwardKinematics : public btIParallelForBody
+	{
+		btMultiBody** multiBodies;
+		btMultiBodyDynamicsWorldMt* world;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			ThreadScratch& scratch = world->getThreadScratch();
+			world->forwardKinematicsInternal(&multiBodies[iBegin], iEnd - iBegin, scratch.m_world_to_local, scratch.m_local_origin);
+		}
+	};
+
+	struct UpdaterComputeAccelerations : public btIParallelForBody
+	{
+		const btContactSolverInfo* solverInfo;
+		bool isConstraintPass;
+		btMultiBody** multiBodies;
+		btMultiBodyDynamicsWorldMt* world;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			ThreadScratch& scratch = world->getThreadScratch();
+			world->computeMultiBodyAccelerationsInternal(&multiBodies[iBegin], iEnd - iBegin, *solverInfo, isConstraintPass, scratch.m_r, scratch.m_v, scratch.m_m);
+		}
+	};
+
+	struct UpdaterIntegrateTransforms : public btIParallelForBody
+	{
+		btScalar timeStep;
+		btMultiBody** multiBodies;
+		btMultiBodyDynamicsWorldMt* world;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			ThreadScratch& scratch = world->getThreadScratch();
+			world->integrateMultiBodyTransformsInternal(&multiBodies[iBegin], iEnd - iBegin, timeStep, scratch.m_world_to_local, scratch.m_local_origin);
+		}
+	};
+
+	struct UpdaterPredictTransforms : public btIParallelForBody
+	{
+		btScalar timeStep;
+		btMultiBody** multiBodies;
+		btMultiBodyDynamicsWorldMt* world;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			ThreadScratch& scratch = world->getThreadScratch();
+			world->predictMultiBodyTransformsInternal(&multiBodies[iBegin], iEnd - iBegin, timeStep, scratch.m_world_to_local, scratch.m_local_origin);
+		}
+	};
+
+	virtual void computeMultiBodyAccelerations(const btContactSolverInfo& solverInfo, bool isConstraintPass) BT_OVERRIDE;
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btMultiBodyDynamicsWorldMt(btDispatcher * dispatcher,
+							   btBroadphaseInterface * pairCache,
+							   btMultiBodyConstraintSolverPoolMt * solverPool,  // Note this should be a solver-pool for multi-threading
+							   btCollisionConfiguration * collisionConfiguration);
+	virtual ~btMultiBodyDynamicsWorldMt();
+
+	virtual void forwardKinematics() BT_OVERRIDE;
+	virtual void integrateMultiBodyTransforms(btScalar timeStep) BT_OVERRIDE;
+	virtual void predictMultiBodyTransforms(btScalar timeStep) BT_OVERRIDE;
+};
+
+#endif  //BT_MULTIBODY_DYNAMICS_WORLD_MT_H
@@ -131,6 +131,66 @@ bool s_error = false;
 
 #define BTNUB_OPTIMIZATIONS
 
+// row kernels of the pivoting steps. they use independent partial sums and
+// unit stride loops without aliasing so the compiler can vectorize them.
+
+static btScalar btDantzigDot(const btScalar *a, const btScalar *b, int n)
+{
+	btScalar s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+	for (; i < n; ++i)
+	{
+		s0 += a[i] * b[i];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+// p[r] = dot(A[r], q) for 4 rows at a time, so that every load of q is shared by 4 rows
+static void btDantzigRowsDot(btScalar *const *rows, const btScalar *q, btScalar *p, int numRows, int n)
+{
+	int r = 0;
+	for (; r + 4 <= numRows; r += 4)
+	{
+		const btScalar *a0 = rows[r];
+		const btScalar *a1 = rows[r + 1];
+		const btScalar *a2 = rows[r + 2];
+		const btScalar *a3 = rows[r + 3];
+		btScalar s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			const btScalar qi = q[i];
+			s0 += a0[i] * qi;
+			s1 += a1[i] * qi;
+			s2 += a2[i] * qi;
+			s3 += a3[i] * qi;
+		}
+		p[r] = s0;
+		p[r + 1] = s1;
+		p[r + 2] = s2;
+		p[r + 3] = s3;
+	}
+	for (; r < numRows; ++r)
+	{
+		p[r] = btDantzigDot(rows[r], q, n);
+	}
+}
+
+// y += s * x
+static void btDantzigAxpy(btScalar *y, btScalar s, const btScalar *x, int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		y[i] += s * x[i];
+	}
+}
+
 /* solve L*X=B, with B containing 1 right hand sides.
  * L is an n*n lower triangular matrix with ones on the diagonal.
  * L is stored by rows and its leading dimension is lskip.
@@ -1234,8 +1294,8 @@ struct btLCP
 	int indexC(int i) const { return i; }
 	int indexN(int i) const { return i + m_nC; }
 	btScalar Aii(int i) const { return BTAROW(i)[i]; }
-	btScalar AiC_times_qC(int i, btScalar *q) const { return btLargeDot(BTAROW(i), q, m_nC); }
-	btScalar AiN_times_qN(int i, btScalar *q) const { return btLargeDot(BTAROW(i) + m_nC, q + m_nC, m_nN); }
+	btScalar AiC_times_qC(int i, btScalar *q) const { return btDantzigDot(BTAROW(i), q, m_nC); }
+	btScalar AiN_times_qN(int i, btScalar *q) const { return btDantzigDot(BTAROW(i) + m_nC, q + m_nC, m_nN); }
 	void pN_equals_ANC_times_qC(btScalar *p, btScalar *q);
 	void pN_plusequals_ANi(btScalar *p, int i, int sign = 1);
 	void pC_plusequals_s_times_qC(btScalar *p, btScalar s, btScalar *q);
@@ -1395,7 +1455,7 @@ void btLCP::transfer_i_to_C(int i)
 				for (int j = 0; j < nC; ++j) Ltgt[j] = ell[j];
 			}
 			const int nC = m_nC;
-			m_d[nC] = btRecip(BTAROW(i)[i] - btLargeDot(m_ell, m_Dell, nC));
+			m_d[nC] = btRecip(BTAROW(i)[i] - btDantzigDot(m_ell, m_Dell, nC));
 		}
 		else
 		{
@@ -1439,7 +1499,7 @@ void btLCP::transfer_i_from_N_to_C(int i)
 				for (int j = 0; j < nC; ++j) Ltgt[j] = ell[j] = Dell[j] * d[j];
 			}
 			const int nC = m_nC;
-			m_d[nC] = btRecip(BTAROW(i)[i] - btLargeDot(m_ell, m_Dell, nC));
+			m_d[nC] = btRecip(BTAROW(i)[i] - btDantzigDot(m_ell, m_Dell, nC));
 		}
 		else
 		{
@@ -1638,7 +1698,7 @@ void btLDLTRemove(btScalar **A, const int *p, btScalar *L, btScalar *d,
 				const int n2_minus_r = n2 - r;
 				for (int i = 0; i < n2_minus_r; Lcurr += nskip, ++i)
 				{
-					a[i] = btLargeDot(Lcurr, t, r) - BTGETA(pp_r[i], p_r);
+					a[i] = btDantzigDot(Lcurr, t, r) - BTGETA(pp_r[i], p_r);
 				}
 			}
 			a[0] += btScalar(1.0);
@@ -1707,12 +1767,16 @@ void btLCP::pN_equals_ANC_times_qC(btScalar *p, btScalar *q)
 	// problems because of the overhead involved. so we'll stick with the
 	// simple method for now.
 	const int nC = m_nC;
+#ifdef BTROWPTRS
+	btDantzigRowsDot(m_A + nC, q, p + nC, m_nN, nC);
+#else
 	btScalar *ptgt = p + nC;
 	const int nN = m_nN;
 	for (int i = 0; i < nN; ++i)
 	{
-		ptgt[i] = btLargeDot(BTAROW(i + nC), q, nC);
+		ptgt[i] = btDantzigDot(BTAROW(i + nC), q, nC);
 	}
+#endif
 }
 
 void btLCP::pN_plusequals_ANi(btScalar *p, int i, int sign)
@@ -1734,22 +1798,13 @@ void btLCP::pN_plusequals_ANi(btScalar *p, int i, int sign)
 
 void btLCP::pC_plusequals_s_times_qC(btScalar *p, btScalar s, btScalar *q)
 {
-	const int nC = m_nC;
-	for (int i = 0; i < nC; ++i)
-	{
-		p[i] += s * q[i];
-	}
+	btDantzigAxpy(p, s, q, m_nC);
 }
 
 void btLCP::pN_plusequals_s_times_qN(btScalar *p, btScalar s, btScalar *q)
 {
 	const int nC = m_nC;
-	btScalar *ptgt = p + nC, *qsrc = q + nC;
-	const int nN = m_nN;
-	for (int i = 0; i < nN; ++i)
-	{
-		ptgt[i] += s * qsrc[i];
-	}
+	btDantzigAxpy(p + nC, s, q + nC, m_nN);
 }
 
 void btLCP::solve1(btScalar *a, int i, int dir, int only_transfer)
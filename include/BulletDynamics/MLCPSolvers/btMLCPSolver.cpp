@@ -36,6 +36,10 @@ btScalar btMLCPSolver::solveGroupCacheFriendlySetup(btCollisionObject** bodies,
 {
 	btSequentialImpulseConstraintSolver::solveGroupCacheFriendlySetup(bodies, numBodiesUnUsed, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
 
+	///substeps are solved by the iterations of btSequentialImpulseConstraintSolver, no MLCP is needed
+	if (infoGlobal.m_numSolverSubsteps > 1)
+		return 0.f;
+
 	{
 		BT_PROFILE("gather constraint data");
 
@@ -477,71 +481,68 @@ void btMLCPSolver::createMLCP(const btContactSolverInfo& infoGlobal)
 		}
 	}
 
-	btMatrixXu& Minv = m_scratchMInv;
-	Minv.resize(6 * numBodies, 6 * numBodies);
-	Minv.setZero();
+	btAlignedObjectArray<btScalar>& Minv = m_scratchMInv;
+	Minv.resize(0);
+	Minv.resize(36 * numBodies, btScalar(0));
 	for (int i = 0; i < numBodies; i++)
 	{
 		const btSolverBody& rb = m_tmpSolverBodyPool[i];
 		const btVector3& invMass = rb.m_invMass;
-		setElem(Minv, i * 6 + 0, i * 6 + 0, invMass[0]);
-		setElem(Minv, i * 6 + 1, i * 6 + 1, invMass[1]);
-		setElem(Minv, i * 6 + 2, i * 6 + 2, invMass[2]);
+		btScalar* block = &Minv[36 * i];
+		block[0 * 6 + 0] = invMass[0];
+		block[1 * 6 + 1] = invMass[1];
+		block[2 * 6 + 2] = invMass[2];
 		btRigidBody* orgBody = m_tmpSolverBodyPool[i].m_originalBody;
 
 		for (int r = 0; r < 3; r++)
 			for (int c = 0; c < 3; c++)
-				setElem(Minv, i * 6 + 3 + r, i * 6 + 3 + c, orgBody ? orgBody->getInvInertiaTensorWorld()[r][c] : 0);
+				block[(3 + r) * 6 + 3 + c] = orgBody ? orgBody->getInvInertiaTensorWorld()[r][c] : 0;
 	}
 
-	btMatrixXu& J = m_scratchJ;
-	J.resize(numConstraintRows, 6 * numBodies);
-	J.setZero();
+	//each row of J only has a 1x6 block for each of its two bodies
+	btBlockSparseMatrixXu& J = m_scratchJ;
+	J.reset(numBodies);
 
 	m_lo.resize(numConstraintRows);
 	m_hi.resize(numConstraintRows);
 
 	for (int i = 0; i < numConstraintRows; i++)
 	{
-		m_lo[i] = m_allConstraintPtrArray[i]->m_lowerLimit;
-		m_hi[i] = m_allConstraintPtrArray[i]->m_upperLimit;
+		const btSolverConstraint& c = *m_allConstraintPtrArray[i];
+		m_lo[i] = c.m_lowerLimit;
+		m_hi[i] = c.m_upperLimit;
 
-		int bodyIndex0 = m_allConstraintPtrArray[i]->m_solverBodyIdA;
-		int bodyIndex1 = m_allConstraintPtrArray[i]->m_solverBodyIdB;
+		int bodyIndex0 = c.m_solverBodyIdA;
+		int bodyIndex1 = c.m_solverBodyIdB;
 		if (m_tmpSolverBodyPool[bodyIndex0].m_originalBody)
 		{
-			setElem(J, i, 6 * bodyIndex0 + 0, m_allConstraintPtrArray[i]->m_contactNormal1[0]);
-			setElem(J, i, 6 * bodyIndex0 + 1, m_allConstraintPtrArray[i]->m_contactNormal1[1]);
-			setElem(J, i, 6 * bodyIndex0 + 2, m_allConstraintPtrArray[i]->m_contactNormal1[2]);
-			setElem(J, i, 6 * bodyIndex0 + 3, m_allConstraintPtrArray[i]->m_relpos1CrossNormal[0]);
-			setElem(J, i, 6 * bodyIndex0 + 4, m_allConstraintPtrArray[i]->m_relpos1CrossNormal[1]);
-			setElem(J, i, 6 * bodyIndex0 + 5, m_allConstraintPtrArray[i]->m_relpos1CrossNormal[2]);
+			btScalar* block = J.appendBlock(bodyIndex0);
+			for (int r = 0; r < 3; r++)
+			{
+				block[r] = c.m_contactNormal1[r];
+				block[3 + r] = c.m_relpos1CrossNormal[r];
+			}
 		}
 		if (m_tmpSolverBodyPool[bodyIndex1].m_originalBody)
 		{
-			setElem(J, i, 6 * bodyIndex1 + 0, m_allConstraintPtrArray[i]->m_contactNormal2[0]);
-			setElem(J, i, 6 * bodyIndex1 + 1, m_allConstraintPtrArray[i]->m_contactNormal2[1]);
-			setElem(J, i, 6 * bodyIndex1 + 2, m_allConstraintPtrArray[i]->m_contactNormal2[2]);
-			setElem(J, i, 6 * bodyIndex1 + 3, m_allConstraintPtrArray[i]->m_relpos2CrossNormal[0]);
-			setElem(J, i, 6 * bodyIndex1 + 4, m_allConstraintPtrArray[i]->m_relpos2CrossNormal[1]);
-			setElem(J, i, 6 * bodyIndex1 + 5, m_allConstraintPtrArray[i]->m_relpos2CrossNormal[2]);
+			btScalar* block = J.appendBlock(bodyIndex1);
+			for (int r = 0; r < 3; r++)
+			{
+				block[r] = c.m_contactNormal2[r];
+				block[3 + r] = c.m_relpos2CrossNormal[r];
+			}
 		}
+		J.endRow();
 	}
 
-	btMatrixXu& J_transpose = m_scratchJTranspose;
-	J_transpose = J.transpose();
-
-	btMatrixXu& tmp = m_scratchTmp;
-	//Minv.printMatrix("Minv=");
+	btBlockSparseMatrixXu& JinvM = m_scratchJInvM;
 	{
-		{
-			BT_PROFILE("J*Minv");
-			tmp = J * Minv;
-		}
-		{
-			BT_PROFILE("J*tmp");
-			m_A = tmp * J_transpose;
-		}
+		BT_PROFILE("J*Minv");
+		J.multiplyBlockDiagonal(Minv, JinvM);
+	}
+	{
+		BT_PROFILE("J*tmp");
+		JinvM.multiplyTranspose(J, m_A);
 	}
 	//J.printMatrix("J");
 	if (1)
@@ -569,6 +570,9 @@ void btMLCPSolver::createMLCP(const btContactSolverInfo& infoGlobal)
 
 btScalar btMLCPSolver::solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer)
 {
+	if (infoGlobal.m_numSolverSubsteps > 1)
+		return btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyIterations(bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, infoGlobal, debugDrawer);
+
 	bool result = true;
 	{
 		BT_PROFILE("solveMLCP");
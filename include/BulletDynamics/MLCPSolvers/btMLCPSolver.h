@@ -47,10 +47,9 @@ protected:
 	btMatrixXu m_scratchJ3;
 	btMatrixXu m_scratchJInvM3;
 	btAlignedObjectArray<int> m_scratchOfs;
-	btMatrixXu m_scratchMInv;
-	btMatrixXu m_scratchJ;
-	btMatrixXu m_scratchJTranspose;
-	btMatrixXu m_scratchTmp;
+	btAlignedObjectArray<btScalar> m_scratchMInv;  // 6x6 inverse mass block per solver body
+	btBlockSparseMatrixXu m_scratchJ;
+	btBlockSparseMatrixXu m_scratchJInvM;
 
 	virtual btScalar solveGroupCacheFriendlySetup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
 	virtual btScalar solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds, btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer);
@@ -54,9 +54,9 @@ public:
 				delta = 0.0f;
 				if (useSparsity)
 				{
-					for (int h = 0; h < A.m_rowNonZeroElements1[i].size(); h++)
+					for (int h = A.m_rowNonZeroOffsets[i]; h < A.m_rowNonZeroOffsets[i + 1]; h++)
 					{
-						j = A.m_rowNonZeroElements1[i][h];
+						j = A.m_rowNonZeroColumns[h];
 						if (j != i)  //skip main diagonal
 						{
 							delta += A(i, j) * x[j];
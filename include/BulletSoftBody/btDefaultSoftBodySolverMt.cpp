@@ -0,0 +1,241 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDefaultSoftBodySolverMt.h"
+#include "BulletSoftBody/btSoftBody.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
+#include "LinearMath/btHashMap.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+struct btSoftBodyPredictMotionLoop : public btIParallelForBody
+{
+	btSoftBody **m_bodies;
+	btScalar m_timeStep;
+
+	btSoftBodyPredictMotionLoop(btSoftBody **bodies, btScalar timeStep) : m_bodies(bodies), m_timeStep(timeStep) {}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[i]->predictMotion(m_timeStep);
+		}
+	}
+};
+
+struct btSoftBodySolveConstraintsLoop : public btIParallelForBody
+{
+	btSoftBody **m_bodies;
+
+	btSoftBodySolveConstraintsLoop(btSoftBody **bodies) : m_bodies(bodies) {}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[i]->solveConstraints();
+		}
+	}
+};
+
+struct btSoftBodyIntegrateMotionLoop : public btIParallelForBody
+{
+	btSoftBody **m_bodies;
+
+	btSoftBodyIntegrateMotionLoop(btSoftBody **bodies) : m_bodies(bodies) {}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[i]->integrateMotion();
+		}
+	}
+};
+
+static void btSoftBodyParallelFor(int iBegin, int iEnd, const btIParallelForBody &body)
+{
+#if BT_THREADSAFE
+	if (btGetTaskScheduler())
+	{
+		btParallelFor(iBegin, iEnd, 1, body);
+		return;
+	}
+#endif
+	body.forLoop(iBegin, iEnd);
+}
+
+static bool btSoftBodyHasWorkerThreads()
+{
+#if BT_THREADSAFE
+	return btGetTaskScheduler() && btGetTaskScheduler()->getNumThreads() > 1;
+#else
+	return false;
+#endif
+}
+
+btDefaultSoftBodySolverMt::btDefaultSoftBodySolverMt()
+{
+	m_minLinksToColor = 1024;
+}
+
+btDefaultSoftBodySolverMt::~btDefaultSoftBodySolverMt()
+{
+}
+
+void btDefaultSoftBodySolverMt::gatherActiveBodies()
+{
+	m_activeBodies.resize(0);
+	for (int i = 0; i < m_softBodySet.size(); ++i)
+	{
+		if (m_softBodySet[i]->isActive())
+		{
+			m_activeBodies.push_back(m_softBodySet[i]);
+		}
+	}
+}
+
+void btDefaultSoftBodySolverMt::buildPhases()
+{
+	// Bodies sharing a dynamic rigid body, a multibody or soft contact faces must not be solved
+	// concurrently. Each body goes one phase after the last phase that used any of its keys, which
+	// also keeps the serial order between interacting bodies.
+	btHashMap<btHashPtr, int> lastPhase;
+	btAlignedObjectArray<const void *> keys;
+	btAlignedObjectArray<int> bodyPhase;
+	bodyPhase.resize(m_activeBodies.size());
+	int numPhases = 0;
+	int lastOwner = 0;
+	for (int i = 0; i < m_activeBodies.size(); ++i)
+	{
+		btSoftBody *psb = m_activeBodies[i];
+		keys.resize(0);
+		keys.push_back(psb);
+		for (int j = 0; j < psb->m_anchors.size(); ++j)
+		{
+			const btRigidBody *body = psb->m_anchors[j].m_body;
+			if (!body->isStaticOrKinematicObject())
+				keys.push_back(body);
+		}
+		for (int j = 0; j < psb->m_rcontacts.size(); ++j)
+		{
+			const btCollisionObject *colObj = psb->m_rcontacts[j].m_cti.m_colObj;
+			if (colObj->getInternalType() == btCollisionObject::CO_FEATHERSTONE_LINK)
+			{
+				const btMultiBodyLinkCollider *multibodyLinkCol = btMultiBodyLinkCollider::upcast(colObj);
+				if (multibodyLinkCol)
+					keys.push_back(multibodyLinkCol->m_multiBody);
+			}
+			else if (!colObj->isStaticOrKinematicObject())
+			{
+				keys.push_back(colObj);
+			}
+		}
+		for (int j = 0; j < psb->m_scontacts.size(); ++j)
+		{
+			// The face belongs to the other soft body of the pair, find it by address
+			const btSoftBody::Face *face = psb->m_scontacts[j].m_face;
+			for (int k = 0; k < m_softBodySet.size(); ++k)
+			{
+				const btSoftBody *owner = m_softBodySet[(lastOwner + k) % m_softBodySet.size()];
+				if (owner->m_faces.size() && face >= &owner->m_faces[0] && face < &owner->m_faces[0] + owner->m_faces.size())
+				{
+					lastOwner = (lastOwner + k) % m_softBodySet.size();
+					keys.push_back(owner);
+					break;
+				}
+			}
+		}
+		int phase = 0;
+		for (int j = 0; j < keys.size(); ++j)
+		{
+			const int *last = lastPhase.find(btHashPtr(keys[j]));
+			if (last)
+				phase = btMax(phase, *last + 1);
+		}
+		for (int j = 0; j < keys.size(); ++j)
+		{
+			lastPhase.insert(btHashPtr(keys[j]), phase);
+		}
+		bodyPhase[i] = phase;
+		numPhases = btMax(numPhases, phase + 1);
+	}
+
+	// Sort the bodies by phase, stable so the order inside a phase stays the same
+	m_phaseOffsets.resize(0);
+	m_phaseOffsets.resize(numPhases + 1, 0);
+	for (int i = 0; i < bodyPhase.size(); ++i)
+		++m_phaseOffsets[bodyPhase[i] + 1];
+	for (int p = 0; p < numPhases; ++p)
+		m_phaseOffsets[p + 1] += m_phaseOffsets[p];
+	btAlignedObjectArray<int> cursor;
+	cursor.resize(numPhases);
+	for (int p = 0; p < numPhases; ++p)
+		cursor[p] = m_phaseOffsets[p];
+	btAlignedObjectArray<btSoftBody *> sorted;
+	sorted.resize(m_activeBodies.size());
+	for (int i = 0; i < m_activeBodies.size(); ++i)
+		sorted[cursor[bodyPhase[i]]++] = m_activeBodies[i];
+	m_activeBodies.copyFromArray(sorted);
+}
+
+void btDefaultSoftBodySolverMt::predictMotion(btScalar timeStep)
+{
+	BT_PROFILE("btDefaultSoftBodySolverMt::predictMotion");
+	gatherActiveBodies();
+	if (m_activeBodies.size())
+	{
+		btSoftBodyPredictMotionLoop loop(&m_activeBodies[0], timeStep);
+		btSoftBodyParallelFor(0, m_activeBodies.size(), loop);
+	}
+}
+
+void btDefaultSoftBodySolverMt::solveConstraints(btScalar solverdt)
+{
+	BT_PROFILE("btDefaultSoftBodySolverMt::solveConstraints");
+	gatherActiveBodies();
+	if (m_activeBodies.size() == 0)
+		return;
+	if (btSoftBodyHasWorkerThreads())
+	{
+		for (int i = 0; i < m_activeBodies.size(); ++i)
+		{
+			btSoftBody *psb = m_activeBodies[i];
+			if (psb->m_links.size() >= m_minLinksToColor && !psb->hasColoredLinks())
+			{
+				psb->colorLinks();
+			}
+		}
+	}
+	buildPhases();
+	btSoftBodySolveConstraintsLoop loop(&m_activeBodies[0]);
+	for (int p = 0; p < m_phaseOffsets.size() - 1; ++p)
+	{
+		btSoftBodyParallelFor(m_phaseOffsets[p], m_phaseOffsets[p + 1], loop);
+	}
+}
+
+void btDefaultSoftBodySolverMt::updateSoftBodies()
+{
+	BT_PROFILE("btDefaultSoftBodySolverMt::updateSoftBodies");
+	gatherActiveBodies();
+	if (m_activeBodies.size())
+	{
+		btSoftBodyIntegrateMotionLoop loop(&m_activeBodies[0]);
+		btSoftBodyParallelFor(0, m_activeBodies.size(), loop);
+	}
+}
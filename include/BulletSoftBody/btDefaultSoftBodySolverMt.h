@@ -0,0 +1,54 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, 
+including commercial applications, and to alter it and redistribute it freely, 
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_DEFAULT_SOFT_BODY_SOLVER_MT_H
+#define BT_DEFAULT_SOFT_BODY_SOLVER_MT_H
+
+#include "btDefaultSoftBodySolver.h"
+
+///
+/// btDefaultSoftBodySolverMt -- multithreaded version of btDefaultSoftBodySolver
+///
+/// Independent soft bodies are stepped concurrently on the btITaskScheduler. Soft bodies that
+/// touch the same dynamic rigid body, multibody or other soft body are put in different phases so
+/// their impulses are applied in the same order as the serial solver. Links of soft bodies with
+/// more than m_minLinksToColor links are colored so PSolve_Links can also run in parallel batches.
+///
+class btDefaultSoftBodySolverMt : public btDefaultSoftBodySolver
+{
+protected:
+	int m_minLinksToColor;
+	btAlignedObjectArray<btSoftBody *> m_activeBodies;
+	btAlignedObjectArray<int> m_phaseOffsets;
+
+	void gatherActiveBodies();
+	void buildPhases();
+
+public:
+	btDefaultSoftBodySolverMt();
+
+	virtual ~btDefaultSoftBodySolverMt();
+
+	virtual void updateSoftBodies();
+
+	virtual void solveConstraints(btScalar solverdt);
+
+	virtual void predictMotion(btScalar solverdt);
+
+	void setMinLinksToColor(int minLinks) { m_minLinksToColor = minLinks; }
+	int getMinLinksToColor() const { return m_minLinksToColor; }
+};
+
+#endif  //BT_DEFAULT_SOFT_BODY_SOLVER_MT_H
@@ -18,10 +18,11 @@
 #include "LinearMath/btQuickprof.h"
 
 btDeformableBackwardEulerObjective::btDeformableBackwardEulerObjective(btAlignedObjectArray<btSoftBody*>& softBodies, const TVStack& backup_v)
-	: m_softBodies(softBodies), m_projection(softBodies), m_backupVelocity(backup_v), m_implicit(false)
+	: m_softBodies(softBodies), m_projection(softBodies), m_backupVelocity(backup_v), m_implicit(false), m_useAssembledMatrix(true), m_matrixAssembled(false)
 {
 	m_massPreconditioner = new MassPreconditioner(m_softBodies);
 	m_KKTPreconditioner = new KKTPreconditioner(m_softBodies, m_projection, m_lf, m_dt, m_implicit);
+	m_blockJacobiPreconditioner = new BlockJacobiPreconditioner(m_softBodies, m_A, m_matrixAssembled);
 	m_preconditioner = m_KKTPreconditioner;
 }
 
@@ -29,6 +30,7 @@ btDeformableBackwardEulerObjective::~btDeformableBackwardEulerObjective()
 {
 	delete m_KKTPreconditioner;
 	delete m_massPreconditioner;
+	delete m_blockJacobiPreconditioner;
 }
 
 void btDeformableBackwardEulerObjective::reinitialize(bool nodeUpdated, btScalar dt)
@@ -41,7 +43,9 @@ void btDeformableBackwardEulerObjective::reinitialize(bool nodeUpdated, btScalar
 	if (nodeUpdated)
 	{
 		updateId();
+		m_A.clear();
 	}
+	m_matrixAssembled = false;
 	for (int i = 0; i < m_lf.size(); ++i)
 	{
 		m_lf[i]->reinitialize(nodeUpdated);
@@ -69,27 +73,36 @@ void btDeformableBackwardEulerObjective::setDt(btScalar dt)
 void btDeformableBackwardEulerObjective::multiply(const TVStack& x, TVStack& b) const
 {
 	BT_PROFILE("multiply");
-	// add in the mass term
-	size_t counter = 0;
-	for (int i = 0; i < m_softBodies.size(); ++i)
+	const btAlignedObjectArray<btDeformableLagrangianForce*>& lf = m_matrixAssembled ? m_matrixFreeForces : m_lf;
+	if (m_matrixAssembled)
 	{
-		btSoftBody* psb = m_softBodies[i];
-		for (int j = 0; j < psb->m_nodes.size(); ++j)
+		// mass and assembled force differentials
+		m_A.multiply(x, b);
+	}
+	else
+	{
+		// add in the mass term
+		size_t counter = 0;
+		for (int i = 0; i < m_softBodies.size(); ++i)
 		{
-			const btSoftBody::Node& node = psb->m_nodes[j];
-			b[counter] = (node.m_im == 0) ? btVector3(0, 0, 0) : x[counter] / node.m_im;
-			++counter;
+			btSoftBody* psb = m_softBodies[i];
+			for (int j = 0; j < psb->m_nodes.size(); ++j)
+			{
+				const btSoftBody::Node& node = psb->m_nodes[j];
+				b[counter] = (node.m_im == 0) ? btVector3(0, 0, 0) : x[counter] / node.m_im;
+				++counter;
+			}
 		}
 	}
 
-	for (int i = 0; i < m_lf.size(); ++i)
+	for (int i = 0; i < lf.size(); ++i)
 	{
 		// add damping matrix
-		m_lf[i]->addScaledDampingForceDifferential(-m_dt, x, b);
+		lf[i]->addScaledDampingForceDifferential(-m_dt, x, b);
         // Always integrate picking force implicitly for stability.
-        if (m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
+        if (m_implicit || lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE)
 		{
-			m_lf[i]->addScaledElasticForceDifferential(-m_dt * m_dt, x, b);
+			lf[i]->addScaledElasticForceDifferential(-m_dt * m_dt, x, b);
 		}
 	}
 	int offset = m_nodes.size();
@@ -121,6 +134,49 @@ void btDeformableBackwardEulerObjective::multiply(const TVStack& x, TVStack& b)
 	}
 }
 
+void btDeformableBackwardEulerObjective::assembleMatrix()
+{
+	m_matrixAssembled = false;
+	if (m_useAssembledMatrix && m_nodes.size())
+	{
+		BT_PROFILE("assembleMatrix");
+		// the pattern follows the soft body topology, rebuild it once if a force wrote outside of it
+		for (int attempt = 0; attempt < 2 && !m_matrixAssembled; ++attempt)
+		{
+			if (attempt > 0 || m_A.rows() != m_nodes.size())
+			{
+				m_A.buildPattern(m_softBodies);
+			}
+			m_A.setZero();
+			btMatrix3x3 I;
+			I.setIdentity();
+			for (int i = 0; i < m_nodes.size(); ++i)
+			{
+				const btSoftBody::Node* node = m_nodes[i];
+				if (node->m_im != 0)
+				{
+					m_A.addDiagonalBlock(i, I * (1. / node->m_im));
+				}
+			}
+			m_matrixFreeForces.resize(0);
+			for (int i = 0; i < m_lf.size(); ++i)
+			{
+				// Always integrate picking force implicitly for stability.
+				const bool elastic = m_implicit || m_lf[i]->getForceType() == BT_MOUSE_PICKING_FORCE;
+				if (!m_lf[i]->addScaledForceDifferentialBlocks(-m_dt, elastic ? -m_dt * m_dt : 0, m_A))
+				{
+					m_matrixFreeForces.push_back(m_lf[i]);
+				}
+			}
+			m_matrixAssembled = !m_A.m_missingBlock;
+		}
+	}
+	if (m_preconditioner == m_blockJacobiPreconditioner)
+	{
+		m_blockJacobiPreconditioner->reinitialize(false);
+	}
+}
+
 void btDeformableBackwardEulerObjective::updateVelocity(const TVStack& dv)
 {
 	for (int i = 0; i < m_softBodies.size(); ++i)
@@ -34,7 +34,8 @@ public:
 	enum _
 	{
 		Mass_preconditioner,
-		KKT_preconditioner
+		KKT_preconditioner,
+		BlockJacobi_preconditioner
 	};
 
 	typedef btAlignedObjectArray<btVector3> TVStack;
@@ -48,6 +49,11 @@ public:
 	bool m_implicit;
 	MassPreconditioner* m_massPreconditioner;
 	KKTPreconditioner* m_KKTPreconditioner;
+	BlockJacobiPreconditioner* m_blockJacobiPreconditioner;
+	btDeformableBlockSparseMatrix m_A;                                  // assembled mass, damping and elastic differential blocks
+	btAlignedObjectArray<btDeformableLagrangianForce*> m_matrixFreeForces;  // forces without an assembled form
+	bool m_useAssembledMatrix;
+	bool m_matrixAssembled;
 
 	btDeformableBackwardEulerObjective(btAlignedObjectArray<btSoftBody*>& softBodies, const TVStack& backup_v);
 
@@ -73,6 +79,9 @@ public:
 	// perform A*x = b
 	void multiply(const TVStack& x, TVStack& b) const;
 
+	// assemble the block sparse matrix used by multiply, once per linear solve
+	void assembleMatrix();
+
 	// set initial guess for CG solve
 	void initialGuess(TVStack& dv, const TVStack& residual);
 
@@ -0,0 +1,251 @@
+/*
+ Bullet Continuous Collision Detection and Physics Library
+ Copyright (c) 2019 Google Inc. http://bulletphysics.org
+ This software is provided 'as-is', without any express or implied warranty.
+ In no event will the authors be held liable for any damages arising from the use of this software.
+ Permission is granted to anyone to use this software for any purpose,
+ including commercial applications, and to alter it and redistribute it freely,
+ subject to the following restrictions:
+ 1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+ 2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+ 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef BT_DEFORMABLE_BLOCK_SPARSE_MATRIX_H
+#define BT_DEFORMABLE_BLOCK_SPARSE_MATRIX_H
+
+#include "btSoftBody.h"
+#include "LinearMath/btMatrix3x3.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btQuickprof.h"
+
+// Block compressed sparse row matrix with 3x3 blocks, one block row per deformable node.
+// The sparsity pattern couples every pair of nodes that share a link, face or tetrahedron.
+class btDeformableBlockSparseMatrix
+{
+public:
+	typedef btAlignedObjectArray<btVector3> TVStack;
+
+	btAlignedObjectArray<int> m_rowOffsets;      // first block of each row, numRows + 1 entries
+	btAlignedObjectArray<int> m_columns;         // column of each block, sorted within a row
+	btAlignedObjectArray<int> m_diagonal;        // index of the diagonal block of each row
+	btAlignedObjectArray<btMatrix3x3> m_blocks;  // 3x3 blocks
+	bool m_missingBlock;                         // set if addBlock was called outside of the pattern
+
+	btDeformableBlockSparseMatrix()
+		: m_missingBlock(false)
+	{
+	}
+
+	int rows() const
+	{
+		return m_rowOffsets.size() ? m_rowOffsets.size() - 1 : 0;
+	}
+
+	void clear()
+	{
+		m_rowOffsets.clear();
+		m_columns.clear();
+		m_diagonal.clear();
+		m_blocks.clear();
+		m_missingBlock = false;
+	}
+
+	// build the pattern from the topology of the soft bodies, nodes are indexed by btSoftBody::Node::index
+	void buildPattern(const btAlignedObjectArray<btSoftBody*>& softBodies)
+	{
+		BT_PROFILE("buildPattern");
+		int numNodes = 0;
+		for (int i = 0; i < softBodies.size(); ++i)
+		{
+			numNodes += softBodies[i]->m_nodes.size();
+		}
+		// count the couplings of each row, duplicates included
+		btAlignedObjectArray<int> count;
+		count.resize(numNodes + 1, 0);
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			for (int i = 0; i < softBodies.size(); ++i)
+			{
+				const btSoftBody* psb = softBodies[i];
+				for (int j = 0; j < psb->m_nodes.size(); ++j)
+				{
+					couple(pass, count, int(psb->m_nodes[j].index), int(psb->m_nodes[j].index));
+				}
+				for (int j = 0; j < psb->m_links.size(); ++j)
+				{
+					const btSoftBody::Link& l = psb->m_links[j];
+					couple(pass, count, int(l.m_n[0]->index), int(l.m_n[1]->index));
+				}
+				for (int j = 0; j < psb->m_faces.size(); ++j)
+				{
+					const btSoftBody::Face& f = psb->m_faces[j];
+					for (int a = 0; a < 3; ++a)
+						couple(pass, count, int(f.m_n[a]->index), int(f.m_n[(a + 1) % 3]->index));
+				}
+				for (int j = 0; j < psb->m_tetras.size(); ++j)
+				{
+					const btSoftBody::Tetra& t = psb->m_tetras[j];
+					for (int a = 0; a < 4; ++a)
+						for (int b = a + 1; b < 4; ++b)
+							couple(pass, count, int(t.m_n[a]->index), int(t.m_n[b]->index));
+				}
+			}
+			if (pass == 0)
+			{
+				// exclusive prefix sum, count[r] becomes the fill cursor of row r
+				m_rowOffsets.resize(numNodes + 1);
+				int sum = 0;
+				for (int r = 0; r <= numNodes; ++r)
+				{
+					m_rowOffsets[r] = sum;
+					sum += count[r];
+					count[r] = m_rowOffsets[r];
+				}
+				m_columns.resize(sum);
+			}
+		}
+		// sort each row and drop duplicates
+		int numBlocks = 0;
+		m_diagonal.resize(numNodes);
+		for (int r = 0; r < numNodes; ++r)
+		{
+			int* cols = &m_columns[0] + m_rowOffsets[r];
+			const int n = m_rowOffsets[r + 1] - m_rowOffsets[r];
+			for (int i = 1; i < n; ++i)
+			{
+				const int c = cols[i];
+				int j = i - 1;
+				for (; j >= 0 && cols[j] > c; --j)
+					cols[j + 1] = cols[j];
+				cols[j + 1] = c;
+			}
+			m_rowOffsets[r] = numBlocks;
+			for (int i = 0; i < n; ++i)
+			{
+				if (i == 0 || cols[i] != cols[i - 1])
+				{
+					if (cols[i] == r)
+						m_diagonal[r] = numBlocks;
+					m_columns[numBlocks++] = cols[i];
+				}
+			}
+		}
+		m_rowOffsets[numNodes] = numBlocks;
+		m_columns.resize(numBlocks);
+		m_blocks.resize(numBlocks);
+		m_missingBlock = false;
+	}
+
+	void setZero()
+	{
+		for (int i = 0; i < m_blocks.size(); ++i)
+		{
+			m_blocks[i].setValue(0, 0, 0, 0, 0, 0, 0, 0, 0);
+		}
+		m_missingBlock = false;
+	}
+
+	// return the index of block (row, col) or -1 if it is not in the pattern
+	int findBlock(int row, int col) const
+	{
+		int lo = m_rowOffsets[row], hi = m_rowOffsets[row + 1];
+		while (lo < hi)
+		{
+			const int mid = (lo + hi) >> 1;
+			if (m_columns[mid] < col)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return (lo < m_rowOffsets[row + 1] && m_columns[lo] == col) ? lo : -1;
+	}
+
+	void addBlock(int row, int col, const btMatrix3x3& m)
+	{
+		const int k = findBlock(row, col);
+		if (k < 0)
+		{
+			m_missingBlock = true;
+			return;
+		}
+		m_blocks[k] += m;
+	}
+
+	void addDiagonalBlock(int row, const btMatrix3x3& m)
+	{
+		m_blocks[m_diagonal[row]] += m;
+	}
+
+	const btMatrix3x3& getDiagonalBlock(int row) const
+	{
+		return m_blocks[m_diagonal[row]];
+	}
+
+	struct MultiplyLoop : public btIParallelForBody
+	{
+		const btDeformableBlockSparseMatrix* m_A;
+		const btVector3* m_x;
+		btVector3* m_b;
+
+		MultiplyLoop(const btDeformableBlockSparseMatrix* A, const btVector3* x, btVector3* b)
+			: m_A(A), m_x(x), m_b(b)
+		{
+		}
+
+		void forLoop(int iBegin, int iEnd) const
+		{
+			const int* offsets = &m_A->m_rowOffsets[0];
+			const int* columns = &m_A->m_columns[0];
+			const btMatrix3x3* blocks = &m_A->m_blocks[0];
+			for (int r = iBegin; r < iEnd; ++r)
+			{
+				btVector3 sum(0, 0, 0);
+				for (int k = offsets[r]; k < offsets[r + 1]; ++k)
+				{
+					sum += blocks[k] * m_x[columns[k]];
+				}
+				m_b[r] = sum;
+			}
+		}
+	};
+
+	// b = A * x for the node rows, entries of b past rows() are left untouched
+	void multiply(const TVStack& x, TVStack& b) const
+	{
+		BT_PROFILE("btDeformableBlockSparseMatrix::multiply");
+		const int n = rows();
+		btAssert(x.size() >= n && b.size() >= n);
+		if (n == 0 || m_blocks.size() == 0)
+			return;
+		MultiplyLoop loop(this, &x[0], &b[0]);
+#if BT_THREADSAFE
+		if (btGetTaskScheduler())
+		{
+			btParallelFor(0, n, 256, loop);
+			return;
+		}
+#endif
+		loop.forLoop(0, n);
+	}
+
+private:
+	// pass 0 counts the couplings of each row, pass 1 writes them at the row cursors
+	void couple(int pass, btAlignedObjectArray<int>& cursor, int a, int b)
+	{
+		if (pass == 0)
+		{
+			++cursor[a];
+			if (a != b)
+				++cursor[b];
+		}
+		else
+		{
+			m_columns[cursor[a]++] = b;
+			if (a != b)
+				m_columns[cursor[b]++] = a;
+		}
+	}
+};
+
+#endif /* BT_DEFORMABLE_BLOCK_SPARSE_MATRIX_H */
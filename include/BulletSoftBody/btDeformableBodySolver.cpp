@@ -165,6 +165,7 @@ void btDeformableBodySolver::updateEnergy(btScalar scale)
 
 btScalar btDeformableBodySolver::computeDescentStep(TVStack& ddv, const TVStack& residual, bool verbose)
 {
+	m_objective->assembleMatrix();
 	m_cg.solve(*m_objective, ddv, residual, false);
 	btScalar inner_product = m_cg.dot(residual, m_ddv);
 	btScalar res_norm = m_objective->computeNorm(residual);
@@ -213,6 +214,7 @@ void btDeformableBodySolver::updateDv(btScalar scale)
 
 void btDeformableBodySolver::computeStep(TVStack& ddv, const TVStack& residual)
 {
+	m_objective->assembleMatrix();
 	if (m_useProjection)
 		m_cg.solve(*m_objective, ddv, residual, false);
 	else
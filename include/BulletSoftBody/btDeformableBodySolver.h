@@ -180,6 +180,10 @@ public:
 			case btDeformableBackwardEulerObjective::KKT_preconditioner:
 				m_objective->m_preconditioner = m_objective->m_KKTPreconditioner;
 				break;
+
+			case btDeformableBackwardEulerObjective::BlockJacobi_preconditioner:
+				m_objective->m_preconditioner = m_objective->m_blockJacobiPreconditioner;
+				break;
 			
 			default:
 				btAssert(false);
@@ -187,6 +191,13 @@ public:
 		}
 	}
 
+	// assemble the force differentials into a block sparse matrix once per linear solve instead of
+	// reevaluating every force in each Krylov iteration
+	virtual void setAssembledMatrix(bool opt)
+	{
+		m_objective->m_useAssembledMatrix = opt;
+	}
+
 	virtual btAlignedObjectArray<btDeformableLagrangianForce*>* getLagrangianForceArray()
 	{
 		return &(m_objective->m_lf);
@@ -115,6 +115,12 @@ public:
 
 	virtual void buildDampingForceDifferentialDiagonal(btScalar scale, TVStack& diagA) {}
 
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		// no force differential
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_COROTATED_FORCE;
@@ -74,6 +74,12 @@ public:
 		}
 	}
 
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		// no force differential
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_GRAVITY_FORCE;
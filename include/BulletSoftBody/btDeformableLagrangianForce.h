@@ -17,6 +17,7 @@
 #define BT_DEFORMABLE_LAGRANGIAN_FORCE_H
 
 #include "btSoftBody.h"
+#include "btDeformableBlockSparseMatrix.h"
 #include <LinearMath/btHashMap.h>
 #include <iostream>
 
@@ -68,6 +69,13 @@ public:
 
 	virtual void addScaledHessian(btScalar scale) {}
 
+	// add the damping (scaled by dampingScale) and elastic (scaled by elasticScale) force differentials to A as 3x3 blocks
+	// return false if the force can only be applied matrix free through the addScaled*ForceDifferential functions
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		return false;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType() = 0;
 
 	virtual void reinitialize(bool nodeUpdated)
@@ -110,6 +118,41 @@ public:
 		return btMatrix3x3(c1, c2, c3).transpose();
 	}
 
+	// Element blocks of a tetra, row d of m_kt[a][b] is the force on node a for a unit displacement of node b along axis d
+	struct TetraBlocks
+	{
+		btMatrix3x3 m_kt[4][4];
+		btVector3 m_g[4];  // shape function gradients, the force differential on node a is -measure * dP * m_g[a]
+	};
+
+	static void initTetraBlocks(const btSoftBody::Tetra& tetra, TetraBlocks& tb)
+	{
+		const btMatrix3x3& Dm_inverse = tetra.m_Dm_inverse;
+		tb.m_g[0] = -(Dm_inverse[0] + Dm_inverse[1] + Dm_inverse[2]);
+		tb.m_g[1] = Dm_inverse[0];
+		tb.m_g[2] = Dm_inverse[1];
+		tb.m_g[3] = Dm_inverse[2];
+	}
+
+	// dF for a unit displacement along axis d of the node with shape function gradient g
+	static btMatrix3x3 unitDeformationDifferential(int d, const btVector3& g)
+	{
+		btMatrix3x3 dF(0, 0, 0, 0, 0, 0, 0, 0, 0);
+		dF[d] = g;
+		return dF;
+	}
+
+	static void addTetraBlocks(const btSoftBody::Tetra& tetra, const TetraBlocks& tb, btDeformableBlockSparseMatrix& A)
+	{
+		for (int a = 0; a < 4; ++a)
+		{
+			for (int b = 0; b < 4; ++b)
+			{
+				A.addBlock(tetra.m_n[a]->index, tetra.m_n[b]->index, tb.m_kt[a][b].transpose());
+			}
+		}
+	}
+
 	// Calculate the incremental deformable generated from the current velocity
 	virtual btMatrix3x3 DsFromVelocity(const btSoftBody::Node* n0, const btSoftBody::Node* n1, const btSoftBody::Node* n2, const btSoftBody::Node* n3)
 	{
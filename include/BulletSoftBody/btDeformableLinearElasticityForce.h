@@ -454,6 +454,74 @@ public:
 		}
 	}
 
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		const bool damping = (dampingScale != 0) && (m_damping_alpha != 0 || m_damping_beta != 0);
+		const bool elastic = (elasticScale != 0);
+		if (!damping && !elastic)
+			return true;
+		TetraBlocks tb;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				const btSoftBody::Tetra& tetra = psb->m_tetras[j];
+				const btSoftBody::TetraScratch& s = psb->m_tetraScratches[j];
+				const btMatrix3x3& R = s.m_corotation;
+				const bool close_to_flat = (s.m_J < TETRA_FLAT_THRESHOLD);
+				initTetraBlocks(tetra, tb);
+				const btScalar dampingScale1 = -dampingScale * tetra.m_element_measure;
+				const btScalar elasticScale1 = -elasticScale * tetra.m_element_measure;
+				for (int b = 0; b < 4; ++b)
+				{
+					for (int d = 0; d < 3; ++d)
+					{
+						const btMatrix3x3 dF = unitDeformationDifferential(d, tb.m_g[b]);
+						const btMatrix3x3 corotated_dF = R.transpose() * dF;
+						btMatrix3x3 dP(0, 0, 0, 0, 0, 0, 0, 0, 0);
+						if (damping)
+						{
+							btMatrix3x3 dPd;
+							firstPiolaDampingDifferential(s, close_to_flat ? dF : corotated_dF, dPd);
+							dP += (close_to_flat ? dPd : R * dPd) * dampingScale1;
+						}
+						if (elastic)
+						{
+							btMatrix3x3 dPe;
+							firstPiolaDifferential(s, corotated_dF, dPe);
+							dP += R * dPe * elasticScale1;
+						}
+						for (int a = 0; a < 4; ++a)
+						{
+							tb.m_kt[a][b][d] = dP * tb.m_g[a];
+						}
+					}
+				}
+				addTetraBlocks(tetra, tb, A);
+			}
+			// mass proportional damping
+			if (damping && m_damping_alpha != 0)
+			{
+				btMatrix3x3 I;
+				I.setIdentity();
+				for (int j = 0; j < psb->m_nodes.size(); ++j)
+				{
+					const btSoftBody::Node& node = psb->m_nodes[j];
+					if (node.m_im > 0)
+					{
+						A.addBlock(node.index, node.index, I * (-dampingScale * m_damping_alpha / node.m_im));
+					}
+				}
+			}
+		}
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_LINEAR_ELASTICITY_FORCE;
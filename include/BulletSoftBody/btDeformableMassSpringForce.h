@@ -17,6 +17,7 @@
 #define BT_MASS_SPRING_H
 
 #include "btDeformableLagrangianForce.h"
+#include "btSoftBodyInternals.h"
 
 class btDeformableMassSpringForce : public btDeformableLagrangianForce
 {
@@ -292,6 +293,56 @@ public:
 		}
 	}
 
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		btMatrix3x3 I;
+		I.setIdentity();
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			const btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_links.size(); ++j)
+			{
+				const btSoftBody::Link& link = psb->m_links[j];
+				btSoftBody::Node* node1 = link.m_n[0];
+				btSoftBody::Node* node2 = link.m_n[1];
+				int id1 = node1->index;
+				int id2 = node2->index;
+				// damping, df1 = K * (dv2 - dv1)
+				btMatrix3x3 K = I * (m_dampingStiffness * dampingScale);
+				if (m_momentum_conserving)
+				{
+					if ((node2->m_x - node1->m_x).norm() > SIMD_EPSILON)
+					{
+						btVector3 dir = (node2->m_x - node1->m_x).normalized();
+						K = OuterProduct(dir, dir) * (m_dampingStiffness * dampingScale);
+					}
+				}
+				// elastic, df1 = E * (dx1 - dx2)
+				btMatrix3x3 E(0, 0, 0, 0, 0, 0, 0, 0, 0);
+				btVector3 dir = (node1->m_q - node2->m_q);
+				btScalar dir_norm = dir.norm();
+				if (elasticScale != 0 && dir_norm > SIMD_EPSILON)
+				{
+					btVector3 dir_normalized = dir.normalized();
+					btScalar scaled_k = elasticScale * (link.m_bbending ? m_bendingStiffness : m_elasticStiffness);
+					btScalar stretch = (dir_norm - link.m_rl) / dir_norm;
+					E = OuterProduct(dir_normalized, dir_normalized) * (scaled_k * (stretch - 1)) - I * (scaled_k * stretch);
+				}
+				const btMatrix3x3 diag = E - K;
+				const btMatrix3x3 offDiag = K - E;
+				A.addBlock(id1, id1, diag);
+				A.addBlock(id1, id2, offDiag);
+				A.addBlock(id2, id1, offDiag);
+				A.addBlock(id2, id2, diag);
+			}
+		}
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_MASSSPRING_FORCE;
@@ -17,6 +17,7 @@
 #define BT_MOUSE_PICKING_FORCE_H
 
 #include "btDeformableLagrangianForce.h"
+#include "btSoftBodyInternals.h"
 
 class btDeformableMousePickingForce : public btDeformableLagrangianForce
 {
@@ -153,6 +154,30 @@ public:
 		m_mouse_pos = p;
 	}
 
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		btMatrix3x3 I;
+		I.setIdentity();
+		for (int i = 0; i < 3; ++i)
+		{
+			btMatrix3x3 K = I * (m_dampingStiffness * dampingScale);
+			if ((m_face.m_n[i]->m_x - m_mouse_pos).norm() > SIMD_EPSILON)
+			{
+				btVector3 dir = (m_face.m_n[i]->m_x - m_mouse_pos).normalized();
+				K = OuterProduct(dir, dir) * (m_dampingStiffness * dampingScale);
+			}
+			// rest length is 0 for picking spring, so the elastic differential is isotropic
+			btMatrix3x3 E(0, 0, 0, 0, 0, 0, 0, 0, 0);
+			if ((m_face.m_n[i]->m_q - m_mouse_pos).norm() > SIMD_EPSILON)
+			{
+				E = I * (-elasticScale * m_elasticStiffness);
+			}
+			int id = m_face.m_n[i]->index;
+			A.addBlock(id, id, E - K);
+		}
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_MOUSE_PICKING_FORCE;
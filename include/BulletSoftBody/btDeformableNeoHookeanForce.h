@@ -412,6 +412,56 @@ public:
 		M[2][2] += scale * (dF[0][0] * F[1][1] + F[0][0] * dF[1][1] - dF[1][0] * F[0][1] - F[1][0] * dF[0][1]);
 	}
 
+	virtual bool addScaledForceDifferentialBlocks(btScalar dampingScale, btScalar elasticScale, btDeformableBlockSparseMatrix& A)
+	{
+		const bool damping = (dampingScale != 0) && (m_mu_damp != 0 || m_lambda_damp != 0);
+		const bool elastic = (elasticScale != 0);
+		if (!damping && !elastic)
+			return true;
+		btMatrix3x3 I;
+		I.setIdentity();
+		TetraBlocks tb;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			if (!psb->isActive())
+			{
+				continue;
+			}
+			for (int j = 0; j < psb->m_tetras.size(); ++j)
+			{
+				const btSoftBody::Tetra& tetra = psb->m_tetras[j];
+				initTetraBlocks(tetra, tb);
+				const btScalar dampingScale1 = -dampingScale * tetra.m_element_measure;
+				const btScalar elasticScale1 = -elasticScale * tetra.m_element_measure;
+				for (int b = 0; b < 4; ++b)
+				{
+					for (int d = 0; d < 3; ++d)
+					{
+						const btMatrix3x3 dF = unitDeformationDifferential(d, tb.m_g[b]);
+						btMatrix3x3 dP(0, 0, 0, 0, 0, 0, 0, 0, 0);
+						if (damping)
+						{
+							dP += ((dF + dF.transpose()) * m_mu_damp + I * (dF[0][0] + dF[1][1] + dF[2][2]) * m_lambda_damp) * dampingScale1;
+						}
+						if (elastic)
+						{
+							btMatrix3x3 dPe;
+							firstPiolaDifferential(psb->m_tetraScratches[j], dF, dPe);
+							dP += dPe * elasticScale1;
+						}
+						for (int a = 0; a < 4; ++a)
+						{
+							tb.m_kt[a][b][d] = dP * tb.m_g[a];
+						}
+					}
+				}
+				addTetraBlocks(tetra, tb, A);
+			}
+		}
+		return true;
+	}
+
 	virtual btDeformableLagrangianForceType getForceType()
 	{
 		return BT_NEOHOOKEAN_FORCE;
@@ -81,6 +81,59 @@ public:
 	}
 };
 
+// Inverts the 3x3 diagonal blocks of the assembled matrix, falls back to the mass preconditioner when no matrix is assembled
+class BlockJacobiPreconditioner : public Preconditioner
+{
+	btAlignedObjectArray<btMatrix3x3> m_inv_blocks;
+	const btAlignedObjectArray<btSoftBody*>& m_softBodies;
+	const btDeformableBlockSparseMatrix& m_A;
+	const bool& m_assembled;
+
+public:
+	BlockJacobiPreconditioner(const btAlignedObjectArray<btSoftBody*>& softBodies, const btDeformableBlockSparseMatrix& A, const bool& assembled)
+		: m_softBodies(softBodies), m_A(A), m_assembled(assembled)
+	{
+	}
+
+	virtual void reinitialize(bool nodeUpdated)
+	{
+		m_inv_blocks.resize(0);
+		btMatrix3x3 I;
+		I.setIdentity();
+		int counter = 0;
+		for (int i = 0; i < m_softBodies.size(); ++i)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			for (int j = 0; j < psb->m_nodes.size(); ++j, ++counter)
+			{
+				const btScalar im = psb->m_nodes[j].m_im;
+				btMatrix3x3 inv = I * im;
+				if (im != 0 && m_assembled && counter < m_A.rows())
+				{
+					const btMatrix3x3& D = m_A.getDiagonalBlock(counter);
+					if (btFabs(D.determinant()) > SIMD_EPSILON * SIMD_EPSILON)
+						inv = D.inverse();
+				}
+				m_inv_blocks.push_back(inv);
+			}
+		}
+	}
+
+	virtual void operator()(const TVStack& x, TVStack& b)
+	{
+		btAssert(b.size() == x.size());
+		btAssert(m_inv_blocks.size() <= x.size());
+		for (int i = 0; i < m_inv_blocks.size(); ++i)
+		{
+			b[i] = m_inv_blocks[i] * x[i];
+		}
+		for (int i = m_inv_blocks.size(); i < b.size(); ++i)
+		{
+			b[i] = x[i];
+		}
+	}
+};
+
 class KKTPreconditioner : public Preconditioner
 {
 	const btAlignedObjectArray<btSoftBody*>& m_softBodies;
@@ -20,6 +20,7 @@ subject to the following restrictions:
 #include "LinearMath/btSerializer.h"
 #include "LinearMath/btImplicitQRSVD.h"
 #include "LinearMath/btAlignedAllocator.h"
+#include "LinearMath/btThreads.h"
 #include "BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
 #include "BulletDynamics/Featherstone/btMultiBodyConstraint.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
@@ -400,6 +401,7 @@ void btSoftBody::appendLink(int model, Material* mat)
 		l.m_material = mat ? mat : m_materials[0];
 	}
 	m_links.push_back(l);
+	m_linkBatchOffsets.resize(0);
 }
 
 //
@@ -1479,6 +1481,7 @@ void btSoftBody::randomizeConstraints()
 	{
 		btSwap(m_links[i], m_links[NEXTRAND % ni]);
 	}
+	m_linkBatchOffsets.resize(0);
 	for (i = 0, ni = m_faces.size(); i < ni; ++i)
 	{
 		btSwap(m_faces[i], m_faces[NEXTRAND % ni]);
@@ -1486,6 +1489,323 @@ void btSoftBody::randomizeConstraints()
 #undef NEXTRAND
 }
 
+//
+int btSoftBody::colorLinks()
+{
+	BT_PROFILE("colorLinks");
+	const int nlinks = m_links.size();
+	const int nnodes = m_nodes.size();
+	m_linkBatchOffsets.resize(0);
+	if (nlinks == 0)
+		return 0;
+	/* Greedy coloring, 64 colors per pass using a node bitmask	*/
+	btAlignedObjectArray<int> colors;
+	btAlignedObjectArray<unsigned long long> used;
+	colors.resize(nlinks, -1);
+	used.resize(nnodes);
+	const Node* nbase = &m_nodes[0];
+	int ncolors = 0;
+	for (int pass = 0, remaining = nlinks; remaining > 0; ++pass)
+	{
+		for (int i = 0; i < nnodes; ++i)
+			used[i] = 0;
+		for (int i = 0; i < nlinks; ++i)
+		{
+			if (colors[i] >= 0)
+				continue;
+			const int ia = int(m_links[i].m_n[0] - nbase);
+			const int ib = int(m_links[i].m_n[1] - nbase);
+			const unsigned long long freeMask = ~(used[ia] | used[ib]);
+			if (freeMask == 0)
+				continue;
+			int bit = 0;
+			while (!(freeMask & (1ULL << bit)))
+				++bit;
+			used[ia] |= 1ULL << bit;
+			used[ib] |= 1ULL << bit;
+			colors[i] = pass * 64 + bit;
+			ncolors = btMax(ncolors, colors[i] + 1);
+			--remaining;
+		}
+	}
+	/* Counting sort links by color	*/
+	m_linkBatchOffsets.resize(ncolors + 1, 0);
+	for (int i = 0; i < nlinks; ++i)
+		++m_linkBatchOffsets[colors[i] + 1];
+	for (int c = 0; c < ncolors; ++c)
+		m_linkBatchOffsets[c + 1] += m_linkBatchOffsets[c];
+	btAlignedObjectArray<int> cursor;
+	cursor.resize(ncolors);
+	for (int c = 0; c < ncolors; ++c)
+		cursor[c] = m_linkBatchOffsets[c];
+	tLinkArray sorted;
+	sorted.resize(nlinks);
+	for (int i = 0; i < nlinks; ++i)
+		sorted[cursor[colors[i]]++] = m_links[i];
+	m_links.copyFromArray(sorted);
+	return ncolors;
+}
+
+//
+bool btSoftBody::hasColoredLinks() const
+{
+	return m_linkBatchOffsets.size() > 1 && m_linkBatchOffsets[m_linkBatchOffsets.size() - 1] == m_links.size();
+}
+
+//
+static inline unsigned int MortonSpread(unsigned int v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+struct LayoutKeyLess
+{
+	const unsigned int* m_keys;
+	LayoutKeyLess(const unsigned int* keys) : m_keys(keys) {}
+	bool operator()(int a, int b) const
+	{
+		return m_keys[a] < m_keys[b] || (m_keys[a] == m_keys[b] && a < b);
+	}
+};
+
+template <typename T>
+static void PermuteArray(btAlignedObjectArray<T>& items, const btAlignedObjectArray<int>& order)
+{
+	btAlignedObjectArray<T> sorted;
+	sorted.resize(items.size());
+	for (int i = 0, ni = items.size(); i < ni; ++i)
+	{
+		sorted[i] = items[order[i]];
+	}
+	/* Same size, so the storage and every pointer into it stay valid	*/
+	items.copyFromArray(sorted);
+}
+
+static void SortByKey(btAlignedObjectArray<unsigned int>& keys, btAlignedObjectArray<int>& order)
+{
+	order.resize(keys.size());
+	for (int i = 0, ni = keys.size(); i < ni; ++i)
+	{
+		order[i] = i;
+	}
+	if (keys.size() > 1)
+	{
+		order.quickSort(LayoutKeyLess(&keys[0]));
+	}
+}
+
+static void RemapFaceData(btDbvntNode* node, const btSoftBody::Face* base, const btAlignedObjectArray<int>& map)
+{
+	if (!node)
+		return;
+	if (node->isleaf())
+	{
+		node->data = (void*)(base + map[int((const btSoftBody::Face*)node->data - base)]);
+		return;
+	}
+	RemapFaceData(node->childs[0], base, map);
+	RemapFaceData(node->childs[1], base, map);
+}
+
+//
+void btSoftBody::optimizeLayout()
+{
+	BT_PROFILE("optimizeLayout");
+	const int nnodes = m_nodes.size();
+	if (nnodes == 0)
+		return;
+	int i, j, ni;
+	btAlignedObjectArray<unsigned int> keys;
+	btAlignedObjectArray<int> order, map;
+
+	/* Contacts are rebuilt by the next collision pass	*/
+	m_rcontacts.resize(0);
+	m_scontacts.resize(0);
+	m_nodeRigidContacts.resize(0);
+	m_faceRigidContacts.resize(0);
+	m_faceNodeContacts.resize(0);
+	m_faceNodeContactsCCD.resize(0);
+
+	/* Order nodes along a Morton curve	*/
+	btVector3 lo = m_nodes[0].m_x, hi = m_nodes[0].m_x;
+	for (i = 1; i < nnodes; ++i)
+	{
+		lo.setMin(m_nodes[i].m_x);
+		hi.setMax(m_nodes[i].m_x);
+	}
+	const btVector3 extent = hi - lo;
+	btVector3 scale;
+	for (j = 0; j < 3; ++j)
+	{
+		scale[j] = extent[j] > SIMD_EPSILON ? btScalar(1023) / extent[j] : btScalar(0);
+	}
+	keys.resize(nnodes);
+	for (i = 0; i < nnodes; ++i)
+	{
+		const btVector3 q = (m_nodes[i].m_x - lo) * scale;
+		keys[i] = MortonSpread((unsigned int)q.x()) |
+				  (MortonSpread((unsigned int)q.y()) << 1) |
+				  (MortonSpread((unsigned int)q.z()) << 2);
+	}
+	SortByKey(keys, order);
+	map.resize(nnodes);
+	for (i = 0; i < nnodes; ++i)
+	{
+		map[order[i]] = i;
+	}
+	/* m_userIndexMapping follows the nodes, it starts as the mapping of the current order	*/
+	if (m_userIndexMapping.size() == 0)
+	{
+		m_userIndexMapping.copyFromArray(map);
+	}
+	else
+	{
+		for (i = 0, ni = m_userIndexMapping.size(); i < ni; ++i)
+		{
+			int& index = m_userIndexMapping[i];
+			if (index >= 0 && index < nnodes)
+				index = map[index];
+		}
+	}
+	/* Node::index belongs to the slot, the deformable solvers key their arrays by it	*/
+	btAlignedObjectArray<int> slotIndices;
+	slotIndices.resize(nnodes);
+	for (i = 0; i < nnodes; ++i)
+	{
+		slotIndices[i] = m_nodes[i].index;
+	}
+	PermuteArray(m_nodes, order);
+	if (m_X.size() == nnodes)
+		PermuteArray(m_X, order);
+	if (m_pose.m_pos.size() == nnodes)
+		PermuteArray(m_pose.m_pos, order);
+	if (m_pose.m_wgh.size() == nnodes)
+		PermuteArray(m_pose.m_wgh, order);
+	Node* nbase = &m_nodes[0];
+#define REMAP_NODE(_p_) (nbase + map[int((_p_)-nbase)])
+	for (i = 0; i < nnodes; ++i)
+	{
+		m_nodes[i].index = slotIndices[i];
+		if (m_nodes[i].m_leaf)
+		{
+			m_nodes[i].m_leaf->data = &m_nodes[i];
+		}
+	}
+	for (i = 0, ni = m_links.size(); i < ni; ++i)
+	{
+		for (j = 0; j < 2; ++j)
+			m_links[i].m_n[j] = REMAP_NODE(m_links[i].m_n[j]);
+	}
+	for (i = 0, ni = m_faces.size(); i < ni; ++i)
+	{
+		for (j = 0; j < 3; ++j)
+			m_faces[i].m_n[j] = REMAP_NODE(m_faces[i].m_n[j]);
+	}
+	for (i = 0, ni = m_tetras.size(); i < ni; ++i)
+	{
+		for (j = 0; j < 4; ++j)
+			m_tetras[i].m_n[j] = REMAP_NODE(m_tetras[i].m_n[j]);
+	}
+	for (i = 0, ni = m_anchors.size(); i < ni; ++i)
+	{
+		m_anchors[i].m_node = REMAP_NODE(m_anchors[i].m_node);
+	}
+	for (i = 0, ni = m_deformableAnchors.size(); i < ni; ++i)
+	{
+		m_deformableAnchors[i].m_node = REMAP_NODE(m_deformableAnchors[i].m_node);
+	}
+	for (i = 0, ni = m_notes.size(); i < ni; ++i)
+	{
+		for (j = 0; j < m_notes[i].m_rank; ++j)
+			m_notes[i].m_nodes[j] = REMAP_NODE(m_notes[i].m_nodes[j]);
+	}
+	for (i = 0, ni = m_clusters.size(); i < ni; ++i)
+	{
+		Cluster* c = m_clusters[i];
+		for (j = 0; j < c->m_nodes.size(); ++j)
+			c->m_nodes[j] = REMAP_NODE(c->m_nodes[j]);
+	}
+	for (i = 0, ni = m_renderNodesParents.size(); i < ni; ++i)
+	{
+		for (j = 0; j < m_renderNodesParents[i].size(); ++j)
+		{
+			m_renderNodesParents[i][j] = REMAP_NODE(m_renderNodesParents[i][j]);
+		}
+	}
+#undef REMAP_NODE
+
+	/* Sort elements by their first node so the solver sweeps walk memory forward	*/
+	keys.resize(m_links.size());
+	for (i = 0, ni = m_links.size(); i < ni; ++i)
+	{
+		keys[i] = (unsigned int)btMin(m_links[i].m_n[0] - nbase, m_links[i].m_n[1] - nbase);
+	}
+	SortByKey(keys, order);
+	PermuteArray(m_links, order);
+	m_linkBatchOffsets.resize(0);
+
+	const int nfaces = m_faces.size();
+	if (nfaces)
+	{
+		keys.resize(nfaces);
+		for (i = 0; i < nfaces; ++i)
+		{
+			keys[i] = (unsigned int)btMin(btMin(m_faces[i].m_n[0] - nbase, m_faces[i].m_n[1] - nbase), m_faces[i].m_n[2] - nbase);
+		}
+		SortByKey(keys, order);
+		map.resize(nfaces);
+		for (i = 0; i < nfaces; ++i)
+		{
+			map[order[i]] = i;
+		}
+		btAlignedObjectArray<int> faceSlots;
+		faceSlots.resize(nfaces);
+		for (i = 0; i < nfaces; ++i)
+		{
+			faceSlots[i] = m_faces[i].m_index;
+		}
+		PermuteArray(m_faces, order);
+		for (i = 0; i < nfaces; ++i)
+		{
+			m_faces[i].m_index = faceSlots[i];
+			if (m_faces[i].m_leaf)
+			{
+				m_faces[i].m_leaf->data = &m_faces[i];
+			}
+		}
+		RemapFaceData(m_fdbvnt, &m_faces[0], map);
+	}
+
+	const int ntetras = m_tetras.size();
+	if (ntetras)
+	{
+		keys.resize(ntetras);
+		for (i = 0; i < ntetras; ++i)
+		{
+			const Tetra& t = m_tetras[i];
+			keys[i] = (unsigned int)btMin(btMin(t.m_n[0] - nbase, t.m_n[1] - nbase), btMin(t.m_n[2] - nbase, t.m_n[3] - nbase));
+		}
+		SortByKey(keys, order);
+		PermuteArray(m_tetras, order);
+		if (m_tetraScratches.size() == ntetras)
+			PermuteArray(m_tetraScratches, order);
+		if (m_tetraScratchesTn.size() == ntetras)
+			PermuteArray(m_tetraScratchesTn, order);
+		for (i = 0; i < ntetras; ++i)
+		{
+			if (m_tetras[i].m_leaf)
+			{
+				m_tetras[i].m_leaf->data = &m_tetras[i];
+			}
+		}
+	}
+}
+
 void btSoftBody::updateState(const btAlignedObjectArray<btVector3>& q, const btAlignedObjectArray<btVector3>& v)
 {
 	int node_count = m_nodes.size();
@@ -1719,6 +2039,8 @@ void btSoftBody::refine(ImplicitFn* ifn, btScalar accurary, bool cut)
 	int newnodes = 0;
 	int i, j, k, ni;
 
+	m_linkBatchOffsets.resize(0);
+
 	/* Filter out		*/
 	for (i = 0; i < m_links.size(); ++i)
 	{
@@ -4001,25 +4323,57 @@ void btSoftBody::PSolve_SContacts(btSoftBody* psb, btScalar, btScalar ti)
 }
 
 //
+static SIMD_FORCE_INLINE void PSolve_Link(btSoftBody::Link& l, btScalar kst)
+{
+	if (l.m_c0 > 0)
+	{
+		btSoftBody::Node& a = *l.m_n[0];
+		btSoftBody::Node& b = *l.m_n[1];
+		const btVector3 del = b.m_x - a.m_x;
+		const btScalar len = del.length2();
+		if (l.m_c1 + len > SIMD_EPSILON)
+		{
+			const btScalar k = ((l.m_c1 - len) / (l.m_c0 * (l.m_c1 + len))) * kst;
+			a.m_x -= del * (k * a.m_im);
+			b.m_x += del * (k * b.m_im);
+		}
+	}
+}
+
+struct PSolveLinkBatchLoop : public btIParallelForBody
+{
+	btSoftBody::Link* m_links;
+	btScalar m_kst;
+
+	PSolveLinkBatchLoop(btSoftBody::Link* links, btScalar kst) : m_links(links), m_kst(kst) {}
+
+	void forLoop(int iBegin, int iEnd) const
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			PSolve_Link(m_links[i], m_kst);
+		}
+	}
+};
+
 void btSoftBody::PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti)
 {
 	BT_PROFILE("PSolve_Links");
-	for (int i = 0, ni = psb->m_links.size(); i < ni; ++i)
+#if BT_THREADSAFE
+	/* Links of one color share no node, so each batch can be solved concurrently	*/
+	if (psb->hasColoredLinks() && btGetTaskScheduler() && btGetTaskScheduler()->getNumThreads() > 1)
 	{
-		Link& l = psb->m_links[i];
-		if (l.m_c0 > 0)
+		PSolveLinkBatchLoop loop(&psb->m_links[0], kst);
+		for (int c = 0, nc = psb->m_linkBatchOffsets.size() - 1; c < nc; ++c)
 		{
-			Node& a = *l.m_n[0];
-			Node& b = *l.m_n[1];
-			const btVector3 del = b.m_x - a.m_x;
-			const btScalar len = del.length2();
-			if (l.m_c1 + len > SIMD_EPSILON)
-			{
-				const btScalar k = ((l.m_c1 - len) / (l.m_c0 * (l.m_c1 + len))) * kst;
-				a.m_x -= del * (k * a.m_im);
-				b.m_x += del * (k * b.m_im);
-			}
+			btParallelFor(psb->m_linkBatchOffsets[c], psb->m_linkBatchOffsets[c + 1], 256, loop);
 		}
+		return;
+	}
+#endif
+	for (int i = 0, ni = psb->m_links.size(); i < ni; ++i)
+	{
+		PSolve_Link(psb->m_links[i], kst);
 	}
 }
 
@@ -4110,7 +4464,25 @@ void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap
 
 			docollide.dynmargin = basemargin + timemargin;
 			docollide.stamargin = basemargin;
-			m_ndbvt.collideTV(m_ndbvt.m_root, volume, docollide);
+
+			//gather the nodes first, so the SDF cells they touch are built in one parallel batch
+			btSoftColliders::CollectNodes collect;
+			m_ndbvt.collideTV(m_ndbvt.m_root, volume, collect);
+			const int numNodes = collect.m_nodes.size();
+			if (numNodes > 0)
+			{
+				btAlignedObjectArray<btVector3> localPositions;
+				localPositions.resize(numNodes);
+				for (int i = 0; i < numNodes; ++i)
+				{
+					localPositions[i] = wtr.invXform(collect.m_nodes[i]->m_x);
+				}
+				m_worldInfo->m_sparsesdf.BuildCells(&localPositions[0], numNodes, pcoWrap->getCollisionShape());
+				for (int i = 0; i < numNodes; ++i)
+				{
+					docollide.DoNode(*collect.m_nodes[i]);
+				}
+			}
 		}
 		break;
 		case fCollision::CL_RS:
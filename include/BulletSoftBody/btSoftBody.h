@@ -814,6 +814,7 @@ public:
 	tNodeArray m_nodes;                // Nodes
 	tRenderNodeArray m_renderNodes;    // Render Nodes
 	tLinkArray m_links;                // Links
+	btAlignedObjectArray<int> m_linkBatchOffsets;  // First link of each color after colorLinks(), empty when not colored
 	tFaceArray m_faces;                // Faces
 	tRenderFaceArray m_renderFaces;    // Faces
 	tTetraArray m_tetras;              // Tetras
@@ -1056,6 +1057,15 @@ public:
 								   Material* mat = 0);
 	/* Randomize constraints to reduce solver bias							*/
 	void randomizeConstraints();
+	/* Reorder links into batches that share no node, solved in parallel	*/
+	int colorLinks();
+	/* Return true if m_links is still ordered by colorLinks()				*/
+	bool hasColoredLinks() const;
+	/* Reorder nodes along a space filling curve and sort links, faces and	*/
+	/* tetras by node so solver sweeps are cache friendly. Call between steps	*/
+	/* The node indices in m_userIndexMapping are remapped, when it is empty	*/
+	/* it is filled with the new index of every node in the previous order	*/
+	void optimizeLayout();
 
 	void updateState(const btAlignedObjectArray<btVector3>& qs, const btAlignedObjectArray<btVector3>& vs);
 
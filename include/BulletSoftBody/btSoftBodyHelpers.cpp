@@ -661,6 +661,9 @@ void btSoftBodyHelpers::ReoptimizeLinkOrder(btSoftBody* psb /* This can be repla
 	delete[] linkDepFreeList;
 	delete[] linkDepListStarts;
 	delete[] linkBuffer;
+
+	// The new order no longer matches any link coloring
+	psb->m_linkBatchOffsets.resize(0);
 }
 
 //
@@ -1601,6 +1601,17 @@ struct btSoftColliders
 		}
 	};
 	//
+	// CollectNodes
+	//
+	struct CollectNodes : btDbvt::ICollide
+	{
+		void Process(const btDbvtNode* leaf)
+		{
+			m_nodes.push_back((btSoftBody::Node*)leaf->data);
+		}
+		btAlignedObjectArray<btSoftBody::Node*> m_nodes;
+	};
+	//
 	// CollideSDF_RS
 	//
 	struct CollideSDF_RS : btDbvt::ICollide
@@ -19,6 +19,10 @@ subject to the following restrictions:
 
 #include "BulletCollision/CollisionDispatch/btCollisionObject.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
+#include "BulletCollision/CollisionShapes/btSphereShape.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/CollisionShapes/btCapsuleShape.h"
+#include "LinearMath/btThreads.h"
 
 // Fast Hash
 
@@ -54,6 +58,15 @@ inline unsigned int HsiehHash(const char* data, int len)
 	return hash;
 }
 
+///Number of cells allocated at once by the btSparseSdf cell pool
+#ifndef BT_SPARSE_SDF_CELLS_PER_BLOCK
+#define BT_SPARSE_SDF_CELLS_PER_BLOCK 64
+#endif
+
+///Signed distance cache for convex shapes, sampled on a sparse grid of cells of CELLSIZE^3 voxels.
+///Cells are built on demand, either one at a time by Evaluate or in parallel batches by BuildCells,
+///and are kept in a least-recently-used list so the cache can be trimmed without scanning it.
+///Evaluate and BuildCells may be called from several threads at once.
 template <const int CELLSIZE>
 struct btSparseSdf
 {
@@ -74,6 +87,37 @@ struct btSparseSdf
 		unsigned hash;
 		const btCollisionShape* pclient;
 		Cell* next;
+		Cell* lruPrev;  //towards the most recently used cell
+		Cell* lruNext;  //towards the least recently used cell
+	};
+	struct CellKey
+	{
+		int c[3];
+		unsigned hash;
+	};
+	struct CellKeyLess
+	{
+		bool operator()(const CellKey& a, const CellKey& b) const
+		{
+			if (a.c[0] != b.c[0])
+				return a.c[0] < b.c[0];
+			if (a.c[1] != b.c[1])
+				return a.c[1] < b.c[1];
+			return a.c[2] < b.c[2];
+		}
+	};
+	struct BuildCellsLoop : public btIParallelForBody
+	{
+		const btSparseSdf* m_sdf;
+		Cell* const* m_cells;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			for (int i = iBegin; i < iEnd; ++i)
+			{
+				m_sdf->BuildCell(*m_cells[i]);
+			}
+		}
 	};
 	//
 	// Fields
@@ -88,9 +132,33 @@ struct btSparseSdf
 	int nprobes;
 	int nqueries;
 
+	btAlignedObjectArray<Cell*> m_cellBlocks;  //pooled cell memory, BT_SPARSE_SDF_CELLS_PER_BLOCK cells per block
+	Cell* m_freeCells;
+	Cell* m_lruHead;
+	Cell* m_lruTail;
+	btSpinMutex m_mutex;
+
+	btSparseSdf()
+		: voxelsz(0.25),
+		  m_defaultVoxelsz(0.25),
+		  puid(0),
+		  ncells(0),
+		  m_clampCells(256 * 1024),
+		  nprobes(1),
+		  nqueries(1),
+		  m_freeCells(0),
+		  m_lruHead(0),
+		  m_lruTail(0)
+	{
+	}
+
 	~btSparseSdf()
 	{
 		Reset();
+		for (int i = 0; i < m_cellBlocks.size(); ++i)
+		{
+			btAlignedFree(m_cellBlocks[i]);
+		}
 	}
 	//
 	// Methods
@@ -100,7 +168,7 @@ struct btSparseSdf
 	void Initialize(int hashsize = 2383, int clampCells = 256 * 1024)
 	{
 		//avoid a crash due to running out of memory, so clamp the maximum number of cells allocated
-		//if this limit is reached, the SDF is reset (at the cost of some performance during the reset)
+		//if this limit is reached, the least recently used cells are recycled
 		m_clampCells = clampCells;
 		cells.resize(hashsize, 0);
 		m_defaultVoxelsz = 0.25;
@@ -115,84 +183,143 @@ struct btSparseSdf
 
 	void Reset()
 	{
+		btMutexLock(&m_mutex);
+		while (m_lruHead)
+		{
+			Cell* pc = m_lruHead;
+			m_lruHead = pc->lruNext;
+			FreeCell(pc);
+		}
+		m_lruTail = 0;
 		for (int i = 0, ni = cells.size(); i < ni; ++i)
 		{
-			Cell* pc = cells[i];
 			cells[i] = 0;
-			while (pc)
-			{
-				Cell* pn = pc->next;
-				delete pc;
-				pc = pn;
-			}
 		}
 		voxelsz = m_defaultVoxelsz;
 		puid = 0;
 		ncells = 0;
 		nprobes = 1;
 		nqueries = 1;
+		btMutexUnlock(&m_mutex);
 	}
 	//
+	///Removes the cells that have not been used during the last 'lifetime' calls.
+	///Walks the least recently used end of the list only, so the cost is proportional to the number of evicted cells.
 	void GarbageCollect(int lifetime = 256)
 	{
+		btMutexLock(&m_mutex);
 		const int life = puid - lifetime;
-		for (int i = 0; i < cells.size(); ++i)
+		while (m_lruTail && m_lruTail->puid < life)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
-			while (pc)
-			{
-				Cell* pn = pc->next;
-				if (pc->puid < life)
-				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					--ncells;
-				}
-				pp = pc;
-				pc = pn;
-			}
+			EvictCell(m_lruTail);
 		}
 		//printf("GC[%d]: %d cells, PpQ: %f\r\n",puid,ncells,nprobes/(btScalar)nqueries);
 		nqueries = 1;
 		nprobes = 1;
 		++puid;  ///@todo: Reset puid's when int range limit is reached	*/
-		/* else setup a priority list...						*/
+		btMutexUnlock(&m_mutex);
 	}
 	//
 	int RemoveReferences(btCollisionShape* pcs)
 	{
+		btMutexLock(&m_mutex);
 		int refcount = 0;
-		for (int i = 0; i < cells.size(); ++i)
+		Cell* pc = m_lruHead;
+		while (pc)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
-			while (pc)
+			Cell* pn = pc->lruNext;
+			if (pc->pclient == pcs)
 			{
-				Cell* pn = pc->next;
-				if (pc->pclient == pcs)
-				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					++refcount;
-				}
-				pp = pc;
-				pc = pn;
+				EvictCell(pc);
+				++refcount;
 			}
+			pc = pn;
 		}
+		btMutexUnlock(&m_mutex);
 		return (refcount);
 	}
 	//
+	///Builds the cells needed to evaluate the given points, expressed in the local frame of shape.
+	///Missing cells are built in parallel with btParallelFor, so following Evaluate calls are plain lookups.
+	void BuildCells(const btVector3* points, int numPoints, const btCollisionShape* shape)
+	{
+		if (numPoints <= 0 || !shape->isConvex())
+			return;
+		btAlignedObjectArray<CellKey> keys;
+		keys.reserve(numPoints);
+		btMutexLock(&m_mutex);
+		for (int i = 0; i < numPoints; ++i)
+		{
+			const btVector3 scx = points[i] / voxelsz;
+			CellKey key;
+			key.c[0] = Decompose(scx.x()).b;
+			key.c[1] = Decompose(scx.y()).b;
+			key.c[2] = Decompose(scx.z()).b;
+			key.hash = Hash(key.c[0], key.c[1], key.c[2], shape);
+			if (!FindCell(key.hash, key.c[0], key.c[1], key.c[2], shape))
+			{
+				keys.push_back(key);
+			}
+		}
+		btMutexUnlock(&m_mutex);
+		if (keys.size() == 0)
+			return;
+
+		//neighbouring points mostly share cells
+		keys.quickSort(CellKeyLess());
+		int numUnique = 1;
+		for (int i = 1; i < keys.size(); ++i)
+		{
+			const CellKey& prev = keys[numUnique - 1];
+			if (keys[i].c[0] != prev.c[0] || keys[i].c[1] != prev.c[1] || keys[i].c[2] != prev.c[2])
+			{
+				keys[numUnique++] = keys[i];
+			}
+		}
+
+		//the new cells are not reachable from the hash table until they are built, so they are filled without the lock
+		btAlignedObjectArray<Cell*> pending;
+		pending.resize(numUnique);
+		btMutexLock(&m_mutex);
+		for (int i = 0; i < numUnique; ++i)
+		{
+			Cell* c = AllocateCell();
+			c->pclient = shape;
+			c->hash = keys[i].hash;
+			c->c[0] = keys[i].c[0];
+			c->c[1] = keys[i].c[1];
+			c->c[2] = keys[i].c[2];
+			pending[i] = c;
+		}
+		btMutexUnlock(&m_mutex);
+
+		BuildCellsLoop loop;
+		loop.m_sdf = this;
+		loop.m_cells = &pending[0];
+#if BT_THREADSAFE
+		if (btGetTaskScheduler())
+			btParallelFor(0, numUnique, 4, loop);
+		else
+#endif
+			loop.forLoop(0, numUnique);
+
+		btMutexLock(&m_mutex);
+		for (int i = 0; i < numUnique; ++i)
+		{
+			Cell* c = pending[i];
+			if (FindCell(c->hash, c->c[0], c->c[1], c->c[2], shape))
+			{
+				//another thread built it in the meantime
+				FreeCell(c);
+			}
+			else
+			{
+				InsertCell(c);
+			}
+		}
+		btMutexUnlock(&m_mutex);
+	}
+	//
 	btScalar Evaluate(const btVector3& x,
 					  const btCollisionShape* shape,
 					  btVector3& normal,
@@ -204,62 +331,47 @@ struct btSparseSdf
 		const IntFrac iy = Decompose(scx.y());
 		const IntFrac iz = Decompose(scx.z());
 		const unsigned h = Hash(ix.b, iy.b, iz.b, shape);
-		Cell*& root = cells[static_cast<int>(h % cells.size())];
-		Cell* c = root;
+		const int o[] = {ix.i, iy.i, iz.i};
+		btScalar d[8];
+		btMutexLock(&m_mutex);
 		++nqueries;
-		while (c)
+		Cell* c = FindCell(h, ix.b, iy.b, iz.b, shape);
+		if (!c)
 		{
+			//build outside of the lock, the distance queries are the expensive part
+			Cell* nc = AllocateCell();
+			btMutexUnlock(&m_mutex);
+			nc->pclient = shape;
+			nc->hash = h;
+			nc->c[0] = ix.b;
+			nc->c[1] = iy.b;
+			nc->c[2] = iz.b;
+			BuildCell(*nc);
+			btMutexLock(&m_mutex);
 			++nprobes;
-			if ((c->hash == h) &&
-				(c->c[0] == ix.b) &&
-				(c->c[1] == iy.b) &&
-				(c->c[2] == iz.b) &&
-				(c->pclient == shape))
+			c = FindCell(h, ix.b, iy.b, iz.b, shape);
+			if (c)
 			{
-				break;
+				FreeCell(nc);
 			}
 			else
 			{
-				// printf("c->hash/c[0][1][2]=%d,%d,%d,%d\n", c->hash, c->c[0], c->c[1],c->c[2]);
-				//printf("h,ixb,iyb,izb=%d,%d,%d,%d\n", h,ix.b, iy.b, iz.b);
-
-				c = c->next;
+				c = nc;
+				InsertCell(c);
 			}
 		}
-		if (!c)
-		{
-			++nprobes;
-			++ncells;
-			//int sz = sizeof(Cell);
-			if (ncells > m_clampCells)
-			{
-				//static int numResets = 0;
-				//numResets++;
-				//printf("numResets=%d\n",numResets);
-				Reset();
-			}
-
-			c = new Cell();
-			c->next = root;
-			root = c;
-			c->pclient = shape;
-			c->hash = h;
-			c->c[0] = ix.b;
-			c->c[1] = iy.b;
-			c->c[2] = iz.b;
-			BuildCell(*c);
-		}
 		c->puid = puid;
+		TouchCell(c);
 		/* Extract infos		*/
-		const int o[] = {ix.i, iy.i, iz.i};
-		const btScalar d[] = {c->d[o[0] + 0][o[1] + 0][o[2] + 0],
-							  c->d[o[0] + 1][o[1] + 0][o[2] + 0],
-							  c->d[o[0] + 1][o[1] + 1][o[2] + 0],
-							  c->d[o[0] + 0][o[1] + 1][o[2] + 0],
-							  c->d[o[0] + 0][o[1] + 0][o[2] + 1],
-							  c->d[o[0] + 1][o[1] + 0][o[2] + 1],
-							  c->d[o[0] + 1][o[1] + 1][o[2] + 1],
-							  c->d[o[0] + 0][o[1] + 1][o[2] + 1]};
+		d[0] = c->d[o[0] + 0][o[1] + 0][o[2] + 0];
+		d[1] = c->d[o[0] + 1][o[1] + 0][o[2] + 0];
+		d[2] = c->d[o[0] + 1][o[1] + 1][o[2] + 0];
+		d[3] = c->d[o[0] + 0][o[1] + 1][o[2] + 0];
+		d[4] = c->d[o[0] + 0][o[1] + 0][o[2] + 1];
+		d[5] = c->d[o[0] + 1][o[1] + 0][o[2] + 1];
+		d[6] = c->d[o[0] + 1][o[1] + 1][o[2] + 1];
+		d[7] = c->d[o[0] + 0][o[1] + 1][o[2] + 1];
+		btMutexUnlock(&m_mutex);
 		/* Normal	*/
 #if 1
 		const btScalar gx[] = {d[1] - d[0], d[2] - d[3],
@@ -286,7 +398,7 @@ struct btSparseSdf
 		return (Lerp(d0, d1, iz.f) - margin);
 	}
 	//
-	void BuildCell(Cell& c)
+	void BuildCell(Cell& c) const
 	{
 		const btVector3 org = btVector3((btScalar)c.c[0],
 										(btScalar)c.c[1],
@@ -311,6 +423,34 @@ struct btSparseSdf
 	static inline btScalar DistanceToShape(const btVector3& x,
 										   const btCollisionShape* shape)
 	{
+		//closed forms of what btGjkEpaSolver2::SignedDistance computes: distance to the core shape minus the margin
+		switch (shape->getShapeType())
+		{
+			case SPHERE_SHAPE_PROXYTYPE:
+			{
+				const btSphereShape* sphere = static_cast<const btSphereShape*>(shape);
+				return (x.length() - sphere->getRadius());
+			}
+			case BOX_SHAPE_PROXYTYPE:
+			{
+				const btBoxShape* box = static_cast<const btBoxShape*>(shape);
+				const btVector3 q = x.absolute() - box->getHalfExtentsWithoutMargin();
+				const btVector3 outside(btMax(q.x(), btScalar(0)), btMax(q.y(), btScalar(0)), btMax(q.z(), btScalar(0)));
+				const btScalar inside = btMin(btMax(q.x(), btMax(q.y(), q.z())), btScalar(0));
+				return (outside.length() + inside - box->getMargin());
+			}
+			case CAPSULE_SHAPE_PROXYTYPE:
+			{
+				const btCapsuleShape* capsule = static_cast<const btCapsuleShape*>(shape);
+				const int upAxis = capsule->getUpAxis();
+				const btScalar halfHeight = capsule->getHalfHeight();
+				btVector3 p = x;
+				p[upAxis] -= btMax(-halfHeight, btMin(halfHeight, p[upAxis]));
+				return (p.length() - capsule->getRadius());
+			}
+			default:
+				break;
+		}
 		btTransform unit;
 		unit.setIdentity();
 		if (shape->isConvex())
@@ -367,6 +507,105 @@ struct btSparseSdf
 
 		return result;
 	}
+
+private:
+	//the methods below expect m_mutex to be held
+	Cell* FindCell(unsigned h, int x, int y, int z, const btCollisionShape* shape)
+	{
+		Cell* c = cells[static_cast<int>(h % cells.size())];
+		while (c)
+		{
+			++nprobes;
+			if ((c->hash == h) &&
+				(c->c[0] == x) &&
+				(c->c[1] == y) &&
+				(c->c[2] == z) &&
+				(c->pclient == shape))
+			{
+				return c;
+			}
+			c = c->next;
+		}
+		return 0;
+	}
+	Cell* AllocateCell()
+	{
+		if (!m_freeCells)
+		{
+			Cell* block = (Cell*)btAlignedAlloc(sizeof(Cell) * BT_SPARSE_SDF_CELLS_PER_BLOCK, 16);
+			m_cellBlocks.push_back(block);
+			for (int i = 0; i < BT_SPARSE_SDF_CELLS_PER_BLOCK; ++i)
+			{
+				block[i].next = m_freeCells;
+				m_freeCells = &block[i];
+			}
+		}
+		Cell* c = m_freeCells;
+		m_freeCells = c->next;
+		c->next = 0;
+		c->lruPrev = 0;
+		c->lruNext = 0;
+		c->puid = puid;
+		return c;
+	}
+	void FreeCell(Cell* c)
+	{
+		c->next = m_freeCells;
+		m_freeCells = c;
+	}
+	void InsertCell(Cell* c)
+	{
+		if (ncells >= m_clampCells && m_lruTail)
+		{
+			EvictCell(m_lruTail);
+		}
+		Cell*& root = cells[static_cast<int>(c->hash % cells.size())];
+		c->next = root;
+		root = c;
+		c->lruPrev = 0;
+		c->lruNext = m_lruHead;
+		if (m_lruHead)
+			m_lruHead->lruPrev = c;
+		m_lruHead = c;
+		if (!m_lruTail)
+			m_lruTail = c;
+		++ncells;
+	}
+	void TouchCell(Cell* c)
+	{
+		if (c == m_lruHead)
+			return;
+		//unlink
+		c->lruPrev->lruNext = c->lruNext;
+		if (c->lruNext)
+			c->lruNext->lruPrev = c->lruPrev;
+		else
+			m_lruTail = c->lruPrev;
+		//push front
+		c->lruPrev = 0;
+		c->lruNext = m_lruHead;
+		m_lruHead->lruPrev = c;
+		m_lruHead = c;
+	}
+	void EvictCell(Cell* c)
+	{
+		Cell** link = &cells[static_cast<int>(c->hash % cells.size())];
+		while (*link != c)
+		{
+			link = &(*link)->next;
+		}
+		*link = c->next;
+		if (c->lruPrev)
+			c->lruPrev->lruNext = c->lruNext;
+		else
+			m_lruHead = c->lruNext;
+		if (c->lruNext)
+			c->lruNext->lruPrev = c->lruPrev;
+		else
+			m_lruTail = c->lruPrev;
+		--ncells;
+		FreeCell(c);
+	}
 };
 
 #endif  //BT_SPARSE_SDF_H
@@ -19,6 +19,7 @@ subject to the following restrictions:
 
 #include "LinearMath/btQuickprof.h"
 #include "LinearMath/btAlignedObjectArray.h"
+#include "LinearMath/btMinMax.h"
 #include <stdio.h>
 
 //#define BT_DEBUG_OSTREAM
@@ -158,7 +159,10 @@ struct btMatrixX
 	int m_setElemOperations;
 
 	btAlignedObjectArray<T> m_storage;
-	mutable btAlignedObjectArray<btAlignedObjectArray<int> > m_rowNonZeroElements1;
+	///non-zero columns of each row in compressed row storage, filled by rowComputeNonZeroElements:
+	///the columns of row i are m_rowNonZeroColumns[m_rowNonZeroOffsets[i] .. m_rowNonZeroOffsets[i+1]-1]
+	mutable btAlignedObjectArray<int> m_rowNonZeroOffsets;
+	mutable btAlignedObjectArray<int> m_rowNonZeroColumns;
 
 	T* getBufferPointerWritable()
 	{
@@ -242,16 +246,26 @@ struct btMatrixX
 
 	void copyLowerToUpperTriangle()
 	{
-		int count = 0;
-		for (int row = 0; row < rows(); row++)
+		//copy tile by tile, so that the strided column reads stay in cache
+		const int tileSize = 32;
+		const int n = rows();
+		T* data = getBufferPointerWritable();
+		for (int row0 = 0; row0 < n; row0 += tileSize)
 		{
-			for (int col = 0; col < row; col++)
+			const int row1 = btMin(row0 + tileSize, n);
+			for (int col0 = 0; col0 <= row0; col0 += tileSize)
 			{
-				setElem(col, row, (*this)(row, col));
-				count++;
+				const int col1 = btMin(col0 + tileSize, n);
+				for (int col = col0; col < col1; col++)
+				{
+					T* dst = data + (size_t)col * m_cols;
+					for (int row = btMax(row0, col + 1); row < row1; row++)
+					{
+						dst[row] = data[(size_t)row * m_cols + col];
+					}
+				}
 			}
 		}
-		//printf("copyLowerToUpperTriangle copied %d elements out of %dx%d=%d\n", count,rows(),cols(),cols()*rows());
 	}
 
 	const T& operator()(int row, int col) const
@@ -300,66 +314,88 @@ struct btMatrixX
 
 	void rowComputeNonZeroElements() const
 	{
-		m_rowNonZeroElements1.resize(rows());
+		m_rowNonZeroOffsets.resize(rows() + 1);
+		m_rowNonZeroColumns.resize(0);
+		const T* data = getBufferPointer();
 		for (int i = 0; i < rows(); i++)
 		{
-			m_rowNonZeroElements1[i].resize(0);
+			m_rowNonZeroOffsets[i] = m_rowNonZeroColumns.size();
+			const T* row = data + (size_t)i * m_cols;
 			for (int j = 0; j < cols(); j++)
 			{
-				if ((*this)(i, j) != 0.f)
+				if (row[j] != 0.f)
 				{
-					m_rowNonZeroElements1[i].push_back(j);
+					m_rowNonZeroColumns.push_back(j);
 				}
 			}
 		}
+		m_rowNonZeroOffsets[rows()] = m_rowNonZeroColumns.size();
 	}
 	btMatrixX transpose() const
 	{
-		//transpose is optimized for sparse matrices
+		//transpose tile by tile, so that both the reads and the writes stay in cache
+		const int tileSize = 32;
 		btMatrixX tr(m_cols, m_rows);
-		tr.setZero();
-		for (int i = 0; i < m_cols; i++)
-			for (int j = 0; j < m_rows; j++)
+		const T* src = getBufferPointer();
+		T* dst = tr.getBufferPointerWritable();
+		for (int j0 = 0; j0 < m_rows; j0 += tileSize)
+		{
+			const int j1 = btMin(j0 + tileSize, m_rows);
+			for (int i0 = 0; i0 < m_cols; i0 += tileSize)
 			{
-				T v = (*this)(j, i);
-				if (v)
+				const int i1 = btMin(i0 + tileSize, m_cols);
+				for (int i = i0; i < i1; i++)
 				{
-					tr.setElem(i, j, v);
+					for (int j = j0; j < j1; j++)
+					{
+						dst[(size_t)i * m_rows + j] = src[(size_t)j * m_cols + i];
+					}
 				}
 			}
+		}
 		return tr;
 	}
 
 	btMatrixX operator*(const btMatrixX& other)
 	{
-		//btMatrixX*btMatrixX implementation, brute force
+		//btMatrixX*btMatrixX implementation, cache blocked and skipping the zeros of this matrix.
+		//The inner loop runs over contiguous rows of other and res so the compiler can vectorize it,
+		//each element still accumulates its products in increasing k order.
 		btAssert(cols() == other.rows());
 
 		btMatrixX res(rows(), other.cols());
 		res.setZero();
-		//		BT_PROFILE("btMatrixX mul");
-		for (int i = 0; i < rows(); ++i)
+		const int numRows = rows();
+		const int numCols = other.cols();
+		const int numInner = cols();
+		if (!numRows || !numCols || !numInner)
+			return res;
+
+		const int blockSize = 64;
+		const T* a = getBufferPointer();
+		const T* b = other.getBufferPointer();
+		T* c = res.getBufferPointerWritable();
+		for (int j0 = 0; j0 < numCols; j0 += blockSize)
 		{
+			const int j1 = btMin(j0 + blockSize, numCols);
+			for (int k0 = 0; k0 < numInner; k0 += blockSize)
 			{
-				for (int j = 0; j < other.cols(); ++j)
+				const int k1 = btMin(k0 + blockSize, numInner);
+				for (int i = 0; i < numRows; ++i)
 				{
-					T dotProd = 0;
+					const T* aRow = a + (size_t)i * numInner;
+					T* cRow = c + (size_t)i * numCols;
+					for (int k = k0; k < k1; ++k)
 					{
+						const T w = aRow[k];
+						if (w == T(0))
+							continue;
+						const T* bRow = b + (size_t)k * numCols;
+						for (int j = j0; j < j1; ++j)
 						{
-							int c = cols();
-
-							for (int k = 0; k < c; k++)
-							{
-								T w = (*this)(i, k);
-								if (other(k, j) != 0.f)
-								{
-									dotProd += w * other(k, j);
-								}
-							}
+							cRow[j] += w * bRow[j];
 						}
 					}
-					if (dotProd)
-						res.setElem(i, j, dotProd);
 				}
 			}
 		}
@@ -382,7 +418,7 @@ struct btMatrixX
 				sum += bb[4] * cc[4];
 				sum += bb[5] * cc[5];
 				sum += bb[6] * cc[6];
-				addElem(row + i, col + j, sum);
+				m_storage[(row + i) * m_cols + col + j] += sum;
 				cc += 8;
 			}
 			bb += 8;
@@ -464,12 +500,163 @@ struct btMatrixX
 	}
 };
 
+///btBlockSparseMatrixX stores a matrix made of dense 1 x BlockSize row blocks, such as a constraint Jacobian
+///where each row only touches the 6 velocity components of one or two bodies.
+///Rows are appended in order, a block is addressed by its block column (the body index).
+template <typename T>
+struct btBlockSparseMatrixX
+{
+	enum
+	{
+		BlockSize = 6
+	};
+
+	int m_numBlockCols;
+	btAlignedObjectArray<int> m_rowOffsets;  // first block of each row, rows()+1 entries
+	btAlignedObjectArray<int> m_blockCols;   // block column of each block
+	btAlignedObjectArray<T> m_values;        // BlockSize values per block
+
+	//scratch for multiplyTranspose, the blocks of other sorted by block column
+	mutable btAlignedObjectArray<int> m_colOffsets;
+	mutable btAlignedObjectArray<int> m_colRows;
+	mutable btAlignedObjectArray<int> m_colBlocks;
+
+	btBlockSparseMatrixX()
+		: m_numBlockCols(0)
+	{
+		m_rowOffsets.push_back(0);
+	}
+
+	void reset(int numBlockCols)
+	{
+		m_numBlockCols = numBlockCols;
+		m_rowOffsets.resize(1);
+		m_rowOffsets[0] = 0;
+		m_blockCols.resize(0);
+		m_values.resize(0);
+	}
+
+	int rows() const
+	{
+		return m_rowOffsets.size() - 1;
+	}
+
+	int cols() const
+	{
+		return m_numBlockCols * BlockSize;
+	}
+
+	///append a zero block to the row that is being built, returns its BlockSize values
+	T* appendBlock(int blockCol)
+	{
+		btAssert(blockCol >= 0 && blockCol < m_numBlockCols);
+		m_blockCols.push_back(blockCol);
+		m_values.resize(m_values.size() + BlockSize, T(0));
+		return &m_values[m_values.size() - BlockSize];
+	}
+
+	void endRow()
+	{
+		m_rowOffsets.push_back(m_blockCols.size());
+	}
+
+	///res = this * M, where M is block diagonal with a BlockSize x BlockSize row major block per block column
+	void multiplyBlockDiagonal(const btAlignedObjectArray<T>& blockDiagonal, btBlockSparseMatrixX& res) const
+	{
+		btAssert(blockDiagonal.size() == m_numBlockCols * BlockSize * BlockSize);
+		res.m_numBlockCols = m_numBlockCols;
+		res.m_rowOffsets = m_rowOffsets;
+		res.m_blockCols = m_blockCols;
+		res.m_values.resize(m_values.size());
+		for (int b = 0; b < m_blockCols.size(); b++)
+		{
+			const T* v = &m_values[b * BlockSize];
+			const T* m = &blockDiagonal[m_blockCols[b] * BlockSize * BlockSize];
+			T* dst = &res.m_values[b * BlockSize];
+			for (int j = 0; j < BlockSize; j++)
+			{
+				dst[j] = 0;
+			}
+			for (int k = 0; k < BlockSize; k++)
+			{
+				const T w = v[k];
+				const T* mRow = m + k * BlockSize;
+				for (int j = 0; j < BlockSize; j++)
+				{
+					dst[j] += w * mRow[j];
+				}
+			}
+		}
+	}
+
+	///res = this * other^T as a dense matrix, only pairs of rows that share a block column contribute
+	void multiplyTranspose(const btBlockSparseMatrixX& other, btMatrixX<T>& res) const
+	{
+		btAssert(m_numBlockCols == other.m_numBlockCols);
+		res.resize(rows(), other.rows());
+		res.setZero();
+
+		//counting sort of the blocks of other by block column
+		m_colOffsets.resize(0);
+		m_colOffsets.resize(m_numBlockCols + 1, 0);
+		m_colRows.resize(other.m_blockCols.size());
+		m_colBlocks.resize(other.m_blockCols.size());
+		int i;
+		for (i = 0; i < other.m_blockCols.size(); i++)
+		{
+			m_colOffsets[other.m_blockCols[i] + 1]++;
+		}
+		for (i = 0; i < m_numBlockCols; i++)
+		{
+			m_colOffsets[i + 1] += m_colOffsets[i];
+		}
+		for (int row = 0; row < other.rows(); row++)
+		{
+			for (int b = other.m_rowOffsets[row]; b < other.m_rowOffsets[row + 1]; b++)
+			{
+				const int slot = m_colOffsets[other.m_blockCols[b]]++;
+				m_colRows[slot] = row;
+				m_colBlocks[slot] = b;
+			}
+		}
+		for (i = m_numBlockCols; i > 0; i--)
+		{
+			m_colOffsets[i] = m_colOffsets[i - 1];
+		}
+		m_colOffsets[0] = 0;
+
+		T* dst = res.getBufferPointerWritable();
+		for (int row = 0; row < rows(); row++)
+		{
+			T* dstRow = dst + (size_t)row * res.cols();
+			for (int b = m_rowOffsets[row]; b < m_rowOffsets[row + 1]; b++)
+			{
+				const T* v = &m_values[b * BlockSize];
+				const int col = m_blockCols[b];
+				for (int c = m_colOffsets[col]; c < m_colOffsets[col + 1]; c++)
+				{
+					const T* w = &other.m_values[m_colBlocks[c] * BlockSize];
+					T dot = v[0] * w[0];
+					for (int k = 1; k < BlockSize; k++)
+					{
+						dot += v[k] * w[k];
+					}
+					dstRow[m_colRows[c]] += dot;
+				}
+			}
+		}
+	}
+};
+
 typedef btMatrixX<float> btMatrixXf;
 typedef btVectorX<float> btVectorXf;
 
 typedef btMatrixX<double> btMatrixXd;
 typedef btVectorX<double> btVectorXd;
 
+typedef btBlockSparseMatrixX<float> btBlockSparseMatrixXf;
+typedef btBlockSparseMatrixX<double> btBlockSparseMatrixXd;
+
 #ifdef BT_DEBUG_OSTREAM
 template <typename T>
 std::ostream& operator<<(std::ostream& os, const btMatrixX<T>& mat)
@@ -524,9 +711,11 @@ inline void setElem(btMatrixXf& mat, int row, int col, float val)
 #ifdef BT_USE_DOUBLE_PRECISION
 #define btVectorXu btVectorXd
 #define btMatrixXu btMatrixXd
+#define btBlockSparseMatrixXu btBlockSparseMatrixXd
 #else
 #define btVectorXu btVectorXf
 #define btMatrixXu btMatrixXf
+#define btBlockSparseMatrixXu btBlockSparseMatrixXf
 #endif  //BT_USE_DOUBLE_PRECISION
 
 #endif  //BT_MATRIX_H_H
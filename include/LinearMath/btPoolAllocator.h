@@ -85,6 +85,22 @@ public:
 		return result;
 	}
 
+	///allocateBatch pops up to maxCount elements from the free list under a single lock.
+	///Returns the number of elements written to 'elements', which can be less than maxCount when the pool runs low.
+	int allocateBatch(void** elements, int maxCount)
+	{
+		btMutexLock(&m_mutex);
+		int count = 0;
+		while (count < maxCount && NULL != m_firstFree)
+		{
+			elements[count++] = m_firstFree;
+			m_firstFree = *(void**)m_firstFree;
+		}
+		m_freeCount -= count;
+		btMutexUnlock(&m_mutex);
+		return count;
+	}
+
 	bool validPtr(void* ptr)
 	{
 		if (ptr)
@@ -111,6 +127,50 @@ public:
 		}
 	}
 
+	///freeMemoryBatch returns several elements to the free list under a single lock
+	void freeMemoryBatch(void* const* elements, int count)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+		// link the batch together first, so the lock is only held for the splice
+		for (int i = 0; i < count - 1; ++i)
+		{
+			btAssert((unsigned char*)elements[i] >= m_pool && (unsigned char*)elements[i] < m_pool + m_maxElements * m_elemSize);
+			*(void**)elements[i] = elements[i + 1];
+		}
+		btAssert((unsigned char*)elements[count - 1] >= m_pool && (unsigned char*)elements[count - 1] < m_pool + m_maxElements * m_elemSize);
+
+		btMutexLock(&m_mutex);
+		*(void**)elements[count - 1] = m_firstFree;
+		m_firstFree = elements[0];
+		m_freeCount += count;
+		btMutexUnlock(&m_mutex);
+	}
+
+	///resetFreeList rebuilds the free list from every element that is not marked in 'used' (one flag per element),
+	///in ascending address order. Used to restore the allocations of a checkpoint, the caller copies the live elements back.
+	void resetFreeList(const unsigned char* used)
+	{
+		btMutexLock(&m_mutex);
+		void* firstFree = 0;
+		int freeCount = 0;
+		for (int i = m_maxElements - 1; i >= 0; --i)
+		{
+			if (!used[i])
+			{
+				unsigned char* p = m_pool + i * m_elemSize;
+				*(void**)p = firstFree;
+				firstFree = p;
+				++freeCount;
+			}
+		}
+		m_firstFree = firstFree;
+		m_freeCount = freeCount;
+		btMutexUnlock(&m_mutex);
+	}
+
 	int getElementSize() const
 	{
 		return m_elemSize;
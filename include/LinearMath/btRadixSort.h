@@ -0,0 +1,128 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2009 Erwin Coumans  http://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_RADIX_SORT_H
+#define BT_RADIX_SORT_H
+
+#include "btScalar.h"
+#include "btMinMax.h"
+#include "btAlignedObjectArray.h"
+#include "btThreads.h"
+#include <string.h>
+
+#define BT_RADIX_SORT_BITS 8
+#define BT_RADIX_SORT_BUCKETS (1 << BT_RADIX_SORT_BITS)
+#define BT_RADIX_SORT_MAX_BLOCKS 64
+
+///counts the digits of each block, or scatters the entries of each block when m_dst is set
+template <typename T, typename KeyOf>
+struct btRadixSortLoop : public btIParallelForBody
+{
+	const T* m_src;
+	T* m_dst;
+	unsigned int* m_histograms;
+	KeyOf m_keyOf;
+	int m_n;
+	int m_blockSize;
+	int m_shift;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		unsigned int offsets[BT_RADIX_SORT_BUCKETS];
+		for (int block = iBegin; block < iEnd; block++)
+		{
+			unsigned int* histogram = &m_histograms[block * BT_RADIX_SORT_BUCKETS];
+			int end = btMin(m_n, (block + 1) * m_blockSize);
+			if (!m_dst)
+			{
+				memset(histogram, 0, sizeof(unsigned int) * BT_RADIX_SORT_BUCKETS);
+				for (int i = block * m_blockSize; i < end; i++)
+				{
+					histogram[(m_keyOf(m_src[i]) >> m_shift) & (BT_RADIX_SORT_BUCKETS - 1)]++;
+				}
+			}
+			else
+			{
+				memcpy(offsets, histogram, sizeof(offsets));
+				for (int i = block * m_blockSize; i < end; i++)
+				{
+					m_dst[offsets[(m_keyOf(m_src[i]) >> m_shift) & (BT_RADIX_SORT_BUCKETS - 1)]++] = m_src[i];
+				}
+			}
+		}
+	}
+};
+
+///btRadixSort is a stable parallel LSD radix sort of entries that carry their key, keyOf(entry) returns it as an unsigned long long.
+///Only the low keyBits bits are sorted. The entries are split in blocks of at least grainSize that are counted and scattered through btParallelFor.
+///Passes where all keys have the same digit are skipped, the keys of a small region usually share their high digits.
+///buffer and histograms are scratch space, pass members to keep their memory between calls.
+template <typename T, typename KeyOf>
+void btRadixSort(btAlignedObjectArray<T>& entries, btAlignedObjectArray<T>& buffer, btAlignedObjectArray<unsigned int>& histograms, const KeyOf& keyOf, int keyBits, int grainSize)
+{
+	btAssert(keyBits >= 0 && keyBits <= 64);
+	int n = entries.size();
+	if (n <= 1)
+		return;
+
+	int numBlocks = btMax(1, btMin(BT_RADIX_SORT_MAX_BLOCKS, n / grainSize));
+	int blockSize = (n + numBlocks - 1) / numBlocks;
+	histograms.resizeNoInitialize(numBlocks * BT_RADIX_SORT_BUCKETS);
+	buffer.resizeNoInitialize(n);
+
+	T* src = &entries[0];
+	T* dst = &buffer[0];
+	btRadixSortLoop<T, KeyOf> loop;
+	loop.m_histograms = &histograms[0];
+	loop.m_keyOf = keyOf;
+	loop.m_n = n;
+	loop.m_blockSize = blockSize;
+	for (int shift = 0; shift < keyBits; shift += BT_RADIX_SORT_BITS)
+	{
+		loop.m_src = src;
+		loop.m_dst = 0;
+		loop.m_shift = shift;
+		btParallelFor(0, numBlocks, 1, loop);
+
+		//the counts become the first destination of each digit in each block
+		unsigned int offset = 0;
+		bool skipPass = false;
+		for (int digit = 0; digit < BT_RADIX_SORT_BUCKETS && !skipPass; digit++)
+		{
+			unsigned int digitBegin = offset;
+			for (int block = 0; block < numBlocks; block++)
+			{
+				unsigned int& entry = histograms[block * BT_RADIX_SORT_BUCKETS + digit];
+				unsigned int numEntries = entry;
+				entry = offset;
+				offset += numEntries;
+			}
+			skipPass = (offset - digitBegin) == (unsigned int)n;
+		}
+		if (skipPass)
+			continue;
+
+		loop.m_dst = dst;
+		btParallelFor(0, numBlocks, 1, loop);
+		btSwap(src, dst);
+	}
+
+	if (src != &entries[0])
+	{
+		memcpy(&entries[0], src, sizeof(T) * n);
+	}
+}
+
+#endif  //BT_RADIX_SORT_H
@@ -103,6 +103,12 @@ void btSpinMutex::unlock()
 	std::atomic_store_explicit(aDest, int(0), std::memory_order_release);
 }
 
+int btAtomicAdd(int* dest, int value)
+{
+	std::atomic<int>* aDest = reinterpret_cast<std::atomic<int>*>(dest);
+	return std::atomic_fetch_add_explicit(aDest, value, std::memory_order_relaxed);
+}
+
 #elif USE_MSVC_INTRINSICS
 
 #define WIN32_LEAN_AND_MEAN
@@ -133,6 +139,12 @@ void btSpinMutex::unlock()
 	_InterlockedExchange(aDest, 0);
 }
 
+int btAtomicAdd(int* dest, int value)
+{
+	volatile long* aDest = reinterpret_cast<long*>(dest);
+	return _InterlockedExchangeAdd(aDest, value);
+}
+
 #elif USE_GCC_BUILTIN_ATOMICS
 
 #define THREAD_LOCAL_STATIC static __thread
@@ -160,6 +172,11 @@ void btSpinMutex::unlock()
 	__atomic_store_n(&mLock, int(0), __ATOMIC_RELEASE);
 }
 
+int btAtomicAdd(int* dest, int value)
+{
+	return __atomic_fetch_add(dest, value, __ATOMIC_RELAXED);
+}
+
 #elif USE_GCC_BUILTIN_ATOMICS_OLD
 
 #define THREAD_LOCAL_STATIC static __thread
@@ -184,6 +201,11 @@ void btSpinMutex::unlock()
 	__sync_fetch_and_and(&mLock, int(0));
 }
 
+int btAtomicAdd(int* dest, int value)
+{
+	return __sync_fetch_and_add(dest, value);
+}
+
 #else  //#elif USE_MSVC_INTRINSICS
 
 #error "no threading primitives defined -- unknown platform"
@@ -209,6 +231,13 @@ bool btSpinMutex::tryLock()
 	return true;
 }
 
+int btAtomicAdd(int* dest, int value)
+{
+	int previous = *dest;
+	*dest += value;
+	return previous;
+}
+
 #define THREAD_LOCAL_STATIC static
 
 #endif  // #else //#if BT_THREADSAFE
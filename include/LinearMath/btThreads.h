@@ -95,6 +95,12 @@ SIMD_FORCE_INLINE bool btMutexTryLock(btSpinMutex* mutex)
 #endif  // #if BT_THREADSAFE
 }
 
+///
+/// btAtomicAdd -- adds value to *dest and returns the previous value, for counters that are shared
+///                by the bodies of a btParallelFor. A plain add if BT_THREADSAFE is 0.
+///
+int btAtomicAdd(int* dest, int value);
+
 //
 // btIParallelForBody -- subclass this to express work that can be done in parallel
 //
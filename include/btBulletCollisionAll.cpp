@@ -7,6 +7,10 @@
 #include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.cpp"
 #include "BulletCollision/BroadphaseCollision/btDispatcher.cpp"
 #include "BulletCollision/BroadphaseCollision/btSimpleBroadphase.cpp"
+#include "BulletCollision/BroadphaseCollision/btParallelBroadphaseUtil.cpp"
+#include "BulletCollision/BroadphaseCollision/btLinearBvhBroadphase.cpp"
+#include "BulletCollision/BroadphaseCollision/btParallelSapBroadphase.cpp"
+#include "BulletCollision/BroadphaseCollision/btHashedGridBroadphase.cpp"
 #include "BulletCollision/CollisionDispatch/SphereTriangleDetector.cpp"
 #include "BulletCollision/CollisionDispatch/btCompoundCollisionAlgorithm.cpp"
 #include "BulletCollision/CollisionDispatch/btHashedSimplePairCache.cpp"
@@ -2,6 +2,7 @@
 #include "BulletDynamics/Dynamics/btRigidBody.cpp"
 #include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.cpp"
 #include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.cpp"
+#include "BulletDynamics/Dynamics/btDynamicsWorldCheckpoint.cpp"
 #include "BulletDynamics/Dynamics/btSimpleDynamicsWorld.cpp"
 #include "BulletDynamics/ConstraintSolver/btBatchedConstraints.cpp"
 #include "BulletDynamics/ConstraintSolver/btConeTwistConstraint.cpp"
@@ -15,6 +16,7 @@
 #include "BulletDynamics/ConstraintSolver/btTypedConstraint.cpp"
 #include "BulletDynamics/ConstraintSolver/btGearConstraint.cpp"
 #include "BulletDynamics/ConstraintSolver/btNNCGConstraintSolver.cpp"
+#include "BulletDynamics/ConstraintSolver/btJacobiConstraintSolver.cpp"
 #include "BulletDynamics/ConstraintSolver/btUniversalConstraint.cpp"
 #include "BulletDynamics/ConstraintSolver/btGeneric6DofConstraint.cpp"
 #include "BulletDynamics/ConstraintSolver/btPoint2PointConstraint.cpp"
@@ -26,6 +28,7 @@
 #include "BulletDynamics/MLCPSolvers/btMLCPSolver.cpp"
 #include "BulletDynamics/Featherstone/btMultiBody.cpp"
 #include "BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.cpp"
+#include "BulletDynamics/Featherstone/btMultiBodyDynamicsWorldMt.cpp"
 #include "BulletDynamics/Featherstone/btMultiBodyJointMotor.cpp"
 #include "BulletDynamics/Featherstone/btMultiBodyGearConstraint.cpp"
 #include "BulletDynamics/Featherstone/btMultiBodyConstraint.cpp"